@@ -0,0 +1,52 @@
+// XerxesLibraryBench.cpp : Times the media library on a generated catalog (see library_benchmark). The same seed generates
+// the same catalog everywhere, so runs on different machines search the same words. Exits with 1 if the searches find the
+// wrong items, so a build can run it.
+//
+//   XerxesLibraryBench [--items n] [--seed n] [database file]
+//   XerxesLibraryBench --assets [database file]
+//
+// The database file is removed and created again; it defaults to library_benchmark.db in the current folder.
+// --assets checks the content hash against reference XXH64 hashes and times importing into an asset store instead (see
+// asset_benchmark), and fails if a hash doesn't match or an import isn't deduplicated. Large assets are written to the
+// asset_benchmark folder.
+
+#include "stdafx.h"
+#include "..\configlib\library_benchmark.h"
+#include "..\configlib\asset_benchmark.h"
+
+#include <cstdlib>
+#include <cstring>
+
+using namespace xerxes;
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1 && std::strcmp(argv[1], "--assets") == 0) {
+        asset_benchmark_options options;
+        if (argc > 2) {
+            options.fn = argv[2];
+        }
+        auto result = asset_benchmark::run(options);
+        std::printf("%d small and %d large assets, each imported twice\n%s", options.small_assets, options.large_assets, result.format().c_str());
+        return result.passed() ? 0 : 1;
+    }
+
+    library_benchmark_options options;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--items") == 0 && i + 1 < argc) {
+            options.items = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            options.seed = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else {
+            options.fn = argv[i];
+        }
+    }
+
+    std::printf("%d items, %d words, %d-%d lyric words per item, seed %u\n", options.items, static_cast<int>(options.vocabulary_size),
+        options.fewest_lyric_words, options.most_lyric_words, options.seed);
+    auto result = library_benchmark::run(options);
+    std::printf("%s", result.format().c_str());
+    return result.passed() ? 0 : 1;
+}
\ No newline at end of file
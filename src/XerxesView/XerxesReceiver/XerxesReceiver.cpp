@@ -0,0 +1,72 @@
+// XerxesReceiver.cpp : The reference receiver of the canvas network output. It connects to the output on this machine,
+// rebuilds the canvas from the stream and reports what arrives once a second. Given a path, it also keeps the latest canvas
+// there as a PPM image.
+//
+//   XerxesReceiver [port] [canvas.ppm]
+//
+
+#include "stdafx.h"
+#include "..\renderlib\network_output.h"
+#include "..\renderlib\network_receiver.h"
+#include "..\renderlib\golden_image.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+using namespace xerxes;
+
+namespace
+{
+    const std::chrono::seconds report_interval(1);
+    const std::chrono::seconds retry_interval(1);
+    // Wake up this often to report, as a static slide sends nothing at all
+    const std::chrono::milliseconds poll_interval(100);
+}
+
+int main(int argc, char *argv[])
+{
+    auto port = argc > 1 ? static_cast<uint16_t>(std::atoi(argv[1])) : network_output::default_port;
+    std::string snapshot = argc > 2 ? argv[2] : "";
+
+    auto waiting = false;
+    for (;;) {
+        network_receiver receiver;
+        if (!receiver.try_connect(port)) {
+            if (!waiting) {
+                std::printf("Waiting for the canvas on port %u\n", static_cast<unsigned>(port));
+                waiting = true;
+            }
+            std::this_thread::sleep_for(retry_interval);
+            continue;
+        }
+        std::printf("Connected to the canvas on port %u\n", static_cast<unsigned>(port));
+        waiting = false;
+
+        auto reported = std::chrono::steady_clock::now();
+        network_receiver_statistics last{};
+        for (;;) {
+            if (receiver.wait(poll_interval) && !receiver.try_receive()) break;
+
+            auto now = std::chrono::steady_clock::now();
+            if (now - reported < report_interval) continue;
+
+            auto seconds = std::chrono::duration<double>(now - reported).count();
+            auto &statistics = receiver.get_statistics();
+            auto &frame = receiver.get_frame();
+            std::printf("frame %llu, %dx%d: %.1f messages/s, %.0f tiles/s, %.1f kB/s, %llu key frames\n",
+                static_cast<unsigned long long>(receiver.get_last_header().index), frame.width(), frame.height(),
+                (statistics.frames - last.frames) / seconds, (statistics.tiles - last.tiles) / seconds,
+                (statistics.bytes - last.bytes) / seconds / 1024.0, static_cast<unsigned long long>(statistics.key_frames));
+            if (!snapshot.empty() && receiver.has_frame() && statistics.frames != last.frames && !golden_image::try_write(snapshot, frame)) {
+                std::printf("Couldn't write %s\n", snapshot.c_str());
+            }
+            // Whoever reads this may be a log rather than a console
+            std::fflush(stdout);
+            last = statistics;
+            reported = now;
+        }
+        std::printf("The canvas went away, or sent something that isn't a frame stream\n");
+    }
+}
\ No newline at end of file
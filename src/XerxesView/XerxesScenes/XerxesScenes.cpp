@@ -0,0 +1,169 @@
+// XerxesScenes.cpp : The golden frame regression suite. Renders every <name>.scene in the scenes folder headlessly and
+// compares its captures with the golden frames in <name>\. Exits with 1 if any capture doesn't match, so a build can run it.
+//
+//   XerxesScenes [--update] [--threads n] [scenes folder]
+//   XerxesScenes --bench [frames]
+//   XerxesScenes --decode-bench [frames]
+//   XerxesScenes --color-bench [repeats]
+//
+// --update writes the captures as the new golden frames; look at them before committing.
+// --bench times composing a 4K canvas serially and on pools of increasing size instead (see tile_benchmark), and fails if
+// a pool composes different pixels.
+// --decode-bench times synthetic 1080p frames through the media decoder and its frame pool (see decode_benchmark), and fails
+// if frames go missing.
+// --color-bench times converting random 1080p YUV planes at every SIMD level (see color_benchmark), and fails if a level
+// converts different pixels than the scalar kernel.
+
+#include "stdafx.h"
+#include "..\renderlib\headless_renderer.h"
+#include "..\renderlib\tile_benchmark.h"
+#include "..\renderlib\decode_benchmark.h"
+#include "..\renderlib\color_benchmark.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+using namespace xerxes;
+
+namespace
+{
+#ifdef _WIN32
+    const char separator = '\\';
+#else
+    const char separator = '/';
+#endif
+    const std::string scene_extension = ".scene";
+
+    // The names of the scenes in folder, without the extension, sorted so the runs are reported in the same order everywhere
+    auto find_scenes(const std::string &folder) -> std::vector<std::string>
+    {
+        std::vector<std::string> names;
+#ifdef _WIN32
+        WIN32_FIND_DATAA data;
+        auto find = FindFirstFileA((folder + "*" + scene_extension).c_str(), &data);
+        if (find != INVALID_HANDLE_VALUE) {
+            do {
+                std::string name(data.cFileName);
+                names.push_back(name.substr(0, name.size() - scene_extension.size()));
+            } while (FindNextFileA(find, &data));
+            FindClose(find);
+        }
+#else
+        auto dir = opendir(folder.c_str());
+        if (dir != nullptr) {
+            while (auto entry = readdir(dir)) {
+                std::string name(entry->d_name);
+                if (name.size() > scene_extension.size() && name.compare(name.size() - scene_extension.size(), scene_extension.size(), scene_extension) == 0) {
+                    names.push_back(name.substr(0, name.size() - scene_extension.size()));
+                }
+            }
+            closedir(dir);
+        }
+#endif
+        std::sort(names.begin(), names.end());
+        return names;
+    }
+
+    // A new scene has no folder for its golden frames yet
+    auto create_folder(const std::string &folder) -> void
+    {
+#ifdef _WIN32
+        CreateDirectoryA(folder.c_str(), NULL);
+#else
+        mkdir(folder.c_str(), 0755);
+#endif
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1 && std::strcmp(argv[1], "--bench") == 0) {
+        tile_benchmark_options options;
+        if (argc > 2) {
+            options.frames = static_cast<uint64_t>(std::atoi(argv[2]));
+        }
+        auto result = tile_benchmark::run(options);
+        std::printf("%dx%d canvas, %dx%d video, %llu frames\n%s", options.width, options.height, options.video_width, options.video_height,
+            static_cast<unsigned long long>(options.frames), result.format().c_str());
+        return result.passed() ? 0 : 1;
+    }
+
+    if (argc > 1 && std::strcmp(argv[1], "--decode-bench") == 0) {
+        decode_benchmark_options options;
+        if (argc > 2) {
+            options.frames = static_cast<uint64_t>(std::atoi(argv[2]));
+        }
+        auto result = decode_benchmark::run(options);
+        std::printf("%dx%d frames, %llu per run, queue of %llu, %llu spare\n%s", options.width, options.height, static_cast<unsigned long long>(options.frames),
+            static_cast<unsigned long long>(options.queue_depth), static_cast<unsigned long long>(options.spare_frames), result.format().c_str());
+        return result.passed() ? 0 : 1;
+    }
+
+    if (argc > 1 && std::strcmp(argv[1], "--color-bench") == 0) {
+        color_benchmark_options options;
+        if (argc > 2) {
+            options.repeats = std::atoi(argv[2]);
+        }
+        auto result = color_benchmark::run(options);
+        std::printf("%dx%d pictures, scaled to %dx%d, %d repeats\n%s", options.width, options.height, options.scaled_width, options.scaled_height,
+            options.repeats, result.format().c_str());
+        return result.passed() ? 0 : 1;
+    }
+
+    headless_options options;
+    std::string folder = std::string("scenes") + separator;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--update") == 0) {
+            options.update_goldens = true;
+        }
+        else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            options.threads = static_cast<size_t>(std::atoi(argv[++i]));
+        }
+        else {
+            folder = argv[i];
+            if (folder.back() != '/' && folder.back() != separator) {
+                folder += separator;
+            }
+        }
+    }
+
+    auto scenes = find_scenes(folder);
+    if (scenes.empty()) {
+        std::printf("No scenes in %s\n", folder.c_str());
+        return 1;
+    }
+
+    auto failed = 0;
+    for (auto &name : scenes) {
+        std::ifstream in(folder + name + scene_extension);
+        scene_script script;
+        std::string error;
+        if (!in || !scene_script::try_parse(in, script, error)) {
+            std::printf("%s: %s\n", name.c_str(), in ? error.c_str() : "can't be read");
+            failed++;
+            continue;
+        }
+
+        options.golden_folder = folder + name + separator;
+        if (options.update_goldens) {
+            create_folder(options.golden_folder);
+        }
+        auto result = headless_renderer::run(script, options);
+        std::printf("%s\n%s", name.c_str(), result.format().c_str());
+        if (!result.passed()) {
+            failed++;
+        }
+    }
+
+    std::printf("%d of %d scenes %s\n", failed == 0 ? static_cast<int>(scenes.size()) : failed, static_cast<int>(scenes.size()), failed == 0 ? "passed" : "failed");
+    return failed == 0 ? 0 : 1;
+}
\ No newline at end of file
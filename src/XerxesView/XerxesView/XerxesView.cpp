@@ -10,7 +10,31 @@
 #include "configuration_manager.h"
 #include "application.h"
 #include "..\configlib\system_configuration.h"
+#include "..\renderlib\task_graph.h"
+#include "..\renderlib\startup_trace.h"
+#include "..\renderlib\event_trace.h"
 #include <ShlObj.h>
+#include <shellapi.h>
+#include <mfapi.h>
+#include <chrono>
+#include <fstream>
+#include <memory>
+
+namespace
+{
+    // The loader and the C runtime run before wWinMain. GetProcessTimes knows when the process was created, to the
+    // resolution of the system clock.
+    auto record_process_start() -> void
+    {
+        FILETIME creation, exit, kernel, user, now;
+        if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) return;
+        GetSystemTimeAsFileTime(&now);
+        auto to_100ns = [](const FILETIME &t) { return (static_cast<long long>(t.dwHighDateTime) << 32) | t.dwLowDateTime; };
+        auto before = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds((to_100ns(now) - to_100ns(creation)) * 100));
+        auto origin = xerxes::startup_trace::get_origin();
+        xerxes::startup_trace::record("process start to wWinMain", origin - before, origin);
+    }
+}
 
 int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
                      _In_opt_ HINSTANCE hPrevInstance,
@@ -20,46 +44,127 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
     UNREFERENCED_PARAMETER(hPrevInstance);
     UNREFERENCED_PARAMETER(lpCmdLine);
 
+    // Startup is traced from here until the canvas presents its first frame
+    xerxes::startup_trace::set_origin(std::chrono::steady_clock::now());
+    record_process_start();
+    xerxes::event_trace::set_thread_name("main");
+
     try {
-        char papp_data[MAX_PATH];
+        // Whichever way this returns, a trace dump being written has to finish, as its thread can't be left running
+        struct trace_flush {
+            ~trace_flush() { xerxes::event_trace::shutdown(); }
+        } trace_on_exit;
+
+        // Whichever way this returns, what the startup task started is shut down again, after the decoders are released
+        struct media_foundation_shutdown {
+            bool com_started = false;
+            bool mf_started = false;
+            ~media_foundation_shutdown() {
+                if (mf_started) {
+                    xerxes::canvas_window::release_media();
+                    MFShutdown();
+                }
+                if (com_started) CoUninitialize();
+            }
+        } media_foundation_on_exit;
 
-        if (!SUCCEEDED(SHGetFolderPathA(NULL, CSIDL_APPDATA, NULL, 0, papp_data))) {
-            MessageBoxA(NULL, "Could not find the system APP DATA folder", "Failure initializing the application", MB_OK);
-            return -1;
-        }
+        std::string app_data;
+        std::unique_ptr<xerxes::system_configuration> syscfg;
+        std::unique_ptr<xerxes::thumbnail_cache> thumbnails;
+        std::unique_ptr<xerxes::media_library> library;
+        std::unique_ptr<xerxes::asset_store> assets;
 
-        std::string app_data(papp_data);
-        if (app_data.empty()) {
-            app_data = ".\\";
+        try {
+            // Opening the databases, starting Media Foundation and enumerating the monitors don't depend on each other
+            xerxes::task_graph startup;
+            auto folder = startup.add("app data folder", [&app_data]() {
+                char papp_data[MAX_PATH];
+                if (!SUCCEEDED(SHGetFolderPathA(NULL, CSIDL_APPDATA, NULL, 0, papp_data))) throw std::exception("Could not find the system APP DATA folder");
+
+                app_data = papp_data;
+                if (app_data.empty()) {
+                    app_data = ".\\";
+                }
+                if (!app_data.empty() && app_data[app_data.size() - 1] != '\\') {
+                    app_data += '\\';
+                }
+
+                app_data.append("XerxesView\\");
+
+                CreateDirectoryA(app_data.c_str(), NULL);
+                // Flight recorder dumps, after a frame spike or when the operator asks
+                CreateDirectoryA((app_data + "traces").c_str(), NULL);
+                xerxes::event_trace::set_dump_folder(app_data + "traces\\");
+            }, {}, true);
+            auto open_syscfg = startup.add("open syscfg.db", [&]() {
+                xerxes::event_trace::scope trace("prepare syscfg.db");
+                syscfg.reset(new xerxes::system_configuration(app_data + "syscfg.db"));
+            }, { folder });
+            auto open_thumbnails = startup.add("open thumbnails.db", [&]() { thumbnails.reset(new xerxes::thumbnail_cache(app_data + "thumbnails.db")); }, { folder });
+            auto open_library = startup.add("open library.db", [&]() { library.reset(new xerxes::media_library(app_data + "library.db")); }, { folder });
+            auto open_assets = startup.add("open assets.db", [&]() {
+                // Asset files are opened with wide paths
+                wchar_t wide_app_data[MAX_PATH];
+                MultiByteToWideChar(CP_ACP, 0, app_data.c_str(), -1, wide_app_data, MAX_PATH);
+                assets.reset(new xerxes::asset_store(app_data + "assets.db", std::wstring(wide_app_data) + L"assets"));
+            }, { folder });
+            // COM belongs to this thread's apartment, which the windows and the media player live in
+            startup.add("start media foundation", [&media_foundation_on_exit]() {
+                media_foundation_on_exit.com_started = SUCCEEDED(CoInitializeEx(NULL, COINIT_APARTMENTTHREADED));
+                media_foundation_on_exit.mf_started = media_foundation_on_exit.com_started && SUCCEEDED(MFStartup(MF_VERSION));
+                if (!media_foundation_on_exit.mf_started) throw std::exception("Could not start Media Foundation");
+            }, {}, true);
+            auto displays = startup.add("enumerate displays", []() { xerxes::configuration_manager::read_displays(); });
+            auto app = startup.add("application", [&]() {
+                xerxes::application::initialize(hInstance, syscfg.get(), thumbnails.get(), library.get(), assets.get());
+            }, { open_syscfg, open_thumbnails, open_library, open_assets }, true);
+            startup.add("window configuration", []() { xerxes::configuration_manager::initialize(); }, { app, displays });
+            startup.run();
         }
-        if (!app_data.empty() && app_data[app_data.size() - 1] != '\\') {
-            app_data += '\\';
+        catch (std::exception &ex) {
+            MessageBoxA(NULL, ex.what(), "Failure initializing the application", MB_OK);
+            return -1;
         }
 
-        app_data.append("XerxesView\\");
-
-        CreateDirectoryA(app_data.c_str(), NULL);
-
-        xerxes::system_configuration syscfg(app_data + "syscfg.db");
+        // Whichever way this returns, a configuration write has to finish before syscfg.db is closed
+        struct configuration_flush {
+            ~configuration_flush() { xerxes::configuration_manager::shutdown(); }
+        } flush_on_exit;
 
-        xerxes::application::initialize(hInstance, &syscfg);
+        // Once the first frame is on the canvas, anything startup put off can be done
+        xerxes::startup_trace::set_on_finished([app_data](const std::string &report) {
+            xerxes::configuration_manager::begin_flush();
+            OutputDebugStringA(report.c_str());
+            std::ofstream(app_data + "startup.log") << report;
+        });
 
-        try {
-            xerxes::configuration_manager::initialize();
-        }
-        catch (std::exception &ex) {
-            MessageBoxA(NULL, ex.what(), "Failure creating the main window", MB_OK);
-            return -1;
+        {
+            xerxes::startup_trace::scope trace("show canvas window");
+            if (!xerxes::configuration_manager::try_show_canvas_window()) {
+                MessageBoxW(NULL, xerxes::get_last_error::get_error_msg(L"Unknown error").c_str(), L"Failure creating the canvas window", MB_OK);
+                return -1;
+            }
         }
 
-        if (!xerxes::configuration_manager::try_show_canvas_window()) {
-            MessageBoxW(NULL, xerxes::get_last_error::get_error_msg(L"Unknown error").c_str(), L"Failure creating the canvas window", MB_OK);
-            return -1;
+        {
+            xerxes::startup_trace::scope trace("show main window");
+            if (!xerxes::configuration_manager::try_show_main_window(nCmdShow)) {
+                MessageBoxW(NULL, xerxes::get_last_error::get_error_msg(L"Unknown error").c_str(), L"Failure creating the main window", MB_OK);
+                return -1;
+            }
         }
 
-        if (!xerxes::configuration_manager::try_show_main_window(nCmdShow)) {
-            MessageBoxW(NULL, xerxes::get_last_error::get_error_msg(L"Unknown error").c_str(), L"Failure creating the main window", MB_OK);
-            return -1;
+        {
+            // Media files on the command line become the cue list, which pre-rolls them in the background
+            xerxes::startup_trace::scope trace("command line media");
+            int argc = 0;
+            auto argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+            if (argv != NULL) {
+                if (argc > 1) {
+                    xerxes::main_window::set_media(std::vector<std::wstring>(argv + 1, argv + argc));
+                }
+                LocalFree(argv);
+            }
         }
 
         HACCEL hAccelTable = LoadAccelerators(hInstance, MAKEINTRESOURCE(IDC_XERXESVIEW));
@@ -69,6 +174,8 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
         // Main message loop:
         while (GetMessage(&msg, nullptr, 0, 0))
         {
+            // The canvas presents on this thread too, so a slow message shows up as a late frame
+            xerxes::event_trace::scope trace("dispatch message", msg.message);
             if (!TranslateAccelerator(msg.hwnd, hAccelTable, &msg))
             {
                 TranslateMessage(&msg);
@@ -5,4 +5,7 @@ namespace xerxes
 {
     HINSTANCE application::_hInstance;
     system_configuration *application::_syscfg;
+    thumbnail_cache *application::_thumbnails;
+    media_library *application::_library;
+    asset_store *application::_assets;
 }
@@ -2,6 +2,9 @@
 
 #include <Windows.h>
 #include "..\configlib\system_configuration.h"
+#include "..\configlib\thumbnail_cache.h"
+#include "..\configlib\media_library.h"
+#include "..\configlib\asset_store.h"
 
 namespace xerxes
 {
@@ -9,9 +12,16 @@ namespace xerxes
     private:
         static HINSTANCE _hInstance;
         static system_configuration *_syscfg;
+        static thumbnail_cache *_thumbnails;
+        static media_library *_library;
+        static asset_store *_assets;
     public:
-        static auto initialize(HINSTANCE hInstance, system_configuration *syscfg) -> void { _hInstance = hInstance; _syscfg = syscfg; }
+        static auto initialize(HINSTANCE hInstance, system_configuration *syscfg, thumbnail_cache *thumbnails, media_library *library, asset_store *assets) -> void { _hInstance = hInstance; _syscfg = syscfg; _thumbnails = thumbnails; _library = library; _assets = assets; }
         static auto instance() -> HINSTANCE { return _hInstance; }
         static auto get_syscfg() -> system_configuration* { return _syscfg; }
+        // Only used by the thumbnail pipeline's thread
+        static auto get_thumbnails() -> thumbnail_cache* { return _thumbnails; }
+        static auto get_library() -> media_library* { return _library; }
+        static auto get_assets() -> asset_store* { return _assets; }
     };
 }
\ No newline at end of file
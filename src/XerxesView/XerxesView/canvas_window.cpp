@@ -8,6 +8,14 @@
 
 #include "messages.h"
 #include "application.h"
+#include "mf_media_source.h"
+#include "mapped_image_source.h"
+#include "gdi_glyph_rasterizer.h"
+#include "..\renderlib\startup_trace.h"
+#include "..\renderlib\event_trace.h"
+#include <dwmapi.h>
+#include <algorithm>
+#include <fstream>
 
 
 #include <Shlwapi.h>
@@ -17,7 +25,15 @@ namespace xerxes
     ATOM canvas_window::_registration = 0;
     HWND canvas_window::_wnd = NULL;
     IMFPMediaPlayer *canvas_window::_player = NULL;
-    bool canvas_window::_is_playing = false;
+    std::unique_ptr<thread_pool> canvas_window::_pool;
+    steady_frame_clock canvas_window::_clock;
+    std::unique_ptr<canvas_pipeline> canvas_window::_pipeline;
+    std::unique_ptr<presentation_scheduler> canvas_window::_scheduler;
+    damage_region canvas_window::_frame_damage;
+    bool canvas_window::_presented = false;
+    int64_t canvas_window::_presented_index = -1;
+    std::atomic<int> canvas_window::_cue_width{ 0 };
+    std::atomic<int> canvas_window::_cue_height{ 0 };
 
     class MediaPlayerCallback : public IMFPMediaPlayerCallback
     {
@@ -73,24 +89,9 @@ namespace xerxes
             {
                 auto pEvent = MFP_GET_MEDIAITEM_CREATED_EVENT(pEventHeader);
                 if (canvas_window::_player != NULL) {
-                    BOOL    bHasVideo = FALSE;
-                    BOOL    bIsSelected = FALSE;
-
-                    // Check if the media item contains video.
-                    HRESULT hr = pEvent->pMediaItem->HasVideo(&bHasVideo, &bIsSelected);
-                    if (SUCCEEDED(hr))
-                    {
-                        canvas_window::_is_playing = bHasVideo && bIsSelected;
-
-                        // Set the media item on the player. This method completes
-                        // asynchronously.
-                        hr = canvas_window::_player->SetMediaItem(pEvent->pMediaItem);
-                    }
-
-                    //if (FAILED(hr))
-                    //{
-                    //    ShowErrorMessage(L"Error playing this file.", hr);
-                    //}
+                    // Set the media item on the player. This method completes
+                    // asynchronously.
+                    canvas_window::_player->SetMediaItem(pEvent->pMediaItem);
                 }
             }
             break;
@@ -123,33 +124,61 @@ namespace xerxes
                 PAINTSTRUCT ps;
                 HDC hdc = BeginPaint(hWnd, &ps);
 
-                if (_player != NULL && _is_playing) {
-                    _player->UpdateVideo();
-                }
-                else {
-                    FillRect(hdc, &ps.rcPaint, static_cast<HBRUSH>(GetStockObject(BLACK_BRUSH)));
+                int64_t index = -1;
+                {
+                    event_trace::scope trace("present");
+                    // Anything damaged was already composed by the scheduler; this only copies the invalid part of the window
+                    if (_pipeline != nullptr) {
+                        index = _pipeline->read_target([&](const surface &target) { present(hdc, ps.rcPaint, target); });
+                    }
                 }
 
-                // TODO: Add any drawing code that uses hdc here...
-                SelectObject(hdc, GetStockObject(WHITE_PEN));
-                RECT rect;
-                GetWindowRect(_wnd, &rect);
-                MoveToEx(hdc, 0, 0, NULL);
-                LineTo(hdc, rect.right - rect.left, rect.bottom - rect.top);
-                MoveToEx(hdc, 0, rect.bottom - rect.top, NULL);
-                LineTo(hdc, rect.right-rect.left, 0);
                 EndPaint(hWnd, &ps);
+                // Repaints of a frame already on screen (the window was uncovered) aren't frames
+                if (index >= 0 && index != _presented_index) {
+                    _presented_index = index;
+                    record_present(static_cast<uint64_t>(index));
+                }
+                if (index >= 0 && !_presented) {
+                    _presented = true;
+                    startup_trace::try_finish("first canvas frame");
+                }
             }
             break;
+        case WM_ERASEBKGND:
+            // WM_PAINT covers every pixel
+            return 1;
         case WM_DESTROY:
+            _scheduler.reset();
             SafeRelease(&_player);
             PostMessage(main_window::get_wnd(), WM_USER_CANVAS_WINDOW_CLOSED, 0, 0);
             _wnd = NULL;
             break;
+        case WM_USER_PLAY_AUDIO:
+            if (_player != NULL) {
+                if (wParam != 0) {
+                    _player->Play();
+                }
+                else {
+                    _player->Pause();
+                }
+            }
+            break;
+        case WM_USER_CUE_AUDIO:
+            {
+                std::unique_ptr<std::wstring> url(reinterpret_cast<std::wstring*>(lParam));
+                if (_player != NULL) {
+                    _player->CreateMediaItemFromURL(url->c_str(), false, 0, NULL);
+                }
+            }
+            break;
         case WM_SIZE:
-            if (_player != NULL && wParam == SIZE_RESTORED) {
-                _player->UpdateVideo();
+            {
+                event_trace::scope trace("resize canvas");
+                _pipeline->resize(LOWORD(lParam), HIWORD(lParam));
             }
+            _cue_width = LOWORD(lParam);
+            _cue_height = HIWORD(lParam);
             break;
         default:
             return DefWindowProc(hWnd, message, wParam, lParam);
@@ -157,6 +186,66 @@ namespace xerxes
         return 0;
     }
 
+    auto canvas_window::render_frame(const frame_info &frame) -> void
+    {
+        event_trace::set_thread_name("canvas render");
+        event_trace::scope trace("render frame", static_cast<int64_t>(frame.index));
+        auto start = _clock.now();
+        auto &damage = _frame_damage;
+        auto composed = _pipeline->render_frame(frame, damage);
+
+        // The flight recorder still holds what led up to it; the control window writes it out
+        if (event_trace::try_report_spike(_clock.now() - start)) {
+            PostMessage(main_window::get_wnd(), WM_USER_TRACE_SPIKE, 0, 0);
+        }
+        if (!composed) return;
+
+        if (_wnd != NULL) {
+            for (auto &r : damage.rects()) {
+                RECT rect{ r.left, r.top, r.right, r.bottom };
+                InvalidateRect(_wnd, &rect, FALSE);
+            }
+        }
+    }
+
+    auto canvas_window::present(HDC hdc, const RECT &rect, const surface &target) -> void
+    {
+        auto clipped = pixel_rect{ rect.left, rect.top, rect.right, rect.bottom }.intersect(target.bounds());
+        if (clipped.empty()) return;
+
+        // Describe just the rows being copied as a top-down DIB, so the source rectangle covers the whole bitmap height
+        BITMAPINFO bmi = {};
+        bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+        bmi.bmiHeader.biWidth = static_cast<LONG>(target.stride() / 4);
+        bmi.bmiHeader.biHeight = -clipped.height();
+        bmi.bmiHeader.biPlanes = 1;
+        bmi.bmiHeader.biBitCount = 32;
+        bmi.bmiHeader.biCompression = BI_RGB;
+
+        StretchDIBits(hdc, clipped.left, clipped.top, clipped.width(), clipped.height(),
+            clipped.left, 0, clipped.width(), clipped.height(), target.row(clipped.top), &bmi, DIB_RGB_COLORS, SRCCOPY);
+    }
+
+    auto canvas_window::record_present(uint64_t index) -> void
+    {
+        present_timing timing{ index, _clock.now().count(), 0 };
+
+        // The display compositor knows when it last scanned out; the copy reaches the screen at the first vblank after it
+        DWM_TIMING_INFO info = {};
+        info.cbSize = sizeof(info);
+        LARGE_INTEGER counter, frequency;
+        if (SUCCEEDED(DwmGetCompositionTimingInfo(NULL, &info)) && info.qpcRefreshPeriod > 0
+            && QueryPerformanceCounter(&counter) && QueryPerformanceFrequency(&frequency)) {
+            auto period = static_cast<long long>(info.qpcRefreshPeriod);
+            auto vblank = static_cast<long long>(info.qpcVBlank);
+            if (vblank <= counter.QuadPart) {
+                vblank += ((counter.QuadPart - vblank) / period + 1) * period;
+            }
+            timing.vblank = timing.presented + (vblank - counter.QuadPart) * 1000000000LL / frequency.QuadPart;
+        }
+        _pipeline->get_timeline().record_present(timing);
+    }
+
     auto canvas_window::try_register_class() -> bool
     {
         assert(_registration == 0);
@@ -182,13 +271,15 @@ namespace xerxes
         return _registration != 0;
     }
 
-    auto canvas_window::try_create_window(int x, int y, int width, int height, bool fullscreen) -> bool
+    auto canvas_window::try_create_window(int x, int y, int width, int height, int refresh_rate, bool fullscreen) -> bool
     {
         assert(_wnd == NULL);
         WCHAR initial_title[MAX_INITIAL_TITLE_LENGTH + 1];
         if (LoadStringW(application::instance(), IDS_APP_TITLE, initial_title, MAX_INITIAL_TITLE_LENGTH) == 0) return false;
         std::wstring title(initial_title);
         title.append(L" - Show");
+        // The layers have to exist before the first WM_SIZE arrives
+        create_pipeline();
         if (fullscreen) {
             _wnd = CreateWindowW(CANVAS_WINDOW_CLASS_NAME, title.c_str(), WS_POPUP,
                 x, y, width, height, nullptr, nullptr, application::instance(), nullptr);
@@ -197,24 +288,29 @@ namespace xerxes
             _wnd = CreateWindowW(CANVAS_WINDOW_CLASS_NAME, title.c_str(), WS_OVERLAPPEDWINDOW,
                 x, y, width, height, nullptr, nullptr, application::instance(), nullptr);
         }
+        if (_wnd != NULL && _scheduler == nullptr) {
+            _scheduler.reset(new presentation_scheduler(_clock, refresh_rate, render_frame));
+            // A frame that takes two intervals is a visible stutter
+            event_trace::set_spike_threshold(_scheduler->get_interval() * 2);
+            _scheduler->start();
+        }
+
         if (_player == NULL) {
-            auto hr = MFPCreateMediaPlayer(NULL, false, 0, new (std::nothrow)MediaPlayerCallback(), _wnd, &_player);
-            if (SUCCEEDED(hr)) {
-                _player->CreateMediaItemFromURL(L"C:\\Users\\dawie\\Videos\\Ian & Cosmo.mp4", false, 0, NULL);
-            }
+            // Video is decoded by our own pipeline; MFPlay without a window only renders the audio
+            MFPCreateMediaPlayer(NULL, false, 0, new (std::nothrow)MediaPlayerCallback(), NULL, &_player);
         }
 
         return _wnd != 0;
     }
 
-    auto canvas_window::try_show(int x, int y, int width, int height, int nCmdShow, bool fullscreen, bool update_immediately) -> bool
+    auto canvas_window::try_show(int x, int y, int width, int height, int refresh_rate, int nCmdShow, bool fullscreen, bool update_immediately) -> bool
     {
         assert(application::instance() != NULL);
         if (_registration == 0) {
             if (!try_register_class()) return false;
         }
         if (_wnd == NULL) {
-            if (!try_create_window(x, y, width, height, fullscreen)) return false;
+            if (!try_create_window(x, y, width, height, refresh_rate, fullscreen)) return false;
         }
         if (fullscreen) {
             ShowWindow(_wnd, SW_SHOW);
@@ -235,4 +331,118 @@ namespace xerxes
         DestroyWindow(_wnd);
     }
 
-}
+    auto canvas_window::create_pipeline() -> void
+    {
+        if (_pipeline != nullptr) return;
+
+        _pool.reset(new thread_pool());
+        _pipeline.reset(new canvas_pipeline(_clock, std::make_shared<gdi_glyph_rasterizer>(), open_cue, _pool.get()));
+        // MFPlay renders the audio of the cue the video layer shows. It belongs to the window thread, where its callbacks arrive too,
+        // so the render thread only posts what it should do.
+        _pipeline->set_on_command([](const canvas_command &command) {
+            if (command.type == canvas_command_type::play && _wnd != NULL) {
+                PostMessage(_wnd, WM_USER_PLAY_AUDIO, command.value != 0 ? 1 : 0, 0);
+            }
+        });
+        _pipeline->set_on_cue([](const std::wstring &url) {
+            if (_wnd == NULL) return;
+            auto posted = new std::wstring(url);
+            if (!PostMessage(_wnd, WM_USER_CUE_AUDIO, 0, reinterpret_cast<LPARAM>(posted))) {
+                delete posted;
+            }
+        });
+    }
+
+    auto canvas_window::open_cue(const std::wstring &url) -> std::unique_ptr<media_source>
+    {
+        return open_media(url, _cue_width, _cue_height);
+    }
+
+    auto canvas_window::open_media(const std::wstring &url, int width, int height) -> std::unique_ptr<media_source>
+    {
+        // Probing a still only parses its header, so try that before the source reader
+        std::unique_ptr<media_source> source = mapped_image_source::try_open(url, width, height);
+        if (source == nullptr) {
+            source = mf_media_source::try_open(url, width, height);
+        }
+        return source;
+    }
+
+    auto canvas_window::set_cues(const std::vector<std::wstring> &urls) -> void
+    {
+        create_pipeline();
+        _pipeline->set_cues(urls);
+    }
+
+    auto canvas_window::set_slide_texts(const std::vector<std::wstring> &texts) -> void
+    {
+        create_pipeline();
+        _pipeline->set_slide_texts(texts);
+    }
+
+    auto canvas_window::set_program_monitor(std::shared_ptr<preview_feed> monitor) -> void
+    {
+        create_pipeline();
+        _pipeline->set_program_monitor(std::move(monitor));
+    }
+
+    auto canvas_window::set_network_output(std::shared_ptr<network_output> output) -> void
+    {
+        create_pipeline();
+        _pipeline->set_network_output(std::move(output));
+    }
+
+    auto canvas_window::set_preview_monitor(std::shared_ptr<preview_feed> monitor) -> void
+    {
+        create_pipeline();
+        _pipeline->set_preview_monitor(std::move(monitor));
+    }
+
+    auto canvas_window::release_media() -> void
+    {
+        if (_pipeline != nullptr) {
+            _pipeline->release_media();
+        }
+    }
+
+    auto canvas_window::post(const canvas_command &command) -> bool
+    {
+        create_pipeline();
+        return _pipeline->post(command);
+    }
+
+    auto canvas_window::get_frame_statistics() -> frame_statistics
+    {
+        if (_scheduler == nullptr) return frame_statistics{};
+        return _scheduler->get_statistics();
+    }
+
+    auto canvas_window::get_tile_timings() -> std::vector<tile_timing>
+    {
+        if (_pipeline == nullptr) return std::vector<tile_timing>();
+        return _pipeline->get_tile_timings();
+    }
+
+    auto canvas_window::get_slide_cache_statistics() -> slide_cache_statistics
+    {
+        if (_pipeline == nullptr) return slide_cache_statistics{};
+        return _pipeline->get_slide_cache_statistics();
+    }
+
+    auto canvas_window::get_cue_latency() -> std::chrono::nanoseconds
+    {
+        if (_pipeline == nullptr) return std::chrono::nanoseconds(0);
+        return _pipeline->get_cue_latency();
+    }
+
+    auto canvas_window::try_export_timeline(const std::wstring &path) -> bool
+    {
+        if (_pipeline == nullptr) return false;
+        std::ofstream out(path, std::ios::out | std::ios::trunc);
+        if (!out) return false;
+        _pipeline->get_timeline().write_csv(out);
+        out.flush();
+        return static_cast<bool>(out);
+    }
+
+}
\ No newline at end of file
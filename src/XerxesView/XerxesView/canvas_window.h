@@ -2,6 +2,12 @@
 
 #include <windows.h>
 #include <mfplay.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "..\renderlib\canvas_pipeline.h"
 
 #define CANVAS_WINDOW_CLASS_NAME L"XerxesViewCanvasWindow"
 
@@ -13,18 +19,73 @@ namespace xerxes
     private:
         static ATOM _registration;
         static HWND _wnd;
+        // Audio only; the video goes through the pipeline
         static IMFPMediaPlayer *_player;
-        static bool _is_playing;
+        static std::unique_ptr<thread_pool> _pool;
+        static steady_frame_clock _clock;
+        // Created on the window thread the first time it is needed, before the scheduler starts, and kept until exit
+        static std::unique_ptr<canvas_pipeline> _pipeline;
+        static std::unique_ptr<presentation_scheduler> _scheduler;
+        // Only used by render_frame; kept so its storage is reused every frame
+        static damage_region _frame_damage;
+        // Startup ends when the first composed frame is presented
+        static bool _presented;
+        // The index of the last frame presented
+        static int64_t _presented_index;
+        // The canvas size stills are decoded for; read by the cue loader thread
+        static std::atomic<int> _cue_width;
+        static std::atomic<int> _cue_height;
 
         static LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam);
 
+        // Called by the scheduler once per refresh: render whatever the layers damaged and invalidate just those areas of the window
+        static auto render_frame(const frame_info &frame) -> void;
+        // Copy rect of the composed canvas to the window
+        static auto present(HDC hdc, const RECT &rect, const surface &target) -> void;
+        // Runs on the window thread after a present of frame index
+        static auto record_present(uint64_t index) -> void;
+        static auto create_pipeline() -> void;
+
         static auto try_register_class() -> bool;
-        static auto try_create_window(int x, int y, int width, int height, bool fullscreen) -> bool;
+        static auto try_create_window(int x, int y, int width, int height, int refresh_rate, bool fullscreen) -> bool;
     public:
         // Try to register the class of this window, create the window and show it. Returns true on success, or false on failure. Use GetLastError and FormatMessage to get the actual error message.
-        static auto try_show(int x, int y, int width, int height, int nCmdShow, bool fullscreen = true, bool update_immediately = true) -> bool;
+        static auto try_show(int x, int y, int width, int height, int refresh_rate, int nCmdShow, bool fullscreen = true, bool update_immediately = true) -> bool;
         static auto close() -> void;
 
+        // Replace the media cue list; slide n fires cue n. The cues after the current one are pre-rolled in the background.
+        static auto set_cues(const std::vector<std::wstring> &urls) -> void;
+
+        // Replace the text of the slides; slide n shows texts[n]
+        static auto set_slide_texts(const std::vector<std::wstring> &texts) -> void;
+
+        // Publish a downscaled copy of every frame to monitor, or stop with nullptr
+        static auto set_program_monitor(std::shared_ptr<preview_feed> monitor) -> void;
+        // Stream the canvas to other processes through output, or stop with nullptr
+        static auto set_network_output(std::shared_ptr<network_output> output) -> void;
+        // Compose the preview bus into monitor, or stop composing it with nullptr
+        static auto set_preview_monitor(std::shared_ptr<preview_feed> monitor) -> void;
+
+        // Opens the media of a cue, with stills decoded to fit the canvas; runs on the cue loader thread
+        static auto open_cue(const std::wstring &url) -> std::unique_ptr<media_source>;
+        // Opens media the way the canvas does, with stills decoded to fit width x height, e.g. for an export
+        static auto open_media(const std::wstring &url, int width, int height) -> std::unique_ptr<media_source>;
+
+        // Stop all decoding, before Media Foundation shuts down
+        static auto release_media() -> void;
+
+        // Queue a command for the next frame. Never blocks; returns false if the canvas has fallen too far behind to accept it.
+        static auto post(const canvas_command &command) -> bool;
+
+        static auto get_frame_statistics() -> frame_statistics;
+        // How the tiles of the last composed frame were rendered
+        static auto get_tile_timings() -> std::vector<tile_timing>;
+        static auto get_slide_cache_statistics() -> slide_cache_statistics;
+        // Time from posting the last cue to presenting its first frame
+        static auto get_cue_latency() -> std::chrono::nanoseconds;
+        // The per-frame timings of the recent frames, as written by frame_timeline::write_csv
+        static auto try_export_timeline(const std::wstring &path) -> bool;
+
         // No instances possible
         canvas_window() = delete;
 
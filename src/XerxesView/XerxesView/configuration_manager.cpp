@@ -3,6 +3,7 @@
 #include "main_window.h"
 #include "canvas_window.h"
 #include "application.h"
+#include "..\renderlib\event_trace.h"
 
 #include <exception>
 #include <map>
@@ -12,6 +13,11 @@ namespace xerxes
 {
     std::vector<configuration_manager::display_info> configuration_manager::_displays;
     configuration_manager::config configuration_manager::_configuration;
+    configuration_manager::config configuration_manager::_loaded;
+    bool configuration_manager::_loaded_main = false;
+    bool configuration_manager::_loaded_canvas = false;
+    bool configuration_manager::_dirty = false;
+    std::thread configuration_manager::_flush;
     configuration_manager::display_info configuration_manager::_main_display_info;
     configuration_manager::display_info configuration_manager::_canvas_display_info;
 
@@ -34,39 +40,73 @@ namespace xerxes
         di.work = info.rcWork;
         di.name = info.szDevice;
 
+        DEVMODEW mode = {};
+        mode.dmSize = sizeof(DEVMODEW);
+        if (EnumDisplaySettingsW(info.szDevice, ENUM_CURRENT_SETTINGS, &mode) && mode.dmDisplayFrequency > 1) {
+            di.refresh_rate = static_cast<int>(mode.dmDisplayFrequency);
+        }
+        else {
+            // 0 and 1 mean "hardware default"
+            di.refresh_rate = 60;
+        }
+
         ((std::vector<display_info>*)dwData)->push_back(std::move(di));
 
         return TRUE;
     }
 
-    auto configuration_manager::read_display_information(std::vector<display_info> &displays) -> void
+    auto configuration_manager::read_displays() -> void
     {
-        if (EnumDisplayMonitors(NULL, NULL, MonitorEnumProc, (LPARAM)&displays) == 0) throw std::exception("Failure enumerating displays");
+        event_trace::scope trace("read displays");
+        _displays.clear();
+        if (EnumDisplayMonitors(NULL, NULL, MonitorEnumProc, (LPARAM)&_displays) == 0) throw std::exception("Failure enumerating displays");
     }
 
     auto configuration_manager::read_configuration_from_database() -> void
     {
+        event_trace::scope trace("read configuration");
         // Try to read configuration - on failure we'll just load defaults
         auto& cfg = _configuration;
-        application::get_syscfg()->get_window_configuration([&cfg](const std::wstring &key) -> window_config* { if (key == L"main") return &cfg.main_window; else if (key == L"canvas") return &cfg.canvas_window; else return nullptr; });
+        _loaded_main = false;
+        _loaded_canvas = false;
+        // configlib doesn't know about the trace, so its calls are timed here
+        event_trace::scope select_trace("select window configuration");
+        application::get_syscfg()->get_window_configuration([&cfg](const std::wstring &key) -> window_config* {
+            if (key == L"main") {
+                _loaded_main = true;
+                return &cfg.main_window;
+            }
+            else if (key == L"canvas") {
+                _loaded_canvas = true;
+                return &cfg.canvas_window;
+            }
+            else return nullptr;
+        });
+        _loaded = _configuration;
     }
 
-    auto configuration_manager::save_configuration_to_database() -> void
+    auto configuration_manager::save_configuration_to_database(const config &cfg) -> void
     {
+        event_trace::scope trace("save configuration");
         // Try to write configuration
-        application::get_syscfg()->write_window_configuration(L"main", _configuration.main_window);
-        application::get_syscfg()->write_window_configuration(L"canvas", _configuration.canvas_window);
+        auto syscfg = application::get_syscfg();
+        auto batch = syscfg->begin_batch();
+        {
+            event_trace::scope write_trace("write window configuration");
+            syscfg->write_window_configuration(L"main", cfg.main_window);
+            syscfg->write_window_configuration(L"canvas", cfg.canvas_window);
+        }
+        batch.commit();
     }
 
     auto configuration_manager::initialize() -> void
     {
+        event_trace::scope trace("initialize configuration");
         // Set default configuration
         _configuration.canvas_window.show_fullscreen = true;
         _configuration.main_window.monitor_name.clear();
         _configuration.canvas_window.monitor_name.clear();
 
-        _displays.clear();
-        read_display_information(_displays);
         read_configuration_from_database();
 
         // Ensure only one window is on primary
@@ -215,12 +255,45 @@ namespace xerxes
         assert(main_di != nullptr);
         assert(canvas_di != nullptr);
 
-        save_configuration_to_database();
+        // Rows that are missing are written too, so the next start finds them
+        _dirty = !_loaded_main || !_loaded_canvas || _configuration.main_window != _loaded.main_window || _configuration.canvas_window != _loaded.canvas_window;
 
         _main_display_info = *main_di;
         _canvas_display_info = *canvas_di;
     }
 
+    auto configuration_manager::begin_flush() -> void
+    {
+        if (!_dirty || _flush.joinable()) return;
+        _dirty = false;
+        auto cfg = _configuration;
+        _flush = std::thread([cfg]() {
+            event_trace::set_thread_name("configuration flush");
+            // The configuration is worked out again on the next start, so a failed write only costs the saved choices
+            try {
+                save_configuration_to_database(cfg);
+            }
+            catch (std::exception &) {
+            }
+        });
+    }
+
+    auto configuration_manager::shutdown() -> void
+    {
+        if (_flush.joinable()) {
+            _flush.join();
+        }
+        // Startup never got to the first frame
+        if (_dirty) {
+            _dirty = false;
+            try {
+                save_configuration_to_database(_configuration);
+            }
+            catch (std::exception &) {
+            }
+        }
+    }
+
     auto configuration_manager::try_show_main_window(int nCmdShow) -> bool
     {
         if (_main_display_info.is_primary) {
@@ -240,20 +313,20 @@ namespace xerxes
     auto configuration_manager::try_show_canvas_window() -> bool
     {
         if (_configuration.canvas_window.show_fullscreen) {
-            return canvas_window::try_show(_canvas_display_info.rect.left, _canvas_display_info.rect.top, _canvas_display_info.rect.right - _canvas_display_info.rect.left, _canvas_display_info.rect.bottom - _canvas_display_info.rect.top, SW_SHOW, _configuration.canvas_window.show_fullscreen);
+            return canvas_window::try_show(_canvas_display_info.rect.left, _canvas_display_info.rect.top, _canvas_display_info.rect.right - _canvas_display_info.rect.left, _canvas_display_info.rect.bottom - _canvas_display_info.rect.top, _canvas_display_info.refresh_rate, SW_SHOW, _configuration.canvas_window.show_fullscreen);
         }
 
         if (_canvas_display_info.is_primary) {
             if (_configuration.canvas_window.show_maximized) {
-                return canvas_window::try_show(CW_USEDEFAULT, 0, CW_USEDEFAULT, 0, SW_MAXIMIZE, false);
+                return canvas_window::try_show(CW_USEDEFAULT, 0, CW_USEDEFAULT, 0, _canvas_display_info.refresh_rate, SW_MAXIMIZE, false);
             }
             else {
-                return canvas_window::try_show(0, 0, _canvas_display_info.rect.right, _canvas_display_info.rect.bottom, SW_SHOW, false);
+                return canvas_window::try_show(0, 0, _canvas_display_info.rect.right, _canvas_display_info.rect.bottom, _canvas_display_info.refresh_rate, SW_SHOW, false);
             }
         }
         else {
             // We can only show maximized on non-primary
-            return canvas_window::try_show(_canvas_display_info.rect.left, _canvas_display_info.rect.top, _canvas_display_info.rect.right - _canvas_display_info.rect.left, _canvas_display_info.rect.bottom - _canvas_display_info.rect.top, SW_MAXIMIZE, false);
+            return canvas_window::try_show(_canvas_display_info.rect.left, _canvas_display_info.rect.top, _canvas_display_info.rect.right - _canvas_display_info.rect.left, _canvas_display_info.rect.bottom - _canvas_display_info.rect.top, _canvas_display_info.refresh_rate, SW_MAXIMIZE, false);
         }
     }
 
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <thread>
 #include <vector>
 #include "..\configlib\system_configuration.h"
 
@@ -13,6 +14,7 @@ namespace xerxes
             RECT work;
             bool is_primary;
             std::wstring name;
+            int refresh_rate;
         };
 
         struct config {
@@ -22,17 +24,29 @@ namespace xerxes
 
         static std::vector<display_info> _displays;
         static config _configuration;
+        // What the database held, to tell whether initialize changed anything
+        static config _loaded;
+        static bool _loaded_main;
+        static bool _loaded_canvas;
+        static bool _dirty;
+        static std::thread _flush;
         static display_info _main_display_info;
         static display_info _canvas_display_info;
 
         static BOOL CALLBACK MonitorEnumProc(_In_ HMONITOR hMonitor, _In_ HDC hdcMonitor, _In_ LPRECT lprcMonitor, _In_ LPARAM dwData);
-        static auto read_display_information(std::vector<display_info> &displays) -> void;
         static auto read_configuration_from_database() -> void;
-        static auto save_configuration_to_database() -> void;
+        static auto save_configuration_to_database(const config &cfg) -> void;
     public:
         configuration_manager() = delete;
 
+        // Enumerate the monitors. It doesn't touch the database, so it can run while that opens.
+        static auto read_displays() -> void;
+        // Work out where the windows go from the monitors and the saved configuration; read_displays must have run
         static auto initialize() -> void;
+        // Save the configuration if initialize changed it, on a background thread so the write stays off the startup path
+        static auto begin_flush() -> void;
+        // Wait for a background flush and save anything still unsaved. Call before the database is closed.
+        static auto shutdown() -> void;
 
         static auto try_show_main_window(int nCmdShow) -> bool;
         static auto try_show_canvas_window() -> bool;
@@ -0,0 +1,84 @@
+#include "stdafx.h"
+#include "gdi_glyph_rasterizer.h"
+
+namespace xerxes
+{
+    gdi_glyph_rasterizer::gdi_glyph_rasterizer()
+        : _dc(CreateCompatibleDC(NULL))
+    {
+    }
+
+    gdi_glyph_rasterizer::~gdi_glyph_rasterizer()
+    {
+        if (_dc != NULL) {
+            DeleteDC(_dc);
+        }
+        for (auto &f : _fonts) {
+            DeleteObject(f.second);
+        }
+    }
+
+    auto gdi_glyph_rasterizer::select(const font_key &font) -> bool
+    {
+        if (_dc == NULL) return false;
+
+        auto i = _fonts.find(font);
+        if (i == _fonts.end()) {
+            // A negative height asks for the em size rather than the cell height
+            auto handle = CreateFontW(-font.size, 0, 0, 0, font.bold ? FW_BOLD : FW_NORMAL, font.italic ? TRUE : FALSE, FALSE, FALSE,
+                DEFAULT_CHARSET, OUT_TT_PRECIS, CLIP_DEFAULT_PRECIS, ANTIALIASED_QUALITY, DEFAULT_PITCH | FF_DONTCARE, font.face.c_str());
+            if (handle == NULL) return false;
+            i = _fonts.emplace(font, handle).first;
+        }
+        return SelectObject(_dc, i->second) != NULL;
+    }
+
+    auto gdi_glyph_rasterizer::get_font_metrics(const font_key &font) -> font_metrics
+    {
+        font_metrics metrics{ font.size, 0, font.size };
+        TEXTMETRICW tm;
+        if (select(font) && GetTextMetricsW(_dc, &tm)) {
+            metrics.ascent = tm.tmAscent;
+            metrics.descent = tm.tmDescent;
+            metrics.line_height = tm.tmHeight + tm.tmExternalLeading;
+        }
+        return metrics;
+    }
+
+    auto gdi_glyph_rasterizer::rasterize(const font_key &font, uint32_t codepoint, glyph_bitmap &glyph) -> bool
+    {
+        // GetGlyphOutline only takes characters of the basic multilingual plane
+        if (codepoint > 0xffff || !select(font)) return false;
+
+        const MAT2 identity = { { 0, 1 }, { 0, 0 }, { 0, 0 }, { 0, 1 } };
+        GLYPHMETRICS gm;
+        auto size = GetGlyphOutlineW(_dc, codepoint, GGO_GRAY8_BITMAP, &gm, 0, NULL, &identity);
+        if (size == GDI_ERROR) return false;
+
+        glyph.advance = gm.gmCellIncX;
+        glyph.left = gm.gmptGlyphOrigin.x;
+        glyph.top = gm.gmptGlyphOrigin.y;
+        // Blank glyphs such as spaces have no bitmap
+        if (size == 0) {
+            glyph.width = glyph.height = 0;
+            glyph.coverage.clear();
+            return true;
+        }
+
+        std::vector<uint8_t> bitmap(size);
+        if (GetGlyphOutlineW(_dc, codepoint, GGO_GRAY8_BITMAP, &gm, size, bitmap.data(), &identity) == GDI_ERROR) return false;
+
+        // 65 levels (0-64) in DWORD aligned rows
+        glyph.width = static_cast<int>(gm.gmBlackBoxX);
+        glyph.height = static_cast<int>(gm.gmBlackBoxY);
+        auto pitch = (glyph.width + 3) & ~3;
+        glyph.coverage.resize(static_cast<size_t>(glyph.width) * glyph.height);
+        for (int y = 0; y < glyph.height; y++) {
+            for (int x = 0; x < glyph.width; x++) {
+                auto level = bitmap[static_cast<size_t>(y) * pitch + x];
+                glyph.coverage[static_cast<size_t>(y) * glyph.width + x] = static_cast<uint8_t>(level >= 64 ? 255 : level * 4);
+            }
+        }
+        return true;
+    }
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <windows.h>
+#include <map>
+#include "..\renderlib\text_engine.h"
+
+namespace xerxes
+{
+    // Rasterizes glyphs with GDI's anti-aliased glyph outlines. Use it from one thread at a time.
+    class gdi_glyph_rasterizer : public glyph_rasterizer {
+    private:
+        HDC _dc;
+        std::map<font_key, HFONT> _fonts;
+
+        auto select(const font_key &font) -> bool;
+    public:
+        gdi_glyph_rasterizer();
+        gdi_glyph_rasterizer(const gdi_glyph_rasterizer &) = delete;
+        auto operator=(const gdi_glyph_rasterizer &)->gdi_glyph_rasterizer& = delete;
+        virtual ~gdi_glyph_rasterizer();
+
+        virtual auto get_font_metrics(const font_key &font) -> font_metrics override;
+        virtual auto rasterize(const font_key &font, uint32_t codepoint, glyph_bitmap &glyph) -> bool override;
+    };
+}
@@ -5,17 +5,138 @@
 #include "abount_dialog.h"
 #include <assert.h>
 #include <string>
+#include <commdlg.h>
+#include <vector>
 
 #include "messages.h"
 #include "configuration_manager.h"
 #include "last_error.h"
 #include "canvas_window.h"
 #include "application.h"
+#include "wic_image_decoder.h"
+#include "media_scanner.h"
+#include "gdi_glyph_rasterizer.h"
+#include "..\renderlib\event_trace.h"
+#include "..\renderlib\offline_exporter.h"
+
+#include <Shlwapi.h>
+#include <ShlObj.h>
+#include <windowsx.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
 
 namespace xerxes
 {
     ATOM main_window::_registration = 0;
     HWND main_window::_wnd = NULL;
+    int64_t main_window::_slide = 0;
+    bool main_window::_is_blanked = false;
+    bool main_window::_is_playing = true;
+    bool main_window::_show_overlay = true;
+    bool main_window::_show_hud = false;
+    bool main_window::_show_monitors = true;
+    std::shared_ptr<preview_feed> main_window::_program_monitor;
+    std::shared_ptr<preview_feed> main_window::_preview_monitor;
+    std::shared_ptr<network_output> main_window::_network;
+    int64_t main_window::_staged = 1;
+    std::vector<std::wstring> main_window::_media;
+    std::unique_ptr<thumbnail_pipeline> main_window::_thumbnails;
+    int main_window::_scroll = 0;
+    std::thread main_window::_scan;
+    std::atomic<bool> main_window::_stop_scan{ false };
+    std::vector<std::wstring> main_window::_slide_texts;
+    std::thread main_window::_export;
+    std::atomic<bool> main_window::_stop_export{ false };
+
+    namespace
+    {
+        // The browser's grid: a thumbnail with the file name under it
+        const int thumbnail_width = 192;
+        const int thumbnail_height = 108;
+        const int cell_margin = 8;
+        const int label_height = 20;
+        const int cell_width = thumbnail_width + cell_margin * 2;
+        const int cell_height = thumbnail_height + label_height + cell_margin * 2;
+
+        // The program and preview monitors are stacked right of the browser and painted about 30 times a second, whatever the
+        // canvas refresh rate
+        const int monitor_width = 480;
+        const int monitor_height = 270;
+        const int monitor_margin = 8;
+        const int monitor_label_height = 36;
+        const int monitor_panel_width = monitor_width + monitor_margin * 2;
+        const UINT_PTR monitor_timer = 1;
+        const UINT monitor_interval_ms = 33;
+
+        // Taking the preview to the program dissolves for half a second
+        const std::chrono::milliseconds take_transition(500);
+
+        // Exports are 1080p at 30 fps; a slide without media is held for eight seconds
+        const int export_width = 1920;
+        const int export_height = 1080;
+        const double export_frame_rate = 30.0;
+        const std::chrono::seconds export_hold(8);
+
+        // The thumbnail cache knows a file by its path, last write time and size
+        auto try_get_file_version(const std::wstring &path, long long &modified, long long &size) -> bool
+        {
+            WIN32_FILE_ATTRIBUTE_DATA data;
+            if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &data)) return false;
+            modified = static_cast<long long>((static_cast<ULONGLONG>(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime);
+            size = static_cast<long long>((static_cast<ULONGLONG>(data.nFileSizeHigh) << 32) | data.nFileSizeLow);
+            return true;
+        }
+
+        auto try_load_thumbnail(const std::wstring &path, surface &thumbnail) -> bool
+        {
+            long long modified, size;
+            thumbnail_data data;
+            if (!try_get_file_version(path, modified, size)) return false;
+            // Runs on the thumbnail pipeline's thread; a cache that can't be read is a miss and the file is decoded instead
+            try {
+                if (!application::get_thumbnails()->try_read(path, modified, size, data)) return false;
+            }
+            catch (std::exception &) {
+                return false;
+            }
+
+            thumbnail.resize(data.width, data.height);
+            auto row_bytes = static_cast<size_t>(data.width) * 4;
+            for (int y = 0; y < data.height; y++) {
+                memcpy(thumbnail.row(y), data.pixels.data() + row_bytes * y, row_bytes);
+            }
+            return true;
+        }
+
+        auto save_thumbnails(const thumbnail_pipeline::decoded_thumbnails &thumbnails) -> void
+        {
+            // Runs on the thumbnail pipeline's thread; thumbnails that can't be cached are decoded again next time
+            try {
+                auto cache = application::get_thumbnails();
+                auto batch = cache->begin_batch();
+                thumbnail_data data;
+                for (auto &t : thumbnails) {
+                    long long modified, size;
+                    if (!try_get_file_version(t.first, modified, size)) continue;
+
+                    auto &pixels = *t.second;
+                    auto row_bytes = static_cast<size_t>(pixels.width()) * 4;
+                    data.width = pixels.width();
+                    data.height = pixels.height();
+                    data.pixels.resize(row_bytes * pixels.height());
+                    for (int y = 0; y < pixels.height(); y++) {
+                        memcpy(data.pixels.data() + row_bytes * y, pixels.row(y), row_bytes);
+                    }
+                    cache->write(t.first, modified, size, data);
+                }
+                batch.commit();
+            }
+            catch (std::exception &) {
+            }
+        }
+    }
 
     LRESULT CALLBACK main_window::WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
     {
@@ -43,20 +164,124 @@ namespace xerxes
                 }
             }
             break;
+        case WM_KEYDOWN:
+            if (!on_key_down(wParam)) {
+                return DefWindowProc(hWnd, message, wParam, lParam);
+            }
+            break;
         case WM_PAINT:
             {
                 PAINTSTRUCT ps;
                 HDC hdc = BeginPaint(hWnd, &ps);
-                // TODO: Add any drawing code that uses hdc here...
+                RECT client;
+                GetClientRect(hWnd, &client);
+                RECT monitors = get_monitors_rect(client), both;
+                if (_show_monitors && UnionRect(&both, &monitors, &ps.rcPaint) && EqualRect(&both, &monitors)) {
+                    // Only the monitors are being refreshed; leave the browser alone
+                    auto buffer_dc = CreateCompatibleDC(hdc);
+                    auto buffer = CreateCompatibleBitmap(hdc, monitors.right - monitors.left, monitors.bottom - monitors.top);
+                    auto old = SelectObject(buffer_dc, buffer);
+                    SetViewportOrgEx(buffer_dc, -monitors.left, -monitors.top, NULL);
+                    paint_monitors(buffer_dc, client);
+                    BitBlt(hdc, monitors.left, monitors.top, monitors.right - monitors.left, monitors.bottom - monitors.top, buffer_dc, monitors.left, monitors.top, SRCCOPY);
+                    SelectObject(buffer_dc, old);
+                    DeleteObject(buffer);
+                    DeleteDC(buffer_dc);
+                    EndPaint(hWnd, &ps);
+                    break;
+                }
+                // Paint off screen, so thumbnails arriving one batch at a time don't flicker
+                auto buffer_dc = CreateCompatibleDC(hdc);
+                auto buffer = CreateCompatibleBitmap(hdc, client.right, client.bottom);
+                auto old = SelectObject(buffer_dc, buffer);
+                paint(buffer_dc, client);
+                BitBlt(hdc, 0, 0, client.right, client.bottom, buffer_dc, 0, 0, SRCCOPY);
+                SelectObject(buffer_dc, old);
+                DeleteObject(buffer);
+                DeleteDC(buffer_dc);
                 EndPaint(hWnd, &ps);
             }
             break;
+        case WM_TIMER:
+            if (wParam == monitor_timer) {
+                RECT client;
+                GetClientRect(hWnd, &client);
+                auto monitors = get_monitors_rect(client);
+                InvalidateRect(hWnd, &monitors, FALSE);
+            }
+            break;
+        case WM_ERASEBKGND:
+            // WM_PAINT covers every pixel
+            return 1;
+        case WM_SIZE:
+            scroll(0);
+            break;
+        case WM_MOUSEWHEEL:
+            scroll(-GET_WHEEL_DELTA_WPARAM(wParam) * cell_height / WHEEL_DELTA);
+            break;
+        case WM_LBUTTONDOWN:
+            {
+                auto index = hit_test(GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
+                if (index >= 0) {
+                    _slide = index;
+                    post_to_canvas(canvas_command::go_to_slide(_slide));
+                    stage(_slide + 1);
+                }
+            }
+            break;
+        case WM_USER_TRACE_SPIKE:
+            event_trace::begin_dump("spike");
+            break;
+        case WM_USER_THUMBNAILS_READY:
+            InvalidateRect(_wnd, NULL, FALSE);
+            break;
+        case WM_USER_SCAN_FINISHED:
+            {
+                std::unique_ptr<scan_statistics> stats(reinterpret_cast<scan_statistics*>(lParam));
+                _scan.join();
+                if (stats == nullptr) {
+                    MessageBoxW(_wnd, L"The media library couldn't be updated", L"Media library", MB_OK | MB_ICONERROR);
+                    break;
+                }
+                auto seconds = std::chrono::duration<double>(stats->elapsed).count();
+                wchar_t text[256];
+                swprintf_s(text, L"%llu files in %llu folders in %.1f s (%.0f files/s)\n%llu added, %llu updated, %llu removed",
+                    stats->files, stats->directories, seconds, stats->files_per_second(), stats->added, stats->updated, stats->removed);
+                MessageBoxW(_wnd, text, L"Media library updated", MB_OK | MB_ICONINFORMATION);
+            }
+            break;
+        case WM_USER_EXPORT_FINISHED:
+            {
+                std::unique_ptr<export_result> result(reinterpret_cast<export_result*>(lParam));
+                _export.join();
+                if (result == nullptr) {
+                    MessageBoxW(_wnd, L"The service couldn't be exported", L"Export", MB_OK | MB_ICONERROR);
+                    break;
+                }
+                MessageBoxA(_wnd, result->format().c_str(), result->succeeded ? "Export finished" : "Export failed", MB_OK | (result->succeeded ? MB_ICONINFORMATION : MB_ICONERROR));
+            }
+            break;
         case WM_USER_CANVAS_WINDOW_CLOSED:
             if (MessageBoxW(_wnd, L"Do you want to show it again?", L"Show window closed", MB_YESNO | MB_ICONEXCLAMATION) == IDYES) {
                 show_canvas_window();
             }
             break;
         case WM_DESTROY:
+            // Before the thumbnail cache and the library close with the application
+            _thumbnails.reset();
+            show_monitors(false);
+            if (_network != nullptr) {
+                canvas_window::set_network_output(nullptr);
+                _network->stop();
+            }
+            if (_scan.joinable()) {
+                _stop_scan = true;
+                _scan.join();
+            }
+            if (_export.joinable()) {
+                _stop_export = true;
+                _export.join();
+            }
             PostQuitMessage(0);
             break;
         case WM_DISPLAYCHANGE:
@@ -117,11 +342,544 @@ namespace xerxes
         canvas_window::close();
     }
 
+    auto main_window::on_key_down(WPARAM key) -> bool
+    {
+        switch (key) {
+        case VK_RIGHT:
+        case VK_NEXT:
+            if (_slide + 1 < get_slide_count()) {
+                post_to_canvas(canvas_command::go_to_slide(++_slide));
+                stage(_slide + 1);
+            }
+            return true;
+        case VK_LEFT:
+        case VK_PRIOR:
+            if (_slide > 0) {
+                post_to_canvas(canvas_command::go_to_slide(--_slide));
+                stage(_slide + 1);
+            }
+            return true;
+        case VK_DOWN:
+            if (_staged + 1 < get_slide_count()) {
+                stage(_staged + 1);
+            }
+            return true;
+        case VK_UP:
+            if (_staged > 0) {
+                stage(_staged - 1);
+            }
+            return true;
+        case VK_RETURN:
+            // The preview becomes the program, and the slide after it is staged. Without slides nothing is staged to take.
+            if (_staged >= 0 && _staged < get_slide_count()) {
+                post_to_canvas(canvas_command::take(take_transition));
+                _slide = _staged;
+                stage(_slide + 1);
+            }
+            return true;
+        case VK_SPACE:
+            _is_playing = !_is_playing;
+            post_to_canvas(canvas_command::play(_is_playing));
+            return true;
+        case 'B':
+            _is_blanked = !_is_blanked;
+            post_to_canvas(canvas_command::blank(_is_blanked));
+            return true;
+        case 'L':
+            _show_overlay = !_show_overlay;
+            post_to_canvas(canvas_command::set_layer(canvas_layer_id::overlay, _show_overlay));
+            return true;
+        case 'P':
+            _show_hud = !_show_hud;
+            post_to_canvas(canvas_command::set_layer(canvas_layer_id::hud, _show_hud));
+            return true;
+        case 'E':
+            export_timeline();
+            return true;
+        case 'D':
+            dump_trace();
+            return true;
+        case 'O':
+            open_media();
+            return true;
+        case 'T':
+            open_text();
+            return true;
+        case 'F':
+            scan_folder();
+            return true;
+        case 'X':
+            export_service();
+            return true;
+        case 'V':
+            show_monitors(!_show_monitors);
+            return true;
+        case 'N':
+            toggle_network_output();
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    auto main_window::open_media() -> void
+    {
+        std::vector<wchar_t> buffer(32 * 1024, L'\0');
+        OPENFILENAMEW ofn = {};
+        ofn.lStructSize = sizeof(ofn);
+        ofn.hwndOwner = _wnd;
+        ofn.lpstrFilter = L"Video files\0*.mp4;*.m4v;*.mov;*.wmv;*.avi;*.mkv\0All files\0*.*\0";
+        ofn.lpstrFile = buffer.data();
+        ofn.nMaxFile = static_cast<DWORD>(buffer.size());
+        ofn.Flags = OFN_FILEMUSTEXIST | OFN_PATHMUSTEXIST | OFN_ALLOWMULTISELECT | OFN_EXPLORER;
+        if (!GetOpenFileNameW(&ofn)) return;
+
+        // One file comes back as a full path; several as the folder followed by the file names, all null separated
+        std::vector<std::wstring> urls;
+        std::wstring folder(buffer.data());
+        auto name = buffer.data() + folder.size() + 1;
+        if (*name == L'\0') {
+            urls.push_back(folder);
+        }
+        else {
+            for (; *name != L'\0'; name += wcslen(name) + 1) {
+                urls.push_back(folder + L"\\" + name);
+            }
+        }
+
+        // The files become the cues of the slides, in the order they were selected
+        set_media(urls);
+    }
+
+    auto main_window::set_media(const std::vector<std::wstring> &urls) -> void
+    {
+        canvas_window::set_cues(urls);
+        _media = urls;
+        _scroll = 0;
+        _slide = 0;
+        _is_playing = true;
+        post_to_canvas(canvas_command::go_to_slide(_slide));
+        stage(_slide + 1);
+    }
+
+    auto main_window::create_thumbnail_pipeline() -> void
+    {
+        if (_thumbnails != nullptr) return;
+
+        // Leave a core to the canvas; the pipeline's own thread decodes as well
+        auto workers = std::max(1u, std::thread::hardware_concurrency() - std::min(2u, std::thread::hardware_concurrency()));
+        _thumbnails.reset(new thumbnail_pipeline(wic_image_decoder::try_decode, try_load_thumbnail, save_thumbnails,
+            []() { PostMessage(_wnd, WM_USER_THUMBNAILS_READY, 0, 0); }, thumbnail_width, thumbnail_height, workers));
+    }
+
+    auto main_window::get_columns(const RECT &client) -> int
+    {
+        auto width = static_cast<int>(client.right - client.left) - (_show_monitors ? monitor_panel_width : 0);
+        return std::max(1, width / cell_width);
+    }
+
+    auto main_window::hit_test(int x, int y) -> int64_t
+    {
+        RECT client;
+        GetClientRect(_wnd, &client);
+        auto columns = get_columns(client);
+        auto column = x / cell_width;
+        if (x < 0 || column >= columns) return -1;
+        auto index = static_cast<int64_t>((y + _scroll) / cell_height) * columns + column;
+        return index < static_cast<int64_t>(_media.size()) ? index : -1;
+    }
+
+    auto main_window::scroll(int delta) -> void
+    {
+        RECT client;
+        GetClientRect(_wnd, &client);
+        auto columns = get_columns(client);
+        auto rows = static_cast<int>((_media.size() + columns - 1) / columns);
+        auto bottom = std::max(0, rows * cell_height - static_cast<int>(client.bottom - client.top));
+        auto scroll = std::min(bottom, std::max(0, _scroll + delta));
+        if (scroll != _scroll || delta == 0) {
+            _scroll = scroll;
+            InvalidateRect(_wnd, NULL, FALSE);
+        }
+    }
+
+    auto main_window::paint(HDC hdc, const RECT &client) -> void
+    {
+        FillRect(hdc, &client, GetSysColorBrush(COLOR_WINDOW));
+        if (_show_monitors) {
+            paint_monitors(hdc, client);
+        }
+        if (_media.empty() || _thumbnails == nullptr) return;
+
+        auto columns = get_columns(client);
+        auto first_row = _scroll / cell_height;
+        auto last_row = (_scroll + client.bottom - client.top + cell_height - 1) / cell_height;
+        auto first = std::min(_media.size(), static_cast<size_t>(first_row) * columns);
+        auto last = std::min(_media.size(), static_cast<size_t>(last_row) * columns);
+
+        // Only what is on screen is loaded, plus the row below it so scrolling down finds it ready
+        std::vector<std::wstring> wanted(_media.begin() + first, _media.begin() + std::min(_media.size(), last + columns));
+        _thumbnails->request(wanted);
+
+        SetBkMode(hdc, TRANSPARENT);
+        SelectObject(hdc, GetStockObject(DEFAULT_GUI_FONT));
+        for (auto i = first; i < last; i++) {
+            auto x = static_cast<int>(i % columns) * cell_width;
+            auto y = static_cast<int>(i / columns) * cell_height - _scroll;
+            RECT box{ x + cell_margin, y + cell_margin, x + cell_margin + thumbnail_width, y + cell_margin + thumbnail_height };
+            if (static_cast<int64_t>(i) == _slide) {
+                RECT selection{ x + 2, y + 2, x + cell_width - 2, y + cell_height - 2 };
+                FillRect(hdc, &selection, GetSysColorBrush(COLOR_HIGHLIGHT));
+            }
+
+            auto thumbnail = _thumbnails->try_get(_media[i]);
+            if (thumbnail != nullptr) {
+                // Centered in the box
+                BITMAPINFO bmi = {};
+                bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+                bmi.bmiHeader.biWidth = static_cast<LONG>(thumbnail->stride() / 4);
+                bmi.bmiHeader.biHeight = -thumbnail->height();
+                bmi.bmiHeader.biPlanes = 1;
+                bmi.bmiHeader.biBitCount = 32;
+                bmi.bmiHeader.biCompression = BI_RGB;
+                SetDIBitsToDevice(hdc, box.left + (thumbnail_width - thumbnail->width()) / 2, box.top + (thumbnail_height - thumbnail->height()) / 2,
+                    thumbnail->width(), thumbnail->height(), 0, 0, 0, thumbnail->height(), thumbnail->data(), &bmi, DIB_RGB_COLORS);
+            }
+            else {
+                FillRect(hdc, &box, GetSysColorBrush(COLOR_BTNFACE));
+            }
+
+            RECT label{ box.left, box.bottom, box.right, box.bottom + label_height };
+            DrawTextW(hdc, PathFindFileNameW(_media[i].c_str()), -1, &label, DT_CENTER | DT_VCENTER | DT_SINGLELINE | DT_END_ELLIPSIS | DT_NOPREFIX);
+        }
+    }
+
+    auto main_window::show_monitors(bool show) -> void
+    {
+        _show_monitors = show;
+        if (show) {
+            _program_monitor = std::make_shared<preview_feed>(monitor_width);
+            _preview_monitor = std::make_shared<preview_feed>(monitor_width);
+            SetTimer(_wnd, monitor_timer, monitor_interval_ms, NULL);
+        }
+        else {
+            KillTimer(_wnd, monitor_timer);
+            _program_monitor.reset();
+            _preview_monitor.reset();
+        }
+        canvas_window::set_program_monitor(_program_monitor);
+        canvas_window::set_preview_monitor(_preview_monitor);
+        scroll(0);
+        InvalidateRect(_wnd, NULL, FALSE);
+    }
+
+    auto main_window::stage(int64_t slide) -> void
+    {
+        // Past the last slide there is nothing to stage; the last one stays on the preview
+        _staged = std::max<int64_t>(0, std::min(slide, get_slide_count() - 1));
+        post_to_canvas(canvas_command::stage(_staged));
+    }
+
+    auto main_window::get_slide_count() -> int64_t
+    {
+        return static_cast<int64_t>(std::max(_media.size(), _slide_texts.size()));
+    }
+
+    auto main_window::toggle_network_output() -> void
+    {
+        if (_network != nullptr) {
+            canvas_window::set_network_output(nullptr);
+            _network->stop();
+            _network.reset();
+        }
+        else {
+            auto network = std::make_shared<network_output>();
+            if (!network->try_start(network_output::default_port)) {
+                MessageBoxW(_wnd, L"The canvas can't be streamed, as its port is in use", L"Network output", MB_OK | MB_ICONERROR);
+                return;
+            }
+            _network = network;
+            canvas_window::set_network_output(_network);
+        }
+        InvalidateRect(_wnd, NULL, FALSE);
+    }
+
+    auto main_window::get_monitors_rect(const RECT &client) -> RECT
+    {
+        auto left = static_cast<int>(client.right) - monitor_width - monitor_margin;
+        return RECT{ left, monitor_margin, left + monitor_width, monitor_margin + (monitor_height + monitor_label_height) * 2 + monitor_margin };
+    }
+
+    auto main_window::paint_monitors(HDC hdc, const RECT &client) -> void
+    {
+        auto bounds = get_monitors_rect(client);
+        FillRect(hdc, &bounds, GetSysColorBrush(COLOR_WINDOW));
+        wchar_t title[64];
+        if (_network != nullptr) {
+            auto statistics = _network->get_statistics();
+            swprintf_s(title, L"Program, streaming to %llu at %llu kB/s", static_cast<unsigned long long>(statistics.receivers),
+                statistics.bytes_per_second / 1024);
+        }
+        else {
+            swprintf_s(title, L"Program");
+        }
+        paint_monitor(hdc, bounds.left, bounds.top, _program_monitor.get(), title);
+        swprintf_s(title, L"Preview: slide %lld", static_cast<long long>(_staged + 1));
+        paint_monitor(hdc, bounds.left, bounds.top + monitor_height + monitor_label_height + monitor_margin, _preview_monitor.get(), title);
+    }
+
+    auto main_window::paint_monitor(HDC hdc, int left, int top, preview_feed *monitor, const wchar_t *title) -> void
+    {
+        RECT picture{ left, top, left + monitor_width, top + monitor_height };
+        RECT label{ left, picture.bottom, picture.right, picture.bottom + monitor_label_height };
+        FillRect(hdc, &picture, static_cast<HBRUSH>(GetStockObject(BLACK_BRUSH)));
+        if (monitor == nullptr) return;
+
+        auto frame = monitor->acquire();
+        if (frame != nullptr && !frame->pixels.empty()) {
+            // Letterboxed, as the canvas needn't be 16:9
+            auto &pixels = frame->pixels;
+            auto scale = std::min(static_cast<double>(monitor_width) / pixels.width(), static_cast<double>(monitor_height) / pixels.height());
+            auto width = static_cast<int>(pixels.width() * scale);
+            auto height = static_cast<int>(pixels.height() * scale);
+            BITMAPINFO bmi = {};
+            bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+            bmi.bmiHeader.biWidth = static_cast<LONG>(pixels.stride() / 4);
+            bmi.bmiHeader.biHeight = -pixels.height();
+            bmi.bmiHeader.biPlanes = 1;
+            bmi.bmiHeader.biBitCount = 32;
+            bmi.bmiHeader.biCompression = BI_RGB;
+            SetStretchBltMode(hdc, HALFTONE);
+            SetBrushOrgEx(hdc, 0, 0, NULL);
+            StretchDIBits(hdc, picture.left + (monitor_width - width) / 2, picture.top + (monitor_height - height) / 2, width, height,
+                0, 0, pixels.width(), pixels.height(), pixels.data(), &bmi, DIB_RGB_COLORS, SRCCOPY);
+        }
+
+        auto statistics = monitor->get_statistics();
+        wchar_t text[256];
+        swprintf_s(text, L"%s - frame %lld, %llu of %llu shown\nDownscale %.2f ms, latency %.1f ms", title,
+            frame != nullptr ? static_cast<long long>(frame->index) : -1LL, statistics.shown, statistics.published, statistics.downscale_ms, statistics.latency_ms);
+        SetBkMode(hdc, TRANSPARENT);
+        SelectObject(hdc, GetStockObject(DEFAULT_GUI_FONT));
+        DrawTextW(hdc, text, -1, &label, DT_LEFT | DT_NOPREFIX);
+    }
+
+    auto main_window::dump_trace() -> void
+    {
+        auto path = event_trace::begin_dump("manual");
+        if (path.empty()) {
+            MessageBoxW(_wnd, L"A trace is still being written, or there is nowhere to write it", L"Trace", MB_OK | MB_ICONERROR);
+            return;
+        }
+        MessageBoxA(_wnd, path.c_str(), "Trace written to", MB_OK | MB_ICONINFORMATION);
+    }
+
+    auto main_window::export_timeline() -> void
+    {
+        wchar_t path[MAX_PATH] = L"frames.csv";
+        OPENFILENAMEW ofn = {};
+        ofn.lStructSize = sizeof(ofn);
+        ofn.hwndOwner = _wnd;
+        ofn.lpstrFilter = L"CSV files\0*.csv\0All files\0*.*\0";
+        ofn.lpstrFile = path;
+        ofn.nMaxFile = MAX_PATH;
+        ofn.lpstrDefExt = L"csv";
+        ofn.Flags = OFN_OVERWRITEPROMPT | OFN_PATHMUSTEXIST;
+        if (!GetSaveFileNameW(&ofn)) return;
+
+        if (!canvas_window::try_export_timeline(path)) {
+            MessageBoxW(_wnd, path, L"Failure writing the frame timings", MB_OK);
+        }
+    }
+
+    auto main_window::open_text() -> void
+    {
+        wchar_t path[MAX_PATH] = L"";
+        OPENFILENAMEW ofn = {};
+        ofn.lStructSize = sizeof(ofn);
+        ofn.hwndOwner = _wnd;
+        ofn.lpstrFilter = L"Text files\0*.txt\0All files\0*.*\0";
+        ofn.lpstrFile = path;
+        ofn.nMaxFile = MAX_PATH;
+        ofn.Flags = OFN_FILEMUSTEXIST | OFN_PATHMUSTEXIST;
+        if (!GetOpenFileNameW(&ofn)) return;
+
+        std::wstring text;
+        if (!try_read_text_file(path, text)) {
+            MessageBoxW(_wnd, path, L"Failure reading the text file", MB_OK);
+            return;
+        }
+
+        // Paragraphs (separated by blank lines) become the slides
+        std::vector<std::wstring> slides;
+        std::wstring slide;
+        size_t start = 0;
+        while (start <= text.size()) {
+            auto end = text.find(L'\n', start);
+            if (end == std::wstring::npos) end = text.size();
+            auto line = text.substr(start, end - start);
+            if (!line.empty() && line.back() == L'\r') line.pop_back();
+            if (line.empty()) {
+                if (!slide.empty()) slides.push_back(slide);
+                slide.clear();
+            }
+            else {
+                if (!slide.empty()) slide += L'\n';
+                slide += line;
+            }
+            start = end + 1;
+        }
+        if (!slide.empty()) slides.push_back(slide);
+
+        canvas_window::set_slide_texts(slides);
+        _slide_texts = slides;
+        _slide = 0;
+        post_to_canvas(canvas_command::go_to_slide(_slide));
+        stage(_slide + 1);
+    }
+
+    auto main_window::scan_folder() -> void
+    {
+        if (_scan.joinable()) {
+            MessageBoxW(_wnd, L"A folder is being scanned already", L"Media library", MB_OK | MB_ICONINFORMATION);
+            return;
+        }
+
+        wchar_t path[MAX_PATH] = L"";
+        BROWSEINFOW bi = {};
+        bi.hwndOwner = _wnd;
+        bi.lpszTitle = L"Add a folder to the media library";
+        bi.ulFlags = BIF_RETURNONLYFSDIRS | BIF_NEWDIALOGSTYLE;
+        auto list = SHBrowseForFolderW(&bi);
+        if (list == NULL) return;
+        auto ok = SHGetPathFromIDListW(list, path);
+        CoTaskMemFree(list);
+        if (!ok) return;
+
+        // The library is only used by the scan until it finishes
+        std::wstring folder(path);
+        _scan = std::thread([folder]() {
+            std::unique_ptr<scan_statistics> stats;
+            try {
+                media_scanner scanner(*application::get_library());
+                stats.reset(new scan_statistics(scanner.scan(folder, _stop_scan)));
+            }
+            catch (std::exception &) {
+                // Reported as a failed scan
+            }
+            if (PostMessage(_wnd, WM_USER_SCAN_FINISHED, 0, reinterpret_cast<LPARAM>(stats.get()))) {
+                stats.release();
+            }
+        });
+    }
+
+    auto main_window::export_service() -> void
+    {
+        if (_export.joinable()) {
+            MessageBoxW(_wnd, L"The service is being exported already", L"Export", MB_OK | MB_ICONINFORMATION);
+            return;
+        }
+        if (_media.empty() && _slide_texts.empty()) {
+            MessageBoxW(_wnd, L"There are no slides or media to export", L"Export", MB_OK | MB_ICONINFORMATION);
+            return;
+        }
+
+        wchar_t path[MAX_PATH] = L"service";
+        OPENFILENAMEW ofn = {};
+        ofn.lStructSize = sizeof(ofn);
+        ofn.hwndOwner = _wnd;
+        ofn.lpstrFilter = L"Raw BGRA video\0*.bgra\0PPM image sequence\0*.ppm\0";
+        ofn.lpstrFile = path;
+        ofn.nMaxFile = MAX_PATH;
+        ofn.lpstrDefExt = L"bgra";
+        ofn.Flags = OFN_OVERWRITEPROMPT | OFN_PATHMUSTEXIST;
+        if (!GetSaveFileNameW(&ofn)) return;
+
+        export_options options;
+        options.cancel = &_stop_export;
+        options.format = ofn.nFilterIndex == 2 ? export_format::image_sequence : export_format::raw;
+        char narrow[MAX_PATH * 2];
+        WideCharToMultiByte(CP_ACP, 0, path, -1, narrow, sizeof(narrow), NULL, NULL);
+        options.path = narrow;
+        // The sequence numbers go before the extension
+        if (options.format == export_format::image_sequence && options.path.size() > 4 && options.path.compare(options.path.size() - 4, 4, ".ppm") == 0) {
+            options.path.resize(options.path.size() - 4);
+        }
+
+        auto slides = _slide_texts;
+        auto cues = _media;
+        _export = std::thread([options, slides, cues]() {
+            event_trace::set_thread_name("export");
+            std::unique_ptr<export_result> result;
+            bool com = SUCCEEDED(CoInitializeEx(NULL, COINIT_MULTITHREADED));
+            try {
+                // Stills are decoded at the size of the export, not of the canvas
+                auto open = [](const std::wstring &url) { return canvas_window::open_media(url, export_width, export_height); };
+                auto script = offline_exporter::make_service_script(slides, cues, open, export_width, export_height, export_frame_rate, export_hold);
+                result.reset(new export_result(offline_exporter::run(script, options, open, std::make_shared<gdi_glyph_rasterizer>())));
+            }
+            catch (std::exception &) {
+                // Reported as a failed export
+            }
+            if (com) {
+                CoUninitialize();
+            }
+            if (PostMessage(_wnd, WM_USER_EXPORT_FINISHED, 0, reinterpret_cast<LPARAM>(result.get()))) {
+                result.release();
+            }
+        });
+    }
+
+    auto main_window::try_read_text_file(const std::wstring &path, std::wstring &text) -> bool
+    {
+        auto file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE) return false;
+
+        std::vector<char> bytes;
+        LARGE_INTEGER size;
+        bool ok = GetFileSizeEx(file, &size) != FALSE && size.QuadPart < (64 << 20);
+        if (ok) {
+            bytes.resize(static_cast<size_t>(size.QuadPart));
+            DWORD read = 0;
+            ok = bytes.empty() || (ReadFile(file, bytes.data(), static_cast<DWORD>(bytes.size()), &read, NULL) != FALSE && read == bytes.size());
+        }
+        CloseHandle(file);
+        if (!ok) return false;
+
+        // UTF-16 with a byte order mark, else UTF-8 (with or without one)
+        if (bytes.size() >= 2 && static_cast<unsigned char>(bytes[0]) == 0xff && static_cast<unsigned char>(bytes[1]) == 0xfe) {
+            text.assign(reinterpret_cast<const wchar_t*>(bytes.data() + 2), (bytes.size() - 2) / 2);
+            return true;
+        }
+        size_t skip = bytes.size() >= 3 && static_cast<unsigned char>(bytes[0]) == 0xef && static_cast<unsigned char>(bytes[1]) == 0xbb && static_cast<unsigned char>(bytes[2]) == 0xbf ? 3 : 0;
+        text.clear();
+        if (bytes.size() == skip) return true;
+        auto length = MultiByteToWideChar(CP_UTF8, 0, bytes.data() + skip, static_cast<int>(bytes.size() - skip), NULL, 0);
+        if (length <= 0) return false;
+        text.resize(static_cast<size_t>(length));
+        MultiByteToWideChar(CP_UTF8, 0, bytes.data() + skip, static_cast<int>(bytes.size() - skip), &text[0], length);
+        return true;
+    }
+
+    auto main_window::post_to_canvas(const canvas_command &command) -> void
+    {
+        // The canvas drains the queue every frame, so a full queue means it is stalled; drop the command rather than block the operator
+        if (!canvas_window::post(command)) {
+            MessageBeep(MB_ICONWARNING);
+        }
+        // The browser highlights the current slide
+        if (_wnd != NULL) {
+            InvalidateRect(_wnd, NULL, FALSE);
+        }
+    }
+
     auto main_window::try_show(int x, int y, int width, int height, int nCmdShow, bool update_immediately) -> bool
     {
         assert(application::instance() != NULL);
         if (!try_register_class()) return false;
         if (!try_create_window(x, y, width, height)) return false;
+        create_thumbnail_pipeline();
+        show_monitors(_show_monitors);
         ShowWindow(_wnd, nCmdShow);
         if (update_immediately) {
             UpdateWindow(_wnd);
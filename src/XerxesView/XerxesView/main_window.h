@@ -1,6 +1,16 @@
 #pragma once
 
 #include <windows.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "..\renderlib\canvas_command.h"
+#include "..\renderlib\thumbnail_pipeline.h"
+#include "..\renderlib\preview_feed.h"
+#include "..\renderlib\network_output.h"
 
 #define MAIN_WINDOW_CLASS_NAME L"XerxesViewMainWindow"
 #define MAX_INITIAL_TITLE_LENGTH 500
@@ -12,16 +22,73 @@ namespace xerxes
         static ATOM _registration;
         static HWND _wnd;
 
+        // What the operator asked the canvas to show. The canvas applies it on its own thread.
+        static int64_t _slide;
+        static bool _is_blanked;
+        static bool _is_playing;
+        static bool _show_overlay;
+        static bool _show_hud;
+        // The slide on the preview bus, which Enter takes to the program
+        static int64_t _staged;
+        // Live copies of the program (the canvas) and of the preview bus, in a panel right of the media browser
+        static bool _show_monitors;
+        static std::shared_ptr<preview_feed> _program_monitor;
+        static std::shared_ptr<preview_feed> _preview_monitor;
+        // Streams the canvas to receivers on this machine while switched on
+        static std::shared_ptr<network_output> _network;
+
+        // The media browser: one thumbnail per cue, loaded only when scrolled into view
+        static std::vector<std::wstring> _media;
+        static std::unique_ptr<thumbnail_pipeline> _thumbnails;
+        static int _scroll;
+        // Scans a folder into the media library, one at a time
+        static std::thread _scan;
+        // Set when the window closes, so the scan doesn't keep it waiting
+        static std::atomic<bool> _stop_scan;
+        // The text of the slides, kept for exports
+        static std::vector<std::wstring> _slide_texts;
+        // Renders the service to a file, one at a time
+        static std::thread _export;
+        // Set when the window closes, so the export stops at the next frame
+        static std::atomic<bool> _stop_export;
+
         static LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam);
 
         static auto try_register_class() -> bool;
         static auto try_create_window(int x, int y, int width, int height) -> bool;
         static auto show_canvas_window() -> void;
         static auto close_canvas_window() -> void;
+        static auto on_key_down(WPARAM key) -> bool;
+        static auto post_to_canvas(const canvas_command &command) -> void;
+        static auto open_media() -> void;
+        static auto open_text() -> void;
+        static auto export_timeline() -> void;
+        static auto dump_trace() -> void;
+        static auto scan_folder() -> void;
+        static auto export_service() -> void;
+        static auto try_read_text_file(const std::wstring &path, std::wstring &text) -> bool;
+        static auto create_thumbnail_pipeline() -> void;
+        static auto paint(HDC hdc, const RECT &client) -> void;
+        static auto show_monitors(bool show) -> void;
+        static auto stage(int64_t slide) -> void;
+        // A slide for every cue or text, whichever there are more of
+        static auto get_slide_count() -> int64_t;
+        static auto toggle_network_output() -> void;
+        // Both monitors, each with its statistics under it
+        static auto get_monitors_rect(const RECT &client) -> RECT;
+        static auto paint_monitors(HDC hdc, const RECT &client) -> void;
+        static auto paint_monitor(HDC hdc, int left, int top, preview_feed *monitor, const wchar_t *title) -> void;
+        static auto get_columns(const RECT &client) -> int;
+        // The media index at a point of the client area, or -1
+        static auto hit_test(int x, int y) -> int64_t;
+        static auto scroll(int delta) -> void;
     public:
         // Try to register the class of this window, create the window and show it. Returns true on success, or false on failure. Use GetLastError and FormatMessage to get the actual error message.
         static auto try_show(int x, int y, int width, int height, int nCmdShow, bool update_immediately = true) -> bool;
 
+        // Make files the cues of the slides, in order, show them in the browser and go to the first
+        static auto set_media(const std::vector<std::wstring> &urls) -> void;
+
         // No instances possible
         main_window() = delete;
 
@@ -0,0 +1,258 @@
+#include "stdafx.h"
+#include "mapped_image_source.h"
+#include "wic_image_decoder.h"
+
+#include <algorithm>
+
+namespace xerxes
+{
+    namespace
+    {
+        template <class T> void SafeRelease(T **ppT)
+        {
+            if (*ppT)
+            {
+                (*ppT)->Release();
+                *ppT = NULL;
+            }
+        }
+
+        // The pixel formats decoders hand out when scaling; anything else goes through a format converter
+        auto get_bytes_per_pixel(const WICPixelFormatGUID &format) -> int
+        {
+            if (format == GUID_WICPixelFormat32bppBGRA || format == GUID_WICPixelFormat32bppBGR) return 4;
+            if (format == GUID_WICPixelFormat24bppBGR) return 3;
+            if (format == GUID_WICPixelFormat8bppGray) return 1;
+            return 0;
+        }
+
+        // Turn a row decoded into the start of its buffer into premultiplied BGRA. Goes right to left, so the wider pixels
+        // never overwrite narrow ones that haven't been read yet.
+        auto widen_row(uint8_t *row, int width, const WICPixelFormatGUID &format) -> void
+        {
+            auto dst = reinterpret_cast<uint32_t*>(row);
+            if (format == GUID_WICPixelFormat24bppBGR) {
+                for (int x = width - 1; x >= 0; x--) {
+                    auto src = row + x * 3;
+                    dst[x] = 0xff000000 | (static_cast<uint32_t>(src[2]) << 16) | (static_cast<uint32_t>(src[1]) << 8) | src[0];
+                }
+            }
+            else if (format == GUID_WICPixelFormat8bppGray) {
+                for (int x = width - 1; x >= 0; x--) {
+                    dst[x] = 0xff000000 | (static_cast<uint32_t>(row[x]) * 0x010101);
+                }
+            }
+            else if (format == GUID_WICPixelFormat32bppBGR) {
+                for (int x = 0; x < width; x++) {
+                    dst[x] |= 0xff000000;
+                }
+            }
+            else {
+                for (int x = 0; x < width; x++) {
+                    auto p = dst[x];
+                    auto a = p >> 24;
+                    if (a == 255) continue;
+                    auto premultiply = [a](uint32_t c) { return (c * a + 127) / 255; };
+                    dst[x] = (a << 24) | (premultiply((p >> 16) & 0xff) << 16) | (premultiply((p >> 8) & 0xff) << 8) | premultiply(p & 0xff);
+                }
+            }
+        }
+    }
+
+    mapped_image_source::mapped_image_source(HANDLE file, HANDLE mapping, const void *view)
+        : _file(file), _mapping(mapping), _view(view), _region(), _decode_region(), _info()
+    {
+    }
+
+    mapped_image_source::~mapped_image_source()
+    {
+        SafeRelease(&_frame);
+        SafeRelease(&_decoder);
+        SafeRelease(&_stream);
+        UnmapViewOfFile(_view);
+        CloseHandle(_mapping);
+        CloseHandle(_file);
+    }
+
+    auto mapped_image_source::try_open(const std::wstring &path, int width, int height, const pixel_rect &region) -> std::unique_ptr<mapped_image_source>
+    {
+        auto factory = wic_image_decoder::get_factory();
+        if (factory == NULL) return nullptr;
+
+        auto file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE) return nullptr;
+        // WIC streams over memory take a DWORD size
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size) || size.QuadPart == 0 || size.QuadPart > MAXDWORD) {
+            CloseHandle(file);
+            return nullptr;
+        }
+        auto mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        const void *view = mapping != NULL ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+        if (view == NULL) {
+            if (mapping != NULL) CloseHandle(mapping);
+            CloseHandle(file);
+            return nullptr;
+        }
+
+        // Owns the handles from here on
+        std::unique_ptr<mapped_image_source> source(new mapped_image_source(file, mapping, view));
+        // Only the header is parsed here; the pixels are decoded from the mapped pages on the first read
+        HRESULT hr = factory->CreateStream(&source->_stream);
+        if (SUCCEEDED(hr)) hr = source->_stream->InitializeFromMemory(static_cast<BYTE*>(const_cast<void*>(view)), static_cast<DWORD>(size.QuadPart));
+        if (SUCCEEDED(hr)) hr = factory->CreateDecoderFromStream(source->_stream, NULL, WICDecodeMetadataCacheOnDemand, &source->_decoder);
+        if (SUCCEEDED(hr)) hr = source->_decoder->GetFrame(0, &source->_frame);
+        if (FAILED(hr) || !source->try_prepare(width, height, region)) return nullptr;
+        return source;
+    }
+
+    auto mapped_image_source::try_prepare(int width, int height, const pixel_rect &region) -> bool
+    {
+        UINT w = 0, h = 0;
+        if (FAILED(_frame->GetSize(&w, &h)) || w == 0 || h == 0) return false;
+
+        auto all = pixel_rect::from_size(static_cast<int>(w), static_cast<int>(h));
+        auto shown = region.empty() ? all : region.intersect(all);
+        if (shown.empty()) return false;
+        _region = WICRect{ shown.left, shown.top, shown.width(), shown.height() };
+
+        // Fit the region inside the target with its aspect ratio. Stills aren't enlarged here; the video layer does that.
+        auto scale = 1.0;
+        if (width > 0 && height > 0) {
+            scale = std::min(1.0, std::min(static_cast<double>(width) / shown.width(), static_cast<double>(height) / shown.height()));
+        }
+        _info.width = std::max(1, static_cast<int>(shown.width() * scale + 0.5));
+        _info.height = std::max(1, static_cast<int>(shown.height() * scale + 0.5));
+        // A still has no frame rate or duration
+        _info.frame_rate = 0.0;
+        _info.duration = std::chrono::nanoseconds(0);
+
+        if (scale < 1.0 && try_choose_decode_size(w, h)) {
+            // The decoder's reduction is at most 2x larger than needed; the video layer filters the rest
+            _info.width = _decode_region.Width;
+            _info.height = _decode_region.Height;
+        }
+        return true;
+    }
+
+    auto mapped_image_source::try_choose_decode_size(UINT width, UINT height) -> bool
+    {
+        IWICBitmapSourceTransform *transform = NULL;
+        if (FAILED(_frame->QueryInterface(IID_PPV_ARGS(&transform)))) return false;
+
+        // The largest reduction whose view of the region still covers the fitted size
+        auto chosen = false;
+        for (UINT factor = 8; factor >= 2 && !chosen; factor /= 2) {
+            UINT dw = (width + factor - 1) / factor;
+            UINT dh = (height + factor - 1) / factor;
+            if (FAILED(transform->GetClosestSize(&dw, &dh)) || dw == 0 || dh == 0 || dw >= width || dh >= height) continue;
+
+            // The region in the reduced pixels, rounded outwards
+            auto left = static_cast<INT>(static_cast<UINT64>(_region.X) * dw / width);
+            auto top = static_cast<INT>(static_cast<UINT64>(_region.Y) * dh / height);
+            auto right = static_cast<INT>(std::min<UINT64>(dw, (static_cast<UINT64>(_region.X + _region.Width) * dw + width - 1) / width));
+            auto bottom = static_cast<INT>(std::min<UINT64>(dh, (static_cast<UINT64>(_region.Y + _region.Height) * dh + height - 1) / height));
+            if (right - left < _info.width || bottom - top < _info.height) continue;
+
+            _decode_width = dw;
+            _decode_height = dh;
+            _decode_region = WICRect{ left, top, right - left, bottom - top };
+            chosen = true;
+        }
+        SafeRelease(&transform);
+        return chosen;
+    }
+
+    auto mapped_image_source::try_decode_transformed(surface &pixels) -> bool
+    {
+        IWICBitmapSourceTransform *transform = NULL;
+        if (FAILED(_frame->QueryInterface(IID_PPV_ARGS(&transform)))) return false;
+
+        WICPixelFormatGUID format = GUID_WICPixelFormat32bppBGRA;
+        HRESULT hr = transform->GetClosestPixelFormat(&format);
+        if (SUCCEEDED(hr) && get_bytes_per_pixel(format) == 0) hr = WINCODEC_ERR_UNSUPPORTEDPIXELFORMAT;
+        if (SUCCEEDED(hr)) {
+            // The rectangle is in the reduced pixels. Rows above it are skipped without the inverse DCT, and the decoder stops
+            // at its bottom. Narrower pixels land at the start of each row and are widened in place.
+            pixels.resize(_decode_region.Width, _decode_region.Height);
+            hr = transform->CopyPixels(&_decode_region, _decode_width, _decode_height, &format, WICBitmapTransformRotate0,
+                static_cast<UINT>(pixels.stride()), static_cast<UINT>(pixels.size_in_bytes()), pixels.data());
+        }
+        if (SUCCEEDED(hr)) {
+            for (int y = 0; y < pixels.height(); y++) {
+                widen_row(reinterpret_cast<uint8_t*>(pixels.row(y)), pixels.width(), format);
+            }
+        }
+
+        SafeRelease(&transform);
+        return SUCCEEDED(hr);
+    }
+
+    auto mapped_image_source::try_decode_pulled(surface &pixels) -> bool
+    {
+        auto factory = wic_image_decoder::get_factory();
+        if (factory == NULL) return false;
+
+        IWICBitmapClipper *clipper = NULL;
+        IWICBitmapScaler *scaler = NULL;
+        IWICFormatConverter *converter = NULL;
+        IWICBitmapSource *source = _frame;
+        source->AddRef();
+        UINT w = 0, h = 0;
+
+        // Each stage pulls only the rows it needs from the one before, so nothing is decoded at full size in one piece
+        HRESULT hr = _frame->GetSize(&w, &h);
+        if (SUCCEEDED(hr) && (_region.X != 0 || _region.Y != 0 || static_cast<UINT>(_region.Width) != w || static_cast<UINT>(_region.Height) != h)) {
+            hr = factory->CreateBitmapClipper(&clipper);
+            if (SUCCEEDED(hr)) hr = clipper->Initialize(source, &_region);
+            if (SUCCEEDED(hr)) {
+                SafeRelease(&source);
+                source = clipper;
+                source->AddRef();
+            }
+        }
+        if (SUCCEEDED(hr) && (_info.width != _region.Width || _info.height != _region.Height)) {
+            hr = factory->CreateBitmapScaler(&scaler);
+            if (SUCCEEDED(hr)) hr = scaler->Initialize(source, static_cast<UINT>(_info.width), static_cast<UINT>(_info.height), WICBitmapInterpolationModeFant);
+            if (SUCCEEDED(hr)) {
+                SafeRelease(&source);
+                source = scaler;
+                source->AddRef();
+            }
+        }
+        if (SUCCEEDED(hr)) hr = factory->CreateFormatConverter(&converter);
+        if (SUCCEEDED(hr)) hr = converter->Initialize(source, GUID_WICPixelFormat32bppPBGRA, WICBitmapDitherTypeNone, NULL, 0.0, WICBitmapPaletteTypeCustom);
+        if (SUCCEEDED(hr)) {
+            pixels.resize(_info.width, _info.height);
+            hr = converter->CopyPixels(NULL, static_cast<UINT>(pixels.stride()), static_cast<UINT>(pixels.size_in_bytes()), pixels.data());
+        }
+
+        SafeRelease(&converter);
+        SafeRelease(&source);
+        SafeRelease(&scaler);
+        SafeRelease(&clipper);
+        return SUCCEEDED(hr);
+    }
+
+    auto mapped_image_source::read_frame(video_frame &frame) -> bool
+    {
+        if (_delivered) return false;
+        // The decoder may have been opened on another thread; this one has to be in the MTA too
+        if (wic_image_decoder::get_factory() == NULL) return false;
+
+        // A decoder that can scale, but not into a format taken here, is pulled through a converter at the same size instead
+        auto decoded = (_decode_width != 0 && try_decode_transformed(frame.pixels)) || try_decode_pulled(frame.pixels);
+        if (!decoded) return false;
+
+        frame.timestamp = std::chrono::nanoseconds(0);
+        frame.duration = std::chrono::nanoseconds(0);
+        _delivered = true;
+        return true;
+    }
+
+    auto mapped_image_source::seek(std::chrono::nanoseconds position) -> bool
+    {
+        _delivered = false;
+        return true;
+    }
+}
\ No newline at end of file
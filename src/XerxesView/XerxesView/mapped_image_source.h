@@ -0,0 +1,54 @@
+#pragma once
+
+#include <windows.h>
+#include <wincodec.h>
+#include <memory>
+#include <string>
+#include "..\renderlib\media_source.h"
+#include "..\renderlib\damage_region.h"
+
+namespace xerxes
+{
+    // Shows a still as a media source with a single frame. The file is memory mapped instead of read, and nothing is decoded
+    // until the frame is read; then only the region that is shown is decoded, at the size it is shown.
+    // Decoders that can scale while decoding (JPEG, in the DCT domain, by 1/2, 1/4 or 1/8) are asked for the smallest of those
+    // sizes that still covers the canvas, so an 8K still on an HD canvas never exists at full size. Other formats are pulled
+    // through a clipper and a scaler, which decode the rows or tiles they need a band at a time.
+    class mapped_image_source : public media_source {
+    private:
+        HANDLE _file;
+        HANDLE _mapping;
+        const void *_view;
+        IWICStream *_stream = NULL;
+        IWICBitmapDecoder *_decoder = NULL;
+        IWICBitmapFrameDecode *_frame = NULL;
+        // The part of the still shown, in its own pixels
+        WICRect _region;
+        // Non-zero when the decoder reduces the whole still to this size, and _decode_region is the region in those pixels
+        UINT _decode_width = 0;
+        UINT _decode_height = 0;
+        WICRect _decode_region;
+        media_info _info;
+        bool _delivered = false;
+
+        mapped_image_source(HANDLE file, HANDLE mapping, const void *view);
+
+        auto try_prepare(int width, int height, const pixel_rect &region) -> bool;
+        auto try_choose_decode_size(UINT width, UINT height) -> bool;
+        auto try_decode_transformed(surface &pixels) -> bool;
+        auto try_decode_pulled(surface &pixels) -> bool;
+    public:
+        mapped_image_source(const mapped_image_source &) = delete;
+        auto operator=(const mapped_image_source &)->mapped_image_source& = delete;
+        virtual ~mapped_image_source();
+
+        // The still at path, to be shown inside width x height. region is the part of the still to show; an empty region
+        // shows all of it. Returns nullptr if the file isn't a still that WIC can decode.
+        static auto try_open(const std::wstring &path, int width, int height, const pixel_rect &region = pixel_rect{ 0, 0, 0, 0 }) -> std::unique_ptr<mapped_image_source>;
+
+        virtual auto get_info() const -> media_info override { return _info; }
+        virtual auto read_frame(video_frame &frame) -> bool override;
+        // Any position shows the still again
+        virtual auto seek(std::chrono::nanoseconds position) -> bool override;
+    };
+}
\ No newline at end of file
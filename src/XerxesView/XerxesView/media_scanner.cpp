@@ -0,0 +1,200 @@
+#include "stdafx.h"
+#include "media_scanner.h"
+
+#include <Shlwapi.h>
+#include <initguid.h>
+#include <propkey.h>
+#include <propvarutil.h>
+#include <ShlObj.h>
+#include <algorithm>
+#include <iterator>
+#include <unordered_map>
+
+namespace xerxes
+{
+    namespace
+    {
+        const wchar_t *media_extensions[] = {
+            L".mp4", L".m4v", L".mov", L".wmv", L".avi", L".mkv", L".mp3", L".m4a", L".wma", L".wav",
+            L".jpg", L".jpeg", L".png", L".bmp", L".gif", L".tif", L".tiff"
+        };
+
+        inline auto to_long_long(const FILETIME &t) -> long long
+        {
+            return static_cast<long long>((static_cast<ULONGLONG>(t.dwHighDateTime) << 32) | t.dwLowDateTime);
+        }
+
+        auto read_string_property(IPropertyStore *store, REFPROPERTYKEY key, std::wstring &value) -> bool
+        {
+            PROPVARIANT var;
+            PropVariantInit(&var);
+            bool found = false;
+            if (SUCCEEDED(store->GetValue(key, &var)) && var.vt != VT_EMPTY) {
+                // Keywords come as a vector of strings; this joins them with "; "
+                PWSTR text = NULL;
+                if (SUCCEEDED(PropVariantToStringAlloc(var, &text)) && text != NULL) {
+                    value = text;
+                    found = !value.empty();
+                    CoTaskMemFree(text);
+                }
+            }
+            PropVariantClear(&var);
+            return found;
+        }
+    }
+
+    const size_t media_scanner::batch_size;
+
+    media_scanner::media_scanner(media_library &library)
+        : _library(library)
+    {
+    }
+
+    auto media_scanner::is_media_file(const wchar_t *name) -> bool
+    {
+        auto extension = PathFindExtensionW(name);
+        for (auto e : media_extensions) {
+            if (_wcsicmp(extension, e) == 0) return true;
+        }
+        return false;
+    }
+
+    auto media_scanner::list_directory(const std::wstring &directory, const std::atomic<bool> &stop, listing &result) -> bool
+    {
+        // The basic information and large fetches make this one round trip per few hundred entries, and the sizes and times come with the names
+        WIN32_FIND_DATAW data;
+        auto find = FindFirstFileExW((directory + L"\\*").c_str(), FindExInfoBasic, &data, FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH);
+        if (find == INVALID_HANDLE_VALUE) return GetLastError() == ERROR_FILE_NOT_FOUND;
+
+        do {
+            if (stop) break;
+            if ((data.dwFileAttributes & (FILE_ATTRIBUTE_HIDDEN | FILE_ATTRIBUTE_SYSTEM)) != 0) continue;
+            if ((data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0) {
+                // Links could lead back up the tree
+                if ((data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0) continue;
+                if (wcscmp(data.cFileName, L".") == 0 || wcscmp(data.cFileName, L"..") == 0) continue;
+                result.directories.push_back(directory + L"\\" + data.cFileName);
+            }
+            else if (is_media_file(data.cFileName)) {
+                auto size = static_cast<long long>((static_cast<ULONGLONG>(data.nFileSizeHigh) << 32) | data.nFileSizeLow);
+                result.files.push_back(found_file{ directory + L"\\" + data.cFileName, to_long_long(data.ftLastWriteTime), size });
+            }
+        } while (FindNextFileW(find, &data));
+        FindClose(find);
+        return true;
+    }
+
+    auto media_scanner::probe(const found_file &file, media_item &item) -> void
+    {
+        item.path = file.path;
+        item.modified = file.modified;
+        item.size = file.size;
+        item.lyrics.clear();
+
+        // The file's own title and keywords if it has them, else its name and folder
+        bool com = SUCCEEDED(CoInitializeEx(NULL, COINIT_MULTITHREADED));
+        IPropertyStore *store = NULL;
+        bool has_title = false, has_tags = false;
+        if (com && SUCCEEDED(SHGetPropertyStoreFromParsingName(file.path.c_str(), NULL, GPS_DEFAULT, IID_PPV_ARGS(&store)))) {
+            has_title = read_string_property(store, PKEY_Title, item.title);
+            has_tags = read_string_property(store, PKEY_Keywords, item.tags);
+            store->Release();
+        }
+        if (com) {
+            CoUninitialize();
+        }
+
+        auto name = PathFindFileNameW(file.path.c_str());
+        if (!has_title) {
+            item.title.assign(name, PathFindExtensionW(name));
+        }
+        if (!has_tags) {
+            auto folder = file.path.substr(0, static_cast<size_t>(name - file.path.c_str()) - 1);
+            item.tags = PathFindFileNameW(folder.c_str());
+        }
+    }
+
+    auto media_scanner::scan(const std::wstring &folder, const std::atomic<bool> &stop) -> scan_statistics
+    {
+        auto start = std::chrono::steady_clock::now();
+        scan_statistics stats{};
+        auto root = folder;
+        while (!root.empty() && root.back() == L'\\') root.pop_back();
+
+        // What the library knows, to be crossed off as the files are found
+        std::unordered_map<std::wstring, std::pair<long long, long long>> known;
+        _library.get_versions(root, [&known](std::wstring &&path, long long modified, long long size) { known.emplace(std::move(path), std::make_pair(modified, size)); });
+
+        std::vector<found_file> changed;
+        std::vector<bool> is_new;
+        std::vector<std::wstring> unreadable;
+        std::vector<std::wstring> level{ root };
+        std::vector<listing> listings;
+        while (!level.empty() && !stop) {
+            listings.assign(level.size(), listing());
+            _pool.parallel_for(level.size(), [&level, &listings, &stop](size_t i) { listings[i].read = list_directory(level[i], stop, listings[i]); });
+            stats.directories += level.size();
+
+            std::vector<std::wstring> next;
+            for (size_t d = 0; d < listings.size(); d++) {
+                auto &l = listings[d];
+                if (!l.read) {
+                    unreadable.push_back(level[d] + L'\\');
+                    continue;
+                }
+                stats.files += l.files.size();
+                for (auto &f : l.files) {
+                    auto i = known.find(f.path);
+                    if (i == known.end()) {
+                        changed.push_back(std::move(f));
+                        is_new.push_back(true);
+                    }
+                    else {
+                        if (i->second.first != f.modified || i->second.second != f.size) {
+                            changed.push_back(std::move(f));
+                            is_new.push_back(false);
+                        }
+                        known.erase(i);
+                    }
+                }
+                std::move(l.directories.begin(), l.directories.end(), std::back_inserter(next));
+            }
+            level.swap(next);
+        }
+
+        // Probe and write in batches, so a first scan of a large folder doesn't hold every item in memory at once
+        std::vector<media_item> items;
+        for (size_t first = 0; first < changed.size() && !stop; first += batch_size) {
+            auto count = std::min(batch_size, changed.size() - first);
+            items.resize(count);
+            _pool.parallel_for(count, [&changed, &items, &stop, first](size_t i) {
+                if (!stop) probe(changed[first + i], items[i]);
+            });
+            // Some of the items weren't probed
+            if (stop) break;
+
+            auto batch = _library.begin_batch();
+            for (size_t i = 0; i < count; i++) {
+                _library.write_item(items[i]);
+                if (is_new[first + i]) stats.added++; else stats.updated++;
+            }
+            batch.commit();
+        }
+
+        // Whatever wasn't crossed off is gone, unless it is somewhere we couldn't look. A stopped scan didn't look everywhere.
+        stats.stopped = stop;
+        if (!known.empty() && !stats.stopped) {
+            auto batch = _library.begin_batch();
+            for (auto &k : known) {
+                auto hidden = std::any_of(unreadable.begin(), unreadable.end(), [&k](const std::wstring &d) { return k.first.compare(0, d.size(), d) == 0; });
+                if (hidden) continue;
+                _library.remove_item(k.first);
+                stats.removed++;
+            }
+            batch.commit();
+        }
+
+        stats.elapsed = std::chrono::steady_clock::now() - start;
+        return stats;
+    }
+}
\ No newline at end of file
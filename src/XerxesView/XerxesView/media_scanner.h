@@ -0,0 +1,66 @@
+#pragma once
+
+#include <windows.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "..\configlib\media_library.h"
+#include "..\renderlib\thread_pool.h"
+
+namespace xerxes
+{
+    struct scan_statistics {
+        uint64_t directories;
+        // Media files found
+        uint64_t files;
+        uint64_t added;
+        uint64_t updated;
+        uint64_t removed;
+        // Stopped before it finished; nothing was removed
+        bool stopped;
+        std::chrono::nanoseconds elapsed;
+
+        inline auto files_per_second() const noexcept -> double { return elapsed.count() <= 0 ? 0.0 : files * 1e9 / elapsed.count(); }
+    };
+
+    // Brings the media library in line with a folder. Directories are listed in parallel, one level of the tree at a time, and
+    // only files whose size or last write time differ from the library are probed for their title and tags. The changes are
+    // written in large transactions.
+    class media_scanner {
+    private:
+        struct found_file {
+            std::wstring path;
+            long long modified;
+            long long size;
+        };
+
+        struct listing {
+            bool read;
+            std::vector<std::wstring> directories;
+            std::vector<found_file> files;
+        };
+
+        media_library &_library;
+        thread_pool _pool;
+
+        static auto is_media_file(const wchar_t *name) -> bool;
+        // False if the directory couldn't be read. Gives up between entries once stop is set.
+        static auto list_directory(const std::wstring &directory, const std::atomic<bool> &stop, listing &result) -> bool;
+        static auto probe(const found_file &file, media_item &item) -> void;
+    public:
+        // Changes written per transaction
+        static const size_t batch_size = 4096;
+
+        // library must outlive the scanner and not be used elsewhere while a scan runs
+        explicit media_scanner(media_library &library);
+        media_scanner(const media_scanner &) = delete;
+        auto operator=(const media_scanner &)->media_scanner& = delete;
+
+        // Scan folder and everything below it. Runs on the calling thread, which takes part in the work. Items in a directory
+        // that couldn't be read are left alone, so an unplugged drive doesn't empty the library. Setting stop ends the scan
+        // soon after, at the next directory entry or file; what was written by then stays in the library.
+        auto scan(const std::wstring &folder, const std::atomic<bool> &stop) -> scan_statistics;
+    };
+}
\ No newline at end of file
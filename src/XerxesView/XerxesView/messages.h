@@ -2,4 +2,15 @@
 
 #include <Windows.h>
 
-#define WM_USER_CANVAS_WINDOW_CLOSED (WM_USER + 0)
\ No newline at end of file
+#define WM_USER_CANVAS_WINDOW_CLOSED (WM_USER + 0)
+#define WM_USER_THUMBNAILS_READY (WM_USER + 1)
+// lParam is a scan_statistics* for the receiver to delete, or nullptr if the scan failed
+#define WM_USER_SCAN_FINISHED (WM_USER + 2)
+// A canvas frame took far longer than its interval; dump the flight recorder
+#define WM_USER_TRACE_SPIKE (WM_USER + 3)
+// lParam is an export_result* for the receiver to delete, or nullptr if the export could not run
+#define WM_USER_EXPORT_FINISHED (WM_USER + 4)
+// The audio of the canvas starts (wParam 1) or pauses (wParam 0); posted by the render thread, as MFPlay belongs to the window thread
+#define WM_USER_PLAY_AUDIO (WM_USER + 5)
+// lParam is a std::wstring* with the url of the cue whose audio plays, for the receiver to delete
+#define WM_USER_CUE_AUDIO (WM_USER + 6)
\ No newline at end of file
@@ -0,0 +1,206 @@
+#include "stdafx.h"
+#include "mf_media_source.h"
+
+#include <mfapi.h>
+#include <propvarutil.h>
+#include <algorithm>
+
+namespace xerxes
+{
+    namespace
+    {
+        template <class T> void SafeRelease(T **ppT)
+        {
+            if (*ppT)
+            {
+                (*ppT)->Release();
+                *ppT = NULL;
+            }
+        }
+
+        // Media Foundation times are in 100ns units
+        inline auto from_mf_time(LONGLONG t) -> std::chrono::nanoseconds { return std::chrono::nanoseconds(t * 100); }
+        inline auto to_mf_time(std::chrono::nanoseconds t) -> LONGLONG { return t.count() / 100; }
+    }
+
+    mf_media_source::mf_media_source(IMFSourceReader *reader, const media_info &info, int coded_width, int coded_height, LONG stride, bool nv12, yuv_matrix matrix, yuv_range range)
+        : _reader(reader), _info(info), _coded_width(coded_width), _coded_height(coded_height), _stride(stride), _nv12(nv12), _matrix(matrix), _range(range)
+    {
+    }
+
+    mf_media_source::~mf_media_source()
+    {
+        SafeRelease(&_reader);
+    }
+
+    auto mf_media_source::try_open(const std::wstring &url, int width, int height) -> std::unique_ptr<mf_media_source>
+    {
+        IMFAttributes *attributes = NULL;
+        IMFSourceReader *reader = NULL;
+        IMFMediaType *type = NULL;
+        std::unique_ptr<mf_media_source> result;
+
+        // The source reader may convert to RGB32 if the decoder can't produce NV12
+        HRESULT hr = MFCreateAttributes(&attributes, 1);
+        if (SUCCEEDED(hr)) hr = attributes->SetUINT32(MF_SOURCE_READER_ENABLE_VIDEO_PROCESSING, TRUE);
+        if (SUCCEEDED(hr)) hr = MFCreateSourceReaderFromURL(url.c_str(), attributes, &reader);
+        if (SUCCEEDED(hr)) hr = reader->SetStreamSelection(static_cast<DWORD>(MF_SOURCE_READER_ALL_STREAMS), FALSE);
+        if (SUCCEEDED(hr)) hr = reader->SetStreamSelection(static_cast<DWORD>(MF_SOURCE_READER_FIRST_VIDEO_STREAM), TRUE);
+        bool nv12 = true;
+        if (SUCCEEDED(hr)) hr = MFCreateMediaType(&type);
+        if (SUCCEEDED(hr)) hr = type->SetGUID(MF_MT_MAJOR_TYPE, MFMediaType_Video);
+        if (SUCCEEDED(hr)) hr = type->SetGUID(MF_MT_SUBTYPE, MFVideoFormat_NV12);
+        if (SUCCEEDED(hr) && FAILED(reader->SetCurrentMediaType(static_cast<DWORD>(MF_SOURCE_READER_FIRST_VIDEO_STREAM), NULL, type))) {
+            nv12 = false;
+            hr = type->SetGUID(MF_MT_SUBTYPE, MFVideoFormat_RGB32);
+            if (SUCCEEDED(hr)) hr = reader->SetCurrentMediaType(static_cast<DWORD>(MF_SOURCE_READER_FIRST_VIDEO_STREAM), NULL, type);
+        }
+        SafeRelease(&type);
+        if (SUCCEEDED(hr)) hr = reader->GetCurrentMediaType(static_cast<DWORD>(MF_SOURCE_READER_FIRST_VIDEO_STREAM), &type);
+
+        if (SUCCEEDED(hr)) {
+            media_info info = {};
+            UINT32 width = 0, height = 0, numerator = 0, denominator = 0;
+            hr = MFGetAttributeSize(type, MF_MT_FRAME_SIZE, &width, &height);
+            if (SUCCEEDED(hr)) {
+                info.width = static_cast<int>(width);
+                info.height = static_cast<int>(height);
+                if (SUCCEEDED(MFGetAttributeRatio(type, MF_MT_FRAME_RATE, &numerator, &denominator)) && denominator != 0) {
+                    info.frame_rate = static_cast<double>(numerator) / denominator;
+                }
+                else {
+                    info.frame_rate = 30.0;
+                }
+
+                PROPVARIANT duration;
+                PropVariantInit(&duration);
+                if (SUCCEEDED(reader->GetPresentationAttribute(static_cast<DWORD>(MF_SOURCE_READER_MEDIASOURCE), MF_PD_DURATION, &duration)) && duration.vt == VT_UI8) {
+                    info.duration = from_mf_time(static_cast<LONGLONG>(duration.uhVal.QuadPart));
+                }
+                PropVariantClear(&duration);
+
+                // A negative stride means the rows are stored bottom-up
+                UINT32 stride = 0;
+                LONG signed_stride = static_cast<LONG>(nv12 ? width : width * 4);
+                if (SUCCEEDED(type->GetUINT32(MF_MT_DEFAULT_STRIDE, &stride))) {
+                    signed_stride = static_cast<LONG>(stride);
+                }
+
+                // Untagged streams follow the usual convention: BT.709 for HD, BT.601 below, limited range
+                auto matrix = height >= 720 ? yuv_matrix::bt709 : yuv_matrix::bt601;
+                UINT32 tag = 0;
+                if (SUCCEEDED(type->GetUINT32(MF_MT_YUV_MATRIX, &tag))) {
+                    if (tag == MFVideoTransferMatrix_BT709) matrix = yuv_matrix::bt709;
+                    else if (tag == MFVideoTransferMatrix_BT601) matrix = yuv_matrix::bt601;
+                }
+                auto range = yuv_range::limited;
+                if (SUCCEEDED(type->GetUINT32(MF_MT_VIDEO_NOMINAL_RANGE, &tag)) && tag == MFNominalRange_0_255) {
+                    range = yuv_range::full;
+                }
+
+                // Fit inside the target with the aspect ratio. Video isn't enlarged here, and RGB32 is only copied; the video layer
+                // scales the rest.
+                auto coded_width = info.width, coded_height = info.height;
+                if (nv12 && width > 0 && height > 0) {
+                    auto scale = std::min(1.0, std::min(static_cast<double>(width) / coded_width, static_cast<double>(height) / coded_height));
+                    info.width = std::max(1, static_cast<int>(coded_width * scale + 0.5));
+                    info.height = std::max(1, static_cast<int>(coded_height * scale + 0.5));
+                }
+
+                result.reset(new mf_media_source(reader, info, coded_width, coded_height, signed_stride, nv12, matrix, range));
+                reader = NULL;
+            }
+        }
+
+        SafeRelease(&type);
+        SafeRelease(&reader);
+        SafeRelease(&attributes);
+        return result;
+    }
+
+    auto mf_media_source::read_frame(video_frame &frame) -> bool
+    {
+        for (;;) {
+            DWORD stream = 0, flags = 0;
+            LONGLONG timestamp = 0;
+            IMFSample *sample = NULL;
+
+            if (FAILED(_reader->ReadSample(static_cast<DWORD>(MF_SOURCE_READER_FIRST_VIDEO_STREAM), 0, &stream, &flags, &timestamp, &sample))) return false;
+            if ((flags & MF_SOURCE_READERF_ENDOFSTREAM) != 0) {
+                SafeRelease(&sample);
+                return false;
+            }
+            // Stream ticks and gaps come without a sample
+            if (sample == NULL) continue;
+
+            IMFMediaBuffer *buffer = NULL;
+            BYTE *data = NULL;
+            DWORD length = 0;
+            LONGLONG duration = 0;
+            auto complete = true;
+            HRESULT hr = sample->ConvertToContiguousBuffer(&buffer);
+            if (SUCCEEDED(hr)) hr = buffer->Lock(&data, NULL, &length);
+            if (SUCCEEDED(hr)) {
+                frame.pixels.resize(_info.width, _info.height);
+                frame.timestamp = from_mf_time(timestamp);
+                frame.duration = SUCCEEDED(sample->GetSampleDuration(&duration)) ? from_mf_time(duration) : std::chrono::nanoseconds(static_cast<long long>(1e9 / _info.frame_rate));
+                complete = _nv12 ? convert_nv12(data, length, frame) : copy_rgb32(data, length, frame);
+                buffer->Unlock();
+            }
+
+            SafeRelease(&buffer);
+            SafeRelease(&sample);
+            // A truncated sample would show whatever the pooled buffer held before; skip to the next one
+            if (SUCCEEDED(hr) && !complete) continue;
+            return SUCCEEDED(hr);
+        }
+    }
+
+    auto mf_media_source::copy_rgb32(const BYTE *data, DWORD length, video_frame &frame) -> bool
+    {
+        auto row_bytes = static_cast<size_t>(_coded_width) * 4;
+        auto stride = static_cast<size_t>(_stride >= 0 ? _stride : -_stride);
+        if (_coded_height > 0 && stride * (_coded_height - 1) + row_bytes > length) return false;
+
+        auto first = _stride >= 0 ? data : data + static_cast<ptrdiff_t>(-_stride) * (_coded_height - 1);
+        for (int y = 0; y < _coded_height; y++) {
+            auto src = first + static_cast<ptrdiff_t>(_stride) * y;
+            auto dst = frame.pixels.row(y);
+            memcpy(dst, src, row_bytes);
+            // RGB32 leaves the fourth byte undefined
+            for (int x = 0; x < _coded_width; x++) {
+                dst[x] |= 0xff000000;
+            }
+        }
+        return true;
+    }
+
+    auto mf_media_source::convert_nv12(const BYTE *data, DWORD length, video_frame &frame) -> bool
+    {
+        // The interleaved chroma plane follows the luma plane, at half the height
+        auto stride = static_cast<ptrdiff_t>(_stride >= 0 ? _stride : -_stride);
+        auto luma_size = stride * _coded_height;
+        if (static_cast<size_t>(luma_size + stride * ((_coded_height + 1) / 2)) > length) return false;
+
+        yuv_image image = {};
+        image.format = yuv_format::nv12;
+        image.width = _coded_width;
+        image.height = _coded_height;
+        image.planes[0] = data;
+        image.planes[1] = data + luma_size;
+        image.strides[0] = stride;
+        image.strides[1] = stride;
+        // The frame already has the shown size; at the coded size this is a plain conversion
+        color_converter::convert_scaled(image, frame.pixels, scale_filter::bicubic, _matrix, _range);
+        return true;
+    }
+
+    auto mf_media_source::seek(std::chrono::nanoseconds position) -> bool
+    {
+        PROPVARIANT var;
+        if (FAILED(InitPropVariantFromInt64(to_mf_time(position), &var))) return false;
+        auto hr = _reader->SetCurrentPosition(GUID_NULL, var);
+        PropVariantClear(&var);
+        return SUCCEEDED(hr);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <windows.h>
+#include <mfidl.h>
+#include <mfreadwrite.h>
+#include <memory>
+#include <string>
+#include "..\renderlib\media_source.h"
+#include "..\renderlib\color_converter.h"
+
+namespace xerxes
+{
+    // Decodes the first video stream of a file with the Media Foundation source reader. The decoder's NV12 output is converted
+    // by our own kernels; RGB32 from the MF video processor is only used when the stream can't be read as NV12.
+    // NV12 video larger than it is shown is converted and scaled to the shown size in one pass, so the full size frame never
+    // exists in BGRA.
+    class mf_media_source : public media_source {
+    private:
+        IMFSourceReader *_reader;
+        media_info _info;
+        // The size of the decoded pictures; _info has the size of the frames read, which is smaller when they are scaled
+        int _coded_width;
+        int _coded_height;
+        LONG _stride;
+        bool _nv12;
+        yuv_matrix _matrix;
+        yuv_range _range;
+
+        mf_media_source(IMFSourceReader *reader, const media_info &info, int coded_width, int coded_height, LONG stride, bool nv12, yuv_matrix matrix, yuv_range range);
+
+        // Both return false, leaving the frame as it was, if the sample is too short for a whole frame
+        auto copy_rgb32(const BYTE *data, DWORD length, video_frame &frame) -> bool;
+        auto convert_nv12(const BYTE *data, DWORD length, video_frame &frame) -> bool;
+    public:
+        mf_media_source(const mf_media_source &) = delete;
+        auto operator=(const mf_media_source &)->mf_media_source& = delete;
+        virtual ~mf_media_source();
+
+        // The video at url, to be shown inside width x height; zero keeps the coded size. Returns nullptr if the file can't be
+        // opened or has no video. MFStartup must have been called.
+        static auto try_open(const std::wstring &url, int width = 0, int height = 0) -> std::unique_ptr<mf_media_source>;
+
+        virtual auto get_info() const -> media_info override { return _info; }
+        virtual auto read_frame(video_frame &frame) -> bool override;
+        virtual auto seek(std::chrono::nanoseconds position) -> bool override;
+    };
+}
\ No newline at end of file
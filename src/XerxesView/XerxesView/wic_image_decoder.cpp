@@ -0,0 +1,112 @@
+#include "stdafx.h"
+#include "wic_image_decoder.h"
+#include "mf_media_source.h"
+
+#include <algorithm>
+
+namespace xerxes
+{
+    namespace
+    {
+        template <class T> void SafeRelease(T **ppT)
+        {
+            if (*ppT)
+            {
+                (*ppT)->Release();
+                *ppT = NULL;
+            }
+        }
+
+        // Decoding runs on pool threads that nobody else initializes COM on, so each thread joins the MTA the first time and
+        // keeps its own WIC factory until it exits
+        struct wic_thread {
+            bool initialized = false;
+            IWICImagingFactory *factory = NULL;
+
+            wic_thread()
+            {
+                initialized = SUCCEEDED(CoInitializeEx(NULL, COINIT_MULTITHREADED));
+                CoCreateInstance(CLSID_WICImagingFactory, NULL, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&factory));
+            }
+
+            ~wic_thread()
+            {
+                SafeRelease(&factory);
+                if (initialized) {
+                    CoUninitialize();
+                }
+            }
+        };
+
+        thread_local wic_thread wic;
+    }
+
+    auto wic_image_decoder::try_decode(const std::wstring &path, int width, int height, surface &image) -> bool
+    {
+        return try_decode_still(path, width, height, image) || try_decode_video(path, image);
+    }
+
+    auto wic_image_decoder::get_factory() -> IWICImagingFactory*
+    {
+        return wic.factory;
+    }
+
+    auto wic_image_decoder::try_decode_still(const std::wstring &path, int width, int height, surface &image) -> bool
+    {
+        if (wic.factory == NULL) return false;
+
+        IWICBitmapDecoder *decoder = NULL;
+        IWICBitmapFrameDecode *frame = NULL;
+        IWICBitmapScaler *scaler = NULL;
+        IWICFormatConverter *converter = NULL;
+        IWICBitmapSource *source = NULL;
+        UINT w = 0, h = 0;
+
+        HRESULT hr = wic.factory->CreateDecoderFromFilename(path.c_str(), NULL, GENERIC_READ, WICDecodeMetadataCacheOnDemand, &decoder);
+        if (SUCCEEDED(hr)) hr = decoder->GetFrame(0, &frame);
+        if (SUCCEEDED(hr)) hr = frame->GetSize(&w, &h);
+        if (SUCCEEDED(hr)) {
+            source = frame;
+            source->AddRef();
+            // Reduce to twice the box before converting, and leave the rest to our filter, which downscales with less aliasing
+            auto scale = std::min(static_cast<double>(width) * 2 / w, static_cast<double>(height) * 2 / h);
+            if (scale < 1.0) {
+                auto sw = std::max(1u, static_cast<UINT>(w * scale));
+                auto sh = std::max(1u, static_cast<UINT>(h * scale));
+                if (SUCCEEDED(wic.factory->CreateBitmapScaler(&scaler)) && SUCCEEDED(scaler->Initialize(frame, sw, sh, WICBitmapInterpolationModeFant))) {
+                    SafeRelease(&source);
+                    source = scaler;
+                    source->AddRef();
+                    w = sw;
+                    h = sh;
+                }
+            }
+        }
+        if (SUCCEEDED(hr)) hr = wic.factory->CreateFormatConverter(&converter);
+        if (SUCCEEDED(hr)) hr = converter->Initialize(source, GUID_WICPixelFormat32bppPBGRA, WICBitmapDitherTypeNone, NULL, 0.0, WICBitmapPaletteTypeCustom);
+        if (SUCCEEDED(hr)) {
+            image.resize(static_cast<int>(w), static_cast<int>(h));
+            hr = converter->CopyPixels(NULL, static_cast<UINT>(image.stride()), static_cast<UINT>(image.size_in_bytes()), image.data());
+        }
+
+        SafeRelease(&converter);
+        SafeRelease(&source);
+        SafeRelease(&scaler);
+        SafeRelease(&frame);
+        SafeRelease(&decoder);
+        return SUCCEEDED(hr);
+    }
+
+    auto wic_image_decoder::try_decode_video(const std::wstring &path, surface &image) -> bool
+    {
+        // Media Foundation was started by the application and works from any MTA thread
+        if (!wic.initialized) return false;
+        auto source = mf_media_source::try_open(path);
+        if (source == nullptr) return false;
+
+        video_frame frame;
+        if (!source->read_frame(frame)) return false;
+        image.swap(frame.pixels);
+        return true;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <windows.h>
+#include <wincodec.h>
+#include <string>
+#include "..\renderlib\surface.h"
+
+namespace xerxes
+{
+    // Decodes stills with WIC and falls back to the first frame of a video for everything else. Safe to call from any thread.
+    class wic_image_decoder {
+    public:
+        wic_image_decoder() = delete;
+
+        // Decode path into image. Large stills are reduced while decoding, but never below width x height.
+        static auto try_decode(const std::wstring &path, int width, int height, surface &image) -> bool;
+
+        // The calling thread's WIC factory, or NULL. The thread joins the MTA the first time, and keeps both until it exits.
+        static auto get_factory() -> IWICImagingFactory*;
+    private:
+        static auto try_decode_still(const std::wstring &path, int width, int height, surface &image) -> bool;
+        static auto try_decode_video(const std::wstring &path, surface &image) -> bool;
+    };
+}
\ No newline at end of file
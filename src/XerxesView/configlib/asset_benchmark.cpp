@@ -0,0 +1,161 @@
+#include "stdafx.h"
+#include "asset_benchmark.h"
+#include "content_hash.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <sstream>
+#include <vector>
+
+namespace xerxes
+{
+    namespace
+    {
+        struct hash_vector {
+            size_t size;
+            uint64_t unseeded;
+            uint64_t seeded;
+        };
+
+        // XXH64 of the first size bytes of vector_bytes, from the reference implementation, without a seed and with vector_seed
+        const uint64_t vector_seed = 2654435761ULL;
+        const hash_vector vectors[] = {
+            { 0, 0xef46db3751d8e999ULL, 0xac75fda2929b17efULL },
+            { 1, 0xe934a84adb052768ULL, 0x5014607643a9b4c3ULL },
+            { 3, 0xa9cf36b41f9e7d09ULL, 0xf251fee9b930fdcbULL },
+            { 4, 0x435f59a33b7eb3d1ULL, 0x4c87093504c2c22fULL },
+            { 8, 0x538cac3b18f9ef8eULL, 0x74ce119567bbdc94ULL },
+            { 14, 0x65ef9f2cde8f47f3ULL, 0x015adbf58b66105dULL },
+            { 31, 0x4071dd1310fa5da9ULL, 0x06feea906359acc2ULL },
+            { 32, 0x13ee8a64346f0691ULL, 0x046847f878f159ffULL },
+            { 33, 0xf75619499e2e2e99ULL, 0x79dd17c53a066526ULL },
+            { 64, 0xfb24d94de825912fULL, 0xf02658af9e7c086aULL },
+            { 100, 0x8a5b7a72e578e053ULL, 0xe31c1dbf81fba5a6ULL },
+            { 222, 0x7f766ab3667da05cULL, 0xc906bb3769fa86efULL },
+            { 1000, 0x8420addb9882cc1bULL, 0xb7bba013322a6060ULL },
+        };
+
+        auto vector_bytes() -> std::vector<uint8_t>
+        {
+            std::vector<uint8_t> bytes(1000);
+            for (size_t i = 0; i < bytes.size(); i++) {
+                bytes[i] = static_cast<uint8_t>((static_cast<uint32_t>(i) * 2654435761u) >> 24);
+            }
+            return bytes;
+        }
+
+        auto streamed(const std::vector<uint8_t> &bytes, size_t size, uint64_t seed, std::mt19937 &random) -> uint64_t
+        {
+            content_hasher hasher(seed);
+            for (size_t done = 0; done < size;) {
+                auto chunk = std::min<size_t>(size - done, 1 + random() % 40);
+                hasher.update(bytes.data() + done, chunk);
+                done += chunk;
+                // Asking for the digest halfway mustn't change the result
+                hasher.digest();
+            }
+            return hasher.digest();
+        }
+
+        auto random_content(size_t size, std::mt19937 &random) -> std::vector<uint8_t>
+        {
+            std::vector<uint8_t> content(size);
+            for (auto &b : content) {
+                b = static_cast<uint8_t>(random());
+            }
+            return content;
+        }
+
+        auto milliseconds_since(std::chrono::steady_clock::time_point start) -> double
+        {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+    }
+
+    auto asset_benchmark_result::passed() const -> bool
+    {
+        return vectors_match && deduplicated && released;
+    }
+
+    auto asset_benchmark_result::format() const -> std::string
+    {
+        std::ostringstream out;
+        char line[256];
+        std::snprintf(line, sizeof(line), "XXH64: %d reference hashes %s, %.2f GB/s\n", vectors, vectors_match ? "matched" : "DID NOT MATCH", hash_gb_per_second);
+        out << line;
+        std::snprintf(line, sizeof(line), "import: %.0f ms, again: %.0f ms\n", import_ms, duplicate_import_ms);
+        out << line;
+        std::snprintf(line, sizeof(line), "%lld assets, %lld references, %.1f MB stored for %.1f MB referenced%s%s\n",
+            imported.assets, imported.references, imported.stored_bytes / 1048576.0, imported.referenced_bytes / 1048576.0,
+            deduplicated ? "" : "  NOT DEDUPLICATED", released ? "" : "  LEFT AFTER RELEASING");
+        out << line;
+        return out.str();
+    }
+
+    auto asset_benchmark::run(const asset_benchmark_options &options) -> asset_benchmark_result
+    {
+        asset_benchmark_result result{};
+        std::mt19937 random(options.seed);
+
+        auto bytes = vector_bytes();
+        result.vectors_match = true;
+        for (auto &v : vectors) {
+            result.vectors_match = result.vectors_match
+                && content_hasher::hash(bytes.data(), v.size) == v.unseeded && content_hasher::hash(bytes.data(), v.size, vector_seed) == v.seeded
+                && streamed(bytes, v.size, 0, random) == v.unseeded && streamed(bytes, v.size, vector_seed, random) == v.seeded;
+            result.vectors++;
+        }
+
+        auto block = random_content(1024 * 1024, random);
+        auto start = std::chrono::steady_clock::now();
+        content_hasher hasher;
+        for (size_t i = 0; i < options.hash_megabytes; i++) {
+            hasher.update(block.data(), block.size());
+        }
+        hasher.digest();
+        auto seconds = milliseconds_since(start) / 1000.0;
+        result.hash_gb_per_second = seconds > 0.0 ? options.hash_megabytes / 1024.0 / seconds : 0.0;
+
+        std::vector<std::vector<uint8_t>> contents;
+        for (auto i = 0; i < options.small_assets; i++) {
+            contents.push_back(random_content(options.small_size, random));
+        }
+        for (auto i = 0; i < options.large_assets; i++) {
+            contents.push_back(random_content(options.large_size, random));
+        }
+
+        std::remove(options.fn.c_str());
+        asset_store store(options.fn, options.folder);
+        std::vector<asset_id> ids(contents.size());
+        auto imported = true;
+        start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < contents.size(); i++) {
+            imported = store.try_import(contents[i].data(), contents[i].size(), ids[i]) && imported;
+        }
+        result.import_ms = milliseconds_since(start);
+        start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < contents.size(); i++) {
+            asset_id again;
+            imported = store.try_import(contents[i].data(), contents[i].size(), again) && again == ids[i] && imported;
+        }
+        result.duplicate_import_ms = milliseconds_since(start);
+
+        long long distinct_bytes = 0;
+        for (auto &content : contents) {
+            distinct_bytes += static_cast<long long>(content.size());
+        }
+        result.imported = store.get_statistics();
+        result.deduplicated = imported && result.imported.assets == static_cast<long long>(contents.size())
+            && result.imported.references == 2 * result.imported.assets
+            && result.imported.stored_bytes == distinct_bytes && result.imported.referenced_bytes == 2 * distinct_bytes;
+
+        auto released = true;
+        for (auto &id : ids) {
+            released = store.release(id) && store.release(id) && released;
+        }
+        result.released = released && store.get_statistics().assets == 0;
+        return result;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "asset_store.h"
+
+namespace xerxes
+{
+    struct asset_benchmark_options {
+        // Removed and created again
+        std::string fn = "asset_benchmark.db";
+        std::wstring folder = L"asset_benchmark";
+        uint32_t seed = 1;
+        // Hashed from memory to time content_hasher alone
+        size_t hash_megabytes = 256;
+        // Distinct contents, each imported twice: the small ones are kept inline, the large ones as files
+        int small_assets = 200;
+        size_t small_size = 16 * 1024;
+        int large_assets = 4;
+        size_t large_size = 16 * 1024 * 1024;
+    };
+
+    struct asset_benchmark_result {
+        // The reference XXH64 hashes checked, hashed at once and streamed in random chunks, and whether all of them matched
+        int vectors;
+        bool vectors_match;
+        double hash_gb_per_second;
+        double import_ms;
+        double duplicate_import_ms;
+        asset_statistics imported;
+        // Every content was stored once and referenced twice, and nothing was left once every reference was released
+        bool deduplicated;
+        bool released;
+
+        auto passed() const -> bool;
+        auto format() const -> std::string;
+    };
+
+    // Checks content_hasher against reference XXH64 hashes, times it, and imports generated contents into an asset_store twice,
+    // checking that the second import only adds references.
+    class asset_benchmark {
+    public:
+        asset_benchmark() = delete;
+
+        static auto run(const asset_benchmark_options &options) -> asset_benchmark_result;
+    };
+}
\ No newline at end of file
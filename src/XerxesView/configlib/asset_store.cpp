@@ -0,0 +1,313 @@
+#include "stdafx.h"
+#include "asset_store.h"
+#include "content_hash.h"
+
+#include <windows.h>
+#include <algorithm>
+#include <cstring>
+#include <cwchar>
+#include <memory>
+
+namespace xerxes
+{
+    namespace
+    {
+        const DWORD chunk_size = 1 << 20;
+
+        class file_handle {
+        private:
+            HANDLE _handle;
+        public:
+            file_handle(HANDLE handle = INVALID_HANDLE_VALUE) : _handle(handle) {}
+            file_handle(const file_handle &) = delete;
+            auto operator=(const file_handle &)->file_handle& = delete;
+            ~file_handle() { close(); }
+
+            inline auto reset(HANDLE handle) -> void { close(); _handle = handle; }
+            inline auto close() -> void {
+                if (_handle != INVALID_HANDLE_VALUE) {
+                    CloseHandle(_handle);
+                    _handle = INVALID_HANDLE_VALUE;
+                }
+            }
+            inline auto get() const noexcept -> HANDLE { return _handle; }
+            inline explicit operator bool() const noexcept { return _handle != INVALID_HANDLE_VALUE; }
+        };
+
+        // Deleted unless it was moved into the store
+        struct temporary_file {
+            std::wstring path;
+            ~temporary_file() { if (!path.empty()) DeleteFileW(path.c_str()); }
+        };
+
+        inline auto open_for_reading(const std::wstring &path) -> HANDLE
+        {
+            return CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        }
+
+        inline auto write_all(HANDLE file, const uint8_t *data, size_t size) -> bool
+        {
+            DWORD written = 0;
+            return WriteFile(file, data, static_cast<DWORD>(size), &written, NULL) && written == size;
+        }
+
+        // Content that is either in memory or in a file, read in chunks
+        class content_reader {
+        private:
+            const uint8_t *_data = nullptr;
+            size_t _remaining = 0;
+            file_handle _file;
+        public:
+            content_reader(const void *data, size_t size) : _data(static_cast<const uint8_t*>(data)), _remaining(size) {}
+            content_reader(const std::wstring &path) : _file(open_for_reading(path)) {}
+
+            // Fills the buffer unless the content ends first. Returns 0 at the end, or if the file can't be read.
+            auto read(uint8_t *buffer, size_t size) -> size_t {
+                if (!_file) {
+                    auto n = std::min(size, _remaining);
+                    memcpy(buffer, _data, n);
+                    _data += n;
+                    _remaining -= n;
+                    return n;
+                }
+                size_t total = 0;
+                while (total < size) {
+                    DWORD read = 0;
+                    if (!ReadFile(_file.get(), buffer + total, static_cast<DWORD>(size - total), &read, NULL) || read == 0) break;
+                    total += read;
+                }
+                return total;
+            }
+        };
+
+        auto equal_content(content_reader &a, content_reader &b) -> bool
+        {
+            std::vector<uint8_t> left(chunk_size), right(chunk_size);
+            for (;;) {
+                auto n = a.read(left.data(), left.size());
+                if (b.read(right.data(), right.size()) != n) return false;
+                if (n == 0) return true;
+                if (memcmp(left.data(), right.data(), n) != 0) return false;
+            }
+        }
+
+        // Zero length blobs need a pointer, or they're bound as NULL, which marks a file
+        inline auto to_blob(const void *data, size_t size) -> sqlite_blob { return sqlite_blob{ size == 0 ? "" : data, static_cast<int>(size) }; }
+    }
+
+    auto asset_id::to_string() const -> std::wstring
+    {
+        wchar_t text[48];
+        swprintf(text, sizeof(text) / sizeof(text[0]), L"%016llx-%lld", static_cast<unsigned long long>(hash), size);
+        return text;
+    }
+
+    const size_t asset_store::default_inline_limit;
+
+    asset_store::asset_store(const std::string & fn, const std::wstring & folder, size_t inline_limit)
+        : _connection(fn), _folder(folder), _inline_limit(inline_limit)
+    {
+        if (!_folder.empty() && _folder[_folder.size() - 1] != L'\\') {
+            _folder += L'\\';
+        }
+        CreateDirectoryW(_folder.c_str(), NULL);
+
+        // Create the database. [data] is NULL for assets stored as files.
+        sqlite_statement(_connection, "CREATE TABLE IF NOT EXISTS [asset]([hash] INTEGER NOT NULL, [size] INTEGER NOT NULL, [references] INTEGER NOT NULL, [data] BLOB, PRIMARY KEY([hash], [size]))").execute();
+
+        _find.prepare(_connection, "SELECT [references], [data] IS NULL FROM [asset] WHERE [hash]=? AND [size]=?");
+        _read.prepare(_connection, "SELECT [data] FROM [asset] WHERE [hash]=? AND [size]=?");
+        _insert.prepare(_connection, "INSERT INTO [asset]([hash], [size], [references], [data]) VALUES (?, ?, 1, ?)");
+        _add_references.prepare(_connection, "UPDATE [asset] SET [references]=[references]+? WHERE [hash]=? AND [size]=?");
+        _remove.prepare(_connection, "DELETE FROM [asset] WHERE [hash]=? AND [size]=?");
+        _statistics.prepare(_connection, "SELECT COUNT(*), SUM([references]), SUM([size]), SUM([size] * [references]) FROM [asset]");
+    }
+
+    auto asset_store::get_file(const asset_id & id) const -> std::wstring
+    {
+        auto name = id.to_string();
+        return _folder + name.substr(0, 2) + L'\\' + name;
+    }
+
+    auto asset_store::try_find(const asset_id & id, long long & references, bool & is_inline) -> bool
+    {
+        auto found = _find.rebind_all(static_cast<long long>(id.hash), id.size).move_next();
+        if (found) {
+            references = _find.get_int64(0);
+            is_inline = _find.get_int(1) == 0;
+        }
+        _find.reset();
+        return found;
+    }
+
+    auto asset_store::try_add(const asset_id & id, const std::vector<uint8_t>& content, const std::wstring & temporary) -> bool
+    {
+        auto transaction = sqlite_transaction(_connection);
+        long long references = 0;
+        bool is_inline = false;
+        if (try_find(id, references, is_inline)) {
+            // The same hash and size: only share it if the bytes are the same too
+            bool same;
+            std::unique_ptr<content_reader> incoming(temporary.empty() ? new content_reader(content.data(), content.size()) : new content_reader(temporary));
+            if (is_inline) {
+                _read.rebind_all(static_cast<long long>(id.hash), id.size).move_next();
+                content_reader stored(_read.get_blob(0), static_cast<size_t>(_read.get_bytes(0)));
+                same = equal_content(stored, *incoming);
+                _read.reset();
+            }
+            else {
+                content_reader stored(get_file(id));
+                same = equal_content(stored, *incoming);
+            }
+            if (!same) return false;
+            _add_references.rebind_all(1LL, static_cast<long long>(id.hash), id.size).execute();
+        }
+        else if (temporary.empty()) {
+            _insert.rebind_all(static_cast<long long>(id.hash), id.size, to_blob(content.data(), content.size())).execute();
+        }
+        else {
+            auto file = get_file(id);
+            CreateDirectoryW(file.substr(0, file.rfind(L'\\')).c_str(), NULL);
+            // Replace whatever a release that didn't finish left behind
+            if (!MoveFileExW(temporary.c_str(), file.c_str(), MOVEFILE_REPLACE_EXISTING)) return false;
+            _insert.rebind_all(static_cast<long long>(id.hash), id.size, sqlite_blob{ nullptr, 0 }).execute();
+        }
+        transaction.commit();
+        return true;
+    }
+
+    auto asset_store::try_import_file(const std::wstring & path, asset_id & id) -> bool
+    {
+        file_handle source(open_for_reading(path));
+        if (!source) return false;
+
+        content_hasher hasher;
+        std::vector<uint8_t> chunk(chunk_size);
+        // Kept in memory until it turns out too large to be inline, then copied to a file in the store's folder so it can be
+        // moved into place without reading the source again
+        std::vector<uint8_t> content;
+        temporary_file temporary;
+        file_handle target;
+        long long size = 0;
+        for (;;) {
+            DWORD read = 0;
+            if (!ReadFile(source.get(), chunk.data(), chunk_size, &read, NULL)) return false;
+            if (read == 0) break;
+            hasher.update(chunk.data(), read);
+            size += read;
+
+            if (target) {
+                if (!write_all(target.get(), chunk.data(), read)) return false;
+                continue;
+            }
+            content.insert(content.end(), chunk.begin(), chunk.begin() + read);
+            if (content.size() > _inline_limit) {
+                wchar_t name[MAX_PATH];
+                if (GetTempFileNameW(_folder.c_str(), L"imp", 0, name) == 0) return false;
+                temporary.path = name;
+                target.reset(CreateFileW(name, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, NULL));
+                if (!target || !write_all(target.get(), content.data(), content.size())) return false;
+                content.clear();
+                content.shrink_to_fit();
+            }
+        }
+        target.close();
+
+        id = asset_id{ hasher.digest(), size };
+        // A new large asset is moved into place; otherwise the temporary file is deleted
+        return try_add(id, content, temporary.path);
+    }
+
+    auto asset_store::try_import(const void * data, size_t size, asset_id & id) -> bool
+    {
+        id = asset_id{ content_hasher::hash(data, size), static_cast<long long>(size) };
+        if (size <= _inline_limit) {
+            std::vector<uint8_t> content(static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + size);
+            return try_add(id, content, std::wstring());
+        }
+
+        temporary_file temporary;
+        wchar_t name[MAX_PATH];
+        if (GetTempFileNameW(_folder.c_str(), L"imp", 0, name) == 0) return false;
+        temporary.path = name;
+        {
+            file_handle target(CreateFileW(name, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, NULL));
+            if (!target || !write_all(target.get(), static_cast<const uint8_t*>(data), size)) return false;
+        }
+        return try_add(id, std::vector<uint8_t>(), temporary.path);
+    }
+
+    auto asset_store::add_reference(const asset_id & id) -> bool
+    {
+        long long references = 0;
+        bool is_inline = false;
+        if (!try_find(id, references, is_inline)) return false;
+        _add_references.rebind_all(1LL, static_cast<long long>(id.hash), id.size).execute();
+        return true;
+    }
+
+    auto asset_store::release(const asset_id & id) -> bool
+    {
+        auto transaction = sqlite_transaction(_connection);
+        long long references = 0;
+        bool is_inline = false;
+        if (!try_find(id, references, is_inline)) return false;
+        if (references > 1) {
+            _add_references.rebind_all(-1LL, static_cast<long long>(id.hash), id.size).execute();
+            transaction.commit();
+            return true;
+        }
+
+        _remove.rebind_all(static_cast<long long>(id.hash), id.size).execute();
+        transaction.commit();
+        // After the commit: a file left behind by a crash is harmless, a row without its file is not
+        if (!is_inline) {
+            DeleteFileW(get_file(id).c_str());
+        }
+        return true;
+    }
+
+    auto asset_store::try_read(const asset_id & id, std::vector<uint8_t>& content) -> bool
+    {
+        long long references = 0;
+        bool is_inline = false;
+        if (!try_find(id, references, is_inline)) return false;
+
+        content.resize(static_cast<size_t>(id.size));
+        if (is_inline) {
+            if (!_read.rebind_all(static_cast<long long>(id.hash), id.size).move_next()) return false;
+            auto valid = _read.get_bytes(0) == id.size;
+            if (valid && id.size > 0) {
+                memcpy(content.data(), _read.get_blob(0), content.size());
+            }
+            _read.reset();
+            return valid;
+        }
+        content_reader file(get_file(id));
+        return file.read(content.data(), content.size()) == content.size();
+    }
+
+    auto asset_store::try_get_file(const asset_id & id, std::wstring & path) -> bool
+    {
+        long long references = 0;
+        bool is_inline = false;
+        if (!try_find(id, references, is_inline) || is_inline) return false;
+        path = get_file(id);
+        return true;
+    }
+
+    auto asset_store::get_statistics() -> asset_statistics
+    {
+        asset_statistics statistics = {};
+        _statistics.reset();
+        // SUM is NULL for an empty store, which reads as 0
+        if (_statistics.move_next()) {
+            statistics.assets = _statistics.get_int64(0);
+            statistics.references = _statistics.get_int64(1);
+            statistics.stored_bytes = _statistics.get_int64(2);
+            statistics.referenced_bytes = _statistics.get_int64(3);
+        }
+        _statistics.reset();
+        return statistics;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "..\dblib\sqlite.h"
+
+namespace xerxes
+{
+    // Names content rather than a file: equal ids mean equal bytes, so caches can key decoded frames and slides by it
+    struct asset_id {
+        uint64_t hash;
+        long long size;
+
+        // 16 hex digits of the hash, then the size
+        auto to_string() const -> std::wstring;
+    };
+
+    inline auto operator==(const asset_id &a, const asset_id &b) noexcept -> bool { return a.hash == b.hash && a.size == b.size; }
+    inline auto operator!=(const asset_id &a, const asset_id &b) noexcept -> bool { return !(a == b); }
+    inline auto operator<(const asset_id &a, const asset_id &b) noexcept -> bool { return a.hash < b.hash || (a.hash == b.hash && a.size < b.size); }
+
+    struct asset_statistics {
+        long long assets;
+        long long references;
+        // What is on disk, and what it would take without deduplication
+        long long stored_bytes;
+        long long referenced_bytes;
+    };
+
+    // Imported files stored once per content, with a reference count for each. Content is identified by its XXH64 hash and
+    // size; when those match an existing asset the bytes are compared before it is shared, so a hash collision can never
+    // hand out the wrong content.
+    // Assets up to the inline limit are kept as blobs in the database, where small reads are cheapest. Larger ones are files
+    // in folder, sharded into subfolders by the first byte of the hash. Use it from one thread at a time.
+    class asset_store {
+    private:
+        sqlite_connection _connection;
+        sqlite_statement _find;
+        sqlite_statement _read;
+        sqlite_statement _insert;
+        sqlite_statement _add_references;
+        sqlite_statement _remove;
+        sqlite_statement _statistics;
+        std::wstring _folder;
+        size_t _inline_limit;
+
+        auto get_file(const asset_id &id) const -> std::wstring;
+        auto try_find(const asset_id &id, long long &references, bool &is_inline) -> bool;
+        auto try_add(const asset_id &id, const std::vector<uint8_t> &content, const std::wstring &temporary) -> bool;
+    public:
+        static const size_t default_inline_limit = 64 * 1024;
+
+        asset_store(const std::string &fn, const std::wstring &folder, size_t inline_limit = default_inline_limit);
+
+        // Add a reference to the content of the file, storing it if it's new. The file is read once, hashing and copying at
+        // the same time. False if the file can't be read, or on a hash collision.
+        auto try_import_file(const std::wstring &path, asset_id &id) -> bool;
+        auto try_import(const void *data, size_t size, asset_id &id) -> bool;
+
+        // False if there is no such asset
+        auto add_reference(const asset_id &id) -> bool;
+        // The content is deleted with the last reference
+        auto release(const asset_id &id) -> bool;
+
+        auto try_read(const asset_id &id, std::vector<uint8_t> &content) -> bool;
+        // Large assets are files that can be mapped or streamed instead of read. False for inline assets.
+        auto try_get_file(const asset_id &id, std::wstring &path) -> bool;
+
+        auto get_statistics() -> asset_statistics;
+    };
+}
+
+namespace std
+{
+    template<> struct hash<xerxes::asset_id> {
+        inline auto operator()(const xerxes::asset_id &id) const noexcept -> size_t { return static_cast<size_t>(id.hash); }
+    };
+}
\ No newline at end of file
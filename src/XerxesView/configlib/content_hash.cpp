@@ -0,0 +1,129 @@
+#include "stdafx.h"
+#include "content_hash.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace xerxes
+{
+    namespace
+    {
+        const uint64_t prime1 = 11400714785074694791ULL;
+        const uint64_t prime2 = 14029467366897019727ULL;
+        const uint64_t prime3 = 1609587929392839161ULL;
+        const uint64_t prime4 = 9650029242287828579ULL;
+        const uint64_t prime5 = 2870177450012600261ULL;
+
+        inline auto rotl(uint64_t x, int r) -> uint64_t { return (x << r) | (x >> (64 - r)); }
+
+        // Unaligned little-endian reads; x86 only
+        inline auto read64(const uint8_t *p) -> uint64_t { uint64_t v; memcpy(&v, p, sizeof(v)); return v; }
+        inline auto read32(const uint8_t *p) -> uint32_t { uint32_t v; memcpy(&v, p, sizeof(v)); return v; }
+
+        inline auto round(uint64_t lane, uint64_t input) -> uint64_t
+        {
+            lane += input * prime2;
+            return rotl(lane, 31) * prime1;
+        }
+
+        inline auto merge(uint64_t h, uint64_t lane) -> uint64_t
+        {
+            h ^= round(0, lane);
+            return h * prime1 + prime4;
+        }
+    }
+
+    content_hasher::content_hasher(uint64_t seed)
+        : _seed(seed)
+    {
+        _lanes[0] = seed + prime1 + prime2;
+        _lanes[1] = seed + prime2;
+        _lanes[2] = seed;
+        _lanes[3] = seed - prime1;
+    }
+
+    auto content_hasher::consume(const uint8_t *block) -> void
+    {
+        _lanes[0] = round(_lanes[0], read64(block));
+        _lanes[1] = round(_lanes[1], read64(block + 8));
+        _lanes[2] = round(_lanes[2], read64(block + 16));
+        _lanes[3] = round(_lanes[3], read64(block + 24));
+    }
+
+    auto content_hasher::update(const void *data, size_t size) -> void
+    {
+        auto p = static_cast<const uint8_t*>(data);
+        _total += size;
+
+        // Top up a partial block first
+        if (_buffered > 0) {
+            auto take = std::min(size, sizeof(_buffer) - _buffered);
+            memcpy(_buffer + _buffered, p, take);
+            _buffered += take;
+            p += take;
+            size -= take;
+            if (_buffered < sizeof(_buffer)) return;
+            consume(_buffer);
+            _buffered = 0;
+        }
+
+        // Keep the lanes in locals so the compiler can keep them in registers
+        auto v1 = _lanes[0], v2 = _lanes[1], v3 = _lanes[2], v4 = _lanes[3];
+        for (; size >= 32; p += 32, size -= 32) {
+            v1 = round(v1, read64(p));
+            v2 = round(v2, read64(p + 8));
+            v3 = round(v3, read64(p + 16));
+            v4 = round(v4, read64(p + 24));
+        }
+        _lanes[0] = v1; _lanes[1] = v2; _lanes[2] = v3; _lanes[3] = v4;
+
+        memcpy(_buffer, p, size);
+        _buffered = size;
+    }
+
+    auto content_hasher::digest() const -> uint64_t
+    {
+        uint64_t h;
+        if (_total >= 32) {
+            h = rotl(_lanes[0], 1) + rotl(_lanes[1], 7) + rotl(_lanes[2], 12) + rotl(_lanes[3], 18);
+            for (auto lane : _lanes) {
+                h = merge(h, lane);
+            }
+        }
+        else {
+            h = _seed + prime5;
+        }
+        h += _total;
+
+        auto p = _buffer;
+        auto remaining = _buffered;
+        for (; remaining >= 8; p += 8, remaining -= 8) {
+            h ^= round(0, read64(p));
+            h = rotl(h, 27) * prime1 + prime4;
+        }
+        if (remaining >= 4) {
+            h ^= static_cast<uint64_t>(read32(p)) * prime1;
+            h = rotl(h, 23) * prime2 + prime3;
+            p += 4;
+            remaining -= 4;
+        }
+        for (; remaining > 0; p++, remaining--) {
+            h ^= *p * prime5;
+            h = rotl(h, 11) * prime1;
+        }
+
+        h ^= h >> 33;
+        h *= prime2;
+        h ^= h >> 29;
+        h *= prime3;
+        h ^= h >> 32;
+        return h;
+    }
+
+    auto content_hasher::hash(const void *data, size_t size, uint64_t seed) -> uint64_t
+    {
+        content_hasher hasher(seed);
+        hasher.update(data, size);
+        return hasher.digest();
+    }
+}
\ No newline at end of file
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace xerxes
+{
+    // XXH64 over a stream of bytes. Not cryptographic, but fast enough to hash a file while it's read from disk, and stable
+    // across versions, so hashes can be stored.
+    class content_hasher {
+    private:
+        uint64_t _lanes[4];
+        uint8_t _buffer[32];
+        size_t _buffered = 0;
+        uint64_t _total = 0;
+        uint64_t _seed;
+
+        auto consume(const uint8_t *block) -> void;
+    public:
+        content_hasher(uint64_t seed = 0);
+
+        auto update(const void *data, size_t size) -> void;
+        // The hash of everything passed to update so far; more can be added afterwards
+        auto digest() const -> uint64_t;
+
+        static auto hash(const void *data, size_t size, uint64_t seed = 0) -> uint64_t;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,189 @@
+#include "stdafx.h"
+#include "library_benchmark.h"
+#include "media_library.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <set>
+#include <sstream>
+
+namespace xerxes
+{
+    namespace
+    {
+        // Per 10000 letters, from 'e' down to 'z'
+        const char letters[] = "etaoinshrdlcumwfgypbvkjxqz";
+        const uint32_t letter_weights[] = { 1270, 910, 820, 750, 700, 670, 630, 610, 600, 430, 400, 280, 280, 240, 240, 220, 200, 200, 190, 150, 100, 80, 15, 15, 10, 7 };
+
+        auto milliseconds_since(std::chrono::steady_clock::time_point start) -> double
+        {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        auto make_path(int item) -> std::wstring
+        {
+            return L"C:\\media\\" + std::to_wstring(item) + L".mp4";
+        }
+
+        const std::wstring changed_title = L"Amazing Grace ";
+
+        // The changed items found by text; a generated item could match it through its lyrics
+        auto count_changed(media_library &library, const std::wstring &text) -> int
+        {
+            auto count = 0;
+            library.search(text, 1000, [&](const media_match &match) {
+                if (match.title.compare(0, changed_title.size(), changed_title) == 0) count++;
+            });
+            return count;
+        }
+    }
+
+    catalog_generator::catalog_generator(uint32_t seed, size_t vocabulary_size, double exponent)
+        : _random(seed)
+    {
+        uint32_t total = 0;
+        for (auto weight : letter_weights) {
+            total += weight;
+        }
+
+        std::set<std::wstring> known;
+        while (_vocabulary.size() < vocabulary_size) {
+            std::wstring word;
+            auto length = next(2, 10);
+            for (auto i = 0; i < length; i++) {
+                auto pick = _random() % total;
+                auto letter = 0;
+                while (pick >= letter_weights[letter]) {
+                    pick -= letter_weights[letter++];
+                }
+                word.push_back(static_cast<wchar_t>(letters[letter]));
+            }
+            if (known.insert(word).second) {
+                _vocabulary.push_back(word);
+            }
+        }
+
+        auto sum = 0.0;
+        _weights.reserve(_vocabulary.size());
+        for (size_t i = 0; i < _vocabulary.size(); i++) {
+            sum += 1.0 / std::pow(i + 1.0, exponent);
+            _weights.push_back(sum);
+        }
+    }
+
+    auto catalog_generator::next_fraction() -> double
+    {
+        return _random() / 4294967296.0;
+    }
+
+    auto catalog_generator::next(int lowest, int highest) -> int
+    {
+        return lowest + static_cast<int>(_random() % static_cast<uint32_t>(highest - lowest + 1));
+    }
+
+    auto catalog_generator::make_words(int count) -> std::wstring
+    {
+        std::wstring words;
+        for (auto i = 0; i < count; i++) {
+            if (i > 0) words.push_back(L' ');
+            auto pick = std::lower_bound(_weights.begin(), _weights.end(), next_fraction() * _weights.back());
+            words += _vocabulary[std::min(static_cast<size_t>(pick - _weights.begin()), _vocabulary.size() - 1)];
+        }
+        return words;
+    }
+
+    auto library_benchmark_result::passed() const -> bool
+    {
+        return found_changed && found_removed;
+    }
+
+    auto library_benchmark_result::format() const -> std::string
+    {
+        std::ostringstream out;
+        char line[256];
+        std::snprintf(line, sizeof(line), "insert: %.0f ms\n", insert_ms);
+        out << line;
+
+        auto total = 0.0, worst = 0.0;
+        for (auto &query : queries) {
+            // The generated words are all ASCII
+            std::string text(query.text.begin(), query.text.end());
+            std::snprintf(line, sizeof(line), "%-32s %7.3f ms  %2d results\n", text.c_str(), query.average_ms, query.results);
+            out << line;
+            total += query.average_ms;
+            worst = std::max(worst, query.average_ms);
+        }
+        if (!queries.empty()) {
+            std::snprintf(line, sizeof(line), "%d queries: mean %.3f ms, worst %.3f ms\n", static_cast<int>(queries.size()), total / queries.size(), worst);
+            out << line;
+        }
+
+        std::snprintf(line, sizeof(line), "re-index changed items: %.1f ms%s\nfull rebuild: %.0f ms%s\n",
+            reindex_ms, found_changed ? "" : "  CHANGED ITEMS NOT FOUND", rebuild_ms, found_removed ? "" : "  REMOVED ITEM STILL FOUND");
+        out << line;
+        return out.str();
+    }
+
+    auto library_benchmark::run(const library_benchmark_options &options) -> library_benchmark_result
+    {
+        library_benchmark_result result{};
+        std::remove(options.fn.c_str());
+        media_library library(options.fn);
+        catalog_generator generator(options.seed, options.vocabulary_size);
+
+        auto start = std::chrono::steady_clock::now();
+        {
+            auto batch = library.begin_batch();
+            for (auto i = 0; i < options.items; i++) {
+                auto title = generator.make_words(generator.next(2, 5));
+                auto lyrics = generator.make_words(generator.next(options.fewest_lyric_words, options.most_lyric_words));
+                library.write_item(media_item{ make_path(i), title, lyrics, generator.make_words(3), i, i * 10LL });
+            }
+            batch.commit();
+        }
+        result.insert_ms = milliseconds_since(start);
+
+        // From single letters, which match most of the catalog, to three word fragments, which have to intersect the lyrics
+        auto &vocabulary = generator.get_vocabulary();
+        auto word = [&](size_t rank, size_t length) { return vocabulary[std::min(rank, vocabulary.size() - 1)].substr(0, length); };
+        std::vector<std::wstring> queries = {
+            L"a", L"e", L"th", L"the", L"ea", L"et ta",
+            word(0, 3),
+            word(500, 4) + L" " + word(3, 2),
+            word(20000, std::wstring::npos),
+            word(0, std::wstring::npos) + L" " + word(1, std::wstring::npos) + L" " + word(2, std::wstring::npos),
+            word(10, std::wstring::npos) + L" " + word(200, std::wstring::npos) + L" " + word(5000, std::wstring::npos),
+            L"zzqx",
+        };
+        for (auto &text : queries) {
+            library_benchmark_query query{ text, 0.0, 0 };
+            start = std::chrono::steady_clock::now();
+            for (auto r = 0; r < options.repeats; r++) {
+                query.results = 0;
+                library.search(text, 20, [&](const media_match &) { query.results++; });
+            }
+            query.average_ms = milliseconds_since(start) / std::max(1, options.repeats);
+            result.queries.push_back(query);
+        }
+
+        start = std::chrono::steady_clock::now();
+        {
+            auto batch = library.begin_batch();
+            for (auto i = 0; i < options.changed_items; i++) {
+                library.write_item(media_item{ make_path(i), changed_title + std::to_wstring(i), generator.make_words(150), L"hymn", i, 1 });
+            }
+            batch.commit();
+        }
+        result.reindex_ms = milliseconds_since(start);
+        result.found_changed = count_changed(library, L"amaz gra") == options.changed_items;
+
+        library.remove_item(make_path(0));
+        start = std::chrono::steady_clock::now();
+        library.rebuild_indexes();
+        result.rebuild_ms = milliseconds_since(start);
+        result.found_removed = count_changed(library, L"amazing grace") == std::max(0, options.changed_items - 1);
+        return result;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace xerxes
+{
+    // Made up words with English letter frequencies, used with Zipf frequencies like the words of real lyrics. Uses only
+    // mt19937 and its own arithmetic on top, so the same seed generates the same catalog with every compiler.
+    class catalog_generator {
+    private:
+        std::mt19937 _random;
+        std::vector<std::wstring> _vocabulary;
+        // Running totals of the Zipf weights of the vocabulary
+        std::vector<double> _weights;
+
+        // [0, 1)
+        auto next_fraction() -> double;
+    public:
+        catalog_generator(uint32_t seed, size_t vocabulary_size, double exponent = 1.07);
+
+        inline auto get_vocabulary() const -> const std::vector<std::wstring> & { return _vocabulary; }
+
+        // count words picked from the vocabulary, separated by spaces
+        auto make_words(int count) -> std::wstring;
+        auto next(int lowest, int highest) -> int;
+    };
+
+    struct library_benchmark_options {
+        // Removed and created again
+        std::string fn = "library_benchmark.db";
+        uint32_t seed = 1;
+        int items = 50000;
+        size_t vocabulary_size = 30000;
+        int fewest_lyric_words = 80;
+        int most_lyric_words = 250;
+        // Every query is searched this often and the times averaged
+        int repeats = 50;
+        int changed_items = 100;
+    };
+
+    struct library_benchmark_query {
+        std::wstring text;
+        double average_ms;
+        int results;
+    };
+
+    struct library_benchmark_result {
+        double insert_ms;
+        std::vector<library_benchmark_query> queries;
+        double reindex_ms;
+        double rebuild_ms;
+        // The changed items are found by their new titles, and not any more once removed, also after the rebuild
+        bool found_changed;
+        bool found_removed;
+
+        auto passed() const -> bool;
+        // One line per query, then the mean and worst of them and the times of the writes
+        auto format() const -> std::string;
+    };
+
+    // How quickly media_library searches a large generated catalog: prefix queries from single letters to three word lyric
+    // fragments, re-indexing a batch of changed items, and rebuilding the indexes from scratch.
+    class library_benchmark {
+    public:
+        library_benchmark() = delete;
+
+        static auto run(const library_benchmark_options &options) -> library_benchmark_result;
+    };
+}
\ No newline at end of file
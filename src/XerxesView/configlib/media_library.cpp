@@ -0,0 +1,120 @@
+#include "stdafx.h"
+#include "media_library.h"
+
+#include <cwctype>
+
+namespace xerxes
+{
+    media_library::media_library(const std::string & fn)
+        : _connection(fn)
+    {
+        // Create the database
+        sqlite_statement(_connection, "CREATE TABLE IF NOT EXISTS [media]([id] INTEGER PRIMARY KEY, [path] TEXT NOT NULL UNIQUE, [title] TEXT, [sort_title] TEXT, [lyrics] TEXT, [tags] TEXT, [modified] INTEGER NOT NULL, [size] INTEGER NOT NULL)").execute();
+        sqlite_statement(_connection, "CREATE INDEX IF NOT EXISTS [media_sort_title] ON [media]([sort_title])").execute();
+        // Titles and lyrics are indexed apart, so matching the short titles doesn't have to read through the postings of the lyrics.
+        // The indexes don't keep their own copy of the text. Two and three character prefixes are indexed too.
+        sqlite_statement(_connection, "CREATE VIRTUAL TABLE IF NOT EXISTS [media_title_index] USING fts5([title], [tags], content='media', content_rowid='id', tokenize='unicode61 remove_diacritics 1', prefix='2 3')").execute();
+        sqlite_statement(_connection, "CREATE VIRTUAL TABLE IF NOT EXISTS [media_lyrics_index] USING fts5([lyrics], content='media', content_rowid='id', tokenize='unicode61 remove_diacritics 1', prefix='2 3')").execute();
+        sqlite_statement(_connection, "CREATE TRIGGER IF NOT EXISTS [media_indexed] AFTER INSERT ON [media] BEGIN "
+            "INSERT INTO [media_title_index]([rowid], [title], [tags]) VALUES (new.[id], new.[title], new.[tags]); "
+            "INSERT INTO [media_lyrics_index]([rowid], [lyrics]) VALUES (new.[id], new.[lyrics]); END").execute();
+        sqlite_statement(_connection, "CREATE TRIGGER IF NOT EXISTS [media_unindexed] AFTER DELETE ON [media] BEGIN "
+            "INSERT INTO [media_title_index]([media_title_index], [rowid], [title], [tags]) VALUES ('delete', old.[id], old.[title], old.[tags]); "
+            "INSERT INTO [media_lyrics_index]([media_lyrics_index], [rowid], [lyrics]) VALUES ('delete', old.[id], old.[lyrics]); END").execute();
+        sqlite_statement(_connection, "CREATE TRIGGER IF NOT EXISTS [media_title_reindexed] AFTER UPDATE OF [title], [tags] ON [media] BEGIN "
+            "INSERT INTO [media_title_index]([media_title_index], [rowid], [title], [tags]) VALUES ('delete', old.[id], old.[title], old.[tags]); "
+            "INSERT INTO [media_title_index]([rowid], [title], [tags]) VALUES (new.[id], new.[title], new.[tags]); END").execute();
+        sqlite_statement(_connection, "CREATE TRIGGER IF NOT EXISTS [media_lyrics_reindexed] AFTER UPDATE OF [lyrics] ON [media] BEGIN "
+            "INSERT INTO [media_lyrics_index]([media_lyrics_index], [rowid], [lyrics]) VALUES ('delete', old.[id], old.[lyrics]); "
+            "INSERT INTO [media_lyrics_index]([rowid], [lyrics]) VALUES (new.[id], new.[lyrics]); END").execute();
+
+        _find.prepare(_connection, "SELECT [id] FROM [media] WHERE [path]=?");
+        _insert.prepare(_connection, "INSERT INTO [media]([path], [title], [sort_title], [lyrics], [tags], [modified], [size]) VALUES (?, ?, ?, ?, ?, ?, ?)");
+        _update.prepare(_connection, "UPDATE [media] SET [title]=?, [sort_title]=?, [lyrics]=?, [tags]=?, [modified]=?, [size]=? WHERE [id]=?");
+        _delete.prepare(_connection, "DELETE FROM [media] WHERE [path]=?");
+        _count.prepare(_connection, "SELECT COUNT(*) FROM [media]");
+        _versions.prepare(_connection, "SELECT [path], [modified], [size] FROM [media] WHERE [path]>=? AND [path]<?");
+        _search_title_prefix.prepare(_connection, "SELECT [id], [path], [title] FROM [media] WHERE [sort_title]>=? AND [sort_title]<? ORDER BY [sort_title] LIMIT ?");
+        _search_titles.prepare(_connection, "SELECT [media].[id], [media].[path], [media].[title] FROM [media_title_index] JOIN [media] ON [media].[id]=[media_title_index].[rowid] WHERE [media_title_index] MATCH ? LIMIT ?");
+        _search_lyrics.prepare(_connection, "SELECT [media].[id], [media].[path], [media].[title] FROM [media_lyrics_index] JOIN [media] ON [media].[id]=[media_lyrics_index].[rowid] WHERE [media_lyrics_index] MATCH ? LIMIT ?");
+    }
+
+    auto media_library::make_sort_title(const std::wstring & title) -> std::wstring
+    {
+        std::wstring sort_title;
+        for (auto c : title) {
+            if (std::iswspace(c)) {
+                if (!sort_title.empty() && sort_title.back() != L' ') sort_title += L' ';
+            }
+            else {
+                sort_title += static_cast<wchar_t>(std::towlower(c));
+            }
+        }
+        if (!sort_title.empty() && sort_title.back() == L' ') sort_title.pop_back();
+        return sort_title;
+    }
+
+    auto media_library::make_query(const std::wstring & text) -> std::wstring
+    {
+        // Each word is quoted, so nothing the operator types is taken for query syntax
+        std::wstring query;
+        size_t i = 0;
+        while (i < text.size()) {
+            while (i < text.size() && !std::iswalnum(text[i])) i++;
+            auto start = i;
+            while (i < text.size() && std::iswalnum(text[i])) i++;
+            if (i == start) break;
+
+            if (!query.empty()) query += L' ';
+            query += L'"';
+            query.append(text, start, i - start);
+            query += i - start > 1 ? L"\"*" : L"\"";
+        }
+        return query;
+    }
+
+    auto media_library::write_item(const media_item & item) -> long long
+    {
+        auto title = optional<std::wstring>{ item.title.empty(), item.title };
+        auto sort_title = optional<std::wstring>{ item.title.empty(), make_sort_title(item.title) };
+        auto lyrics = optional<std::wstring>{ item.lyrics.empty(), item.lyrics };
+        auto tags = optional<std::wstring>{ item.tags.empty(), item.tags };
+        if (_find.rebind_all(item.path).move_next()) {
+            // Found the record - update it
+            auto id = _find.get_int64(0);
+            _find.reset();
+            _update.rebind_all(title, sort_title, lyrics, tags, item.modified, item.size, id).execute();
+            return id;
+        }
+        else {
+            // Not found - insert it
+            _insert.rebind_all(item.path, title, sort_title, lyrics, tags, item.modified, item.size).execute();
+            return _connection.get_last_inserted_rowid();
+        }
+    }
+
+    auto media_library::remove_item(const std::wstring & path) -> void
+    {
+        _delete.rebind_all(path).execute();
+    }
+
+    auto media_library::get_count() -> long long
+    {
+        _count.reset();
+        VERIFY(_count.move_next() == true);
+        return _count.get_int64(0);
+    }
+
+    auto media_library::rebuild_indexes() -> void
+    {
+        sqlite_execute(_connection, "INSERT INTO [media_title_index]([media_title_index]) VALUES ('rebuild')");
+        sqlite_execute(_connection, "INSERT INTO [media_lyrics_index]([media_lyrics_index]) VALUES ('rebuild')");
+        optimize_indexes();
+    }
+
+    auto media_library::optimize_indexes() -> void
+    {
+        sqlite_execute(_connection, "INSERT INTO [media_title_index]([media_title_index]) VALUES ('optimize')");
+        sqlite_execute(_connection, "INSERT INTO [media_lyrics_index]([media_lyrics_index]) VALUES ('optimize')");
+    }
+}
\ No newline at end of file
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <set>
+#include <string>
+#include "..\dblib\sqlite.h"
+
+namespace xerxes
+{
+    struct media_item {
+        std::wstring path;
+        std::wstring title;
+        std::wstring lyrics;
+        // Separated by spaces
+        std::wstring tags;
+        // Last write time and size of the file, so a scan can tell whether it changed
+        long long modified;
+        long long size;
+    };
+
+    struct media_match {
+        long long id;
+        std::wstring path;
+        std::wstring title;
+    };
+
+    // The songs and videos known to the application, searchable by title, tags and lyrics. The full text indexes are kept up to
+    // date by triggers as items are written, so a change never needs a full re-index. Use it from one thread at a time.
+    class media_library {
+    private:
+        sqlite_connection _connection;
+        sqlite_statement _find;
+        sqlite_statement _insert;
+        sqlite_statement _update;
+        sqlite_statement _delete;
+        sqlite_statement _count;
+        sqlite_statement _versions;
+        sqlite_statement _search_title_prefix;
+        sqlite_statement _search_titles;
+        sqlite_statement _search_lyrics;
+
+        // Lower case with single spaces, for matching the start of titles
+        static auto make_sort_title(const std::wstring &title) -> std::wstring;
+        // Every word of text, all of which have to match: words of two or more characters as prefixes, single characters as
+        // whole words (a one character prefix matches too much of the index to be quick). Empty if text has no words.
+        static auto make_query(const std::wstring &text) -> std::wstring;
+
+        template<typename _OnMatch> inline auto report(const sqlite_statement &statement, std::set<long long> &reported, int limit, const _OnMatch &on_match) -> void {
+            for (auto row : statement) {
+                // [id], [path], [title]
+                if (reported.insert(row.get_int64(0)).second) {
+                    on_match(media_match{ row.get_int64(0), row.get_wstring(1), row.get_is_null(2) ? L"" : row.get_wstring(2) });
+                    if (static_cast<int>(reported.size()) >= limit) break;
+                }
+            }
+            statement.reset();
+        }
+    public:
+        media_library(const std::string &fn);
+
+        // Adds the item, or replaces the one with the same path. Returns its id.
+        auto write_item(const media_item &item) -> long long;
+        auto remove_item(const std::wstring &path) -> void;
+        auto get_count() -> long long;
+
+        // Call on_item(path, modified, size) for every item in folder or below it, so a scan can tell what changed
+        template<typename _OnItem> inline auto get_versions(const std::wstring &folder, const _OnItem &on_item) -> void {
+            // Every path that starts with folder and a backslash; ']' is the character after the backslash
+            _versions.rebind_all(folder + L'\\', folder + L']');
+            for (auto row : _versions) {
+                // [path], [modified], [size]
+                on_item(std::wstring(row.get_wstring(0)), row.get_int64(1), row.get_int64(2));
+            }
+        }
+
+        // Writes are much cheaper in a batch
+        inline auto begin_batch() -> sqlite_transaction { return sqlite_transaction(_connection); }
+
+        // Build the indexes again from the items, e.g. after they were damaged, and merge their segments
+        auto rebuild_indexes() -> void;
+        // Merge the index segments that incremental writes leave behind
+        auto optimize_indexes() -> void;
+
+        // Call on_match with up to limit matches for text, in order: titles that start with text, titles and tags with all its
+        // words, then lyrics with all its words. "amaz gra" finds "Amazing Grace". Every step stops at the limit instead of
+        // ranking all the matches, so a search takes a few milliseconds however common the words are.
+        // Returns false if text has nothing to search for.
+        template<typename _OnMatch> inline auto search(const std::wstring &text, int limit, const _OnMatch &on_match) -> bool {
+            auto prefix = make_sort_title(text);
+            if (prefix.empty() || limit <= 0) return false;
+
+            std::set<long long> reported;
+            _search_title_prefix.rebind_all(prefix, prefix + L'\xffff', limit);
+            report(_search_title_prefix, reported, limit, on_match);
+
+            auto query = make_query(text);
+            if (!query.empty() && static_cast<int>(reported.size()) < limit) {
+                _search_titles.rebind_all(query, limit);
+                report(_search_titles, reported, limit, on_match);
+            }
+            if (!query.empty() && static_cast<int>(reported.size()) < limit) {
+                _search_lyrics.rebind_all(query, limit);
+                report(_search_lyrics, reported, limit, on_match);
+            }
+            return true;
+        }
+    };
+}
\ No newline at end of file
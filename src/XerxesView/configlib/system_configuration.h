@@ -12,6 +12,11 @@ namespace xerxes
         std::wstring monitor_name;
     };
 
+    inline auto operator==(const window_config &a, const window_config &b) -> bool {
+        return a.show_on_primary == b.show_on_primary && a.show_maximized == b.show_maximized && a.show_fullscreen == b.show_fullscreen && a.monitor_name == b.monitor_name;
+    }
+    inline auto operator!=(const window_config &a, const window_config &b) -> bool { return !(a == b); }
+
     class system_configuration {
     private:
         sqlite_connection _connection;
@@ -37,5 +42,8 @@ namespace xerxes
         }
 
         auto write_window_configuration(const std::wstring &key, const window_config &cfg) -> void;
+
+        // Writes in a batch share one commit
+        inline auto begin_batch() -> sqlite_transaction { return sqlite_transaction(_connection); }
     };
 }
\ No newline at end of file
@@ -0,0 +1,43 @@
+#include "stdafx.h"
+#include "thumbnail_cache.h"
+
+#include <cstring>
+
+namespace xerxes
+{
+    thumbnail_cache::thumbnail_cache(const std::string & fn)
+        : _connection(fn)
+    {
+        // Create the database
+        sqlite_statement(_connection, "CREATE TABLE IF NOT EXISTS [thumbnail]([path] TEXT PRIMARY KEY, [modified] INTEGER NOT NULL, [size] INTEGER NOT NULL, [width] INTEGER NOT NULL, [height] INTEGER NOT NULL, [pixels] BLOB NOT NULL)").execute();
+
+        _select.prepare(_connection, "SELECT [width], [height], [pixels] FROM [thumbnail] WHERE [path]=? AND [modified]=? AND [size]=?");
+        _write.prepare(_connection, "INSERT OR REPLACE INTO [thumbnail]([path], [modified], [size], [width], [height], [pixels]) VALUES (?, ?, ?, ?, ?, ?)");
+    }
+
+    auto thumbnail_cache::try_read(const std::wstring & path, long long modified, long long size, thumbnail_data & thumbnail) -> bool
+    {
+        if (!_select.rebind_all(path, modified, size).move_next()) return false;
+
+        auto width = _select.get_int(0);
+        auto height = _select.get_int(1);
+        auto pixels = _select.get_blob(2);
+        auto bytes = static_cast<size_t>(_select.get_bytes(2));
+        // A row that doesn't match its size is treated as missing and written again
+        auto valid = width > 0 && height > 0 && pixels != nullptr && bytes == static_cast<size_t>(width) * height * 4;
+        if (valid) {
+            thumbnail.width = width;
+            thumbnail.height = height;
+            thumbnail.pixels.resize(bytes);
+            memcpy(thumbnail.pixels.data(), pixels, bytes);
+        }
+        // Don't hold the read open between lookups
+        _select.reset();
+        return valid;
+    }
+
+    auto thumbnail_cache::write(const std::wstring & path, long long modified, long long size, const thumbnail_data & thumbnail) -> void
+    {
+        _write.rebind_all(path, modified, size, thumbnail.width, thumbnail.height, sqlite_blob{ thumbnail.pixels.data(), static_cast<int>(thumbnail.pixels.size()) }).execute();
+    }
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "..\dblib\sqlite.h"
+
+namespace xerxes
+{
+    // A thumbnail as stored: BGRA rows of width * 4 bytes
+    struct thumbnail_data {
+        int width;
+        int height;
+        std::vector<uint8_t> pixels;
+    };
+
+    // Thumbnails of files, keyed by path, modification time and size so a file that changed is decoded again. Use it from
+    // one thread at a time.
+    class thumbnail_cache {
+    private:
+        sqlite_connection _connection;
+        sqlite_statement _select;
+        sqlite_statement _write;
+    public:
+        thumbnail_cache(const std::string &fn);
+
+        // False if there's no thumbnail for this version of the file
+        auto try_read(const std::wstring &path, long long modified, long long size, thumbnail_data &thumbnail) -> bool;
+        // Replaces the thumbnail of any other version of the file
+        auto write(const std::wstring &path, long long modified, long long size, const thumbnail_data &thumbnail) -> void;
+
+        // Writes are much cheaper in a batch
+        inline auto begin_batch() -> sqlite_transaction { return sqlite_transaction(_connection); }
+    };
+}
\ No newline at end of file
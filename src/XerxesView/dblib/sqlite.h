@@ -23,6 +23,12 @@ namespace xerxes
         T value;
     };
 
+    // A blob parameter. The bytes are not copied and must stay valid until the statement is reset or bound again.
+    struct sqlite_blob {
+        const void *data;
+        int size;
+    };
+
     enum class sqlite_type {
         _int = SQLITE_INTEGER,
         _float = SQLITE_FLOAT,
@@ -234,6 +240,14 @@ namespace xerxes
             return static_cast<const wchar_t*>(sqlite3_column_text16(static_cast<const T *>(this)->get_abi(), col));
         }
 
+        inline auto get_blob(const int col = 0) const noexcept -> const void* {
+            return sqlite3_column_blob(static_cast<const T *>(this)->get_abi(), col);
+        }
+        // The size of a blob or text column in bytes; call after get_blob
+        inline auto get_bytes(const int col = 0) const noexcept -> int {
+            return sqlite3_column_bytes(static_cast<const T *>(this)->get_abi(), col);
+        }
+
         inline auto get_column_type(const int col = 0) const noexcept -> sqlite_type {
             return static_cast<sqlite_type>(sqlite3_column_type(static_cast<const T *>(this)->get_abi(), col));
         }
@@ -374,6 +388,12 @@ namespace xerxes
             }
             return *this;
         }
+        inline auto bind(const int index, const sqlite_blob &value) const -> const sqlite_statement&{
+            if (sqlite3_bind_blob(get_abi(), index, value.data, value.size, SQLITE_STATIC) != SQLITE_OK) {
+                throw sqlite_exception(sqlite3_db_handle(get_abi()));
+            }
+            return *this;
+        }
         inline auto bind(const int index, bool value) const -> const sqlite_statement&{
             return bind(index, (value ? 1 : 0));
         }
@@ -436,6 +456,37 @@ namespace xerxes
         return stmt.get_int();
     }
 
+    // Begins a transaction that is rolled back unless it is committed before it goes out of scope
+    class sqlite_transaction {
+    private:
+        const sqlite_connection *_connection;
+        bool _done = false;
+    public:
+        explicit sqlite_transaction(const sqlite_connection &cn)
+            : _connection(&cn)
+        {
+            sqlite_execute(cn, "BEGIN");
+        }
+        sqlite_transaction(const sqlite_transaction &) = delete;
+        sqlite_transaction(sqlite_transaction &&other) noexcept
+            : _connection(other._connection), _done(other._done)
+        {
+            other._done = true;
+        }
+        auto operator=(const sqlite_transaction &)->sqlite_transaction& = delete;
+
+        ~sqlite_transaction() noexcept {
+            if (!_done) {
+                sqlite3_exec(_connection->get_abi(), "ROLLBACK", nullptr, nullptr, nullptr);
+            }
+        }
+
+        inline auto commit() -> void {
+            sqlite_execute(*_connection, "COMMIT");
+            _done = true;
+        }
+    };
+
     class sqlite_iterator;
 
     class sqlite_row : public sqlite_reader<sqlite_row> {
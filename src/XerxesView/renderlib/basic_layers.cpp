@@ -0,0 +1,49 @@
+#include "stdafx.h"
+#include "basic_layers.h"
+
+#include <algorithm>
+
+namespace xerxes
+{
+    auto solid_layer::set_color(uint32_t color) -> void
+    {
+        if (_color != color) {
+            _color = color;
+            invalidate_all();
+        }
+    }
+
+    auto solid_layer::render(surface &target, const pixel_rect &clip) -> void
+    {
+        target.fill(clip, _color);
+    }
+
+    auto line_overlay_layer::render_diagonal(surface &target, const pixel_rect &clip, bool mirrored) -> void
+    {
+        if (_width <= 0 || _height <= 0) return;
+
+        for (int y = clip.top; y < clip.bottom; y++) {
+            // The span of columns the line covers on this row, so steep and shallow lines are both unbroken
+            auto x0 = static_cast<int>(static_cast<long long>(y) * _width / _height);
+            auto x1 = std::max(x0 + 1, static_cast<int>(static_cast<long long>(y + 1) * _width / _height));
+            if (mirrored) {
+                auto t = _width - x1;
+                x1 = _width - x0;
+                x0 = t;
+            }
+            x0 = std::max(x0, clip.left);
+            x1 = std::min(x1, clip.right);
+
+            auto p = target.row(y);
+            for (int x = x0; x < x1; x++) {
+                p[x] = _color;
+            }
+        }
+    }
+
+    auto line_overlay_layer::render(surface &target, const pixel_rect &clip) -> void
+    {
+        render_diagonal(target, clip, false);
+        render_diagonal(target, clip, true);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include "layer.h"
+
+namespace xerxes
+{
+    // Fills the canvas with a single colour
+    class solid_layer : public layer {
+    private:
+        uint32_t _color;
+    public:
+        explicit solid_layer(uint32_t color = 0xff000000) : _color(color) {}
+
+        auto set_color(uint32_t color) -> void;
+        inline auto get_color() const noexcept -> uint32_t { return _color; }
+
+        virtual auto render(surface &target, const pixel_rect &clip) -> void override;
+    };
+
+    // The two corner to corner diagonals, used to line up projectors
+    class line_overlay_layer : public layer {
+    private:
+        uint32_t _color;
+
+        auto render_diagonal(surface &target, const pixel_rect &clip, bool mirrored) -> void;
+    public:
+        explicit line_overlay_layer(uint32_t color = 0xffffffff) : _color(color) {}
+
+        virtual auto render(surface &target, const pixel_rect &clip) -> void override;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include "spsc_ring.h"
+
+namespace xerxes
+{
+    enum class canvas_command_type {
+        none,
+        go_to_slide,
+        play,
+        blank,
+        set_layer,
+        // Put a slide on the preview bus, or take it off with -1
+        stage,
+        // Make the staged slide the program with a dissolve of value milliseconds
+        take
+    };
+
+    enum class canvas_layer_id {
+        media,
+        overlay,
+        // The frame timing HUD
+        hud
+    };
+
+    // A request from the control window to the canvas. Commands are plain values so queueing one never allocates.
+    struct canvas_command {
+        canvas_command_type type;
+        canvas_layer_id layer;
+        int64_t value;
+        // When the command was queued, on the canvas frame clock
+        std::chrono::nanoseconds issued;
+
+        static inline auto go_to_slide(int64_t index) noexcept -> canvas_command { return canvas_command{ canvas_command_type::go_to_slide, canvas_layer_id::media, index, std::chrono::nanoseconds(0) }; }
+        static inline auto play(bool playing) noexcept -> canvas_command { return canvas_command{ canvas_command_type::play, canvas_layer_id::media, playing ? 1 : 0, std::chrono::nanoseconds(0) }; }
+        static inline auto blank(bool blanked) noexcept -> canvas_command { return canvas_command{ canvas_command_type::blank, canvas_layer_id::media, blanked ? 1 : 0, std::chrono::nanoseconds(0) }; }
+        static inline auto set_layer(canvas_layer_id layer, bool visible) noexcept -> canvas_command { return canvas_command{ canvas_command_type::set_layer, layer, visible ? 1 : 0, std::chrono::nanoseconds(0) }; }
+        static inline auto stage(int64_t index) noexcept -> canvas_command { return canvas_command{ canvas_command_type::stage, canvas_layer_id::media, index, std::chrono::nanoseconds(0) }; }
+        static inline auto take(std::chrono::milliseconds transition) noexcept -> canvas_command { return canvas_command{ canvas_command_type::take, canvas_layer_id::media, static_cast<int64_t>(transition.count()), std::chrono::nanoseconds(0) }; }
+    };
+
+    // The control window produces, the canvas render thread drains it once per frame
+    using canvas_command_queue = spsc_ring<canvas_command, 256>;
+}
\ No newline at end of file
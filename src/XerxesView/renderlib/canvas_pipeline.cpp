@@ -0,0 +1,478 @@
+#include "stdafx.h"
+#include "canvas_pipeline.h"
+#include "startup_trace.h"
+#include "event_trace.h"
+
+#include <algorithm>
+#include <cwchar>
+#include <thread>
+
+namespace xerxes
+{
+    namespace
+    {
+        // About seven slides at 4K, or thirty at 1080p
+        const size_t slide_cache_budget = 256 * 1024 * 1024;
+
+        // The HUD sits in the top left corner and shows the last 256 frames
+        const int hud_margin = 16;
+        const int hud_width = 256 * frame_graph_layer::bar_width + 8;
+        const int hud_graph_height = 96;
+        const int hud_text_height = 84;
+        const std::chrono::milliseconds hud_refresh(250);
+
+        // The staged cue's first frame may be decoded after the slide was staged, so the preview bus looks again this often
+        const std::chrono::milliseconds bus_refresh(40);
+    }
+
+    canvas_pipeline::canvas_pipeline(frame_clock &clock, std::shared_ptr<glyph_rasterizer> rasterizer, cue_list::media_opener opener, thread_pool *pool)
+        : _clock(clock), _slide_texts(std::make_shared<std::vector<std::wstring>>())
+    {
+        _compositor.set_thread_pool(pool);
+        _video = std::make_shared<video_layer>();
+        _compositor.add_layer(_video);
+        _text_engine = std::make_shared<text_engine>(rasterizer);
+        _text = std::make_shared<text_layer>(_text_engine, text_style{ font_key{ L"Segoe UI", 0, true, false }, text_align::center, 0xffffffff });
+        _slides.reset(new slide_cache([this](size_t slide, surface &target) { render_slide(slide, target); }, slide_cache_budget));
+        _slide = std::make_shared<slide_layer>();
+        _compositor.add_layer(_slide);
+        _overlay = std::make_shared<line_overlay_layer>();
+        _compositor.add_layer(_overlay);
+        _dissolve = std::make_shared<dissolve_layer>();
+        _compositor.add_layer(_dissolve);
+        _blank = std::make_shared<solid_layer>(0xff000000);
+        _blank->set_visible(false);
+        _compositor.add_layer(_blank);
+        // Above the blank, so the timings can still be watched with the show blanked
+        _hud_graph = std::make_shared<frame_graph_layer>();
+        _hud_graph->set_visible(false);
+        _compositor.add_layer(_hud_graph);
+        _hud_text_engine = std::make_shared<text_engine>(rasterizer);
+        _hud_text = std::make_shared<text_layer>(_hud_text_engine, text_style{ font_key{ L"Consolas", 14, false, false }, text_align::left, 0xffffffff });
+        _hud_text->set_visible(false);
+        _compositor.add_layer(_hud_text);
+        _opener = std::move(opener);
+        _cues.reset(new cue_list(_opener));
+
+        // The same pool, but its tiles only run when no program tile is waiting
+        _bus.set_thread_pool(pool);
+        _bus.set_priority(task_priority::low);
+        _bus_video = std::make_shared<video_layer>();
+        _bus.add_layer(_bus_video);
+        _bus_slide = std::make_shared<slide_layer>();
+        _bus.add_layer(_bus_slide);
+    }
+
+    canvas_pipeline::~canvas_pipeline()
+    {
+        stop_bus();
+    }
+
+    auto canvas_pipeline::resize(int width, int height) -> void
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        _compositor.resize(width, height);
+        place_hud();
+        request_bus(bus_request{ _staged_slide, width, height });
+    }
+
+    auto canvas_pipeline::render_frame(const frame_info &frame, damage_region &damage) -> bool
+    {
+        frame_timing timing{ frame.index, frame.deadline.count(), _clock.now().count(), 0, static_cast<uint32_t>(frame.skipped), 0.0f, 0,
+            static_cast<uint16_t>(_commands.size()) };
+        auto composed = false;
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            canvas_command command;
+            while (_commands.try_pop(command)) {
+                apply(command);
+            }
+            if (_deterministic) {
+                wait_for_media(frame);
+            }
+            if (_pending_cue >= 0) {
+                try_fire_pending_cue();
+            }
+            // The canvas was resized since the slide was rendered
+            if (_slide->is_stale()) {
+                show_slide();
+            }
+            if (_hud_graph->get_visible()) {
+                update_hud(frame);
+            }
+            _compositor.advance(frame.deadline);
+            auto start = startup_trace::clock::now();
+            {
+                event_trace::scope trace("compose");
+                composed = _compositor.compose(damage);
+            }
+            // A new feed gets the canvas as it is, even if nothing changed
+            auto monitor = std::atomic_load(&_program_monitor);
+            if (monitor != nullptr && (composed || monitor->is_empty())) {
+                event_trace::scope trace("program monitor");
+                monitor->publish(_compositor.target(), frame.index);
+            }
+            // Every frame, as a receiver that just connected needs the canvas even if nothing changed
+            auto output = std::atomic_load(&_network_output);
+            if (output != nullptr) {
+                event_trace::scope trace("network output");
+                static const damage_region nothing;
+                output->publish(_compositor.target(), composed ? damage : nothing, frame.index);
+            }
+            if (composed) {
+                timing.composed = _clock.now().count();
+                _composed_index = frame.index;
+                if (!_composed) {
+                    _composed = true;
+                    startup_trace::record("compose first frame", start, startup_trace::clock::now());
+                }
+            }
+            // Decode times and queue depths depend on the machine, and would show on the HUD
+            auto &decoder = _video->get_decoder();
+            if (decoder != nullptr && !_deterministic) {
+                auto stats = decoder->get_statistics();
+                timing.decode_ms = static_cast<float>(stats.last_decode_ms);
+                timing.decode_queue = static_cast<uint16_t>(stats.queue_depth);
+            }
+        }
+
+        _timeline.record_frame(timing);
+        event_trace::counter("command queue", timing.command_queue);
+        event_trace::counter("decode queue", timing.decode_queue);
+        if (frame.skipped > 0) {
+            event_trace::instant("skipped intervals", static_cast<int64_t>(frame.skipped));
+        }
+        return composed;
+    }
+
+    auto canvas_pipeline::set_program_monitor(std::shared_ptr<preview_feed> monitor) -> void
+    {
+        std::atomic_store(&_program_monitor, std::move(monitor));
+    }
+
+    auto canvas_pipeline::set_network_output(std::shared_ptr<network_output> output) -> void
+    {
+        std::atomic_store(&_network_output, std::move(output));
+    }
+
+    auto canvas_pipeline::set_preview_monitor(std::shared_ptr<preview_feed> monitor) -> void
+    {
+        auto watched = monitor != nullptr;
+        std::atomic_store(&_preview_monitor, std::move(monitor));
+        if (!watched) {
+            stop_bus();
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_bus_lock);
+            _bus_changed = true;
+            if (!_bus_running) {
+                _bus_running = true;
+                _bus_thread = std::thread([this] { run_bus(); });
+            }
+        }
+        _bus_wake.notify_all();
+    }
+
+    auto canvas_pipeline::stop_bus() -> void
+    {
+        {
+            std::lock_guard<std::mutex> lock(_bus_lock);
+            _bus_running = false;
+        }
+        _bus_wake.notify_all();
+        if (_bus_thread.joinable()) {
+            _bus_thread.join();
+        }
+    }
+
+    auto canvas_pipeline::request_bus(const bus_request &request) -> void
+    {
+        {
+            std::lock_guard<std::mutex> lock(_bus_lock);
+            _bus_request = request;
+            _bus_changed = true;
+        }
+        _bus_wake.notify_all();
+    }
+
+    auto canvas_pipeline::run_bus() -> void
+    {
+        event_trace::set_thread_name("preview bus");
+        uint64_t index = 0;
+        int64_t shown = -1;
+        std::unique_lock<std::mutex> lock(_bus_lock);
+        while (_bus_running) {
+            auto request = _bus_request;
+            _bus_changed = false;
+            lock.unlock();
+            {
+                event_trace::scope trace("compose preview bus");
+                compose_bus(request, request.slide != shown, index++);
+                shown = request.slide;
+            }
+            lock.lock();
+            _bus_wake.wait_for(lock, bus_refresh, [this] { return _bus_changed || !_bus_running; });
+        }
+    }
+
+    auto canvas_pipeline::compose_bus(const bus_request &request, bool restaged, uint64_t index) -> void
+    {
+        auto monitor = std::atomic_load(&_preview_monitor);
+        if (monitor == nullptr || request.width <= 0 || request.height <= 0) return;
+
+        if (_bus.width() != request.width || _bus.height() != request.height) {
+            _bus.resize(request.width, request.height);
+        }
+        if (request.slide < 0) {
+            _bus_slide->set_slide(nullptr);
+            _bus_video->set_still(frame_ref());
+        }
+        else {
+            auto slide = static_cast<size_t>(request.slide);
+            // At the program's size this is the entry the cache warmed for the program, and the one it shows after the take
+            _bus_slide->set_slide(has_text(request.slide) ? _slides->get(slide, request.width, request.height) : nullptr);
+
+            frame_ref still;
+            auto ready = false;
+            {
+                // Only held to look; the program composes with it held, so the bus waits for the program and never the other way
+                std::lock_guard<std::mutex> lock(_lock);
+                std::shared_ptr<media_decoder> decoder;
+                if (_cues != nullptr && _cues->try_peek(slide, decoder)) {
+                    ready = true;
+                    // A slide without media keeps showing the program's, as it will once taken
+                    still = decoder != nullptr ? decoder->get_queue().peek() : _video->get_frame();
+                }
+            }
+            if (ready) {
+                _bus_video->set_still(std::move(still));
+            }
+            else if (restaged) {
+                // Black until the cue has its first frame, rather than the previous cue's
+                _bus_video->set_still(frame_ref());
+            }
+        }
+
+        damage_region damage;
+        if (_bus.compose(damage) || monitor->is_empty()) {
+            monitor->publish(_bus.target(), index);
+        }
+    }
+
+    auto canvas_pipeline::read_target(const std::function<void(const surface &target)> &copy) -> int64_t
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        copy(_compositor.target());
+        return _composed ? static_cast<int64_t>(_composed_index) : -1;
+    }
+
+    auto canvas_pipeline::wait_for_media(const frame_info &frame) -> void
+    {
+        auto start = std::chrono::steady_clock::now();
+        while (_pending_cue >= 0) {
+            try_fire_pending_cue();
+            if (_pending_cue >= 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+        _video->wait_for_frames(frame.deadline);
+        _last_wait = std::chrono::steady_clock::now() - start;
+    }
+
+    auto canvas_pipeline::apply(const canvas_command &command) -> void
+    {
+        event_trace::instant("canvas command", static_cast<int64_t>(command.type));
+        switch (command.type) {
+        case canvas_command_type::go_to_slide:
+            _current_slide = command.value;
+            show_slide();
+            _pending_cue = command.value;
+            _pending_cue_issued = command.issued;
+            break;
+        case canvas_command_type::play:
+            _video->set_playing(command.value != 0);
+            break;
+        case canvas_command_type::stage:
+            _staged_slide = std::max<int64_t>(command.value, -1);
+            if (_cues != nullptr) {
+                // Pre-roll the staged cue even if it isn't next to the current one
+                _cues->set_staged(_staged_slide >= 0 ? static_cast<size_t>(_staged_slide) : cue_list::npos);
+            }
+            request_bus(bus_request{ _staged_slide, _compositor.width(), _compositor.height() });
+            break;
+        case canvas_command_type::take:
+            take(command);
+            break;
+        case canvas_command_type::blank:
+            _is_blanked = command.value != 0;
+            _blank->set_visible(_is_blanked);
+            break;
+        case canvas_command_type::set_layer:
+            if (command.layer == canvas_layer_id::overlay) {
+                _overlay->set_visible(command.value != 0);
+            }
+            else if (command.layer == canvas_layer_id::media) {
+                _video->set_visible(command.value != 0);
+            }
+            else if (command.layer == canvas_layer_id::hud) {
+                _hud_graph->set_visible(command.value != 0);
+                _hud_text->set_visible(command.value != 0);
+                // Show current numbers straight away rather than the ones from when it was last hidden
+                _hud_updated = std::chrono::nanoseconds(0);
+            }
+            break;
+        default:
+            break;
+        }
+        if (_on_command) {
+            _on_command(command);
+        }
+    }
+
+    auto canvas_pipeline::take(const canvas_command &command) -> void
+    {
+        if (_staged_slide < 0) return;
+
+        // The program as it is now fades out over the staged slide
+        _dissolve->start(_compositor.target(), std::chrono::milliseconds(command.value));
+        _current_slide = _staged_slide;
+        show_slide();
+        _pending_cue = _staged_slide;
+        _pending_cue_issued = command.issued;
+    }
+
+    auto canvas_pipeline::update_hud(const frame_info &frame) -> void
+    {
+        if (_hud_updated.count() != 0 && frame.deadline - _hud_updated < hud_refresh) return;
+        _hud_updated = frame.deadline;
+
+        std::vector<frame_timing> frames;
+        _timeline.get_frames(frames, static_cast<size_t>(hud_width / frame_graph_layer::bar_width));
+        _hud_graph->set_frames(frames, frame.interval);
+
+        auto summary = _timeline.summarize(_clock.now());
+        wchar_t text[512];
+        std::swprintf(text, sizeof(text) / sizeof(text[0]), L"%.1f fps, render %.2f ms (worst %.2f) of %.2f ms\ndecode %.2f ms, %zu queued\npresent %.2f ms after compose\nskipped %llu (%llu in all), %zu commands waiting",
+            summary.presents_per_second, summary.average_render_ms, summary.worst_render_ms, frame.interval.count() / 1e6,
+            summary.decode_ms, summary.decode_queue, summary.average_present_ms,
+            static_cast<unsigned long long>(summary.skipped), static_cast<unsigned long long>(summary.total_skipped), summary.command_queue);
+        _hud_text->set_text(text);
+    }
+
+    auto canvas_pipeline::place_hud() -> void
+    {
+        auto width = std::min(hud_width, _compositor.width() - 2 * hud_margin);
+        pixel_rect box{ hud_margin, hud_margin, hud_margin + width, hud_margin + hud_graph_height + hud_text_height };
+        _hud_graph->set_box(box, hud_graph_height);
+        _hud_text->set_box(pixel_rect{ box.left + 8, box.top + hud_graph_height + 8, box.right - 8, box.bottom - 4 });
+    }
+
+    auto canvas_pipeline::show_slide() -> void
+    {
+        auto width = _compositor.width();
+        auto height = _compositor.height();
+        // A slide past the last text only shows its cue
+        if (!has_text(_current_slide) || width <= 0 || height <= 0) {
+            _slide->set_slide(nullptr);
+            return;
+        }
+
+        auto index = static_cast<size_t>(_current_slide);
+        // A slide that wasn't warmed is rendered here, as it would have been without the cache
+        _slide->set_slide(_slides->get(index, width, height));
+        _slides->set_current(index, width, height);
+    }
+
+    auto canvas_pipeline::has_text(int64_t slide) const -> bool
+    {
+        return slide >= 0 && static_cast<size_t>(slide) < std::atomic_load(&_slide_texts)->size();
+    }
+
+    auto canvas_pipeline::render_slide(size_t slide, surface &target) -> void
+    {
+        // Calls are serialized by the cache, so the text layer and engine are only ever used by one thread
+        auto texts = std::atomic_load(&_slide_texts);
+        _text->resize(target.width(), target.height());
+        _text->set_text(slide < texts->size() ? (*texts)[slide] : std::wstring());
+        _text->prepare(nullptr);
+        _text->render(target, target.bounds());
+        // Nothing composes the text layer, so its damage is never needed
+        damage_region unused;
+        _text->collect_damage(unused);
+    }
+
+    auto canvas_pipeline::try_fire_pending_cue() -> void
+    {
+        std::shared_ptr<media_decoder> decoder;
+        if (_cues == nullptr) {
+            _pending_cue = -1;
+            return;
+        }
+        if (!_cues->try_take(static_cast<size_t>(_pending_cue), decoder)) return;
+
+        if (decoder != nullptr) {
+            event_trace::instant("fire cue", _pending_cue);
+            _cues->retire(_video->get_decoder());
+            _video->set_decoder(std::move(decoder), _pending_cue_issued);
+            _video->set_playing(true);
+            if (_on_cue) {
+                _on_cue(_cues->get_url(static_cast<size_t>(_pending_cue)));
+            }
+        }
+        // A slide without media keeps showing the previous one
+        _pending_cue = -1;
+    }
+
+    auto canvas_pipeline::post(const canvas_command &command) -> bool
+    {
+        auto stamped = command;
+        stamped.issued = _clock.now();
+        return _commands.try_push(stamped);
+    }
+
+    auto canvas_pipeline::set_cues(const std::vector<std::wstring> &urls) -> void
+    {
+        // release_media drops the list; the render thread only looks at it with _lock held
+        if (_cues == nullptr) {
+            std::lock_guard<std::mutex> lock(_lock);
+            _cues.reset(new cue_list(_opener));
+        }
+        _cues->set_cues(urls);
+    }
+
+    auto canvas_pipeline::set_slide_texts(const std::vector<std::wstring> &texts) -> void
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        std::atomic_store(&_slide_texts, std::shared_ptr<const std::vector<std::wstring>>(std::make_shared<std::vector<std::wstring>>(texts)));
+        _slides->invalidate();
+        _slides->set_slide_count(texts.size());
+        show_slide();
+    }
+
+    auto canvas_pipeline::release_media() -> void
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        _video->set_decoder(nullptr);
+        _cues.reset();
+        _pending_cue = -1;
+    }
+
+    auto canvas_pipeline::get_tile_timings() -> std::vector<tile_timing>
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        return _compositor.get_tile_timings();
+    }
+
+    auto canvas_pipeline::get_slide_cache_statistics() -> slide_cache_statistics
+    {
+        return _slides->get_statistics();
+    }
+
+    auto canvas_pipeline::get_cue_latency() -> std::chrono::nanoseconds
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        return _video->get_cue_latency();
+    }
+}
\ No newline at end of file
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "compositor.h"
+#include "basic_layers.h"
+#include "frame_clock.h"
+#include "presentation_scheduler.h"
+#include "canvas_command.h"
+#include "video_layer.h"
+#include "cue_list.h"
+#include "text_layer.h"
+#include "slide_cache.h"
+#include "slide_layer.h"
+#include "frame_timeline.h"
+#include "frame_graph_layer.h"
+#include "preview_feed.h"
+#include "dissolve_layer.h"
+#include "network_output.h"
+
+namespace xerxes
+{
+    // Everything the canvas shows, without a window: the layers, the commands from the control window, the cues and the slides.
+    // The owner calls render_frame once per refresh on its render thread and copies the composed canvas wherever it goes,
+    // whether that's a window, a file or an offscreen buffer that is compared with golden frames.
+    // What the canvas shows is the program. A second bus, the preview, shows the staged slide until it is taken to the program;
+    // it is only composed while something watches it, on its own thread and below the program on the thread pool.
+    class canvas_pipeline {
+    public:
+        // Called on the render thread with every command as it is applied, e.g. to keep the audio in step
+        using command_callback = std::function<void(const canvas_command &command)>;
+        // Called on the render thread when a cue's media replaces what the video layer showed
+        using cue_callback = std::function<void(const std::wstring &url)>;
+    private:
+        frame_clock &_clock;
+        // Guards the compositor between the render thread, which composes, and whoever presents and resizes
+        std::mutex _lock;
+        compositor _compositor;
+        std::shared_ptr<video_layer> _video;
+        // Only used by the slide cache's renderer
+        std::shared_ptr<text_engine> _text_engine;
+        std::shared_ptr<text_layer> _text;
+        // The text of every slide. Replaced as a whole with atomic_store, as the slide cache reads it on its worker.
+        std::shared_ptr<const std::vector<std::wstring>> _slide_texts;
+        std::unique_ptr<slide_cache> _slides;
+        std::shared_ptr<slide_layer> _slide;
+        std::shared_ptr<line_overlay_layer> _overlay;
+        // The program as it was before a take, fading out
+        std::shared_ptr<dissolve_layer> _dissolve;
+        std::shared_ptr<solid_layer> _blank;
+        // The frame timing HUD, hidden unless toggled. Its text has its own engine, as _text_engine belongs to the slide cache.
+        std::shared_ptr<frame_graph_layer> _hud_graph;
+        std::shared_ptr<text_engine> _hud_text_engine;
+        std::shared_ptr<text_layer> _hud_text;
+        std::chrono::nanoseconds _hud_updated{ 0 };
+        frame_timeline _timeline;
+        canvas_command_queue _commands;
+        cue_list::media_opener _opener;
+        std::unique_ptr<cue_list> _cues;
+        command_callback _on_command;
+        cue_callback _on_cue;
+        bool _is_blanked = false;
+        int64_t _current_slide = 0;
+        // The cue asked for that wasn't pre-rolled yet, or -1
+        int64_t _pending_cue = -1;
+        std::chrono::nanoseconds _pending_cue_issued{ 0 };
+        // The slide on the preview bus, or -1
+        int64_t _staged_slide = -1;
+        // Guarded by _lock
+        bool _composed = false;
+        uint64_t _composed_index = 0;
+        // Wait for cues and video frames instead of showing whatever is ready, so a run renders the same frames every time
+        bool _deterministic = false;
+        std::chrono::nanoseconds _last_wait{ 0 };
+        // Where the control window's copy of the canvas goes, if it shows one. Replaced with atomic_store.
+        std::shared_ptr<preview_feed> _program_monitor;
+        // Where the program is streamed to other processes, if anywhere. Replaced with atomic_store.
+        std::shared_ptr<network_output> _network_output;
+
+        // The preview bus. Its compositor and layers are only touched by its thread; the slides come from the same cache as
+        // the program's and the video is a reference to a frame the cue has already decoded, so nothing is rendered twice.
+        struct bus_request {
+            int64_t slide;
+            int width;
+            int height;
+        };
+        compositor _bus;
+        std::shared_ptr<video_layer> _bus_video;
+        std::shared_ptr<slide_layer> _bus_slide;
+        std::shared_ptr<preview_feed> _preview_monitor;
+        // Guards the request and wakes the bus thread
+        std::mutex _bus_lock;
+        std::condition_variable _bus_wake;
+        bus_request _bus_request{ -1, 0, 0 };
+        bool _bus_changed = false;
+        bool _bus_running = false;
+        std::thread _bus_thread;
+
+        // With _lock held
+        auto apply(const canvas_command &command) -> void;
+        auto try_fire_pending_cue() -> void;
+        // Show the current slide from the cache and warm its neighbours
+        auto show_slide() -> void;
+        // Whether a slide has text to render; the slides after the last text only show their cues
+        auto has_text(int64_t slide) const -> bool;
+        auto render_slide(size_t slide, surface &target) -> void;
+        auto update_hud(const frame_info &frame) -> void;
+        auto place_hud() -> void;
+        auto wait_for_media(const frame_info &frame) -> void;
+        auto take(const canvas_command &command) -> void;
+        auto request_bus(const bus_request &request) -> void;
+
+        // The preview bus thread
+        auto run_bus() -> void;
+        // restaged: the slide changed since the last call
+        auto compose_bus(const bus_request &request, bool restaged, uint64_t index) -> void;
+        auto stop_bus() -> void;
+    public:
+        // Glyphs come from rasterizer, cue media from opener. pool, if not nullptr, renders the tiles and must outlive the pipeline.
+        canvas_pipeline(frame_clock &clock, std::shared_ptr<glyph_rasterizer> rasterizer, cue_list::media_opener opener, thread_pool *pool = nullptr);
+        canvas_pipeline(const canvas_pipeline &) = delete;
+        auto operator=(const canvas_pipeline &)->canvas_pipeline& = delete;
+        ~canvas_pipeline();
+
+        // Set before rendering starts
+        inline auto set_on_command(command_callback callback) -> void { _on_command = std::move(callback); }
+        inline auto set_on_cue(cue_callback callback) -> void { _on_cue = std::move(callback); }
+        inline auto set_deterministic(bool deterministic) -> void { _deterministic = deterministic; }
+
+        auto resize(int width, int height) -> void;
+
+        // Apply the commands that arrived, advance the layers to the frame's deadline and compose what they damaged into damage.
+        // Returns false if nothing changed. Call once per frame from one thread.
+        auto render_frame(const frame_info &frame, damage_region &damage) -> bool;
+
+        // Call copy with the composed canvas while no frame is being composed. Returns the index of the frame the canvas
+        // holds, or -1 if nothing was composed yet.
+        auto read_target(const std::function<void(const surface &target)> &copy) -> int64_t;
+
+        // Publish every composed frame to monitor from the render thread, or stop with nullptr. The feed never makes
+        // the render thread wait, however slowly it is read.
+        auto set_program_monitor(std::shared_ptr<preview_feed> monitor) -> void;
+        // Stream the program to output from the render thread, or stop with nullptr
+        auto set_network_output(std::shared_ptr<network_output> output) -> void;
+        // Compose the preview bus into monitor, or stop composing it with nullptr
+        auto set_preview_monitor(std::shared_ptr<preview_feed> monitor) -> void;
+
+        // Queue a command for the next frame. Never blocks; returns false if the canvas has fallen too far behind to accept it.
+        auto post(const canvas_command &command) -> bool;
+
+        // Replace the media cue list; slide n fires cue n. The cues after the current one are pre-rolled in the background.
+        auto set_cues(const std::vector<std::wstring> &urls) -> void;
+        // Replace the text of the slides; slide n shows texts[n]
+        auto set_slide_texts(const std::vector<std::wstring> &texts) -> void;
+        // Stop all decoding
+        auto release_media() -> void;
+
+        inline auto get_timeline() -> frame_timeline& { return _timeline; }
+        // How long the last frame waited for media in deterministic mode; not part of its render time
+        inline auto get_last_wait() const noexcept -> std::chrono::nanoseconds { return _last_wait; }
+        // How the tiles of the last composed frame were rendered
+        auto get_tile_timings() -> std::vector<tile_timing>;
+        auto get_slide_cache_statistics() -> slide_cache_statistics;
+        // Time from posting the last cue to presenting its first frame
+        auto get_cue_latency() -> std::chrono::nanoseconds;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,166 @@
+#include "stdafx.h"
+#include "color_benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <sstream>
+
+namespace xerxes
+{
+    namespace
+    {
+        const yuv_format formats[] = { yuv_format::nv12, yuv_format::i420, yuv_format::yuy2 };
+
+        // Random planes of one format, with strides wider than the rows like a decoder's
+        struct random_picture {
+            std::vector<uint8_t> planes[3];
+            yuv_image image;
+
+            random_picture(yuv_format format, int width, int height, std::mt19937 &random)
+            {
+                image = yuv_image{ format, width, height, { nullptr, nullptr, nullptr }, { 0, 0, 0 } };
+                auto chroma_width = (width + 1) / 2, chroma_height = (height + 1) / 2;
+                switch (format) {
+                case yuv_format::nv12:
+                    make_plane(0, width + 16, height, random);
+                    make_plane(1, chroma_width * 2 + 16, chroma_height, random);
+                    break;
+                case yuv_format::i420:
+                    make_plane(0, width + 16, height, random);
+                    make_plane(1, chroma_width + 16, chroma_height, random);
+                    make_plane(2, chroma_width + 16, chroma_height, random);
+                    break;
+                default:
+                    make_plane(0, chroma_width * 4 + 16, height, random);
+                    break;
+                }
+            }
+
+            auto make_plane(int index, int stride, int rows, std::mt19937 &random) -> void
+            {
+                planes[index].resize(static_cast<size_t>(stride) * rows);
+                for (auto &b : planes[index]) {
+                    b = static_cast<uint8_t>(random());
+                }
+                image.planes[index] = planes[index].data();
+                image.strides[index] = stride;
+            }
+        };
+
+        auto same_pixels(const surface &a, const surface &b) -> bool
+        {
+            if (a.width() != b.width() || a.height() != b.height()) return false;
+            for (int y = 0; y < a.height(); y++) {
+                if (std::memcmp(a.row(y), b.row(y), static_cast<size_t>(a.width()) * 4) != 0) return false;
+            }
+            return true;
+        }
+
+        auto format_name(yuv_format format) -> const char*
+        {
+            switch (format) {
+            case yuv_format::nv12: return "nv12";
+            case yuv_format::i420: return "i420";
+            default: return "yuy2";
+            }
+        }
+
+        auto level_name(simd_level level) -> const char*
+        {
+            switch (level) {
+            case simd_level::scalar: return "scalar";
+            case simd_level::sse2: return "sse2";
+            default: return "avx2";
+            }
+        }
+
+        template<typename _Convert> auto time_per_megapixel(int repeats, int width, int height, const _Convert &convert) -> double
+        {
+            auto start = std::chrono::steady_clock::now();
+            for (auto r = 0; r < repeats; r++) {
+                convert();
+            }
+            auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            return ms / std::max(1, repeats) / (static_cast<double>(width) * height / 1e6);
+        }
+    }
+
+    auto color_benchmark_result::passed() const -> bool
+    {
+        for (auto &r : runs) {
+            if (!r.identical) return false;
+        }
+        return true;
+    }
+
+    auto color_benchmark_result::format() const -> std::string
+    {
+        std::ostringstream out;
+        char line[256];
+        auto scalar_convert = 0.0, scalar_scaled = 0.0;
+        for (auto &r : runs) {
+            if (r.level == simd_level::scalar) {
+                scalar_convert = r.convert_ms_per_megapixel;
+                scalar_scaled = r.scaled_ms_per_megapixel;
+            }
+            std::snprintf(line, sizeof(line), "%s %-6s  convert %6.3f ms/MP (%4.1fx), scaled %6.3f ms/MP (%4.1fx), converted then scaled %6.3f ms/MP%s\n",
+                format_name(r.format), level_name(r.level),
+                r.convert_ms_per_megapixel, r.convert_ms_per_megapixel > 0.0 ? scalar_convert / r.convert_ms_per_megapixel : 0.0,
+                r.scaled_ms_per_megapixel, r.scaled_ms_per_megapixel > 0.0 ? scalar_scaled / r.scaled_ms_per_megapixel : 0.0, r.two_pass_ms_per_megapixel,
+                r.identical ? "" : "  DIFFERENT FROM SCALAR");
+            out << line;
+        }
+        return out.str();
+    }
+
+    auto color_benchmark::run(const color_benchmark_options &options) -> color_benchmark_result
+    {
+        color_benchmark_result result;
+        std::mt19937 random(options.seed);
+        auto selected = color_converter::get_level();
+        auto supported = static_cast<int>(color_converter::get_supported_level());
+
+        for (auto format : formats) {
+            random_picture picture(format, options.width, options.height, random);
+            // Odd in both directions, and not a multiple of any vector width
+            random_picture odd(format, 37, 23, random);
+
+            surface expected, expected_scaled(options.scaled_width, options.scaled_height), expected_odd;
+            for (auto level = 0; level <= supported; level++) {
+                color_converter::set_level(static_cast<simd_level>(level));
+                color_benchmark_run run{ format, static_cast<simd_level>(level), 0.0, 0.0, 0.0, true };
+
+                surface converted, scaled(options.scaled_width, options.scaled_height), converted_odd;
+                run.convert_ms_per_megapixel = time_per_megapixel(options.repeats, options.width, options.height, [&]() {
+                    color_converter::convert(picture.image, converted, yuv_matrix::bt709, yuv_range::limited);
+                });
+                run.scaled_ms_per_megapixel = time_per_megapixel(options.repeats, options.width, options.height, [&]() {
+                    color_converter::convert_scaled(picture.image, scaled, scale_filter::bicubic, yuv_matrix::bt709, yuv_range::limited);
+                });
+                run.two_pass_ms_per_megapixel = time_per_megapixel(options.repeats, options.width, options.height, [&]() {
+                    color_converter::convert(picture.image, converted, yuv_matrix::bt709, yuv_range::limited);
+                    image_scaler::scale(converted, scaled, scale_filter::bicubic);
+                });
+                color_converter::convert(picture.image, converted, yuv_matrix::bt709, yuv_range::limited);
+                color_converter::convert_scaled(picture.image, scaled, scale_filter::bicubic, yuv_matrix::bt709, yuv_range::limited);
+                color_converter::convert(odd.image, converted_odd, yuv_matrix::bt601, yuv_range::full);
+
+                if (level == 0) {
+                    expected.swap(converted);
+                    expected_scaled.swap(scaled);
+                    expected_odd.swap(converted_odd);
+                }
+                else {
+                    run.identical = same_pixels(converted, expected) && same_pixels(scaled, expected_scaled) && same_pixels(converted_odd, expected_odd);
+                }
+                result.runs.push_back(run);
+            }
+        }
+
+        color_converter::set_level(selected);
+        return result;
+    }
+}
\ No newline at end of file
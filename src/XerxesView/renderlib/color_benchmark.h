@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "color_converter.h"
+
+namespace xerxes
+{
+    struct color_benchmark_options {
+        int width = 1920;
+        int height = 1080;
+        // convert_scaled is timed into this size
+        int scaled_width = 1280;
+        int scaled_height = 720;
+        // Every conversion is repeated this often and the times averaged
+        int repeats = 20;
+        uint32_t seed = 1;
+    };
+
+    struct color_benchmark_run {
+        yuv_format format;
+        simd_level level;
+        double convert_ms_per_megapixel;
+        // Per megapixel of the source, in one pass and converting the whole picture before scaling it
+        double scaled_ms_per_megapixel;
+        double two_pass_ms_per_megapixel;
+        // Converted the same pixels as the scalar kernel, also at an odd size that leaves a tail after the vectors
+        bool identical;
+    };
+
+    struct color_benchmark_result {
+        std::vector<color_benchmark_run> runs;
+
+        auto passed() const -> bool;
+        // One line per format and level, with its speedup over the scalar kernel
+        auto format() const -> std::string;
+    };
+
+    // How quickly color_converter turns random YUV planes into BGRA, for each format and each level the CPU supports, and
+    // whether every level converts exactly the same pixels as the scalar kernel.
+    class color_benchmark {
+    public:
+        color_benchmark() = delete;
+
+        static auto run(const color_benchmark_options &options) -> color_benchmark_result;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,302 @@
+#include "stdafx.h"
+#include "color_converter.h"
+#include "color_kernels.h"
+#include "simd.h"
+
+#include <atomic>
+#include <cmath>
+#include <vector>
+
+#if XERXES_AVX2 && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace xerxes
+{
+    namespace details
+    {
+        auto nv12_row_scalar(const uint8_t *y, const uint8_t *uv, const uint8_t *, uint32_t *dst, int width, const yuv_coefficients &c) -> void
+        {
+            for (int x = 0; x < width; x++) {
+                auto chroma = uv + (x >> 1) * 2;
+                dst[x] = yuv_to_bgra(y[x], chroma[0], chroma[1], c);
+            }
+        }
+
+        auto i420_row_scalar(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint32_t *dst, int width, const yuv_coefficients &c) -> void
+        {
+            for (int x = 0; x < width; x++) {
+                dst[x] = yuv_to_bgra(y[x], u[x >> 1], v[x >> 1], c);
+            }
+        }
+
+        auto yuy2_row_scalar(const uint8_t *p, const uint8_t *, const uint8_t *, uint32_t *dst, int width, const yuv_coefficients &c) -> void
+        {
+            for (int x = 0; x < width; x++) {
+                auto pair = p + (x >> 1) * 4;
+                dst[x] = yuv_to_bgra(p[x * 2], pair[1], pair[3], c);
+            }
+        }
+
+#if XERXES_SSE2
+        namespace
+        {
+            struct sse2_coefficients {
+                __m128i y_offset;
+                __m128i y;
+                __m128i vr;
+                __m128i ug;
+                __m128i vg;
+                __m128i ub;
+                __m128i chroma_offset;
+                __m128i round;
+                __m128i alpha;
+
+                explicit sse2_coefficients(const yuv_coefficients &c)
+                    : y_offset(_mm_set1_epi16(c.y_offset)), y(_mm_set1_epi16(c.y)), vr(_mm_set1_epi16(c.vr)), ug(_mm_set1_epi16(c.ug)),
+                      vg(_mm_set1_epi16(c.vg)), ub(_mm_set1_epi16(c.ub)), chroma_offset(_mm_set1_epi16(128)), round(_mm_set1_epi16(4)),
+                      alpha(_mm_set1_epi8(static_cast<char>(0xff)))
+                {
+                }
+            };
+
+            inline auto channel(__m128i yt, __m128i chroma, const sse2_coefficients &k) -> __m128i
+            {
+                return _mm_srai_epi16(_mm_adds_epi16(_mm_adds_epi16(yt, chroma), k.round), 3);
+            }
+
+            // 16 pixels: luma as two vectors of 8 words, and the 8 chroma samples they share as words
+            inline auto convert16(__m128i ylo, __m128i yhi, __m128i u, __m128i v, const sse2_coefficients &k, uint32_t *dst) -> void
+            {
+                u = _mm_slli_epi16(_mm_sub_epi16(u, k.chroma_offset), 6);
+                v = _mm_slli_epi16(_mm_sub_epi16(v, k.chroma_offset), 6);
+                auto rv = _mm_mulhi_epi16(v, k.vr);
+                auto gc = _mm_sub_epi16(_mm_setzero_si128(), _mm_add_epi16(_mm_mulhi_epi16(u, k.ug), _mm_mulhi_epi16(v, k.vg)));
+                auto bu = _mm_mulhi_epi16(u, k.ub);
+
+                auto ytlo = _mm_mulhi_epi16(_mm_slli_epi16(_mm_sub_epi16(ylo, k.y_offset), 6), k.y);
+                auto ythi = _mm_mulhi_epi16(_mm_slli_epi16(_mm_sub_epi16(yhi, k.y_offset), 6), k.y);
+
+                // Each chroma term is shared by two neighbouring pixels
+                auto r = _mm_packus_epi16(channel(ytlo, _mm_unpacklo_epi16(rv, rv), k), channel(ythi, _mm_unpackhi_epi16(rv, rv), k));
+                auto g = _mm_packus_epi16(channel(ytlo, _mm_unpacklo_epi16(gc, gc), k), channel(ythi, _mm_unpackhi_epi16(gc, gc), k));
+                auto b = _mm_packus_epi16(channel(ytlo, _mm_unpacklo_epi16(bu, bu), k), channel(ythi, _mm_unpackhi_epi16(bu, bu), k));
+
+                auto bglo = _mm_unpacklo_epi8(b, g);
+                auto bghi = _mm_unpackhi_epi8(b, g);
+                auto ralo = _mm_unpacklo_epi8(r, k.alpha);
+                auto rahi = _mm_unpackhi_epi8(r, k.alpha);
+                auto out = reinterpret_cast<__m128i*>(dst);
+                _mm_storeu_si128(out, _mm_unpacklo_epi16(bglo, ralo));
+                _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(bglo, ralo));
+                _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(bghi, rahi));
+                _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(bghi, rahi));
+            }
+        }
+
+        auto nv12_row_sse2(const uint8_t *y, const uint8_t *uv, const uint8_t *, uint32_t *dst, int width, const yuv_coefficients &c) -> void
+        {
+            sse2_coefficients k(c);
+            auto zero = _mm_setzero_si128();
+            auto low_bytes = _mm_set1_epi16(0x00ff);
+            int x = 0;
+            for (; x + 16 <= width; x += 16) {
+                auto luma = _mm_loadu_si128(reinterpret_cast<const __m128i*>(y + x));
+                auto chroma = _mm_loadu_si128(reinterpret_cast<const __m128i*>(uv + x));
+                convert16(_mm_unpacklo_epi8(luma, zero), _mm_unpackhi_epi8(luma, zero), _mm_and_si128(chroma, low_bytes), _mm_srli_epi16(chroma, 8), k, dst + x);
+            }
+            nv12_row_scalar(y + x, uv + x, nullptr, dst + x, width - x, c);
+        }
+
+        auto i420_row_sse2(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint32_t *dst, int width, const yuv_coefficients &c) -> void
+        {
+            sse2_coefficients k(c);
+            auto zero = _mm_setzero_si128();
+            int x = 0;
+            for (; x + 16 <= width; x += 16) {
+                auto luma = _mm_loadu_si128(reinterpret_cast<const __m128i*>(y + x));
+                auto cb = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(u + x / 2)), zero);
+                auto cr = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(v + x / 2)), zero);
+                convert16(_mm_unpacklo_epi8(luma, zero), _mm_unpackhi_epi8(luma, zero), cb, cr, k, dst + x);
+            }
+            i420_row_scalar(y + x, u + x / 2, v + x / 2, dst + x, width - x, c);
+        }
+
+        auto yuy2_row_sse2(const uint8_t *p, const uint8_t *, const uint8_t *, uint32_t *dst, int width, const yuv_coefficients &c) -> void
+        {
+            sse2_coefficients k(c);
+            auto low_bytes = _mm_set1_epi16(0x00ff);
+            auto low_words = _mm_set1_epi32(0x0000ffff);
+            int x = 0;
+            for (; x + 16 <= width; x += 16) {
+                auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + x * 2));
+                auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + x * 2 + 16));
+                // The odd bytes hold U V U V...; split them into a vector of U and one of V
+                auto ca = _mm_srli_epi16(a, 8);
+                auto cb = _mm_srli_epi16(b, 8);
+                auto cu = _mm_packs_epi32(_mm_and_si128(ca, low_words), _mm_and_si128(cb, low_words));
+                auto cv = _mm_packs_epi32(_mm_srli_epi32(ca, 16), _mm_srli_epi32(cb, 16));
+                convert16(_mm_and_si128(a, low_bytes), _mm_and_si128(b, low_bytes), cu, cv, k, dst + x);
+            }
+            yuy2_row_scalar(p + x * 2, nullptr, nullptr, dst + x, width - x, c);
+        }
+#endif
+    }
+
+    namespace
+    {
+        auto detect_level() -> simd_level
+        {
+#if XERXES_AVX2 && defined(_MSC_VER)
+            int info[4];
+            __cpuid(info, 0);
+            if (info[0] >= 7) {
+                __cpuid(info, 1);
+                // The OS has to save the YMM registers too
+                auto os_avx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+                __cpuidex(info, 7, 0);
+                if (os_avx && (info[1] & (1 << 5)) != 0) return simd_level::avx2;
+            }
+#elif XERXES_AVX2 && defined(__GNUC__)
+            if (__builtin_cpu_supports("avx2")) return simd_level::avx2;
+#endif
+            return XERXES_SSE2 ? simd_level::sse2 : simd_level::scalar;
+        }
+
+        std::atomic<int> selected_level(-1);
+
+        auto make_coefficients(yuv_matrix matrix, yuv_range range) -> details::yuv_coefficients
+        {
+            double kr = matrix == yuv_matrix::bt709 ? 0.2126 : 0.299;
+            double kb = matrix == yuv_matrix::bt709 ? 0.0722 : 0.114;
+            double kg = 1.0 - kr - kb;
+            double y_scale = range == yuv_range::limited ? 255.0 / 219.0 : 1.0;
+            double c_scale = range == yuv_range::limited ? 255.0 / 224.0 : 1.0;
+
+            auto fixed = [](double v) { return static_cast<int16_t>(std::lround(v * 8192.0)); };
+            details::yuv_coefficients c;
+            c.y_offset = range == yuv_range::limited ? 16 : 0;
+            c.y = fixed(y_scale);
+            c.vr = fixed(2.0 * (1.0 - kr) * c_scale);
+            c.ug = fixed(2.0 * (1.0 - kb) * kb / kg * c_scale);
+            c.vg = fixed(2.0 * (1.0 - kr) * kr / kg * c_scale);
+            c.ub = fixed(2.0 * (1.0 - kb) * c_scale);
+            return c;
+        }
+
+        auto select_kernel(yuv_format format) -> details::yuv_row_kernel
+        {
+            auto level = color_converter::get_level();
+            switch (format) {
+            case yuv_format::nv12:
+#if XERXES_AVX2
+                if (level == simd_level::avx2) return details::nv12_row_avx2;
+#endif
+#if XERXES_SSE2
+                if (level != simd_level::scalar) return details::nv12_row_sse2;
+#endif
+                return details::nv12_row_scalar;
+            case yuv_format::i420:
+#if XERXES_AVX2
+                if (level == simd_level::avx2) return details::i420_row_avx2;
+#endif
+#if XERXES_SSE2
+                if (level != simd_level::scalar) return details::i420_row_sse2;
+#endif
+                return details::i420_row_scalar;
+            default:
+#if XERXES_AVX2
+                if (level == simd_level::avx2) return details::yuy2_row_avx2;
+#endif
+#if XERXES_SSE2
+                if (level != simd_level::scalar) return details::yuy2_row_sse2;
+#endif
+                return details::yuy2_row_scalar;
+            }
+        }
+
+        inline auto run_row(details::yuv_row_kernel kernel, const yuv_image &src, int y, uint32_t *dst, const details::yuv_coefficients &c) -> void
+        {
+            switch (src.format) {
+            case yuv_format::nv12:
+                kernel(src.planes[0] + y * src.strides[0], src.planes[1] + (y >> 1) * src.strides[1], nullptr, dst, src.width, c);
+                break;
+            case yuv_format::i420:
+                kernel(src.planes[0] + y * src.strides[0], src.planes[1] + (y >> 1) * src.strides[1], src.planes[2] + (y >> 1) * src.strides[2], dst, src.width, c);
+                break;
+            default:
+                kernel(src.planes[0] + y * src.strides[0], nullptr, nullptr, dst, src.width, c);
+                break;
+            }
+        }
+
+        // Source rows of the current filter window while converting and scaling
+        thread_local surface window_rows;
+        thread_local std::vector<int> window_row_ids;
+    }
+
+    auto color_converter::get_supported_level() -> simd_level
+    {
+        static const simd_level supported = detect_level();
+        return supported;
+    }
+
+    auto color_converter::get_level() -> simd_level
+    {
+        auto level = selected_level.load(std::memory_order_relaxed);
+        return level < 0 ? get_supported_level() : static_cast<simd_level>(level);
+    }
+
+    auto color_converter::set_level(simd_level level) -> void
+    {
+        if (static_cast<int>(level) > static_cast<int>(get_supported_level())) {
+            level = get_supported_level();
+        }
+        selected_level = static_cast<int>(level);
+    }
+
+    auto color_converter::convert_row(const yuv_image &src, int y, uint32_t *dst, yuv_matrix matrix, yuv_range range) -> void
+    {
+        run_row(select_kernel(src.format), src, y, dst, make_coefficients(matrix, range));
+    }
+
+    auto color_converter::convert(const yuv_image &src, surface &dst, yuv_matrix matrix, yuv_range range) -> void
+    {
+        dst.resize(src.width, src.height);
+        if (dst.empty()) return;
+
+        auto kernel = select_kernel(src.format);
+        auto c = make_coefficients(matrix, range);
+        for (int y = 0; y < src.height; y++) {
+            run_row(kernel, src, y, dst.row(y), c);
+        }
+    }
+
+    auto color_converter::convert_scaled(const yuv_image &src, surface &dst, scale_filter filter, yuv_matrix matrix, yuv_range range) -> void
+    {
+        if (dst.empty() || src.width <= 0 || src.height <= 0) return;
+        if (dst.width() == src.width && dst.height() == src.height) {
+            convert(src, dst, matrix, range);
+            return;
+        }
+
+        auto horizontal = image_scaler::get_filter_bank(src.width, dst.width(), filter);
+        auto vertical = image_scaler::get_filter_bank(src.height, dst.height(), filter);
+        auto kernel = select_kernel(src.format);
+        auto c = make_coefficients(matrix, range);
+
+        // A window's rows are all different modulo the number of taps, so a ring of that many rows holds a whole window
+        auto taps = vertical->taps();
+        window_rows.resize(src.width, taps);
+        window_row_ids.assign(static_cast<size_t>(taps), -1);
+        image_scaler::scale_rows([&](int y) -> const uint8_t* {
+            auto slot = y % taps;
+            auto row = window_rows.row(slot);
+            if (window_row_ids[slot] != y) {
+                run_row(kernel, src, y, row, c);
+                window_row_ids[slot] = y;
+            }
+            return reinterpret_cast<const uint8_t*>(row);
+        }, dst.data(), dst.stride(), *horizontal, *vertical, 0, dst.height());
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "surface.h"
+#include "image_scaler.h"
+
+namespace xerxes
+{
+    enum class yuv_format {
+        // Y plane, then one plane of interleaved U and V at half resolution
+        nv12,
+        // Y plane, then U and V planes at half resolution
+        i420,
+        // Packed Y0 U Y1 V, chroma at half horizontal resolution
+        yuy2
+    };
+
+    enum class yuv_matrix {
+        bt601,
+        bt709
+    };
+
+    enum class yuv_range {
+        // Y in 16-235, chroma in 16-240
+        limited,
+        full
+    };
+
+    enum class simd_level {
+        scalar,
+        sse2,
+        avx2
+    };
+
+    // A decoded picture in one of the YUV layouts. Unused planes are ignored; yuy2 only uses the first.
+    struct yuv_image {
+        yuv_format format;
+        int width;
+        int height;
+        const uint8_t *planes[3];
+        ptrdiff_t strides[3];
+    };
+
+    // Converts YUV pictures to opaque BGRA. The vectorized kernels are picked from what the CPU supports when first used; all
+    // levels produce exactly the same pixels. Chroma is taken from the nearest sample.
+    class color_converter {
+    public:
+        color_converter() = delete;
+
+        // dst is resized to the size of src
+        static auto convert(const yuv_image &src, surface &dst, yuv_matrix matrix, yuv_range range) -> void;
+
+        // Convert and scale to the size of dst in one pass. Source rows are converted once, as the scaler reaches them, into a
+        // few rows of scratch instead of a full intermediate image.
+        static auto convert_scaled(const yuv_image &src, surface &dst, scale_filter filter, yuv_matrix matrix, yuv_range range) -> void;
+
+        // Convert row y of src into width pixels at dst
+        static auto convert_row(const yuv_image &src, int y, uint32_t *dst, yuv_matrix matrix, yuv_range range) -> void;
+
+        static auto get_supported_level() -> simd_level;
+        static auto get_level() -> simd_level;
+        // Use at most level, e.g. to compare the kernels. Levels the CPU doesn't support are clamped.
+        static auto set_level(simd_level level) -> void;
+    };
+}
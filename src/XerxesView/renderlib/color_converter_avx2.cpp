@@ -0,0 +1,145 @@
+#include "stdafx.h"
+#include "color_kernels.h"
+#include "simd.h"
+
+// Built with /arch:AVX2; only called once the CPU is known to support it
+#if XERXES_AVX2
+#include <immintrin.h>
+
+namespace xerxes
+{
+    namespace details
+    {
+        namespace
+        {
+            struct avx2_coefficients {
+                __m256i y_offset;
+                __m256i y;
+                __m256i vr;
+                __m256i ug;
+                __m256i vg;
+                __m256i ub;
+                __m256i chroma_offset;
+                __m256i round;
+                __m256i alpha;
+            };
+
+            XERXES_TARGET_AVX2 inline auto load_coefficients(const yuv_coefficients &c) -> avx2_coefficients
+            {
+                avx2_coefficients k;
+                k.y_offset = _mm256_set1_epi16(c.y_offset);
+                k.y = _mm256_set1_epi16(c.y);
+                k.vr = _mm256_set1_epi16(c.vr);
+                k.ug = _mm256_set1_epi16(c.ug);
+                k.vg = _mm256_set1_epi16(c.vg);
+                k.ub = _mm256_set1_epi16(c.ub);
+                k.chroma_offset = _mm256_set1_epi16(128);
+                k.round = _mm256_set1_epi16(4);
+                k.alpha = _mm256_set1_epi8(static_cast<char>(0xff));
+                return k;
+            }
+
+            XERXES_TARGET_AVX2 inline auto channel(__m256i yt, __m256i chroma, const avx2_coefficients &k) -> __m256i
+            {
+                return _mm256_srai_epi16(_mm256_adds_epi16(_mm256_adds_epi16(yt, chroma), k.round), 3);
+            }
+
+            // The 16 chroma words in pixel order, each repeated for the two pixels sharing it: pixels 0-15 and 16-31.
+            // Unpacking works within 128-bit lanes, so the halves are put back in order afterwards.
+            XERXES_TARGET_AVX2 inline auto duplicate(__m256i chroma, __m256i &first, __m256i &second) -> void
+            {
+                auto lo = _mm256_unpacklo_epi16(chroma, chroma);
+                auto hi = _mm256_unpackhi_epi16(chroma, chroma);
+                first = _mm256_permute2x128_si256(lo, hi, 0x20);
+                second = _mm256_permute2x128_si256(lo, hi, 0x31);
+            }
+
+            // 32 pixels: luma as two vectors of 16 words in pixel order, and their 16 chroma samples as words
+            XERXES_TARGET_AVX2 inline auto convert32(__m256i ylo, __m256i yhi, __m256i u, __m256i v, const avx2_coefficients &k, uint32_t *dst) -> void
+            {
+                u = _mm256_slli_epi16(_mm256_sub_epi16(u, k.chroma_offset), 6);
+                v = _mm256_slli_epi16(_mm256_sub_epi16(v, k.chroma_offset), 6);
+                __m256i rv0, rv1, gc0, gc1, bu0, bu1;
+                duplicate(_mm256_mulhi_epi16(v, k.vr), rv0, rv1);
+                duplicate(_mm256_sub_epi16(_mm256_setzero_si256(), _mm256_add_epi16(_mm256_mulhi_epi16(u, k.ug), _mm256_mulhi_epi16(v, k.vg))), gc0, gc1);
+                duplicate(_mm256_mulhi_epi16(u, k.ub), bu0, bu1);
+
+                auto ytlo = _mm256_mulhi_epi16(_mm256_slli_epi16(_mm256_sub_epi16(ylo, k.y_offset), 6), k.y);
+                auto ythi = _mm256_mulhi_epi16(_mm256_slli_epi16(_mm256_sub_epi16(yhi, k.y_offset), 6), k.y);
+
+                // Packing interleaves the lanes: [0-7 16-23 | 8-15 24-31]
+                auto r = _mm256_packus_epi16(channel(ytlo, rv0, k), channel(ythi, rv1, k));
+                auto g = _mm256_packus_epi16(channel(ytlo, gc0, k), channel(ythi, gc1, k));
+                auto b = _mm256_packus_epi16(channel(ytlo, bu0, k), channel(ythi, bu1, k));
+
+                // [0-7 | 8-15] and [16-23 | 24-31]
+                auto bglo = _mm256_unpacklo_epi8(b, g);
+                auto bghi = _mm256_unpackhi_epi8(b, g);
+                auto ralo = _mm256_unpacklo_epi8(r, k.alpha);
+                auto rahi = _mm256_unpackhi_epi8(r, k.alpha);
+
+                // [0-3 | 8-11] and [4-7 | 12-15], and the same from 16
+                auto p0 = _mm256_unpacklo_epi16(bglo, ralo);
+                auto p1 = _mm256_unpackhi_epi16(bglo, ralo);
+                auto p2 = _mm256_unpacklo_epi16(bghi, rahi);
+                auto p3 = _mm256_unpackhi_epi16(bghi, rahi);
+                auto out = reinterpret_cast<__m256i*>(dst);
+                _mm256_storeu_si256(out, _mm256_permute2x128_si256(p0, p1, 0x20));
+                _mm256_storeu_si256(out + 1, _mm256_permute2x128_si256(p0, p1, 0x31));
+                _mm256_storeu_si256(out + 2, _mm256_permute2x128_si256(p2, p3, 0x20));
+                _mm256_storeu_si256(out + 3, _mm256_permute2x128_si256(p2, p3, 0x31));
+            }
+        }
+
+        XERXES_TARGET_AVX2 auto nv12_row_avx2(const uint8_t *y, const uint8_t *uv, const uint8_t *, uint32_t *dst, int width, const yuv_coefficients &c) -> void
+        {
+            auto k = load_coefficients(c);
+            auto low_bytes = _mm256_set1_epi16(0x00ff);
+            int x = 0;
+            for (; x + 32 <= width; x += 32) {
+                auto ylo = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(y + x)));
+                auto yhi = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(y + x + 16)));
+                auto chroma = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(uv + x));
+                convert32(ylo, yhi, _mm256_and_si256(chroma, low_bytes), _mm256_srli_epi16(chroma, 8), k, dst + x);
+            }
+            _mm256_zeroupper();
+            nv12_row_sse2(y + x, uv + x, nullptr, dst + x, width - x, c);
+        }
+
+        XERXES_TARGET_AVX2 auto i420_row_avx2(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint32_t *dst, int width, const yuv_coefficients &c) -> void
+        {
+            auto k = load_coefficients(c);
+            int x = 0;
+            for (; x + 32 <= width; x += 32) {
+                auto ylo = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(y + x)));
+                auto yhi = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(y + x + 16)));
+                auto cb = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(u + x / 2)));
+                auto cr = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(v + x / 2)));
+                convert32(ylo, yhi, cb, cr, k, dst + x);
+            }
+            _mm256_zeroupper();
+            i420_row_sse2(y + x, u + x / 2, v + x / 2, dst + x, width - x, c);
+        }
+
+        XERXES_TARGET_AVX2 auto yuy2_row_avx2(const uint8_t *p, const uint8_t *, const uint8_t *, uint32_t *dst, int width, const yuv_coefficients &c) -> void
+        {
+            auto k = load_coefficients(c);
+            auto low_bytes = _mm256_set1_epi16(0x00ff);
+            auto low_words = _mm256_set1_epi32(0x0000ffff);
+            int x = 0;
+            for (; x + 32 <= width; x += 32) {
+                auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + x * 2));
+                auto b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + x * 2 + 32));
+                auto ca = _mm256_srli_epi16(a, 8);
+                auto cb = _mm256_srli_epi16(b, 8);
+                // Packing within lanes gives [0-3 8-11 | 4-7 12-15]; swap the middle quarters back
+                auto cu = _mm256_permute4x64_epi64(_mm256_packs_epi32(_mm256_and_si256(ca, low_words), _mm256_and_si256(cb, low_words)), 0xd8);
+                auto cv = _mm256_permute4x64_epi64(_mm256_packs_epi32(_mm256_srli_epi32(ca, 16), _mm256_srli_epi32(cb, 16)), 0xd8);
+                convert32(_mm256_and_si256(a, low_bytes), _mm256_and_si256(b, low_bytes), cu, cv, k, dst + x);
+            }
+            _mm256_zeroupper();
+            yuy2_row_sse2(p + x * 2, nullptr, nullptr, dst + x, width - x, c);
+        }
+    }
+}
+#endif
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+
+// Internal to the color converter: the fixed point coefficients and the per-row kernels of every instruction set level
+namespace xerxes
+{
+    namespace details
+    {
+        // Chroma and luma are scaled to 6 fraction bits and multiplied by 13 fraction bit coefficients, keeping the high 16 bits
+        // of the product (what _mm_mulhi_epi16 does), which leaves the channel with 3 fraction bits.
+        struct yuv_coefficients {
+            int16_t y_offset;
+            int16_t y;
+            int16_t vr;
+            int16_t ug;
+            int16_t vg;
+            int16_t ub;
+        };
+
+        inline auto mulhi(int a, int c) noexcept -> int { return (a * c) >> 16; }
+
+        inline auto clamp_channel(int v) noexcept -> uint32_t { return static_cast<uint32_t>(v < 0 ? 0 : (v > 255 ? 255 : v)); }
+
+        inline auto yuv_to_bgra(int y, int u, int v, const yuv_coefficients &c) noexcept -> uint32_t
+        {
+            auto yt = mulhi((y - c.y_offset) << 6, c.y);
+            auto ut = (u - 128) << 6;
+            auto vt = (v - 128) << 6;
+            auto r = (yt + mulhi(vt, c.vr) + 4) >> 3;
+            auto g = (yt - mulhi(ut, c.ug) - mulhi(vt, c.vg) + 4) >> 3;
+            auto b = (yt + mulhi(ut, c.ub) + 4) >> 3;
+            return 0xff000000u | (clamp_channel(r) << 16) | (clamp_channel(g) << 8) | clamp_channel(b);
+        }
+
+        // Convert width pixels of one row. p0 is Y (or the packed yuy2 row); p1 and p2 are the chroma planes (p1 only for nv12).
+        using yuv_row_kernel = void(*)(const uint8_t *p0, const uint8_t *p1, const uint8_t *p2, uint32_t *dst, int width, const yuv_coefficients &c);
+
+        auto nv12_row_scalar(const uint8_t *y, const uint8_t *uv, const uint8_t *, uint32_t *dst, int width, const yuv_coefficients &c) -> void;
+        auto i420_row_scalar(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint32_t *dst, int width, const yuv_coefficients &c) -> void;
+        auto yuy2_row_scalar(const uint8_t *p, const uint8_t *, const uint8_t *, uint32_t *dst, int width, const yuv_coefficients &c) -> void;
+
+        auto nv12_row_sse2(const uint8_t *y, const uint8_t *uv, const uint8_t *, uint32_t *dst, int width, const yuv_coefficients &c) -> void;
+        auto i420_row_sse2(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint32_t *dst, int width, const yuv_coefficients &c) -> void;
+        auto yuy2_row_sse2(const uint8_t *p, const uint8_t *, const uint8_t *, uint32_t *dst, int width, const yuv_coefficients &c) -> void;
+
+        auto nv12_row_avx2(const uint8_t *y, const uint8_t *uv, const uint8_t *, uint32_t *dst, int width, const yuv_coefficients &c) -> void;
+        auto i420_row_avx2(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint32_t *dst, int width, const yuv_coefficients &c) -> void;
+        auto yuy2_row_avx2(const uint8_t *p, const uint8_t *, const uint8_t *, uint32_t *dst, int width, const yuv_coefficients &c) -> void;
+    }
+}
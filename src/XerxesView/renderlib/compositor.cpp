@@ -0,0 +1,137 @@
+#include "stdafx.h"
+#include "compositor.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace xerxes
+{
+    const int compositor::min_tile_height;
+    constexpr float compositor::target_tile_ms_low;
+    constexpr float compositor::target_tile_ms_high;
+
+    auto compositor::resize(int width, int height) -> void
+    {
+        if (width == _target.width() && height == _target.height()) return;
+
+        _target.resize(width, height);
+        for (auto &l : _layers) {
+            l->resize(width, height);
+        }
+        _pending.clear();
+        invalidate_all();
+    }
+
+    auto compositor::add_layer(std::shared_ptr<layer> l) -> void
+    {
+        l->resize(_target.width(), _target.height());
+        _layers.push_back(std::move(l));
+    }
+
+    auto compositor::remove_layer(const std::shared_ptr<layer> &l) -> void
+    {
+        auto i = std::find(_layers.begin(), _layers.end(), l);
+        if (i != _layers.end()) {
+            _layers.erase(i);
+            // We don't know what it covered
+            invalidate_all();
+        }
+    }
+
+    auto compositor::advance(std::chrono::nanoseconds now) -> void
+    {
+        for (auto &l : _layers) {
+            l->advance(now);
+        }
+    }
+
+    auto compositor::compose(damage_region &damage) -> bool
+    {
+        for (auto &l : _layers) {
+            l->collect_damage(_pending);
+        }
+        _pending.clip(_target.bounds());
+        if (_pending.empty()) return false;
+
+        thread_pool::priority_scope priority(_priority);
+        for (auto &l : _layers) {
+            if (l->get_visible()) {
+                l->prepare(_pool);
+            }
+        }
+
+        split_into_tiles();
+        if (_pool != nullptr) {
+            _pool->parallel_for(_tiles.size(), [this](size_t i) { render_tile(i); });
+        }
+        else {
+            for (size_t i = 0; i < _tiles.size(); i++) {
+                render_tile(i);
+            }
+        }
+        adapt_tile_height();
+
+        damage = _pending;
+        _pending.clear();
+        return true;
+    }
+
+    auto compositor::split_into_tiles() -> void
+    {
+        // Without a pool the tiles only serve the timings, so they are as large as the adaptation allows
+        auto concurrency = _pool != nullptr ? static_cast<int>(_pool->get_concurrency()) : 1;
+        auto height = _tile_height;
+        // Give every thread something to do when the damage is small
+        auto bounds = _pending.bounds();
+        if (concurrency > 1) {
+            height = std::min(height, std::max(min_tile_height, (bounds.height() + concurrency - 1) / concurrency));
+        }
+
+        _tiles.clear();
+        for (auto &r : _pending.rects()) {
+            for (auto top = r.top; top < r.bottom; top += height) {
+                _tiles.push_back(pixel_rect{ r.left, top, r.right, std::min(top + height, r.bottom) });
+            }
+        }
+        _timings.resize(_tiles.size());
+    }
+
+    auto compositor::render_tile(size_t index) -> void
+    {
+        auto start = std::chrono::steady_clock::now();
+        auto &r = _tiles[index];
+        _target.fill(r, _background);
+        for (auto &l : _layers) {
+            if (l->get_visible()) {
+                l->render(_target, r);
+            }
+        }
+
+        auto &timing = _timings[index];
+        timing.rect = r;
+        timing.milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+        timing.thread = static_cast<uint32_t>(thread_pool::current_thread());
+    }
+
+    auto compositor::adapt_tile_height() -> void
+    {
+        if (_timings.empty()) return;
+
+        // Tiles are cut short at the edges of the damage, so judge the tile height by the time per row
+        float total = 0.0f;
+        long long rows = 0;
+        for (auto &t : _timings) {
+            total += t.milliseconds;
+            rows += t.rect.height();
+        }
+        if (rows == 0) return;
+
+        auto expected = total / rows * _tile_height;
+        if (expected < target_tile_ms_low && _tile_height < _target.height()) {
+            _tile_height *= 2;
+        }
+        else if (expected > target_tile_ms_high && _tile_height > min_tile_height) {
+            _tile_height = std::max(min_tile_height, _tile_height / 2);
+        }
+    }
+}
\ No newline at end of file
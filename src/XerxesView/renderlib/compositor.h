@@ -0,0 +1,72 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <vector>
+#include "surface.h"
+#include "layer.h"
+#include "damage_region.h"
+#include "thread_pool.h"
+
+namespace xerxes
+{
+    // How long one tile of the last composed frame took, and on which pool thread (0 for the compositing thread)
+    struct tile_timing {
+        pixel_rect rect;
+        float milliseconds;
+        uint32_t thread;
+    };
+
+    // Composes a stack of layers (bottom first) into a canvas surface. Only the union of the areas the layers damaged is rendered again;
+    // everything else is kept from the previous frame.
+    // With a thread pool the damage is cut into horizontal tiles that are rendered in parallel. Tiles never overlap, so the result
+    // is the same whatever the tiling; the tile height adapts to how long tiles take to render.
+    class compositor {
+    private:
+        surface _target;
+        std::vector<std::shared_ptr<layer>> _layers;
+        damage_region _pending;
+        uint32_t _background = 0xff000000;
+        thread_pool *_pool = nullptr;
+        task_priority _priority = task_priority::high;
+        int _tile_height = 64;
+        std::vector<pixel_rect> _tiles;
+        std::vector<tile_timing> _timings;
+
+        auto split_into_tiles() -> void;
+        auto render_tile(size_t index) -> void;
+        auto adapt_tile_height() -> void;
+    public:
+        static const int min_tile_height = 16;
+        // Aim for tiles that take this long: long enough to hide the scheduling cost, short enough to balance the threads
+        static constexpr float target_tile_ms_low = 0.5f;
+        static constexpr float target_tile_ms_high = 2.0f;
+
+        auto resize(int width, int height) -> void;
+
+        auto add_layer(std::shared_ptr<layer> l) -> void;
+        auto remove_layer(const std::shared_ptr<layer> &l) -> void;
+
+        inline auto invalidate(const pixel_rect &r) -> void { _pending.add(r); }
+        inline auto invalidate_all() -> void { _pending.add(_target.bounds()); }
+
+        // Let time-based layers move to the frame presented at now
+        auto advance(std::chrono::nanoseconds now) -> void;
+
+        // Collect the damage from all the layers and render it. Returns false, without touching the target, if nothing changed.
+        // On success, damage holds the area of the target that has to be presented.
+        auto compose(damage_region &damage) -> bool;
+
+        // nullptr renders on the calling thread only. The pool must outlive the compositor or be replaced first.
+        inline auto set_thread_pool(thread_pool *pool) noexcept -> void { _pool = pool; }
+        // The priority of the tiles, and of whatever the layers spread over the pool
+        inline auto set_priority(task_priority priority) noexcept -> void { _priority = priority; }
+        inline auto get_tile_height() const noexcept -> int { return _tile_height; }
+        // The tiles of the last composed frame
+        inline auto get_tile_timings() const noexcept -> const std::vector<tile_timing>& { return _timings; }
+
+        inline auto target() const noexcept -> const surface& { return _target; }
+        inline auto width() const noexcept -> int { return _target.width(); }
+        inline auto height() const noexcept -> int { return _target.height(); }
+    };
+}
\ No newline at end of file
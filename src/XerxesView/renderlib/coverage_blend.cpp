@@ -0,0 +1,182 @@
+#include "stdafx.h"
+#include "coverage_blend.h"
+#include "simd.h"
+
+#include <cstring>
+
+namespace xerxes
+{
+    namespace
+    {
+        // x / 255, rounded, for x up to 255 * 255
+        inline auto div255(uint32_t x) noexcept -> uint32_t
+        {
+            x += 128;
+            return (x + (x >> 8)) >> 8;
+        }
+
+        inline auto blend_pixel(uint32_t d, uint32_t cov, uint32_t color) noexcept -> uint32_t
+        {
+            auto inverse = 255 - div255((color >> 24) * cov);
+            uint32_t out = 0;
+            for (int shift = 0; shift < 32; shift += 8) {
+                auto c = (color >> shift) & 0xff;
+                auto b = (d >> shift) & 0xff;
+                out |= div255(c * cov + b * inverse) << shift;
+            }
+            return out;
+        }
+
+        inline auto over_pixel(uint32_t d, uint32_t s) noexcept -> uint32_t
+        {
+            auto inverse = 255 - (s >> 24);
+            uint32_t out = 0;
+            for (int shift = 0; shift < 32; shift += 8) {
+                auto c = (s >> shift) & 0xff;
+                auto b = (d >> shift) & 0xff;
+                out |= (c + div255(b * inverse)) << shift;
+            }
+            return out;
+        }
+
+        inline auto mix_pixel(uint32_t d, uint32_t s, uint32_t weight) noexcept -> uint32_t
+        {
+            uint32_t out = 0;
+            for (int shift = 0; shift < 32; shift += 8) {
+                auto c = (s >> shift) & 0xff;
+                auto b = (d >> shift) & 0xff;
+                out |= div255(c * weight + b * (255 - weight)) << shift;
+            }
+            return out;
+        }
+
+#if XERXES_SSE2
+        inline auto div255(__m128i x) -> __m128i
+        {
+            x = _mm_add_epi16(x, _mm_set1_epi16(128));
+            return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+        }
+
+        // Two pixels as words, with their coverage repeated over the four channels
+        inline auto blend2(__m128i d, __m128i cov, __m128i color, __m128i color_alpha) -> __m128i
+        {
+            auto inverse = _mm_sub_epi16(_mm_set1_epi16(255), div255(_mm_mullo_epi16(color_alpha, cov)));
+            return div255(_mm_add_epi16(_mm_mullo_epi16(color, cov), _mm_mullo_epi16(d, inverse)));
+        }
+
+        // Two pixels as words; the alpha of s repeated over the four channels
+        inline auto over2(__m128i d, __m128i s) -> __m128i
+        {
+            auto alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+            return _mm_add_epi16(s, div255(_mm_mullo_epi16(d, _mm_sub_epi16(_mm_set1_epi16(255), alpha))));
+        }
+
+        inline auto mix2(__m128i d, __m128i s, __m128i weight, __m128i inverse) -> __m128i
+        {
+            return div255(_mm_add_epi16(_mm_mullo_epi16(s, weight), _mm_mullo_epi16(d, inverse)));
+        }
+#endif
+    }
+
+    auto blend_coverage_scalar(uint32_t *dst, const uint8_t *coverage, int count, uint32_t color) -> void
+    {
+        for (int x = 0; x < count; x++) {
+            auto cov = coverage[x];
+            if (cov == 0) continue;
+            dst[x] = cov == 255 && (color >> 24) == 255 ? color : blend_pixel(dst[x], cov, color);
+        }
+    }
+
+    auto blend_coverage(uint32_t *dst, const uint8_t *coverage, int count, uint32_t color) -> void
+    {
+        int x = 0;
+#if XERXES_SSE2
+        auto zero = _mm_setzero_si128();
+        auto c = _mm_unpacklo_epi8(_mm_set1_epi32(static_cast<int>(color)), zero);
+        auto ca = _mm_set1_epi16(static_cast<short>(color >> 24));
+        for (; x + 4 <= count; x += 4) {
+            uint32_t mask;
+            memcpy(&mask, coverage + x, 4);
+            // Most of a glyph box is empty
+            if (mask == 0) continue;
+
+            auto p = reinterpret_cast<__m128i*>(dst + x);
+            auto d = _mm_loadu_si128(p);
+            auto m = _mm_cvtsi32_si128(static_cast<int>(mask));
+            m = _mm_unpacklo_epi8(m, m);
+            m = _mm_unpacklo_epi16(m, m);
+            auto lo = blend2(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(m, zero), c, ca);
+            auto hi = blend2(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(m, zero), c, ca);
+            _mm_storeu_si128(p, _mm_packus_epi16(lo, hi));
+        }
+#endif
+        blend_coverage_scalar(dst + x, coverage + x, count - x, color);
+    }
+
+    auto blend_over_scalar(uint32_t *dst, const uint32_t *src, int count) -> void
+    {
+        for (int x = 0; x < count; x++) {
+            auto alpha = src[x] >> 24;
+            if (alpha == 0) continue;
+            dst[x] = alpha == 255 ? src[x] : over_pixel(dst[x], src[x]);
+        }
+    }
+
+    auto blend_over(uint32_t *dst, const uint32_t *src, int count) -> void
+    {
+        int x = 0;
+#if XERXES_SSE2
+        auto zero = _mm_setzero_si128();
+        auto alpha_mask = _mm_set1_epi32(static_cast<int>(0xff000000));
+        for (; x + 4 <= count; x += 4) {
+            auto s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+            auto alpha = _mm_and_si128(s, alpha_mask);
+            // Slides are mostly transparent around the text
+            if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, zero)) == 0xffff) continue;
+
+            auto p = reinterpret_cast<__m128i*>(dst + x);
+            if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, alpha_mask)) == 0xffff) {
+                _mm_storeu_si128(p, s);
+                continue;
+            }
+            auto d = _mm_loadu_si128(p);
+            auto lo = over2(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(s, zero));
+            auto hi = over2(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(s, zero));
+            _mm_storeu_si128(p, _mm_packus_epi16(lo, hi));
+        }
+#endif
+        blend_over_scalar(dst + x, src + x, count - x);
+    }
+
+    auto blend_mix_scalar(uint32_t *dst, const uint32_t *src, int count, uint32_t weight) -> void
+    {
+        for (int x = 0; x < count; x++) {
+            dst[x] = mix_pixel(dst[x], src[x], weight);
+        }
+    }
+
+    auto blend_mix(uint32_t *dst, const uint32_t *src, int count, uint32_t weight) -> void
+    {
+        if (weight == 0) return;
+        if (weight >= 255) {
+            std::memcpy(dst, src, static_cast<size_t>(count) * sizeof(uint32_t));
+            return;
+        }
+
+        int x = 0;
+#if XERXES_SSE2
+        auto zero = _mm_setzero_si128();
+        auto w = _mm_set1_epi16(static_cast<short>(weight));
+        auto inverse = _mm_set1_epi16(static_cast<short>(255 - weight));
+        for (; x + 4 <= count; x += 4) {
+            auto s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+            auto p = reinterpret_cast<__m128i*>(dst + x);
+            auto d = _mm_loadu_si128(p);
+            auto lo = mix2(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(s, zero), w, inverse);
+            auto hi = mix2(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(s, zero), w, inverse);
+            _mm_storeu_si128(p, _mm_packus_epi16(lo, hi));
+        }
+#endif
+        blend_mix_scalar(dst + x, src + x, count - x, weight);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+
+namespace xerxes
+{
+    // Blend a premultiplied BGRA colour into count pixels of dst, weighted by an 8-bit coverage mask (e.g. a glyph).
+    // The SSE2 and scalar paths give identical results.
+    auto blend_coverage(uint32_t *dst, const uint8_t *coverage, int count, uint32_t color) -> void;
+    auto blend_coverage_scalar(uint32_t *dst, const uint8_t *coverage, int count, uint32_t color) -> void;
+
+    // Blend count premultiplied BGRA pixels of src over dst. Transparent runs are skipped and opaque ones copied.
+    auto blend_over(uint32_t *dst, const uint32_t *src, int count) -> void;
+    auto blend_over_scalar(uint32_t *dst, const uint32_t *src, int count) -> void;
+
+    // Mix count pixels of src into dst by a constant weight from 0 (dst stays) to 255 (src replaces it), e.g. for a dissolve
+    auto blend_mix(uint32_t *dst, const uint32_t *src, int count, uint32_t weight) -> void;
+    auto blend_mix_scalar(uint32_t *dst, const uint32_t *src, int count, uint32_t weight) -> void;
+}
\ No newline at end of file
@@ -0,0 +1,200 @@
+#include "stdafx.h"
+#include "cue_list.h"
+
+namespace xerxes
+{
+    const size_t cue_list::npos;
+
+    cue_list::cue_list(media_opener opener, size_t preload)
+        : _opener(std::move(opener)), _preload(preload)
+    {
+        _thread = std::thread([this]() { run(); });
+    }
+
+    cue_list::~cue_list()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            _running = false;
+        }
+        _wake.notify_all();
+        _thread.join();
+    }
+
+    auto cue_list::set_cues(const std::vector<std::wstring> &urls) -> void
+    {
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            for (auto &c : _cues) {
+                if (c.decoder != nullptr) {
+                    _retired.push_back(std::move(c.decoder));
+                }
+            }
+            _cues.clear();
+            for (auto &url : urls) {
+                _cues.push_back(cue{ url, cue_state::idle, nullptr });
+            }
+            _current = 0;
+            _staged = npos;
+        }
+        _wake.notify_all();
+    }
+
+    auto cue_list::get_count() -> size_t
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        return _cues.size();
+    }
+
+    auto cue_list::get_url(size_t index) -> std::wstring
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        return index < _cues.size() ? _cues[index].url : std::wstring();
+    }
+
+    auto cue_list::try_take(size_t index, std::shared_ptr<media_decoder> &decoder) -> bool
+    {
+        decoder.reset();
+        std::unique_lock<std::mutex> lock(_lock);
+        if (index >= _cues.size()) return true;
+
+        if (_current != index) {
+            _current = index;
+            // Whatever was taken before is on its way out; coming back to it opens it again from the start
+            for (auto &c : _cues) {
+                if (c.state == cue_state::taken) c.state = cue_state::idle;
+            }
+            lock.unlock();
+            _wake.notify_all();
+            lock.lock();
+            if (index >= _cues.size()) return true;
+        }
+
+        auto &c = _cues[index];
+        switch (c.state) {
+        case cue_state::failed:
+            return true;
+        case cue_state::loaded:
+            // Only fire once the first frame is decoded, so the switch is gapless
+            if (c.decoder->get_queue().size() == 0 && !c.decoder->get_end_of_stream()) return false;
+            decoder = std::move(c.decoder);
+            c.state = cue_state::taken;
+            return true;
+        case cue_state::taken:
+            // Firing the current cue again restarts it
+            c.state = cue_state::idle;
+            lock.unlock();
+            _wake.notify_all();
+            return false;
+        default:
+            return false;
+        }
+    }
+
+    auto cue_list::set_staged(size_t index) -> void
+    {
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            if (_staged == index) return;
+            _staged = index;
+        }
+        _wake.notify_all();
+    }
+
+    auto cue_list::try_peek(size_t index, std::shared_ptr<media_decoder> &decoder) -> bool
+    {
+        decoder.reset();
+        std::lock_guard<std::mutex> lock(_lock);
+        if (index >= _cues.size() || !in_window(index)) return true;
+
+        auto &c = _cues[index];
+        switch (c.state) {
+        case cue_state::loaded:
+            if (c.decoder->get_queue().size() == 0 && !c.decoder->get_end_of_stream()) return false;
+            decoder = c.decoder;
+            return true;
+        case cue_state::idle:
+        case cue_state::loading:
+            return false;
+        default:
+            return true;
+        }
+    }
+
+    auto cue_list::retire(std::shared_ptr<media_decoder> decoder) -> void
+    {
+        if (decoder == nullptr) return;
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            _retired.push_back(std::move(decoder));
+        }
+        _wake.notify_all();
+    }
+
+    auto cue_list::next_to_load() -> size_t
+    {
+        auto found = npos;
+        for (size_t i = 0; i < _cues.size(); i++) {
+            auto &c = _cues[i];
+            if (!in_window(i)) {
+                if (c.decoder != nullptr) {
+                    _retired.push_back(std::move(c.decoder));
+                }
+                if (c.state != cue_state::loading) c.state = cue_state::idle;
+            }
+            // The current cue goes first: it is the one being waited for. After that, in order.
+            else if (c.state == cue_state::idle && (found == npos || i == _current)) {
+                found = i;
+            }
+        }
+        return found;
+    }
+
+    auto cue_list::run() -> void
+    {
+        std::unique_lock<std::mutex> lock(_lock);
+        while (_running) {
+            if (!_retired.empty()) {
+                auto retired = std::move(_retired);
+                _retired.clear();
+                lock.unlock();
+                retired.clear();
+                lock.lock();
+                continue;
+            }
+
+            auto index = next_to_load();
+            if (index == npos) {
+                _wake.wait(lock);
+                continue;
+            }
+
+            auto url = _cues[index].url;
+            _cues[index].state = cue_state::loading;
+            lock.unlock();
+
+            // Opening probes the media; starting the decoder pre-rolls its queue
+            std::shared_ptr<media_decoder> decoder;
+            auto source = _opener(url);
+            if (source != nullptr) {
+                decoder = std::make_shared<media_decoder>(std::move(source));
+                decoder->start();
+            }
+
+            lock.lock();
+            // The list may have been replaced or moved on while we were opening
+            if (index < _cues.size() && _cues[index].url == url && _cues[index].state == cue_state::loading && in_window(index)) {
+                _cues[index].state = decoder != nullptr ? cue_state::loaded : cue_state::failed;
+                _cues[index].decoder = std::move(decoder);
+            }
+            else {
+                if (index < _cues.size() && _cues[index].state == cue_state::loading) {
+                    _cues[index].state = cue_state::idle;
+                }
+                if (decoder != nullptr) {
+                    _retired.push_back(std::move(decoder));
+                }
+            }
+        }
+    }
+}
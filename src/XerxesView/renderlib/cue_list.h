@@ -0,0 +1,81 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "media_source.h"
+#include "media_decoder.h"
+
+namespace xerxes
+{
+    // An ordered list of media cues. The cues following the current one are opened, probed and pre-rolled to their first frame on a
+    // background thread, so firing one only hands an already decoded frame to the video layer.
+    class cue_list {
+    public:
+        using media_opener = std::function<std::unique_ptr<media_source>(const std::wstring &url)>;
+    private:
+        enum class cue_state {
+            idle,
+            loading,
+            loaded,
+            failed,
+            // Handed to the caller
+            taken
+        };
+
+        struct cue {
+            std::wstring url;
+            cue_state state;
+            std::shared_ptr<media_decoder> decoder;
+        };
+
+        media_opener _opener;
+        size_t _preload;
+        std::mutex _lock;
+        std::condition_variable _wake;
+        std::vector<cue> _cues;
+        size_t _current = 0;
+        // Loaded as well, outside the window, for the preview bus
+        size_t _staged = npos;
+        // Decoders are stopped on the loader thread, because stopping joins the decode thread
+        std::vector<std::shared_ptr<media_decoder>> _retired;
+        bool _running = true;
+        std::thread _thread;
+
+        auto run() -> void;
+        // The next cue in the preload window that still has to be opened, or npos. Drops the decoders outside the window.
+        auto next_to_load() -> size_t;
+        inline auto in_window(size_t index) const noexcept -> bool { return (index >= _current && index <= _current + _preload) || index == _staged; }
+    public:
+        static const size_t npos = static_cast<size_t>(-1);
+
+        // Keep preload cues after the current one ready
+        explicit cue_list(media_opener opener, size_t preload = 2);
+        cue_list(const cue_list &) = delete;
+        auto operator=(const cue_list &)->cue_list& = delete;
+        ~cue_list();
+
+        // Replace the cues and make the first one current
+        auto set_cues(const std::vector<std::wstring> &urls) -> void;
+        auto get_count() -> size_t;
+        auto get_url(size_t index) -> std::wstring;
+
+        // Make index the current cue. Returns true once the cue is settled: decoder then holds the pre-rolled decoder, or nullptr if
+        // the cue doesn't exist or its media couldn't be opened. Returns false while it is still loading; call again on a later frame.
+        auto try_take(size_t index, std::shared_ptr<media_decoder> &decoder) -> bool;
+
+        // Keep index loaded too, wherever it is, or nothing extra with npos
+        auto set_staged(size_t index) -> void;
+        // The pre-rolled decoder of index without taking it, to show its first frame elsewhere; its queue must not be popped.
+        // Returns false while the cue is still loading; decoder is nullptr if it is not in the window or failed.
+        auto try_peek(size_t index, std::shared_ptr<media_decoder> &decoder) -> bool;
+
+        // Hand back a decoder that is no longer shown so it is shut down off the caller's thread
+        auto retire(std::shared_ptr<media_decoder> decoder) -> void;
+    };
+}
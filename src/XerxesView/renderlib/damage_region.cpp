@@ -0,0 +1,89 @@
+#include "stdafx.h"
+#include "damage_region.h"
+
+#include <algorithm>
+
+namespace xerxes
+{
+    auto pixel_rect::intersect(const pixel_rect &other) const noexcept -> pixel_rect
+    {
+        pixel_rect r{ std::max(left, other.left), std::max(top, other.top), std::min(right, other.right), std::min(bottom, other.bottom) };
+        if (r.empty()) return pixel_rect{ 0, 0, 0, 0 };
+        return r;
+    }
+
+    auto pixel_rect::unite(const pixel_rect &other) const noexcept -> pixel_rect
+    {
+        if (empty()) return other;
+        if (other.empty()) return *this;
+        return pixel_rect{ std::min(left, other.left), std::min(top, other.top), std::max(right, other.right), std::max(bottom, other.bottom) };
+    }
+
+    auto damage_region::add(const pixel_rect &r) -> void
+    {
+        if (r.empty()) return;
+
+        auto merged = r;
+        for (;;) {
+            bool changed = false;
+            for (auto i = _rects.begin(); i != _rects.end();) {
+                if (i->contains(merged)) return;
+                if (merged.contains(*i) || merged.intersects(*i)) {
+                    merged = merged.unite(*i);
+                    i = _rects.erase(i);
+                    changed = true;
+                }
+                else {
+                    ++i;
+                }
+            }
+            // A union can grow into rectangles it did not touch before
+            if (!changed) break;
+        }
+
+        _rects.push_back(merged);
+        if (_rects.size() > max_rects) {
+            auto b = bounds();
+            _rects.clear();
+            _rects.push_back(b);
+        }
+    }
+
+    auto damage_region::add(const damage_region &other) -> void
+    {
+        for (auto &r : other._rects) {
+            add(r);
+        }
+    }
+
+    auto damage_region::clip(const pixel_rect &bounds) -> void
+    {
+        for (auto i = _rects.begin(); i != _rects.end();) {
+            *i = i->intersect(bounds);
+            if (i->empty()) {
+                i = _rects.erase(i);
+            }
+            else {
+                ++i;
+            }
+        }
+    }
+
+    auto damage_region::bounds() const noexcept -> pixel_rect
+    {
+        pixel_rect b{ 0, 0, 0, 0 };
+        for (auto &r : _rects) {
+            b = b.unite(r);
+        }
+        return b;
+    }
+
+    auto damage_region::area() const noexcept -> long long
+    {
+        long long a = 0;
+        for (auto &r : _rects) {
+            a += r.area();
+        }
+        return a;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace xerxes
+{
+    // A rectangle in pixels. right and bottom are exclusive.
+    struct pixel_rect {
+        int left;
+        int top;
+        int right;
+        int bottom;
+
+        inline auto width() const noexcept -> int { return right - left; }
+        inline auto height() const noexcept -> int { return bottom - top; }
+        inline auto empty() const noexcept -> bool { return right <= left || bottom <= top; }
+        inline auto area() const noexcept -> long long { return empty() ? 0 : static_cast<long long>(width()) * height(); }
+
+        inline auto contains(const pixel_rect &other) const noexcept -> bool {
+            return other.left >= left && other.top >= top && other.right <= right && other.bottom <= bottom;
+        }
+        inline auto intersects(const pixel_rect &other) const noexcept -> bool {
+            return other.left < right && other.right > left && other.top < bottom && other.bottom > top;
+        }
+
+        auto intersect(const pixel_rect &other) const noexcept -> pixel_rect;
+        auto unite(const pixel_rect &other) const noexcept -> pixel_rect;
+
+        static inline auto from_size(int width, int height) noexcept -> pixel_rect { return pixel_rect{ 0, 0, width, height }; }
+    };
+
+    // The set of areas that changed since the last composition. Overlapping rectangles are merged, and once there are too many
+    // of them the region collapses to its bounding box, since many small blits cost more than one larger one.
+    class damage_region {
+    private:
+        std::vector<pixel_rect> _rects;
+    public:
+        static const size_t max_rects = 8;
+
+        auto add(const pixel_rect &r) -> void;
+        auto add(const damage_region &other) -> void;
+        auto clip(const pixel_rect &bounds) -> void;
+        auto bounds() const noexcept -> pixel_rect;
+        auto area() const noexcept -> long long;
+
+        inline auto clear() noexcept -> void { _rects.clear(); }
+        inline auto empty() const noexcept -> bool { return _rects.empty(); }
+        inline auto rects() const noexcept -> const std::vector<pixel_rect>& { return _rects; }
+    };
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+#include "stdafx.h"
+#include "decode_benchmark.h"
+#include "media_decoder.h"
+#include "synthetic_media_source.h"
+
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <sstream>
+
+namespace xerxes
+{
+    namespace
+    {
+        auto run_once(const decode_benchmark_options &options, size_t held) -> decode_benchmark_run
+        {
+            decode_benchmark_run run{ held, 0, 0.0, 0.0, 0.0, 0, true };
+            media_decoder decoder(std::unique_ptr<media_source>(new synthetic_media_source(options.width, options.height, options.frame_rate, options.frames)),
+                options.queue_depth, options.spare_frames);
+
+            std::deque<frame_ref> kept;
+            auto start = std::chrono::steady_clock::now();
+            decoder.start();
+            for (uint64_t i = 0; i < options.frames; i++) {
+                auto frame = decoder.get_queue().pop_wait();
+                if (frame == nullptr) break;
+                auto expected = std::chrono::nanoseconds(static_cast<long long>(i * 1e9 / options.frame_rate));
+                if (frame->timestamp != expected) {
+                    run.complete = false;
+                }
+                run.frames++;
+                kept.push_back(std::move(frame));
+                while (kept.size() > held + 1) {
+                    kept.pop_front();
+                }
+            }
+            auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            kept.clear();
+            decoder.stop();
+
+            auto stats = decoder.get_statistics();
+            run.complete = run.complete && run.frames == options.frames;
+            run.frames_per_second = seconds > 0.0 ? run.frames / seconds : 0.0;
+            run.decode_rate = stats.decode_rate;
+            run.average_decode_ms = stats.average_decode_ms;
+            run.buffer_waits = stats.buffer_waits;
+            return run;
+        }
+    }
+
+    auto decode_benchmark_result::passed() const -> bool
+    {
+        for (auto &r : runs) {
+            if (!r.complete) return false;
+        }
+        return true;
+    }
+
+    auto decode_benchmark_result::format() const -> std::string
+    {
+        std::ostringstream out;
+        char line[256];
+        for (auto &r : runs) {
+            std::snprintf(line, sizeof(line), "holding %llu  %8.1f frames/s, decode %6.3f ms (%8.1f frames/s of decode time), %5llu buffer waits%s\n",
+                static_cast<unsigned long long>(r.held), r.frames_per_second, r.average_decode_ms, r.decode_rate,
+                static_cast<unsigned long long>(r.buffer_waits), r.complete ? "" : ", FRAMES MISSING OR OUT OF ORDER");
+            out << line;
+        }
+        return out.str();
+    }
+
+    auto decode_benchmark::run(const decode_benchmark_options &options) -> decode_benchmark_result
+    {
+        decode_benchmark_result result;
+        // Nothing held; as many as the spare frames, which the pool is sized for; and all but the one the decoder needs, which
+        // leaves it without a buffer after every frame until the consumer lets go of the oldest
+        for (auto held : { size_t(0), options.spare_frames, options.queue_depth + options.spare_frames - 1 }) {
+            result.runs.push_back(run_once(options, held));
+        }
+        return result;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace xerxes
+{
+    struct decode_benchmark_options {
+        int width = 1920;
+        int height = 1080;
+        double frame_rate = 60.0;
+        uint64_t frames = 600;
+        size_t queue_depth = 4;
+        size_t spare_frames = 3;
+    };
+
+    struct decode_benchmark_run {
+        // How many frames the consumer held on to besides the one it took last, like the layers and monitors do
+        size_t held;
+        uint64_t frames;
+        // Frames through the queue per second of wall time
+        double frames_per_second;
+        // From the decoder's statistics
+        double decode_rate;
+        double average_decode_ms;
+        uint64_t buffer_waits;
+        // Every frame arrived, in order
+        bool complete;
+    };
+
+    struct decode_benchmark_result {
+        std::vector<decode_benchmark_run> runs;
+
+        auto passed() const -> bool;
+        // One line per run
+        auto format() const -> std::string;
+    };
+
+    // How fast frames get through media_decoder, without a codec or a disk: synthetic frames are decoded into the pool and
+    // taken off the queue as fast as they come. The consumer first lets go of every frame at once, then holds on to more of
+    // them, until the decoder runs out of buffers and has to wait for each.
+    class decode_benchmark {
+    public:
+        decode_benchmark() = delete;
+
+        static auto run(const decode_benchmark_options &options) -> decode_benchmark_result;
+    };
+}
\ No newline at end of file
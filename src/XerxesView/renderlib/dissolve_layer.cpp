@@ -0,0 +1,74 @@
+#include "stdafx.h"
+#include "dissolve_layer.h"
+#include "coverage_blend.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace xerxes
+{
+    auto dissolve_layer::start(const surface &from, std::chrono::nanoseconds duration) -> void
+    {
+        if (duration.count() <= 0 || from.width() != _width || from.height() != _height || from.empty()) {
+            stop();
+            return;
+        }
+
+        _from.resize(from.width(), from.height());
+        for (int y = 0; y < from.height(); y++) {
+            std::memcpy(_from.row(y), from.row(y), static_cast<size_t>(from.width()) * sizeof(uint32_t));
+        }
+        _duration = duration;
+        _started = false;
+        _weight = 255;
+        invalidate_all();
+    }
+
+    auto dissolve_layer::stop() -> void
+    {
+        if (_weight > 0) {
+            invalidate_all();
+        }
+        _weight = 0;
+        _from = surface();
+    }
+
+    auto dissolve_layer::resize(int width, int height) -> void
+    {
+        layer::resize(width, height);
+        // The old canvas no longer lines up with the new one
+        stop();
+    }
+
+    auto dissolve_layer::advance(std::chrono::nanoseconds now) -> void
+    {
+        if (_weight == 0) return;
+
+        if (!_started) {
+            _start = now;
+            _started = true;
+        }
+        auto elapsed = now - _start;
+        if (elapsed >= _duration) {
+            stop();
+            return;
+        }
+
+        auto weight = static_cast<uint32_t>(255 - 255 * elapsed.count() / _duration.count());
+        weight = std::max(weight, 1u);
+        if (weight != _weight) {
+            _weight = weight;
+            invalidate_all();
+        }
+    }
+
+    auto dissolve_layer::render(surface &target, const pixel_rect &clip) -> void
+    {
+        if (_weight == 0) return;
+
+        auto area = clip.intersect(_from.bounds());
+        for (int y = area.top; y < area.bottom; y++) {
+            blend_mix(target.row(y) + area.left, _from.row(y) + area.left, area.width(), _weight);
+        }
+    }
+}
\ No newline at end of file
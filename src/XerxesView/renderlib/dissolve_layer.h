@@ -0,0 +1,30 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include "layer.h"
+
+namespace xerxes
+{
+    // A dissolve from what the canvas showed before a take: a copy of the old canvas drawn over the new one, fading out.
+    // The copy is only held while the dissolve runs.
+    class dissolve_layer : public layer {
+    private:
+        surface _from;
+        std::chrono::nanoseconds _duration{ 0 };
+        std::chrono::nanoseconds _start{ 0 };
+        bool _started = false;
+        // How much of the old canvas shows, 0 to 255
+        uint32_t _weight = 0;
+
+        auto stop() -> void;
+    public:
+        // Fade from a copy of from over duration, counted from the next advance. A zero duration cuts.
+        auto start(const surface &from, std::chrono::nanoseconds duration) -> void;
+        inline auto is_running() const noexcept -> bool { return _weight > 0; }
+
+        virtual auto resize(int width, int height) -> void override;
+        virtual auto advance(std::chrono::nanoseconds now) -> void override;
+        virtual auto render(surface &target, const pixel_rect &clip) -> void override;
+    };
+}
\ No newline at end of file
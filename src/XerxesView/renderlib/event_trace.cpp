@@ -0,0 +1,281 @@
+#include "stdafx.h"
+#include "event_trace.h"
+#include "history_ring.h"
+
+#include <algorithm>
+#include <ctime>
+#include <fstream>
+
+namespace xerxes
+{
+    const size_t event_trace::events_per_thread;
+
+    struct event_trace::thread_buffer {
+        history_ring<event, events_per_thread> events;
+        // The thread writing into the buffer, or 0 while it is free for the next thread to take
+        std::atomic<uint32_t> thread{ 0 };
+        std::atomic<const char*> name{ nullptr };
+    };
+
+    std::atomic<bool> event_trace::_enabled{ true };
+    std::atomic<long long> event_trace::_window{ 10000000000LL };
+    std::atomic<long long> event_trace::_spike_threshold{ 0 };
+    std::atomic<long long> event_trace::_last_spike{ 0 };
+    std::atomic<uint32_t> event_trace::_next_thread{ 1 };
+    std::mutex event_trace::_lock;
+    std::vector<std::unique_ptr<event_trace::thread_buffer>> event_trace::_buffers;
+    std::vector<std::pair<uint32_t, std::string>> event_trace::_exited;
+    std::string event_trace::_dump_folder;
+    std::thread event_trace::_dumper;
+    std::atomic<bool> event_trace::_dumping{ false };
+
+    // Gives the buffer back when its thread exits, so threads started per cue or per scan don't each keep one
+    struct thread_slot {
+        event_trace::thread_buffer *buffer = nullptr;
+        uint32_t thread = 0;
+
+        ~thread_slot() {
+            if (buffer != nullptr) {
+                event_trace::release_buffer(buffer);
+            }
+        }
+    };
+
+    namespace
+    {
+        // Enough for the threads started per cue or per scan over the length of a dump window
+        const size_t max_exited = 256;
+
+        thread_local thread_slot current;
+
+        // Chrome traces count in microseconds from an arbitrary origin
+        auto write_time(std::ostream &out, int64_t ns) -> void
+        {
+            out << ns / 1000 << '.';
+            auto fraction = ns % 1000;
+            if (fraction < 100) out << '0';
+            if (fraction < 10) out << '0';
+            out << fraction;
+        }
+
+        auto write_string(std::ostream &out, const char *s) -> void
+        {
+            out << '"';
+            for (; *s != '\0'; s++) {
+                if (*s == '"' || *s == '\\') out << '\\';
+                if (static_cast<unsigned char>(*s) >= 0x20) out << *s;
+            }
+            out << '"';
+        }
+    }
+
+    auto event_trace::get_buffer() -> thread_buffer*
+    {
+        if (current.buffer != nullptr) return current.buffer;
+
+        std::lock_guard<std::mutex> lock(_lock);
+        current.thread = _next_thread++;
+        for (auto &b : _buffers) {
+            if (b->thread.load() == 0) {
+                current.buffer = b.get();
+                break;
+            }
+        }
+        if (current.buffer == nullptr) {
+            _buffers.push_back(std::unique_ptr<thread_buffer>(new thread_buffer()));
+            current.buffer = _buffers.back().get();
+        }
+        // The events of the previous owner stay until they are overwritten; they carry its thread number
+        current.buffer->name = nullptr;
+        current.buffer->thread = current.thread;
+        return current.buffer;
+    }
+
+    auto event_trace::release_buffer(thread_buffer *buffer) -> void
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        auto name = buffer->name.load();
+        if (name != nullptr) {
+            if (_exited.size() == max_exited) {
+                _exited.erase(_exited.begin());
+            }
+            _exited.emplace_back(buffer->thread.load(), name);
+        }
+        buffer->thread = 0;
+    }
+
+    auto event_trace::push(const event &e) -> void
+    {
+        auto buffer = get_buffer();
+        auto stamped = e;
+        stamped.thread = current.thread;
+        buffer->events.push(stamped);
+    }
+
+    auto event_trace::set_enabled(bool enabled) -> void
+    {
+        _enabled = enabled;
+    }
+
+    auto event_trace::set_window(std::chrono::nanoseconds window) -> void
+    {
+        _window = window.count();
+    }
+
+    auto event_trace::complete(const char *name, int64_t start, int64_t end, int64_t argument) -> void
+    {
+        if (!get_enabled()) return;
+        push(event{ name, start, end - start, argument, 0, event_type::complete });
+    }
+
+    auto event_trace::counter(const char *name, int64_t value) -> void
+    {
+        if (!get_enabled()) return;
+        push(event{ name, now(), value, 0, 0, event_type::counter });
+    }
+
+    auto event_trace::instant(const char *name, int64_t argument) -> void
+    {
+        if (!get_enabled()) return;
+        push(event{ name, now(), 0, argument, 0, event_type::instant });
+    }
+
+    auto event_trace::set_thread_name(const char *name) -> void
+    {
+        get_buffer()->name.store(name, std::memory_order_relaxed);
+    }
+
+    auto event_trace::snapshot(std::vector<event> &events, std::vector<std::pair<uint32_t, std::string>> &threads) -> void
+    {
+        events.clear();
+        threads.clear();
+        auto since = now() - _window.load();
+        std::vector<event> recent;
+        std::lock_guard<std::mutex> lock(_lock);
+        threads = _exited;
+        for (auto &b : _buffers) {
+            b->events.snapshot(recent);
+            for (auto &e : recent) {
+                // A complete event is recorded when it ends, so one that started before the window may still matter
+                if (e.start + (e.type == event_type::complete ? e.value : 0) >= since) {
+                    events.push_back(e);
+                }
+            }
+            auto thread = b->thread.load();
+            auto name = b->name.load();
+            if (thread != 0 && name != nullptr) {
+                threads.emplace_back(thread, name);
+            }
+        }
+    }
+
+    auto event_trace::write_chrome_trace(std::ostream &out, const std::vector<event> &events, const std::vector<std::pair<uint32_t, std::string>> &threads) -> void
+    {
+        int64_t origin = 0;
+        if (!events.empty()) {
+            origin = std::min_element(events.begin(), events.end(), [](const event &a, const event &b) { return a.start < b.start; })->start;
+        }
+
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        auto first = true;
+        for (auto &t : threads) {
+            out << (first ? "" : ",\n") << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << t.first << ",\"args\":{\"name\":";
+            write_string(out, t.second.c_str());
+            out << "}}";
+            first = false;
+        }
+        for (auto &e : events) {
+            out << (first ? "" : ",\n") << "{\"name\":";
+            write_string(out, e.name);
+            out << ",\"pid\":1,\"tid\":" << e.thread << ",\"ts\":";
+            write_time(out, e.start - origin);
+            switch (e.type) {
+            case event_type::complete:
+                out << ",\"ph\":\"X\",\"dur\":";
+                write_time(out, e.value);
+                out << ",\"args\":{\"argument\":" << e.argument << "}}";
+                break;
+            case event_type::counter:
+                out << ",\"ph\":\"C\",\"args\":{\"value\":" << e.value << "}}";
+                break;
+            case event_type::instant:
+                out << ",\"ph\":\"i\",\"s\":\"t\",\"args\":{\"argument\":" << e.argument << "}}";
+                break;
+            }
+            first = false;
+        }
+        out << "\n]}\n";
+    }
+
+    auto event_trace::set_spike_threshold(std::chrono::nanoseconds threshold) -> void
+    {
+        _spike_threshold = threshold.count();
+    }
+
+    auto event_trace::try_report_spike(std::chrono::nanoseconds frame_time, std::chrono::nanoseconds cooldown) -> bool
+    {
+        auto threshold = _spike_threshold.load(std::memory_order_relaxed);
+        if (threshold <= 0 || frame_time.count() <= threshold) return false;
+
+        auto t = now();
+        auto last = _last_spike.load();
+        if (last != 0 && t - last < cooldown.count()) return false;
+        return _last_spike.compare_exchange_strong(last, t);
+    }
+
+    auto event_trace::set_dump_folder(const std::string &folder) -> void
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        _dump_folder = folder;
+    }
+
+    auto event_trace::begin_dump(const char *reason) -> std::string
+    {
+        if (_dumping.exchange(true)) return std::string();
+
+        auto events = std::make_shared<std::vector<event>>();
+        auto threads = std::make_shared<std::vector<std::pair<uint32_t, std::string>>>();
+        snapshot(*events, *threads);
+
+        std::string path;
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            if (_dump_folder.empty()) {
+                _dumping = false;
+                return std::string();
+            }
+            auto t = std::time(nullptr);
+            std::tm local;
+#ifdef _WIN32
+            localtime_s(&local, &t);
+#else
+            localtime_r(&t, &local);
+#endif
+            char stamp[32];
+            std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &local);
+            path = _dump_folder + reason + "-" + stamp + ".json";
+
+            // The previous dump finished, as _dumping was clear
+            if (_dumper.joinable()) {
+                _dumper.join();
+            }
+            // Formatting a few hundred thousand events takes long enough to stall whichever thread asked
+            _dumper = std::thread([path, events, threads]() {
+                std::ofstream out(path, std::ios::out | std::ios::trunc);
+                if (out) {
+                    write_chrome_trace(out, *events, *threads);
+                }
+                _dumping = false;
+            });
+        }
+        return path;
+    }
+
+    auto event_trace::shutdown() -> void
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        if (_dumper.joinable()) {
+            _dumper.join();
+        }
+    }
+}
\ No newline at end of file
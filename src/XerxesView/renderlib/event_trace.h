@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace xerxes
+{
+    // A flight recorder of what every thread was doing. Each thread writes fixed size binary events into its own lock-free ring,
+    // so recording costs two clock reads and a few stores and never waits; the newest events are kept and the older ones
+    // overwritten. A dump writes the events of the last few seconds as a Chrome trace, which chrome://tracing and Perfetto open.
+    // Names must be string literals, or live as long as the process; only the pointer is recorded.
+    class event_trace {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        enum class event_type : uint8_t {
+            complete,
+            counter,
+            instant
+        };
+
+        struct event {
+            const char *name;
+            // Nanoseconds on clock
+            int64_t start;
+            // How long a complete event took, in nanoseconds, or the value of a counter
+            int64_t value;
+            // Optional detail shown with complete and instant events, e.g. a message number
+            int64_t argument;
+            uint32_t thread;
+            event_type type;
+        };
+
+        // Records the time from its construction to its destruction as a complete event
+        class scope {
+        private:
+            const char *_name;
+            int64_t _argument;
+            int64_t _start;
+        public:
+            explicit scope(const char *name, int64_t argument = 0) : _name(name), _argument(argument), _start(get_enabled() ? now() : 0) {}
+            scope(const scope &) = delete;
+            auto operator=(const scope &)->scope& = delete;
+            ~scope() {
+                if (_start != 0) {
+                    complete(_name, _start, now(), _argument);
+                }
+            }
+        };
+
+        static const size_t events_per_thread = 16384;
+    private:
+        struct thread_buffer;
+
+        static std::atomic<bool> _enabled;
+        static std::atomic<long long> _window;
+        static std::atomic<long long> _spike_threshold;
+        static std::atomic<long long> _last_spike;
+        static std::atomic<uint32_t> _next_thread;
+        // Guards the buffer list and the dump state; recording only takes it the first time a thread records
+        static std::mutex _lock;
+        static std::vector<std::unique_ptr<thread_buffer>> _buffers;
+        // The names of threads that exited, as their events can still be in the buffers
+        static std::vector<std::pair<uint32_t, std::string>> _exited;
+        static std::string _dump_folder;
+        static std::thread _dumper;
+        static std::atomic<bool> _dumping;
+
+        static auto get_buffer() -> thread_buffer*;
+        static auto release_buffer(thread_buffer *buffer) -> void;
+        static auto push(const event &e) -> void;
+
+        friend struct thread_slot;
+    public:
+        event_trace() = delete;
+
+        static inline auto now() -> int64_t { return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now().time_since_epoch()).count(); }
+
+        // Recording is on from the start
+        static inline auto get_enabled() -> bool { return _enabled.load(std::memory_order_relaxed); }
+        static auto set_enabled(bool enabled) -> void;
+        // How far back a dump goes; threads that record a lot may have overwritten part of it sooner
+        static auto set_window(std::chrono::nanoseconds window) -> void;
+
+        static auto complete(const char *name, int64_t start, int64_t end, int64_t argument = 0) -> void;
+        static auto counter(const char *name, int64_t value) -> void;
+        static auto instant(const char *name, int64_t argument = 0) -> void;
+        // Shown as the name of the calling thread. Cheap enough to call every time the thread starts a unit of work.
+        static auto set_thread_name(const char *name) -> void;
+
+        // The newest events of every thread within the window, oldest first per thread, and the names of the threads by number
+        static auto snapshot(std::vector<event> &events, std::vector<std::pair<uint32_t, std::string>> &threads) -> void;
+        static auto write_chrome_trace(std::ostream &out, const std::vector<event> &events, const std::vector<std::pair<uint32_t, std::string>> &threads) -> void;
+
+        // A frame taking longer than threshold is a spike; 0 turns spike detection off
+        static auto set_spike_threshold(std::chrono::nanoseconds threshold) -> void;
+        // Returns true if frame_time is a spike that should be dumped. At most one spike per cooldown is reported, so a burst
+        // of slow frames produces one dump, and the dump itself can't cause the next one.
+        static auto try_report_spike(std::chrono::nanoseconds frame_time, std::chrono::nanoseconds cooldown = std::chrono::seconds(30)) -> bool;
+
+        // Dumps are written to folder as <reason>-<local time>.json
+        static auto set_dump_folder(const std::string &folder) -> void;
+        // Take a snapshot now and write it on a background thread. Returns the path of the file, or an empty string if there
+        // is no dump folder or the previous dump is still being written.
+        static auto begin_dump(const char *reason) -> std::string;
+        // Wait for a dump being written
+        static auto shutdown() -> void;
+    };
+}
\ No newline at end of file
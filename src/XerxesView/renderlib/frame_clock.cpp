@@ -0,0 +1,23 @@
+#include "stdafx.h"
+#include "frame_clock.h"
+
+#include <thread>
+
+namespace xerxes
+{
+    auto steady_frame_clock::now() -> std::chrono::nanoseconds
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch());
+    }
+
+    auto steady_frame_clock::wait_until(std::chrono::nanoseconds t) -> void
+    {
+        auto remaining = t - now();
+        if (remaining > _spin) {
+            std::this_thread::sleep_for(remaining - _spin);
+        }
+        while (now() < t) {
+            std::this_thread::yield();
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+namespace xerxes
+{
+    // The time source of the presentation scheduler. Times are relative to an arbitrary epoch.
+    class frame_clock {
+    public:
+        virtual ~frame_clock() = default;
+
+        virtual auto now() -> std::chrono::nanoseconds = 0;
+        // Block until now() >= t
+        virtual auto wait_until(std::chrono::nanoseconds t) -> void = 0;
+    };
+
+    // Real time. Sleeps for most of the wait and spins for the last part, since the OS sleep granularity is coarser than a frame budget allows.
+    class steady_frame_clock : public frame_clock {
+    private:
+        std::chrono::nanoseconds _spin;
+    public:
+        explicit steady_frame_clock(std::chrono::nanoseconds spin = std::chrono::milliseconds(2)) : _spin(spin) {}
+
+        virtual auto now() -> std::chrono::nanoseconds override;
+        virtual auto wait_until(std::chrono::nanoseconds t) -> void override;
+    };
+
+    // Simulated time for deterministic runs: waiting jumps straight to the deadline and work costs nothing unless advance() is called.
+    class simulated_frame_clock : public frame_clock {
+    private:
+        std::atomic<long long> _now;
+    public:
+        explicit simulated_frame_clock(std::chrono::nanoseconds start = std::chrono::nanoseconds(0)) : _now(start.count()) {}
+
+        inline auto advance(std::chrono::nanoseconds d) -> void { _now += d.count(); }
+
+        virtual auto now() -> std::chrono::nanoseconds override { return std::chrono::nanoseconds(_now.load()); }
+        virtual auto wait_until(std::chrono::nanoseconds t) -> void override {
+            auto current = _now.load();
+            while (current < t.count() && !_now.compare_exchange_weak(current, t.count())) {}
+        }
+    };
+}
\ No newline at end of file
@@ -0,0 +1,87 @@
+#include "stdafx.h"
+#include "frame_graph_layer.h"
+
+#include <algorithm>
+
+namespace xerxes
+{
+    const int frame_graph_layer::bar_width;
+
+    namespace
+    {
+        const uint32_t panel_color = 0xc0000000;
+        const uint32_t budget_color = 0xff40c040;
+        const uint32_t bar_color = 0xffc0c0c0;
+        const uint32_t late_color = 0xff2090ff;
+        const uint32_t skipped_color = 0xff2020ff;
+        const int margin = 4;
+
+        // Darken count pixels under the premultiplied panel colour
+        inline auto blend_panel(uint32_t *p, int count) -> void {
+            const uint32_t keep = 255 - (panel_color >> 24);
+            for (int i = 0; i < count; i++) {
+                auto c = p[i];
+                auto rb = ((c & 0x00ff00ff) * keep >> 8) & 0x00ff00ff;
+                auto ag = (((c >> 8) & 0x00ff00ff) * keep) & 0xff00ff00;
+                p[i] = (rb | ag) + panel_color;
+            }
+        }
+    }
+
+    auto frame_graph_layer::set_box(const pixel_rect &box, int graph_height) -> void
+    {
+        invalidate(_box);
+        _box = box;
+        _graph = pixel_rect{ box.left + margin, box.top + margin, box.right - margin, std::min(box.bottom, box.top + margin + graph_height) };
+        _budget_y = _graph.top + _graph.height() / 2;
+        invalidate(_box);
+    }
+
+    auto frame_graph_layer::set_frames(const std::vector<frame_timing> &frames, std::chrono::nanoseconds interval) -> void
+    {
+        auto count = std::min(frames.size(), static_cast<size_t>(std::max(0, _graph.width() / bar_width)));
+        auto first = frames.size() - count;
+        auto scale = interval.count() > 0 ? _graph.height() / (2.0 * interval.count()) : 0.0;
+
+        _bars.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            auto &f = frames[first + i];
+            auto render_time = f.composed != 0 ? f.composed - f.start : 0;
+            auto &b = _bars[i];
+            b.height = std::min(_graph.height(), static_cast<int>(render_time * scale + 0.5));
+            b.color = f.skipped > 0 ? skipped_color : render_time > interval.count() ? late_color : bar_color;
+        }
+        invalidate(_graph);
+    }
+
+    auto frame_graph_layer::render(surface &target, const pixel_rect &clip) -> void
+    {
+        auto area = clip.intersect(_box);
+        if (area.empty()) return;
+
+        for (int y = area.top; y < area.bottom; y++) {
+            blend_panel(target.row(y) + area.left, area.width());
+        }
+
+        // The bars grow up from the bottom of the graph
+        auto graph = area.intersect(_graph);
+        for (int y = graph.top; y < graph.bottom; y++) {
+            auto p = target.row(y);
+            auto height = _graph.bottom - y;
+            auto first = std::max<int>(0, (graph.left - _graph.left) / bar_width);
+            auto last = std::min<int>(static_cast<int>(_bars.size()), (graph.right - _graph.left + bar_width - 1) / bar_width);
+            for (auto i = first; i < last; i++) {
+                auto &b = _bars[i];
+                if (b.height < height) continue;
+                auto x0 = std::max(graph.left, _graph.left + i * bar_width);
+                auto x1 = std::min(graph.right, x0 + bar_width);
+                for (auto x = x0; x < x1; x++) {
+                    p[x] = b.color;
+                }
+            }
+            if (y == _budget_y) {
+                std::fill(p + graph.left, p + graph.right, budget_color);
+            }
+        }
+    }
+}
\ No newline at end of file
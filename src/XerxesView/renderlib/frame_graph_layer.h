@@ -0,0 +1,36 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+#include "layer.h"
+#include "frame_timeline.h"
+
+namespace xerxes
+{
+    // The HUD behind the frame statistics: a translucent panel with a bar per recent frame, as tall as the frame took to render.
+    // The line across is the refresh interval; frames over it are drawn orange, and frames that followed skipped intervals red.
+    class frame_graph_layer : public layer {
+    private:
+        struct bar {
+            int height;
+            uint32_t color;
+        };
+
+        pixel_rect _box{ 0, 0, 0, 0 };
+        pixel_rect _graph{ 0, 0, 0, 0 };
+        std::vector<bar> _bars;
+        int _budget_y = 0;
+    public:
+        static const int bar_width = 2;
+
+        // The panel covers box; the bars fill its top graph_height rows and the rest is left for text
+        auto set_box(const pixel_rect &box, int graph_height) -> void;
+        inline auto get_box() const noexcept -> const pixel_rect& { return _box; }
+
+        // Show the newest frames that fit, oldest on the left. The graph is two intervals tall.
+        auto set_frames(const std::vector<frame_timing> &frames, std::chrono::nanoseconds interval) -> void;
+
+        virtual auto render(surface &target, const pixel_rect &clip) -> void override;
+    };
+}
\ No newline at end of file
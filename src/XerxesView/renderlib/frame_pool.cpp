@@ -0,0 +1,120 @@
+#include "stdafx.h"
+#include "frame_pool.h"
+
+namespace xerxes
+{
+    frame_ref::frame_ref(const frame_ref &other) noexcept
+        : _frame(other._frame)
+    {
+        if (_frame != nullptr) {
+            _frame->refs.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    auto frame_ref::operator=(const frame_ref &other) noexcept -> frame_ref&
+    {
+        if (other._frame != nullptr) {
+            other._frame->refs.fetch_add(1, std::memory_order_relaxed);
+        }
+        reset();
+        _frame = other._frame;
+        return *this;
+    }
+
+    auto frame_ref::operator=(frame_ref &&other) noexcept -> frame_ref&
+    {
+        if (this != &other) {
+            reset();
+            _frame = other._frame;
+            other._frame = nullptr;
+        }
+        return *this;
+    }
+
+    auto frame_ref::reset() noexcept -> void
+    {
+        if (_frame == nullptr) return;
+
+        auto frame = _frame;
+        _frame = nullptr;
+        if (frame->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            auto pool = frame->pool;
+            pool->push_free(frame);
+            pool->release();
+        }
+    }
+
+    frame_pool::frame_pool(uint32_t count, int width, int height)
+        : _frames(new details::pooled_frame[count]), _count(count), _free(0), _refs(1), _waiting(0)
+    {
+        for (uint32_t i = 0; i < count; i++) {
+            auto &f = _frames[i];
+            f.frame.pixels.resize(width, height);
+            f.frame.timestamp = std::chrono::nanoseconds(0);
+            f.frame.duration = std::chrono::nanoseconds(0);
+            f.refs = 0;
+            f.pool = this;
+            push_free(&f);
+        }
+    }
+
+    auto frame_pool::create(size_t count, int width, int height) -> std::shared_ptr<frame_pool>
+    {
+        // The owner holds one reference; frames still out there keep the pool alive after the owner lets go
+        return std::shared_ptr<frame_pool>(new frame_pool(static_cast<uint32_t>(count > 0 ? count : 1), width, height), [](frame_pool *p) { p->release(); });
+    }
+
+    auto frame_pool::push_free(details::pooled_frame *frame) noexcept -> void
+    {
+        auto index = static_cast<uint64_t>(frame - _frames.get()) + 1;
+        auto head = _free.load(std::memory_order_relaxed);
+        uint64_t next;
+        do {
+            frame->next.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+            next = ((head >> 32) + 1) << 32 | index;
+        } while (!_free.compare_exchange_weak(head, next, std::memory_order_release, std::memory_order_relaxed));
+
+        // Either this sees the waiter, or the waiter's next try_acquire sees the frame
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (_waiting.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard<std::mutex> lock(_wait_lock);
+            _returned.notify_all();
+        }
+    }
+
+    auto frame_pool::try_acquire() noexcept -> frame_ref
+    {
+        auto head = _free.load(std::memory_order_acquire);
+        for (;;) {
+            auto index = static_cast<uint32_t>(head);
+            if (index == 0) return frame_ref();
+
+            auto frame = &_frames[index - 1];
+            // If another thread took this frame first the change count moved on and the exchange fails
+            auto next = ((head >> 32) + 1) << 32 | frame->next.load(std::memory_order_relaxed);
+            if (_free.compare_exchange_weak(head, next, std::memory_order_acquire, std::memory_order_acquire)) {
+                frame->refs.store(1, std::memory_order_relaxed);
+                add_ref();
+                return frame_ref(frame);
+            }
+        }
+    }
+
+    auto frame_pool::wake_waiters() -> void
+    {
+        std::lock_guard<std::mutex> lock(_wait_lock);
+        _returned.notify_all();
+    }
+
+    auto frame_pool::add_ref() noexcept -> void
+    {
+        _refs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    auto frame_pool::release() noexcept -> void
+    {
+        if (_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete this;
+        }
+    }
+}
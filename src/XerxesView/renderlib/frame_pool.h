@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include "media_source.h"
+
+namespace xerxes
+{
+    class frame_pool;
+
+    namespace details
+    {
+        struct pooled_frame {
+            video_frame frame;
+            std::atomic<int> refs;
+            std::atomic<uint32_t> next;
+            frame_pool *pool;
+        };
+    }
+
+    // A counted reference to a frame of a frame pool. Copies share the pixels; the buffer goes back to its pool when the last
+    // reference is dropped. Copying never allocates.
+    class frame_ref {
+    private:
+        details::pooled_frame *_frame = nullptr;
+
+        explicit frame_ref(details::pooled_frame *frame) noexcept : _frame(frame) {}
+    public:
+        frame_ref() noexcept = default;
+        frame_ref(const frame_ref &other) noexcept;
+        frame_ref(frame_ref &&other) noexcept : _frame(other._frame) { other._frame = nullptr; }
+        ~frame_ref() noexcept { reset(); }
+
+        auto operator=(const frame_ref &other) noexcept -> frame_ref&;
+        auto operator=(frame_ref &&other) noexcept -> frame_ref&;
+
+        auto reset() noexcept -> void;
+
+        inline explicit operator bool() const noexcept { return _frame != nullptr; }
+        inline auto operator==(std::nullptr_t) const noexcept -> bool { return _frame == nullptr; }
+        inline auto operator!=(std::nullptr_t) const noexcept -> bool { return _frame != nullptr; }
+        inline auto operator*() const noexcept -> video_frame& { return _frame->frame; }
+        inline auto operator->() const noexcept -> video_frame* { return &_frame->frame; }
+
+        friend class frame_pool;
+    };
+
+    // A fixed set of frame buffers, all allocated (aligned) up front. Free buffers are kept on a lock-free stack, so taking and
+    // returning one never blocks or allocates; a decoder that finds the pool empty has to wait for a consumer to drop a frame.
+    // Only when someone waits in acquire_wait does returning a frame take a lock, to wake them.
+    // The pool lives until its owner and every outstanding frame are gone.
+    class frame_pool {
+    private:
+        std::unique_ptr<details::pooled_frame[]> _frames;
+        uint32_t _count;
+        // Index + 1 of the top of the free stack in the low half, a change count in the high half against ABA
+        std::atomic<uint64_t> _free;
+        std::atomic<int> _refs;
+        // Threads in acquire_wait, which a returned frame has to wake
+        std::atomic<int> _waiting;
+        std::mutex _wait_lock;
+        std::condition_variable _returned;
+
+        frame_pool(uint32_t count, int width, int height);
+
+        auto push_free(details::pooled_frame *frame) noexcept -> void;
+        auto add_ref() noexcept -> void;
+        auto release() noexcept -> void;
+    public:
+        frame_pool(const frame_pool &) = delete;
+        auto operator=(const frame_pool &)->frame_pool& = delete;
+
+        static auto create(size_t count, int width, int height) -> std::shared_ptr<frame_pool>;
+
+        // An exclusive frame to decode into, or an empty reference if every buffer is in use
+        auto try_acquire() noexcept -> frame_ref;
+        // An exclusive frame to decode into, waiting for one to be returned if every buffer is in use. Gives up with an empty
+        // reference once stop() returns true; whoever makes it true calls wake_waiters, so the waiter looks again.
+        template<typename _Stop> inline auto acquire_wait(const _Stop &stop) -> frame_ref {
+            auto frame = try_acquire();
+            if (frame != nullptr) return frame;
+
+            std::unique_lock<std::mutex> lock(_wait_lock);
+            _waiting.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            // A frame returned between the check and the wait notifies under the lock, so it can't be missed
+            _returned.wait(lock, [this, &frame, &stop]() {
+                frame = try_acquire();
+                return frame != nullptr || stop();
+            });
+            _waiting.fetch_sub(1, std::memory_order_relaxed);
+            return frame;
+        }
+        inline auto acquire_wait() -> frame_ref { return acquire_wait([]() { return false; }); }
+        // Make the threads in acquire_wait look at their stop condition again
+        auto wake_waiters() -> void;
+
+        inline auto get_count() const noexcept -> size_t { return _count; }
+
+        friend class frame_ref;
+    };
+}
@@ -0,0 +1,104 @@
+#include "stdafx.h"
+#include "frame_queue.h"
+
+namespace xerxes
+{
+    frame_queue::frame_queue(size_t capacity)
+        : _frames(capacity > 0 ? capacity : 1)
+    {
+    }
+
+    auto frame_queue::push(frame_ref frame) -> bool
+    {
+        std::unique_lock<std::mutex> lock(_lock);
+        _not_full.wait(lock, [this]() { return _closed || _size < _frames.size(); });
+        if (_closed) return false;
+
+        _frames[(_first + _size) % _frames.size()] = std::move(frame);
+        _size++;
+        lock.unlock();
+        _not_empty.notify_one();
+        return true;
+    }
+
+    auto frame_queue::peek_timestamp(std::chrono::nanoseconds &timestamp) const -> bool
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        if (_size == 0) return false;
+        timestamp = _frames[_first]->timestamp;
+        return true;
+    }
+
+    auto frame_queue::peek_newest_timestamp(std::chrono::nanoseconds &timestamp) const -> bool
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        if (_size == 0) return false;
+        timestamp = _frames[(_first + _size - 1) % _frames.size()]->timestamp;
+        return true;
+    }
+
+    auto frame_queue::peek() const -> frame_ref
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        return _size > 0 ? _frames[_first] : frame_ref();
+    }
+
+    auto frame_queue::pop() -> frame_ref
+    {
+        frame_ref frame;
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            if (_size == 0) return frame;
+            frame = std::move(_frames[_first]);
+            _first = (_first + 1) % _frames.size();
+            _size--;
+        }
+        _not_full.notify_one();
+        return frame;
+    }
+
+    auto frame_queue::pop_wait() -> frame_ref
+    {
+        frame_ref frame;
+        {
+            std::unique_lock<std::mutex> lock(_lock);
+            _not_empty.wait(lock, [this]() { return _closed || _size > 0; });
+            if (_size == 0) return frame;
+            frame = std::move(_frames[_first]);
+            _first = (_first + 1) % _frames.size();
+            _size--;
+        }
+        _not_full.notify_one();
+        return frame;
+    }
+
+    auto frame_queue::close() -> void
+    {
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            _closed = true;
+        }
+        _not_full.notify_all();
+        _not_empty.notify_all();
+    }
+
+    auto frame_queue::flush() -> void
+    {
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            // Dropping the references hands the buffers back to their pool
+            for (auto &f : _frames) {
+                f.reset();
+            }
+            _first = 0;
+            _size = 0;
+        }
+        _not_full.notify_all();
+    }
+
+    auto frame_queue::size() const -> size_t
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        return _size;
+    }
+}
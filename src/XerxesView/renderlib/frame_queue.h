@@ -0,0 +1,48 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+#include "frame_pool.h"
+
+namespace xerxes
+{
+    // Bounded queue of decoded frames between a decode thread and the compositor. The decoder blocks when the queue is full, which is
+    // what paces decoding to playback. The queue only moves frame references around; its slots are allocated once.
+    // An export runs it the other way around, from the compositor to the threads that write the frames out.
+    class frame_queue {
+    private:
+        mutable std::mutex _lock;
+        std::condition_variable _not_full;
+        std::condition_variable _not_empty;
+        std::vector<frame_ref> _frames;
+        size_t _first = 0;
+        size_t _size = 0;
+        bool _closed = false;
+    public:
+        explicit frame_queue(size_t capacity);
+
+        // Blocks while the queue is full. Returns false if the queue was closed.
+        auto push(frame_ref frame) -> bool;
+
+        // Timestamp of the oldest queued frame. Returns false if the queue is empty.
+        auto peek_timestamp(std::chrono::nanoseconds &timestamp) const -> bool;
+        // Timestamp of the newest queued frame
+        auto peek_newest_timestamp(std::chrono::nanoseconds &timestamp) const -> bool;
+        // Another reference to the oldest queued frame, which stays queued. An empty reference if the queue is empty.
+        auto peek() const -> frame_ref;
+        // An empty reference if the queue is empty
+        auto pop() -> frame_ref;
+        // Blocks while the queue is empty. An empty reference once the queue is closed and drained.
+        auto pop_wait() -> frame_ref;
+
+        // Wake up and refuse the producer, e.g. when the decoder is shutting down, and let the consumer drain what is queued
+        auto close() -> void;
+        // Drop all queued frames, e.g. after a seek
+        auto flush() -> void;
+
+        auto size() const -> size_t;
+        inline auto capacity() const noexcept -> size_t { return _frames.size(); }
+    };
+}
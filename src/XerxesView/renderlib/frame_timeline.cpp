@@ -0,0 +1,114 @@
+#include "stdafx.h"
+#include "frame_timeline.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace xerxes
+{
+    const size_t frame_timeline::history;
+
+    namespace
+    {
+        inline auto to_ms(int64_t ns) -> double { return ns / 1e6; }
+    }
+
+    auto frame_timeline::record_frame(const frame_timing & timing) -> void
+    {
+        _frames.push(timing);
+        if (timing.skipped > 0) {
+            _total_skipped.fetch_add(timing.skipped, std::memory_order_relaxed);
+        }
+    }
+
+    auto frame_timeline::record_present(const present_timing & timing) -> void
+    {
+        _presents.push(timing);
+    }
+
+    auto frame_timeline::get_frames(std::vector<frame_timing>& frames, size_t count) const -> void
+    {
+        _frames.snapshot(frames, count);
+    }
+
+    auto frame_timeline::summarize(std::chrono::nanoseconds now) const -> frame_timeline_summary
+    {
+        std::vector<frame_timing> frames;
+        std::vector<present_timing> presents;
+        _frames.snapshot(frames);
+        _presents.snapshot(presents);
+
+        frame_timeline_summary summary{};
+        summary.frames = _frames.get_written();
+        summary.total_skipped = _total_skipped.load(std::memory_order_relaxed);
+        auto since = now.count() - 1000000000LL;
+
+        // Composed frames by index, to find how long each present waited
+        std::unordered_map<uint64_t, int64_t> composed;
+        size_t rendered = 0;
+        double render_total = 0.0;
+        for (auto &f : frames) {
+            if (f.composed != 0) {
+                composed[f.index] = f.composed;
+            }
+            if (f.start < since) continue;
+            auto render_ms = to_ms((f.composed != 0 ? f.composed : f.start) - f.start);
+            render_total += render_ms;
+            summary.worst_render_ms = std::max(summary.worst_render_ms, render_ms);
+            summary.skipped += f.skipped;
+            rendered++;
+        }
+        if (rendered > 0) {
+            summary.average_render_ms = render_total / rendered;
+        }
+        if (!frames.empty()) {
+            auto &last = frames.back();
+            summary.decode_ms = last.decode_ms;
+            summary.decode_queue = last.decode_queue;
+            summary.command_queue = last.command_queue;
+        }
+
+        size_t presented = 0, waited = 0;
+        double wait_total = 0.0;
+        for (auto &p : presents) {
+            if (p.presented < since) continue;
+            presented++;
+            auto c = composed.find(p.index);
+            if (c != composed.end()) {
+                wait_total += to_ms(p.presented - c->second);
+                waited++;
+            }
+        }
+        summary.presents_per_second = static_cast<double>(presented);
+        if (waited > 0) {
+            summary.average_present_ms = wait_total / waited;
+        }
+        return summary;
+    }
+
+    auto frame_timeline::write_csv(std::ostream & out) const -> void
+    {
+        std::vector<frame_timing> frames;
+        std::vector<present_timing> presents;
+        _frames.snapshot(frames);
+        _presents.snapshot(presents);
+
+        // A frame may be presented more than once (the window was uncovered); the first one counts
+        std::unordered_map<uint64_t, const present_timing*> first_present;
+        for (auto &p : presents) {
+            first_present.emplace(p.index, &p);
+        }
+
+        out << "index,deadline_ms,start_ms,composed_ms,presented_ms,vblank_ms,render_ms,skipped,decode_ms,decode_queue,command_queue\n";
+        out.setf(std::ios::fixed);
+        out.precision(3);
+        for (auto &f : frames) {
+            auto p = first_present.find(f.index);
+            auto presented = p != first_present.end() ? p->second->presented : 0;
+            auto vblank = p != first_present.end() ? p->second->vblank : 0;
+            out << f.index << ',' << to_ms(f.deadline) << ',' << to_ms(f.start) << ',' << to_ms(f.composed) << ','
+                << to_ms(presented) << ',' << to_ms(vblank) << ',' << (f.composed != 0 ? to_ms(f.composed - f.start) : 0.0) << ','
+                << f.skipped << ',' << f.decode_ms << ',' << f.decode_queue << ',' << f.command_queue << '\n';
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+#include "history_ring.h"
+
+namespace xerxes
+{
+    // One pass of the canvas render callback. Times are on the frame clock, in nanoseconds.
+    struct frame_timing {
+        uint64_t index;
+        // The vblank the frame is meant for
+        int64_t deadline;
+        int64_t start;
+        // When compose finished, or 0 if nothing was damaged
+        int64_t composed;
+        // Intervals skipped before this frame because an earlier one ran late
+        uint32_t skipped;
+        // The video decoder's most recent frame, and the frames it has queued
+        float decode_ms;
+        uint16_t decode_queue;
+        // Commands from the control window waiting when the frame started
+        uint16_t command_queue;
+    };
+
+    // A composed frame copied to the window
+    struct present_timing {
+        uint64_t index;
+        int64_t presented;
+        // The first vblank after the copy, when the display compositor reports one, otherwise 0
+        int64_t vblank;
+    };
+
+    struct frame_timeline_summary {
+        // Over the last second
+        double presents_per_second;
+        double average_render_ms;
+        double worst_render_ms;
+        // From compose to the copy to the window
+        double average_present_ms;
+        double decode_ms;
+        uint64_t skipped;
+        // Since the timeline started
+        uint64_t total_skipped;
+        uint64_t frames;
+        size_t decode_queue;
+        size_t command_queue;
+    };
+
+    // The recent history of the canvas pipeline. Frames are recorded by the render thread and presents by the window thread,
+    // each into its own lock-free ring, so recording never waits for the HUD or an export that reads them.
+    class frame_timeline {
+    public:
+        static const size_t history = 1024;
+    private:
+        history_ring<frame_timing, history> _frames;
+        history_ring<present_timing, history> _presents;
+        std::atomic<uint64_t> _total_skipped;
+    public:
+        frame_timeline() : _total_skipped(0) {}
+
+        // Render thread only
+        auto record_frame(const frame_timing &timing) -> void;
+        // Window thread only
+        auto record_present(const present_timing &timing) -> void;
+
+        auto get_frames(std::vector<frame_timing> &frames, size_t count = history) const -> void;
+        auto summarize(std::chrono::nanoseconds now) const -> frame_timeline_summary;
+
+        // Comma separated, one line per frame with its present joined in, times in milliseconds on the frame clock
+        auto write_csv(std::ostream &out) const -> void;
+    };
+}
\ No newline at end of file
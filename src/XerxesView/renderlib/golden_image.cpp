@@ -0,0 +1,126 @@
+#include "stdafx.h"
+#include "golden_image.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <vector>
+
+namespace xerxes
+{
+    namespace
+    {
+        inline auto channel_difference(uint32_t a, uint32_t b) -> int
+        {
+            auto d = 0;
+            for (int shift = 0; shift < 24; shift += 8) {
+                d = std::max(d, std::abs(static_cast<int>((a >> shift) & 0xff) - static_cast<int>((b >> shift) & 0xff)));
+            }
+            return d;
+        }
+
+        // The header fields are separated by whitespace and may be interleaved with # comments
+        auto read_header_value(std::istream &in, int &value) -> bool
+        {
+            while (in) {
+                auto c = in.peek();
+                if (c == '#') {
+                    std::string comment;
+                    std::getline(in, comment);
+                }
+                else if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+                    in.get();
+                }
+                else {
+                    break;
+                }
+            }
+            return static_cast<bool>(in >> value);
+        }
+    }
+
+    auto golden_image::try_write(const std::string &path, const surface &image) -> bool
+    {
+        std::ofstream out(path, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+
+        out << "P6\n" << image.width() << ' ' << image.height() << "\n255\n";
+        std::vector<char> row(static_cast<size_t>(image.width()) * 3);
+        for (int y = 0; y < image.height(); y++) {
+            auto src = image.row(y);
+            for (int x = 0; x < image.width(); x++) {
+                row[x * 3] = static_cast<char>((src[x] >> 16) & 0xff);
+                row[x * 3 + 1] = static_cast<char>((src[x] >> 8) & 0xff);
+                row[x * 3 + 2] = static_cast<char>(src[x] & 0xff);
+            }
+            out.write(row.data(), row.size());
+        }
+        return static_cast<bool>(out);
+    }
+
+    auto golden_image::try_read(const std::string &path, surface &image) -> bool
+    {
+        std::ifstream in(path, std::ios::in | std::ios::binary);
+        if (!in) return false;
+
+        char magic[2];
+        int width, height, max_value;
+        if (!in.read(magic, 2) || magic[0] != 'P' || magic[1] != '6') return false;
+        if (!read_header_value(in, width) || !read_header_value(in, height) || !read_header_value(in, max_value)) return false;
+        if (width <= 0 || height <= 0 || max_value != 255) return false;
+        // Exactly one whitespace character ends the header
+        in.get();
+
+        image.resize(width, height);
+        std::vector<unsigned char> row(static_cast<size_t>(width) * 3);
+        for (int y = 0; y < height; y++) {
+            if (!in.read(reinterpret_cast<char*>(row.data()), row.size())) return false;
+            auto dst = image.row(y);
+            for (int x = 0; x < width; x++) {
+                dst[x] = 0xff000000 | (static_cast<uint32_t>(row[x * 3]) << 16) | (static_cast<uint32_t>(row[x * 3 + 1]) << 8) | row[x * 3 + 2];
+            }
+        }
+        return true;
+    }
+
+    auto golden_image::compare(const surface &actual, const surface &expected, const golden_tolerance &tolerance) -> image_difference
+    {
+        image_difference result{};
+        if (actual.width() != expected.width() || actual.height() != expected.height()) {
+            result.size_mismatch = true;
+            result.differing_fraction = 1.0;
+            return result;
+        }
+
+        for (int y = 0; y < actual.height(); y++) {
+            auto a = actual.row(y);
+            auto e = expected.row(y);
+            for (int x = 0; x < actual.width(); x++) {
+                if (a[x] == e[x]) continue;
+                auto d = channel_difference(a[x], e[x]);
+                result.max_channel = std::max(result.max_channel, d);
+                if (d > tolerance.channel) {
+                    result.differing_pixels++;
+                }
+            }
+        }
+        auto pixels = static_cast<uint64_t>(actual.width()) * actual.height();
+        result.differing_fraction = pixels == 0 ? 0.0 : static_cast<double>(result.differing_pixels) / pixels;
+        return result;
+    }
+
+    auto golden_image::make_difference(const surface &actual, const surface &expected, const golden_tolerance &tolerance, surface &difference) -> void
+    {
+        auto width = std::min(actual.width(), expected.width());
+        auto height = std::min(actual.height(), expected.height());
+        difference.resize(width, height);
+        for (int y = 0; y < height; y++) {
+            auto a = actual.row(y);
+            auto e = expected.row(y);
+            auto d = difference.row(y);
+            for (int x = 0; x < width; x++) {
+                d[x] = channel_difference(a[x], e[x]) > tolerance.channel ? 0xffffffff : 0xff000000 | ((e[x] >> 2) & 0x003f3f3f);
+            }
+        }
+    }
+}
\ No newline at end of file
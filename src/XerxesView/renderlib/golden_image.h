@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "surface.h"
+
+namespace xerxes
+{
+    // How far a rendered frame may be from its golden image and still match. Scaling and blending may round differently
+    // between instruction sets, so exact equality is too strict.
+    struct golden_tolerance {
+        // Largest difference of any colour channel that still counts as equal
+        int channel;
+        // Fraction of the pixels that may differ by more than that
+        double pixels;
+    };
+
+    struct image_difference {
+        int max_channel;
+        uint64_t differing_pixels;
+        double differing_fraction;
+        bool size_mismatch;
+
+        inline auto within(const golden_tolerance &tolerance) const noexcept -> bool {
+            return !size_mismatch && differing_fraction <= tolerance.pixels;
+        }
+    };
+
+    // Golden frames are kept as binary PPM (RGB, 8 bits per channel), which any image viewer opens and which diffs exactly.
+    // The canvas is opaque, so dropping alpha loses nothing.
+    class golden_image {
+    public:
+        golden_image() = delete;
+
+        static auto try_write(const std::string &path, const surface &image) -> bool;
+        static auto try_read(const std::string &path, surface &image) -> bool;
+
+        static auto compare(const surface &actual, const surface &expected, const golden_tolerance &tolerance) -> image_difference;
+        // White where the channels differ by more than the tolerance, the expected image dimmed elsewhere
+        static auto make_difference(const surface &actual, const surface &expected, const golden_tolerance &tolerance, surface &difference) -> void;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,264 @@
+#include "stdafx.h"
+#include "headless_renderer.h"
+#include "canvas_pipeline.h"
+#include "reference_glyph_rasterizer.h"
+#include "synthetic_media_source.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+
+namespace xerxes
+{
+    namespace
+    {
+        // Scripts are UTF-8
+        auto to_wide(const std::string &s) -> std::wstring
+        {
+            std::wstring result;
+            for (size_t i = 0; i < s.size(); i++) {
+                auto c = static_cast<unsigned char>(s[i]);
+                uint32_t codepoint = c;
+                auto extra = c >= 0xf0 ? 3 : c >= 0xe0 ? 2 : c >= 0xc0 ? 1 : 0;
+                if (extra > 0) {
+                    codepoint = c & (0x3f >> extra);
+                    for (int k = 0; k < extra && i + 1 < s.size(); k++) {
+                        codepoint = (codepoint << 6) | (static_cast<unsigned char>(s[++i]) & 0x3f);
+                    }
+                }
+                result.push_back(static_cast<wchar_t>(codepoint));
+            }
+            return result;
+        }
+
+        auto unescape(const std::string &s) -> std::string
+        {
+            std::string result;
+            for (size_t i = 0; i < s.size(); i++) {
+                if (s[i] == '\\' && i + 1 < s.size() && s[i + 1] == 'n') {
+                    result.push_back('\n');
+                    i++;
+                }
+                else {
+                    result.push_back(s[i]);
+                }
+            }
+            return result;
+        }
+
+        auto try_parse_command(std::istream &line, canvas_command &command) -> bool
+        {
+            std::string verb;
+            line >> verb;
+            if (verb == "go") {
+                int64_t slide;
+                if (!(line >> slide)) return false;
+                command = canvas_command::go_to_slide(slide);
+            }
+            else if (verb == "stage" || verb == "take") {
+                int64_t value;
+                if (!(line >> value)) return false;
+                command = verb == "stage" ? canvas_command::stage(value) : canvas_command::take(std::chrono::milliseconds(value));
+            }
+            else if (verb == "play" || verb == "blank") {
+                int on;
+                if (!(line >> on)) return false;
+                command = verb == "play" ? canvas_command::play(on != 0) : canvas_command::blank(on != 0);
+            }
+            else if (verb == "layer") {
+                std::string layer;
+                int on;
+                if (!(line >> layer >> on)) return false;
+                if (layer == "media") command = canvas_command::set_layer(canvas_layer_id::media, on != 0);
+                else if (layer == "overlay") command = canvas_command::set_layer(canvas_layer_id::overlay, on != 0);
+                else if (layer == "hud") command = canvas_command::set_layer(canvas_layer_id::hud, on != 0);
+                else return false;
+            }
+            else {
+                return false;
+            }
+            return true;
+        }
+    }
+
+    auto scene_script::try_parse(std::istream &in, scene_script &script, std::string &error) -> bool
+    {
+        script = scene_script();
+        std::string text;
+        for (int number = 1; std::getline(in, text); number++) {
+            if (!text.empty() && text.back() == '\r') text.pop_back();
+            auto first = text.find_first_not_of(" \t");
+            if (first == std::string::npos || text[first] == '#') continue;
+
+            std::istringstream line(text.substr(first));
+            std::string keyword;
+            line >> keyword;
+            auto ok = true;
+            if (keyword == "size") {
+                ok = static_cast<bool>(line >> script.width >> script.height) && script.width > 0 && script.height > 0;
+            }
+            else if (keyword == "refresh") {
+                ok = static_cast<bool>(line >> script.refresh_rate) && script.refresh_rate > 1.0;
+            }
+            else if (keyword == "frames") {
+                ok = static_cast<bool>(line >> script.frames);
+            }
+            else if (keyword == "slide" || keyword == "cue") {
+                std::string rest;
+                std::getline(line >> std::ws, rest);
+                (keyword == "slide" ? script.slides : script.cues).push_back(to_wide(unescape(rest)));
+            }
+            else if (keyword == "at") {
+                scene_action action{};
+                std::string verb;
+                ok = static_cast<bool>(line >> action.frame);
+                if (ok && line.peek() != EOF) {
+                    auto position = line.tellg();
+                    line >> verb;
+                    if (verb == "capture") {
+                        action.type = scene_action_type::capture;
+                        ok = static_cast<bool>(line >> action.name);
+                    }
+                    else {
+                        line.seekg(position);
+                        action.type = scene_action_type::command;
+                        ok = try_parse_command(line, action.command);
+                    }
+                }
+                if (ok) {
+                    script.actions.push_back(action);
+                }
+            }
+            else {
+                ok = false;
+            }
+            if (!ok) {
+                error = "line " + std::to_string(number) + ": " + text;
+                return false;
+            }
+        }
+
+        // Actions of the same frame keep the order they were written in
+        std::stable_sort(script.actions.begin(), script.actions.end(), [](const scene_action &a, const scene_action &b) { return a.frame < b.frame; });
+        return true;
+    }
+
+    auto headless_result::passed() const -> bool
+    {
+        for (auto &c : captures) {
+            if (!c.matched) return false;
+        }
+        return true;
+    }
+
+    auto headless_result::format() const -> std::string
+    {
+        std::ostringstream out;
+        char line[256];
+        for (auto &c : captures) {
+            if (c.golden_missing) {
+                std::snprintf(line, sizeof(line), "%-24s frame %5llu  no golden frame\n", c.name.c_str(), static_cast<unsigned long long>(c.frame));
+            }
+            else {
+                std::snprintf(line, sizeof(line), "%-24s frame %5llu  %s  %llu pixels differ (%.4f%%), max channel difference %d\n",
+                    c.name.c_str(), static_cast<unsigned long long>(c.frame), c.matched ? "match   " : "MISMATCH",
+                    static_cast<unsigned long long>(c.difference.differing_pixels), c.difference.differing_fraction * 100.0, c.difference.max_channel);
+            }
+            out << line;
+        }
+        std::snprintf(line, sizeof(line), "%llu frames, average %.3f ms, p99 %.3f ms, worst %.3f ms\n",
+            static_cast<unsigned long long>(frames), average_ms, p99_ms, worst_ms);
+        out << line;
+        return out.str();
+    }
+
+    auto headless_renderer::open_synthetic(const std::wstring &url) -> std::unique_ptr<media_source>
+    {
+        const std::wstring prefix = L"synthetic:";
+        if (url.compare(0, prefix.size(), prefix) != 0) return nullptr;
+
+        int width = 0, height = 0;
+        double rate = 0.0;
+        unsigned long long frames = 0;
+        std::string spec(url.begin() + prefix.size(), url.end());
+        if (std::sscanf(spec.c_str(), "%dx%d@%lf/%llu", &width, &height, &rate, &frames) < 3 || width <= 0 || height <= 0) return nullptr;
+        return std::unique_ptr<media_source>(new synthetic_media_source(width, height, rate, frames));
+    }
+
+    auto headless_renderer::run(const scene_script &script, const headless_options &options) -> headless_result
+    {
+        headless_result result{};
+        simulated_frame_clock clock;
+        thread_pool pool(options.threads);
+        canvas_pipeline pipeline(clock, std::make_shared<reference_glyph_rasterizer>(), open_synthetic, &pool);
+        pipeline.set_deterministic(true);
+        pipeline.resize(script.width, script.height);
+        pipeline.set_slide_texts(script.slides);
+        pipeline.set_cues(script.cues);
+
+        size_t next_action = 0;
+        damage_region damage;
+        surface canvas, golden, difference;
+        presentation_scheduler scheduler(clock, script.refresh_rate, [&](const frame_info &frame) {
+            auto first = next_action;
+            while (next_action < script.actions.size() && script.actions[next_action].frame <= frame.index) {
+                auto &action = script.actions[next_action++];
+                if (action.type == scene_action_type::command) {
+                    pipeline.post(action.command);
+                }
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            pipeline.render_frame(frame, damage);
+            auto elapsed = std::chrono::steady_clock::now() - start - pipeline.get_last_wait();
+            result.frame_ms.push_back(std::chrono::duration<float, std::milli>(elapsed).count());
+
+            for (auto i = first; i < next_action; i++) {
+                auto &action = script.actions[i];
+                if (action.type != scene_action_type::capture) continue;
+
+                pipeline.read_target([&](const surface &target) {
+                    canvas.resize(target.width(), target.height());
+                    for (int y = 0; y < target.height(); y++) {
+                        std::copy(target.row(y), target.row(y) + target.width(), canvas.row(y));
+                    }
+                });
+                headless_capture capture{ action.name, frame.index, false, false, image_difference{} };
+                auto path = options.golden_folder + action.name;
+                if (options.update_goldens) {
+                    capture.matched = golden_image::try_write(path + ".ppm", canvas);
+                }
+                else if (!golden_image::try_read(path + ".ppm", golden)) {
+                    capture.golden_missing = true;
+                    golden_image::try_write(path + ".actual.ppm", canvas);
+                }
+                else {
+                    capture.difference = golden_image::compare(canvas, golden, options.tolerance);
+                    capture.matched = capture.difference.within(options.tolerance);
+                    if (!capture.matched) {
+                        golden_image::try_write(path + ".actual.ppm", canvas);
+                        golden_image::make_difference(canvas, golden, options.tolerance, difference);
+                        golden_image::try_write(path + ".diff.ppm", difference);
+                    }
+                }
+                result.captures.push_back(capture);
+            }
+        });
+        scheduler.run_frames(script.frames);
+        pipeline.release_media();
+
+        result.frames = result.frame_ms.size();
+        if (!result.frame_ms.empty()) {
+            std::vector<float> sorted(result.frame_ms);
+            std::sort(sorted.begin(), sorted.end());
+            double total = 0.0;
+            for (auto ms : sorted) {
+                total += ms;
+            }
+            result.average_ms = total / sorted.size();
+            result.p99_ms = sorted[std::min(sorted.size() - 1, sorted.size() * 99 / 100)];
+            result.worst_ms = sorted.back();
+        }
+        return result;
+    }
+}
\ No newline at end of file
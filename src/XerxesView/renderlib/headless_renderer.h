@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "canvas_command.h"
+#include "golden_image.h"
+#include "media_source.h"
+
+namespace xerxes
+{
+    enum class scene_action_type {
+        command,
+        // Compare the composed canvas with the golden frame of the same name
+        capture
+    };
+
+    struct scene_action {
+        uint64_t frame;
+        scene_action_type type;
+        canvas_command command;
+        std::string name;
+    };
+
+    // What the headless renderer plays. Scripts are text, one statement per line, # starts a comment:
+    //   size 1280 720              the canvas size
+    //   refresh 60                 frames per second
+    //   frames 120                 how many frames to render
+    //   slide Amazing grace\nhow   appends a slide; \n breaks the line
+    //   cue synthetic:640x360@30   appends a cue; synthetic media is the only kind a headless run opens
+    //   at 10 go 1                 at frame 10 post a command: go <slide>, play 0|1, blank 0|1, layer media|overlay|hud 0|1,
+    //                              stage <slide>, take <dissolve ms>
+    //   at 10 capture name         after frame 10 compare the canvas with the golden frame name
+    struct scene_script {
+        int width = 1280;
+        int height = 720;
+        double refresh_rate = 60.0;
+        uint64_t frames = 0;
+        std::vector<std::wstring> slides;
+        std::vector<std::wstring> cues;
+        // In frame order
+        std::vector<scene_action> actions;
+
+        // On failure error says which line was wrong
+        static auto try_parse(std::istream &in, scene_script &script, std::string &error) -> bool;
+    };
+
+    struct headless_options {
+        // Golden frames are <folder><name>.ppm. A frame that doesn't match is written next to its golden as <name>.actual.ppm
+        // together with <name>.diff.ppm.
+        std::string golden_folder;
+        golden_tolerance tolerance{ 2, 0.0 };
+        // Write the captures as the new golden frames instead of comparing
+        bool update_goldens = false;
+        // Tile rendering threads; 0 for one per core
+        size_t threads = 0;
+    };
+
+    struct headless_capture {
+        std::string name;
+        uint64_t frame;
+        bool matched;
+        bool golden_missing;
+        image_difference difference;
+    };
+
+    struct headless_result {
+        uint64_t frames;
+        // Wall time each frame took to render, without the time spent waiting for media
+        std::vector<float> frame_ms;
+        double average_ms;
+        double p99_ms;
+        double worst_ms;
+        std::vector<headless_capture> captures;
+
+        auto passed() const -> bool;
+        // One line per capture and one with the frame times
+        auto format() const -> std::string;
+    };
+
+    // Runs the canvas pipeline without a window, on a simulated clock, into an offscreen canvas. Cues and video frames are
+    // waited for instead of dropped and text uses the reference font, so the same script renders the same frames on every
+    // machine, and those are compared with golden frames. Frame times are real, so a run also catches a slower pipeline.
+    // The suite is the scenes folder next to the solution; XerxesScenes runs it.
+    class headless_renderer {
+    public:
+        headless_renderer() = delete;
+
+        // Opens synthetic:<width>x<height>@<fps>[/<frames>]; nullptr for anything else
+        static auto open_synthetic(const std::wstring &url) -> std::unique_ptr<media_source>;
+
+        static auto run(const scene_script &script, const headless_options &options) -> headless_result;
+    };
+}
\ No newline at end of file
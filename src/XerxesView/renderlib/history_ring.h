@@ -0,0 +1,68 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+#include "padded.h"
+
+namespace xerxes
+{
+    // The most recent Capacity records written by one thread, readable from any number of others. The writer never waits:
+    // every slot has a sequence number that is odd while the slot is written, so a reader copies a slot and keeps the copy
+    // only if the sequence didn't change meanwhile. Records must be plain data. Capacity must be a power of two.
+    template<typename T, size_t Capacity> class history_ring {
+        static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+        static_assert(std::is_trivially_copyable<T>::value, "Records are copied while they may be written");
+    private:
+        struct slot {
+            std::atomic<uint64_t> sequence;
+            T value;
+        };
+
+        slot _slots[Capacity];
+        // Read by every reader before it looks at a slot, so kept off the line of the slot written last
+        padded<std::atomic<uint64_t>> _written;
+    public:
+        history_ring() noexcept : _written(0) {
+            for (auto &s : _slots) {
+                s.sequence.store(0, std::memory_order_relaxed);
+            }
+        }
+        history_ring(const history_ring &) = delete;
+        auto operator=(const history_ring &)->history_ring& = delete;
+
+        // Writer only
+        inline auto push(const T &value) noexcept -> void {
+            auto n = _written.value.load(std::memory_order_relaxed);
+            auto &s = _slots[n & (Capacity - 1)];
+            s.sequence.store(2 * n + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            s.value = value;
+            s.sequence.store(2 * n + 2, std::memory_order_release);
+            _written.value.store(n + 1, std::memory_order_release);
+        }
+
+        // Any thread: the newest count records, oldest first. Records the writer overwrote during the copy are left out.
+        auto snapshot(std::vector<T> &records, size_t count = Capacity) const -> void {
+            records.clear();
+            auto written = _written.value.load(std::memory_order_acquire);
+            auto first = written - std::min<uint64_t>(written, std::min(count, Capacity));
+            for (auto n = first; n < written; n++) {
+                auto &s = _slots[n & (Capacity - 1)];
+                auto before = s.sequence.load(std::memory_order_acquire);
+                if (before != 2 * n + 2) continue;
+                T copy = s.value;
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (s.sequence.load(std::memory_order_relaxed) != before) continue;
+                records.push_back(copy);
+            }
+        }
+
+        // How many records were ever written
+        inline auto get_written() const noexcept -> uint64_t { return _written.value.load(std::memory_order_acquire); }
+        inline auto capacity() const noexcept -> size_t { return Capacity; }
+    };
+}
\ No newline at end of file
@@ -0,0 +1,321 @@
+#include "stdafx.h"
+#include "image_scaler.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace xerxes
+{
+    std::mutex image_scaler::_cache_lock;
+    std::map<image_scaler::bank_key, std::shared_ptr<const filter_bank>> image_scaler::_cache;
+
+    namespace
+    {
+        const double pi = 3.14159265358979323846;
+
+        auto filter_support(scale_filter filter) -> double
+        {
+            switch (filter) {
+            case scale_filter::bilinear: return 1.0;
+            case scale_filter::bicubic: return 2.0;
+            default: return 3.0;
+            }
+        }
+
+        auto sinc(double x) -> double
+        {
+            if (x == 0.0) return 1.0;
+            x *= pi;
+            return std::sin(x) / x;
+        }
+
+        auto filter_kernel(scale_filter filter, double x) -> double
+        {
+            x = std::fabs(x);
+            switch (filter) {
+            case scale_filter::bilinear:
+                return x < 1.0 ? 1.0 - x : 0.0;
+            case scale_filter::bicubic:
+                {
+                    // Catmull-Rom (a = -0.5)
+                    const double a = -0.5;
+                    if (x < 1.0) return ((a + 2.0) * x - (a + 3.0)) * x * x + 1.0;
+                    if (x < 2.0) return ((a * x - 5.0 * a) * x + 8.0 * a) * x - 4.0 * a;
+                    return 0.0;
+                }
+            default:
+                return x < 3.0 ? sinc(x) * sinc(x / 3.0) : 0.0;
+            }
+        }
+
+        inline auto clamp_byte(int v) -> uint8_t
+        {
+            return static_cast<uint8_t>(v < 0 ? 0 : (v > 255 ? 255 : v));
+        }
+
+        const int rounding = 1 << (filter_bank::precision - 1);
+
+        // Scratch row between the two passes, kept per thread so steady state scaling does not allocate
+        thread_local std::vector<uint8_t> scratch;
+        thread_local std::vector<const uint8_t*> scratch_rows;
+    }
+
+    filter_bank::filter_bank(int src_size, int dst_size, scale_filter filter)
+        : _src_size(src_size), _dst_size(dst_size)
+    {
+        auto scale = static_cast<double>(src_size) / dst_size;
+        auto filter_scale = std::max(scale, 1.0);
+        auto support = filter_support(filter) * filter_scale;
+
+        _taps = std::min(static_cast<int>(std::ceil(support)) * 2 + 1, src_size);
+        // An even number of taps lets the SIMD kernels consume taps in pairs
+        if ((_taps & 1) != 0 && _taps < src_size) _taps++;
+
+        _offsets.resize(dst_size);
+        _weights.resize(static_cast<size_t>(dst_size) * _taps);
+
+        std::vector<double> w(_taps);
+        for (int i = 0; i < dst_size; i++) {
+            auto center = (i + 0.5) * scale - 0.5;
+            auto left = static_cast<int>(std::ceil(center - support));
+            auto right = static_cast<int>(std::floor(center + support));
+            auto start = std::min(std::max(left, 0), src_size - _taps);
+
+            std::fill(w.begin(), w.end(), 0.0);
+            double total = 0.0;
+            for (int j = left; j <= right; j++) {
+                auto k = filter_kernel(filter, (j - center) / filter_scale);
+                if (k == 0.0) continue;
+                // Samples outside the source are folded onto the edge
+                auto index = std::min(std::max(j, 0), src_size - 1) - start;
+                if (index < 0 || index >= _taps) continue;
+                w[index] += k;
+                total += k;
+            }
+            if (total == 0.0) {
+                w[std::min(std::max(static_cast<int>(center + 0.5), 0), src_size - 1) - start] = total = 1.0;
+            }
+
+            auto fixed = _weights.data() + static_cast<size_t>(i) * _taps;
+            int sum = 0, largest = 0;
+            for (int t = 0; t < _taps; t++) {
+                fixed[t] = static_cast<int16_t>(std::lround(w[t] / total * (1 << precision)));
+                sum += fixed[t];
+                if (std::abs(fixed[t]) > std::abs(fixed[largest])) largest = t;
+            }
+            // Make the weights sum to exactly one so flat areas stay flat
+            fixed[largest] = static_cast<int16_t>(fixed[largest] + (1 << precision) - sum);
+            _offsets[i] = start;
+        }
+    }
+
+    auto image_scaler::get_filter_bank(int src_size, int dst_size, scale_filter filter) -> std::shared_ptr<const filter_bank>
+    {
+        std::lock_guard<std::mutex> lock(_cache_lock);
+        auto key = std::make_tuple(src_size, dst_size, filter);
+        auto i = _cache.find(key);
+        if (i != _cache.end()) return i->second;
+
+        // Outputs rarely change size, so anything beyond a handful of entries is stale
+        if (_cache.size() >= 64) _cache.clear();
+
+        auto bank = std::make_shared<const filter_bank>(src_size, dst_size, filter);
+        _cache.emplace(key, bank);
+        return bank;
+    }
+
+    auto image_scaler::clear_cache() -> void
+    {
+        std::lock_guard<std::mutex> lock(_cache_lock);
+        _cache.clear();
+    }
+
+    auto image_scaler::horizontal_pass(const uint8_t *src, uint8_t *dst, const filter_bank &bank) -> void
+    {
+        auto taps = bank.taps();
+        auto width = bank.dst_size();
+#if XERXES_SSE2
+        if ((taps & 1) == 0) {
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i round = _mm_set1_epi32(rounding);
+            for (int x = 0; x < width; x++) {
+                auto s = src + bank.offset(x) * 4;
+                auto w = bank.weights(x);
+                __m128i acc = round;
+                int t = 0;
+                for (; t + 4 <= taps; t += 4) {
+                    // [b0 g0 r0 a0 b1 g1 r1 a1] -> [b0 b1 g0 g1 r0 r1 a0 a1] so one madd applies two taps
+                    __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + t * 4));
+                    __m128i wv = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(w + t));
+                    __m128i lo = _mm_unpacklo_epi8(p, zero);
+                    __m128i hi = _mm_unpackhi_epi8(p, zero);
+                    lo = _mm_unpacklo_epi16(lo, _mm_srli_si128(lo, 8));
+                    hi = _mm_unpacklo_epi16(hi, _mm_srli_si128(hi, 8));
+                    acc = _mm_add_epi32(acc, _mm_madd_epi16(lo, _mm_shuffle_epi32(wv, 0x00)));
+                    acc = _mm_add_epi32(acc, _mm_madd_epi16(hi, _mm_shuffle_epi32(wv, 0x55)));
+                }
+                if (t < taps) {
+                    __m128i p = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(s + t * 4)), zero);
+                    p = _mm_unpacklo_epi16(p, _mm_srli_si128(p, 8));
+                    __m128i wv = _mm_shuffle_epi32(_mm_cvtsi32_si128(*reinterpret_cast<const int*>(w + t)), 0x00);
+                    acc = _mm_add_epi32(acc, _mm_madd_epi16(p, wv));
+                }
+                acc = _mm_srai_epi32(acc, filter_bank::precision);
+                acc = _mm_packs_epi32(acc, acc);
+                acc = _mm_packus_epi16(acc, acc);
+                *reinterpret_cast<int*>(dst + x * 4) = _mm_cvtsi128_si32(acc);
+            }
+            return;
+        }
+#endif
+        for (int x = 0; x < width; x++) {
+            auto s = src + bank.offset(x) * 4;
+            auto w = bank.weights(x);
+            int b = rounding, g = rounding, r = rounding, a = rounding;
+            for (int t = 0; t < taps; t++) {
+                b += s[t * 4 + 0] * w[t];
+                g += s[t * 4 + 1] * w[t];
+                r += s[t * 4 + 2] * w[t];
+                a += s[t * 4 + 3] * w[t];
+            }
+            dst[x * 4 + 0] = clamp_byte(b >> filter_bank::precision);
+            dst[x * 4 + 1] = clamp_byte(g >> filter_bank::precision);
+            dst[x * 4 + 2] = clamp_byte(r >> filter_bank::precision);
+            dst[x * 4 + 3] = clamp_byte(a >> filter_bank::precision);
+        }
+    }
+
+    auto image_scaler::vertical_pass(const uint8_t * const *rows, uint8_t *dst, int width, const int16_t *weights, int taps) -> void
+    {
+        int x = 0;
+#if XERXES_SSE2
+        if ((taps & 1) == 0) {
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i round = _mm_set1_epi32(rounding);
+            for (; x + 4 <= width; x += 4) {
+                __m128i acc0 = round, acc1 = round, acc2 = round, acc3 = round;
+                for (int t = 0; t < taps; t += 2) {
+                    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[t] + x * 4));
+                    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[t + 1] + x * 4));
+                    __m128i wv = _mm_shuffle_epi32(_mm_cvtsi32_si128(*reinterpret_cast<const int*>(weights + t)), 0x00);
+                    __m128i alo = _mm_unpacklo_epi8(a, zero), blo = _mm_unpacklo_epi8(b, zero);
+                    __m128i ahi = _mm_unpackhi_epi8(a, zero), bhi = _mm_unpackhi_epi8(b, zero);
+                    acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(_mm_unpacklo_epi16(alo, blo), wv));
+                    acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(_mm_unpackhi_epi16(alo, blo), wv));
+                    acc2 = _mm_add_epi32(acc2, _mm_madd_epi16(_mm_unpacklo_epi16(ahi, bhi), wv));
+                    acc3 = _mm_add_epi32(acc3, _mm_madd_epi16(_mm_unpackhi_epi16(ahi, bhi), wv));
+                }
+                __m128i lo = _mm_packs_epi32(_mm_srai_epi32(acc0, filter_bank::precision), _mm_srai_epi32(acc1, filter_bank::precision));
+                __m128i hi = _mm_packs_epi32(_mm_srai_epi32(acc2, filter_bank::precision), _mm_srai_epi32(acc3, filter_bank::precision));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 4), _mm_packus_epi16(lo, hi));
+            }
+        }
+#endif
+        for (auto i = x * 4; i < width * 4; i++) {
+            int v = rounding;
+            for (int t = 0; t < taps; t++) {
+                v += rows[t][i] * weights[t];
+            }
+            dst[i] = clamp_byte(v >> filter_bank::precision);
+        }
+    }
+
+    auto image_scaler::scale_rows(const uint8_t *src, ptrdiff_t src_stride, uint8_t *dst, ptrdiff_t dst_stride, const filter_bank &horizontal, const filter_bank &vertical, int y0, int y1) -> void
+    {
+        if (y0 >= y1) return;
+
+        // Vertical first: the expensive horizontal pass then only runs once per destination row and strips never overlap
+        auto src_width = horizontal.src_size();
+        auto taps = vertical.taps();
+
+        scratch.resize(static_cast<size_t>(src_width) * 4);
+        scratch_rows.resize(taps);
+        for (int y = y0; y < y1; y++) {
+            auto offset = vertical.offset(y);
+            for (int t = 0; t < taps; t++) {
+                scratch_rows[t] = src + (offset + t) * src_stride;
+            }
+            vertical_pass(scratch_rows.data(), scratch.data(), src_width, vertical.weights(y), taps);
+            horizontal_pass(scratch.data(), dst + y * dst_stride, horizontal);
+        }
+    }
+
+    auto image_scaler::scale_rows(const row_source &src, uint8_t *dst, ptrdiff_t dst_stride, const filter_bank &horizontal, const filter_bank &vertical, int y0, int y1) -> void
+    {
+        if (y0 >= y1) return;
+
+        auto src_width = horizontal.src_size();
+        auto taps = vertical.taps();
+
+        scratch.resize(static_cast<size_t>(src_width) * 4);
+        scratch_rows.resize(taps);
+        for (int y = y0; y < y1; y++) {
+            auto offset = vertical.offset(y);
+            for (int t = 0; t < taps; t++) {
+                scratch_rows[t] = src(offset + t);
+            }
+            vertical_pass(scratch_rows.data(), scratch.data(), src_width, vertical.weights(y), taps);
+            horizontal_pass(scratch.data(), dst + y * dst_stride, horizontal);
+        }
+    }
+
+    auto image_scaler::scale(const surface &src, surface &dst, scale_filter filter, thread_pool *pool) -> void
+    {
+        if (src.empty() || dst.empty()) return;
+
+        auto horizontal = get_filter_bank(src.width(), dst.width(), filter);
+        auto vertical = get_filter_bank(src.height(), dst.height(), filter);
+        if (pool == nullptr) {
+            scale_rows(src.data(), src.stride(), dst.data(), dst.stride(), *horizontal, *vertical, 0, dst.height());
+            return;
+        }
+
+        // A few strips per thread so the threads that finish early can steal the rest
+        auto strips = static_cast<int>(std::min<size_t>(pool->get_concurrency() * 4, static_cast<size_t>(dst.height())));
+        auto strip_height = (dst.height() + strips - 1) / strips;
+        pool->parallel_for(static_cast<size_t>(strips), [&](size_t s) {
+            auto y0 = static_cast<int>(s) * strip_height;
+            scale_rows(src.data(), src.stride(), dst.data(), dst.stride(), *horizontal, *vertical, y0, std::min(y0 + strip_height, dst.height()));
+        });
+    }
+
+    auto image_scaler::halve(const surface &src, surface &dst) -> void
+    {
+        auto width = src.width() / 2;
+        auto height = src.height() / 2;
+        dst.resize(width, height);
+        for (int y = 0; y < height; y++) {
+            auto a = reinterpret_cast<const uint8_t*>(src.row(y * 2));
+            auto b = reinterpret_cast<const uint8_t*>(src.row(y * 2 + 1));
+            auto d = reinterpret_cast<uint8_t*>(dst.row(y));
+            int x = 0;
+#if XERXES_SSE2
+            // Four destination pixels from two rows of eight, summed exactly in 16 bits
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i two = _mm_set1_epi16(2);
+            for (; x + 4 <= width; x += 4) {
+                __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + x * 8));
+                __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + x * 8));
+                __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + x * 8 + 16));
+                __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + x * 8 + 16));
+                // Pixels 0-1 and 2-3 of each group of four, both rows added
+                __m128i lo0 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero));
+                __m128i hi0 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero));
+                __m128i lo1 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(b1, zero));
+                __m128i hi1 = _mm_add_epi16(_mm_unpackhi_epi8(a1, zero), _mm_unpackhi_epi8(b1, zero));
+                // Even pixels plus odd pixels
+                __m128i s0 = _mm_add_epi16(_mm_unpacklo_epi64(lo0, hi0), _mm_unpackhi_epi64(lo0, hi0));
+                __m128i s1 = _mm_add_epi16(_mm_unpacklo_epi64(lo1, hi1), _mm_unpackhi_epi64(lo1, hi1));
+                s0 = _mm_srli_epi16(_mm_add_epi16(s0, two), 2);
+                s1 = _mm_srli_epi16(_mm_add_epi16(s1, two), 2);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(d + x * 4), _mm_packus_epi16(s0, s1));
+            }
+#endif
+            for (auto i = x * 4; i < width * 4; i++) {
+                auto c = (i & ~3) * 2 + (i & 3);
+                d[i] = static_cast<uint8_t>((a[c] + a[c + 4] + b[c] + b[c + 4] + 2) >> 2);
+            }
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <map>
+#include <tuple>
+#include <vector>
+#include "surface.h"
+#include "thread_pool.h"
+
+namespace xerxes
+{
+    enum class scale_filter {
+        bilinear,
+        bicubic,
+        lanczos3
+    };
+
+    // The weights to resample one axis from src_size to dst_size samples. Every destination sample reads taps() consecutive
+    // source samples starting at offset(i); the window is clamped to the source so the kernels never need bounds checks.
+    class filter_bank {
+    private:
+        int _src_size;
+        int _dst_size;
+        int _taps;
+        std::vector<int> _offsets;
+        std::vector<int16_t> _weights;
+    public:
+        // Weights are fixed point with this many fraction bits and sum to exactly 1 << precision
+        static constexpr int precision = 14;
+
+        filter_bank(int src_size, int dst_size, scale_filter filter);
+
+        inline auto src_size() const noexcept -> int { return _src_size; }
+        inline auto dst_size() const noexcept -> int { return _dst_size; }
+        inline auto taps() const noexcept -> int { return _taps; }
+        inline auto offset(int i) const noexcept -> int { return _offsets[i]; }
+        inline auto weights(int i) const noexcept -> const int16_t* { return _weights.data() + static_cast<size_t>(i) * _taps; }
+    };
+
+    // Separable resampler for BGRA surfaces. Filter banks are computed once per source/destination size pair and cached.
+    class image_scaler {
+    public:
+        // Produces source row y (BGRA) on demand. The rows of one filter window are requested together and must stay valid until
+        // the next window is requested, and windows only move down.
+        using row_source = std::function<const uint8_t*(int y)>;
+    private:
+        using bank_key = std::tuple<int, int, scale_filter>;
+
+        static std::mutex _cache_lock;
+        static std::map<bank_key, std::shared_ptr<const filter_bank>> _cache;
+
+        static auto horizontal_pass(const uint8_t *src, uint8_t *dst, const filter_bank &bank) -> void;
+        static auto vertical_pass(const uint8_t * const *rows, uint8_t *dst, int width, const int16_t *weights, int taps) -> void;
+    public:
+        image_scaler() = delete;
+
+        static auto get_filter_bank(int src_size, int dst_size, scale_filter filter) -> std::shared_ptr<const filter_bank>;
+        static auto clear_cache() -> void;
+
+        // Scale the whole of src into dst. With a pool the destination is split into horizontal strips that its threads render.
+        static auto scale(const surface &src, surface &dst, scale_filter filter, thread_pool *pool = nullptr) -> void;
+
+        // A 2x2 box filter: dst becomes half of src in both directions, odd sizes rounded down. Much cheaper than scale for
+        // previews and thumbnails of the canvas.
+        static auto halve(const surface &src, surface &dst) -> void;
+
+        // Render destination rows [y0, y1) only. src and dst may be sub-rectangles of larger buffers.
+        static auto scale_rows(const uint8_t *src, ptrdiff_t src_stride, uint8_t *dst, ptrdiff_t dst_stride, const filter_bank &horizontal, const filter_bank &vertical, int y0, int y1) -> void;
+        // The same, pulling the source rows from a producer, so a conversion can be fused with the scale without a full intermediate image
+        static auto scale_rows(const row_source &src, uint8_t *dst, ptrdiff_t dst_stride, const filter_bank &horizontal, const filter_bank &vertical, int y0, int y1) -> void;
+    };
+}
\ No newline at end of file
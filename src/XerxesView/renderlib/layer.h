@@ -0,0 +1,60 @@
+#pragma once
+
+#include <chrono>
+#include "surface.h"
+#include "damage_region.h"
+#include "thread_pool.h"
+
+namespace xerxes
+{
+    // Something drawn on the canvas. A layer reports the areas it changed since it was last collected, and is only asked to render
+    // the parts of the canvas that are damaged.
+    class layer {
+    private:
+        damage_region _damage;
+        bool _visible = true;
+    protected:
+        int _width = 0;
+        int _height = 0;
+
+        inline auto invalidate(const pixel_rect &r) -> void { _damage.add(r.intersect(pixel_rect::from_size(_width, _height))); }
+        inline auto invalidate_all() -> void { _damage.add(pixel_rect::from_size(_width, _height)); }
+    public:
+        layer() = default;
+        layer(const layer &) = delete;
+        auto operator=(const layer &)->layer& = delete;
+        virtual ~layer() = default;
+
+        // Move the damage accumulated since the last call into damage
+        inline auto collect_damage(damage_region &damage) -> void {
+            damage.add(_damage);
+            _damage.clear();
+        }
+
+        // The canvas changed size. Everything the layer draws is damaged.
+        virtual auto resize(int width, int height) -> void {
+            _width = width;
+            _height = height;
+            invalidate_all();
+        }
+
+        // Called once per frame before the damage is collected, with the time the frame will be presented
+        virtual auto advance(std::chrono::nanoseconds now) -> void {}
+
+        inline auto get_visible() const noexcept -> bool { return _visible; }
+        inline auto set_visible(bool visible) -> void {
+            if (_visible != visible) {
+                _visible = visible;
+                invalidate_all();
+            }
+        }
+
+        // Called once on the compositing thread before a frame is rendered, for work that has to happen before render is called
+        // for several clips at the same time. pool, if not nullptr, is the compositor's pool for spreading that work.
+        virtual auto prepare(thread_pool *pool) -> void {}
+
+        // Draw the part of the layer inside clip over the content already in target. The clips of one frame don't overlap and may
+        // be rendered concurrently, so render must not change the layer.
+        virtual auto render(surface &target, const pixel_rect &clip) -> void = 0;
+    };
+}
\ No newline at end of file
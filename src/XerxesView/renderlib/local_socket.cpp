@@ -0,0 +1,218 @@
+#include "stdafx.h"
+#include "local_socket.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace xerxes
+{
+    namespace
+    {
+#ifdef _WIN32
+        // Winsock has to be started once per process; it is left running until the process ends
+        auto start_sockets() -> bool
+        {
+            static const bool started = []() {
+                WSADATA data;
+                return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+            }();
+            return started;
+        }
+
+        inline auto close_handle(local_socket::handle h) -> void { closesocket(static_cast<SOCKET>(h)); }
+        const int send_flags = 0;
+#else
+        inline auto start_sockets() -> bool { return true; }
+        inline auto close_handle(local_socket::handle h) -> void { ::close(h); }
+        // A receiver that goes away must not kill the canvas with SIGPIPE
+        const int send_flags = MSG_NOSIGNAL;
+#endif
+
+        auto loopback(uint16_t port) -> sockaddr_in
+        {
+            sockaddr_in address = {};
+            address.sin_family = AF_INET;
+            address.sin_port = htons(port);
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            return address;
+        }
+
+        auto open_stream() -> local_socket::handle
+        {
+            if (!start_sockets()) return local_socket::invalid_handle;
+            auto s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+#ifdef _WIN32
+            if (s == INVALID_SOCKET) return local_socket::invalid_handle;
+#else
+            if (s < 0) return local_socket::invalid_handle;
+#endif
+            return static_cast<local_socket::handle>(s);
+        }
+
+        // Frames are sent whole, so waiting to fill packets only adds latency
+        auto set_no_delay(local_socket::handle h) -> void
+        {
+            int on = 1;
+            setsockopt(h, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&on), sizeof(on));
+        }
+
+        auto set_send_timeout(local_socket::handle h, std::chrono::milliseconds timeout) -> void
+        {
+#ifdef _WIN32
+            DWORD ms = static_cast<DWORD>(timeout.count());
+            setsockopt(h, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&ms), sizeof(ms));
+#else
+            timeval wait;
+            wait.tv_sec = static_cast<long>(timeout.count() / 1000);
+            wait.tv_usec = static_cast<long>(timeout.count() % 1000 * 1000);
+            setsockopt(h, SOL_SOCKET, SO_SNDTIMEO, &wait, sizeof(wait));
+#endif
+        }
+
+        // The canvas can listen again right after it stopped, but nothing else can take the port while it listens
+        auto set_address_use(local_socket::handle h) -> void
+        {
+            int on = 1;
+#ifdef _WIN32
+            setsockopt(h, SOL_SOCKET, SO_EXCLUSIVEADDRUSE, reinterpret_cast<const char*>(&on), sizeof(on));
+#else
+            setsockopt(h, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&on), sizeof(on));
+#endif
+        }
+    }
+
+#ifdef _WIN32
+    const local_socket::handle local_socket::invalid_handle = static_cast<local_socket::handle>(INVALID_SOCKET);
+#else
+    const local_socket::handle local_socket::invalid_handle = -1;
+#endif
+
+    auto local_socket::operator=(local_socket &&other) noexcept -> local_socket&
+    {
+        if (this != &other) {
+            close();
+            _handle = other._handle;
+            other._handle = invalid_handle;
+        }
+        return *this;
+    }
+
+    auto local_socket::try_listen(uint16_t port, local_socket &listener) -> bool
+    {
+        local_socket s(open_stream());
+        if (!s.is_open()) return false;
+
+        set_address_use(s._handle);
+        auto address = loopback(port);
+        if (bind(s._handle, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) return false;
+        if (listen(s._handle, SOMAXCONN) != 0) return false;
+        listener = std::move(s);
+        return true;
+    }
+
+    auto local_socket::try_connect(uint16_t port, local_socket &connection) -> bool
+    {
+        local_socket s(open_stream());
+        if (!s.is_open()) return false;
+
+        auto address = loopback(port);
+        if (connect(s._handle, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) return false;
+        set_no_delay(s._handle);
+        connection = std::move(s);
+        return true;
+    }
+
+    auto local_socket::wait_readable(std::chrono::milliseconds timeout) -> bool
+    {
+        fd_set readable;
+        FD_ZERO(&readable);
+#ifdef _WIN32
+        FD_SET(static_cast<SOCKET>(_handle), &readable);
+#else
+        FD_SET(_handle, &readable);
+#endif
+        timeval wait;
+        wait.tv_sec = static_cast<long>(timeout.count() / 1000);
+        wait.tv_usec = static_cast<long>(timeout.count() % 1000 * 1000);
+        // The first argument is ignored by Winsock
+        return select(static_cast<int>(_handle) + 1, &readable, nullptr, nullptr, &wait) > 0;
+    }
+
+    auto local_socket::try_accept(local_socket &connection, std::chrono::milliseconds send_timeout) -> bool
+    {
+        auto h = accept(_handle, nullptr, nullptr);
+#ifdef _WIN32
+        if (h == INVALID_SOCKET) return false;
+#else
+        if (h < 0) return false;
+#endif
+        local_socket s(static_cast<handle>(h));
+        set_no_delay(s._handle);
+        set_send_timeout(s._handle, send_timeout);
+        connection = std::move(s);
+        return true;
+    }
+
+    auto local_socket::get_port() const -> uint16_t
+    {
+        sockaddr_in address = {};
+        socklen_t size = sizeof(address);
+        if (getsockname(_handle, reinterpret_cast<sockaddr*>(&address), &size) != 0) return 0;
+        return ntohs(address.sin_port);
+    }
+
+    auto local_socket::try_send(const void *data, size_t size) -> bool
+    {
+        auto p = static_cast<const char*>(data);
+        while (size > 0) {
+            // Winsock takes an int; a frame is sent in pieces well under that
+            auto chunk = static_cast<int>(size < (1u << 30) ? size : (1u << 30));
+            auto sent = send(_handle, p, chunk, send_flags);
+            if (sent <= 0) return false;
+            p += sent;
+            size -= static_cast<size_t>(sent);
+        }
+        return true;
+    }
+
+    auto local_socket::try_receive(void *data, size_t size) -> bool
+    {
+        auto p = static_cast<char*>(data);
+        while (size > 0) {
+            auto chunk = static_cast<int>(size < (1u << 30) ? size : (1u << 30));
+            auto received = recv(_handle, p, chunk, 0);
+            if (received <= 0) return false;
+            p += received;
+            size -= static_cast<size_t>(received);
+        }
+        return true;
+    }
+
+    auto local_socket::shutdown() noexcept -> void
+    {
+        if (!is_open()) return;
+#ifdef _WIN32
+        ::shutdown(static_cast<SOCKET>(_handle), SD_BOTH);
+#else
+        ::shutdown(_handle, SHUT_RDWR);
+#endif
+    }
+
+    auto local_socket::close() noexcept -> void
+    {
+        if (!is_open()) return;
+        close_handle(_handle);
+        _handle = invalid_handle;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace xerxes
+{
+    // A blocking TCP socket on the loopback interface. The outputs only talk to processes on the same machine, so nothing
+    // listens beyond 127.0.0.1; whatever forwards the stream further is up to the receiver.
+    class local_socket {
+    public:
+#ifdef _WIN32
+        using handle = uintptr_t;
+#else
+        using handle = int;
+#endif
+        static const handle invalid_handle;
+    private:
+        handle _handle;
+
+        explicit local_socket(handle h) noexcept : _handle(h) {}
+    public:
+        local_socket() noexcept : _handle(invalid_handle) {}
+        local_socket(const local_socket &) = delete;
+        local_socket(local_socket &&other) noexcept : _handle(other._handle) { other._handle = invalid_handle; }
+        ~local_socket() noexcept { close(); }
+
+        auto operator=(const local_socket &)->local_socket& = delete;
+        auto operator=(local_socket &&other) noexcept -> local_socket&;
+
+        // Listen on 127.0.0.1:port. Port 0 picks a free port; get_port tells which.
+        static auto try_listen(uint16_t port, local_socket &listener) -> bool;
+        static auto try_connect(uint16_t port, local_socket &connection) -> bool;
+
+        // Whether data, or a connection on a listener, arrives within timeout
+        auto wait_readable(std::chrono::milliseconds timeout) -> bool;
+        // Take a connection; blocks unless wait_readable said one is there. Sends on the connection fail after send_timeout
+        // instead of waiting for a peer that stopped reading; what was sent of the data is then unknown, so close it.
+        auto try_accept(local_socket &connection, std::chrono::milliseconds send_timeout) -> bool;
+        auto get_port() const -> uint16_t;
+
+        // Send all of data. Returns false if the peer went away.
+        auto try_send(const void *data, size_t size) -> bool;
+        // Receive exactly size bytes. Returns false if the peer went away first.
+        auto try_receive(void *data, size_t size) -> bool;
+
+        // Make a send or receive blocked on another thread fail; call close once that thread has let go
+        auto shutdown() noexcept -> void;
+        auto close() noexcept -> void;
+        inline auto is_open() const noexcept -> bool { return _handle != invalid_handle; }
+    };
+}
\ No newline at end of file
@@ -0,0 +1,74 @@
+#include "stdafx.h"
+#include "media_decoder.h"
+
+namespace xerxes
+{
+    media_decoder::media_decoder(std::unique_ptr<media_source> source, size_t queue_depth, size_t spare_frames)
+        : _source(std::move(source)), _info(_source->get_info()), _pool(frame_pool::create(queue_depth + 1 + spare_frames, _info.width, _info.height)),
+          _queue(queue_depth), _running(false), _end_of_stream(false), _frames_decoded(0), _decode_time(0), _last_decode_time(0), _buffer_waits(0)
+    {
+    }
+
+    media_decoder::~media_decoder()
+    {
+        stop();
+    }
+
+    auto media_decoder::start() -> void
+    {
+        if (_running.exchange(true)) return;
+        _thread = std::thread([this]() { run(); });
+    }
+
+    auto media_decoder::stop() -> void
+    {
+        _running = false;
+        // A decoder waiting for a buffer gives up
+        _pool->wake_waiters();
+        _queue.close();
+        if (_thread.joinable()) {
+            _thread.join();
+        }
+    }
+
+    auto media_decoder::run() -> void
+    {
+        while (_running.load()) {
+            auto frame = _pool->try_acquire();
+            if (frame == nullptr) {
+                // Everything is queued or still on screen somewhere, so sleep until a consumer drops a frame
+                _buffer_waits++;
+                frame = _pool->acquire_wait([this]() { return !_running.load(); });
+                if (frame == nullptr) break;
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            if (!_source->read_frame(*frame)) {
+                _end_of_stream = true;
+                break;
+            }
+            auto decode_time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+            _decode_time += decode_time;
+            _last_decode_time = decode_time;
+            _frames_decoded++;
+
+            // Blocks while the compositor is far enough ahead
+            if (!_queue.push(std::move(frame))) break;
+        }
+    }
+
+    auto media_decoder::get_statistics() const -> decoder_statistics
+    {
+        decoder_statistics stats{};
+        stats.frames_decoded = _frames_decoded.load();
+        auto decode_time = _decode_time.load();
+        if (stats.frames_decoded > 0 && decode_time > 0) {
+            stats.average_decode_ms = decode_time / 1e6 / stats.frames_decoded;
+            stats.decode_rate = stats.frames_decoded * 1e9 / decode_time;
+        }
+        stats.last_decode_ms = _last_decode_time.load() / 1e6;
+        stats.queue_depth = _queue.size();
+        stats.buffer_waits = _buffer_waits.load();
+        return stats;
+    }
+}
\ No newline at end of file
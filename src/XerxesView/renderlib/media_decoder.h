@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "media_source.h"
+#include "frame_pool.h"
+#include "frame_queue.h"
+
+namespace xerxes
+{
+    struct decoder_statistics {
+        uint64_t frames_decoded;
+        double average_decode_ms;
+        double last_decode_ms;
+        // Decoded frames per second of decode thread time, i.e. how far ahead of real time the source could run
+        double decode_rate;
+        size_t queue_depth;
+        // Times the decoder had to wait because every pooled buffer was still referenced
+        uint64_t buffer_waits;
+    };
+
+    // Runs a media source on its own thread and feeds the decoded frames into a bounded frame queue. The frames are decoded
+    // straight into pooled buffers, which the consumers share without copying.
+    class media_decoder {
+    private:
+        std::unique_ptr<media_source> _source;
+        media_info _info;
+        std::shared_ptr<frame_pool> _pool;
+        frame_queue _queue;
+        std::thread _thread;
+        std::atomic<bool> _running;
+        std::atomic<bool> _end_of_stream;
+
+        std::atomic<uint64_t> _frames_decoded;
+        std::atomic<long long> _decode_time;
+        std::atomic<long long> _last_decode_time;
+        std::atomic<uint64_t> _buffer_waits;
+
+        auto run() -> void;
+    public:
+        // Besides the queued frames, the pool has a buffer being decoded into and spare_frames for the consumers to hold on to
+        explicit media_decoder(std::unique_ptr<media_source> source, size_t queue_depth = 4, size_t spare_frames = 3);
+        media_decoder(const media_decoder &) = delete;
+        auto operator=(const media_decoder &)->media_decoder& = delete;
+        ~media_decoder();
+
+        auto start() -> void;
+        auto stop() -> void;
+
+        inline auto get_info() const noexcept -> const media_info& { return _info; }
+        inline auto get_queue() noexcept -> frame_queue& { return _queue; }
+        // The source ran out. Frames may still be queued.
+        inline auto get_end_of_stream() const noexcept -> bool { return _end_of_stream.load(); }
+
+        auto get_statistics() const -> decoder_statistics;
+    };
+}
\ No newline at end of file
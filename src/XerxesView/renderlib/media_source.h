@@ -0,0 +1,36 @@
+#pragma once
+
+#include <chrono>
+#include "surface.h"
+
+namespace xerxes
+{
+    struct media_info {
+        int width;
+        int height;
+        double frame_rate;
+        // Zero when unknown or endless
+        std::chrono::nanoseconds duration;
+    };
+
+    // One decoded picture and where it sits on the media timeline
+    struct video_frame {
+        surface pixels;
+        std::chrono::nanoseconds timestamp;
+        std::chrono::nanoseconds duration;
+    };
+
+    // Something that produces decoded frames in presentation order. Sources are only used from one thread at a time (the decode thread).
+    class media_source {
+    public:
+        virtual ~media_source() = default;
+
+        virtual auto get_info() const -> media_info = 0;
+
+        // Decode the next frame into frame, reusing its pixel buffer when the size matches. Returns false at the end of the stream.
+        virtual auto read_frame(video_frame &frame) -> bool = 0;
+
+        // Position the source so the next frame read is the first one at or after position
+        virtual auto seek(std::chrono::nanoseconds position) -> bool = 0;
+    };
+}
\ No newline at end of file
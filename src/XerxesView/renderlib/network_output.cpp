@@ -0,0 +1,222 @@
+#include "stdafx.h"
+#include "network_output.h"
+#include "event_trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace xerxes
+{
+    namespace
+    {
+        // How often the accept thread looks whether it should stop
+        const std::chrono::milliseconds accept_poll(100);
+        // A receiver that takes longer than this to take a message has stopped reading, and would hold up everyone else
+        const std::chrono::milliseconds send_timeout(500);
+        // How long the bytes per second are averaged over, at least
+        const std::chrono::seconds rate_window(1);
+
+        auto copy_rect(const surface &from, surface &to, const pixel_rect &r) -> void
+        {
+            for (int y = r.top; y < r.bottom; y++) {
+                std::memcpy(to.row(y) + r.left, from.row(y) + r.left, static_cast<size_t>(r.width()) * sizeof(uint32_t));
+            }
+        }
+    }
+
+    const uint16_t network_output::default_port;
+
+    network_output::~network_output()
+    {
+        stop();
+    }
+
+    auto network_output::try_start(uint16_t port) -> bool
+    {
+        stop();
+        if (!local_socket::try_listen(port, _listener)) return false;
+
+        _running = true;
+        _accept_thread = std::thread([this]() { accept(); });
+        _send_thread = std::thread([this]() { send(); });
+        return true;
+    }
+
+    auto network_output::stop() -> void
+    {
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            _running = false;
+            // A receiver that stopped reading would keep the sender blocked
+            for (auto &r : _receivers) {
+                r.socket->shutdown();
+            }
+        }
+        _wake.notify_all();
+        if (_accept_thread.joinable()) {
+            _accept_thread.join();
+        }
+        if (_send_thread.joinable()) {
+            _send_thread.join();
+        }
+        _receivers.clear();
+        _receiver_count = 0;
+        _listener.close();
+    }
+
+    auto network_output::publish(const surface &canvas, const damage_region &damage, uint64_t index) -> void
+    {
+        if (_receiver_count.load(std::memory_order_acquire) == 0) return;
+
+        auto full = _needs_canvas.exchange(false);
+        if (!full && damage.empty()) return;
+
+        std::lock_guard<std::mutex> lock(_lock);
+        if (_latest.width() != canvas.width() || _latest.height() != canvas.height()) {
+            _latest.resize(canvas.width(), canvas.height());
+            full = true;
+        }
+        if (full) {
+            copy_rect(canvas, _latest, canvas.bounds());
+            _pending.add(canvas.bounds());
+        }
+        else {
+            for (auto &r : damage.rects()) {
+                auto area = r.intersect(canvas.bounds());
+                copy_rect(canvas, _latest, area);
+                _pending.add(area);
+            }
+        }
+        if (_dirty) {
+            _merged++;
+        }
+        _index = index;
+        _dirty = true;
+        _wake.notify_one();
+    }
+
+    auto network_output::accept() -> void
+    {
+        event_trace::set_thread_name("network output accept");
+        for (;;) {
+            {
+                std::lock_guard<std::mutex> lock(_lock);
+                if (!_running) return;
+            }
+            local_socket connection;
+            if (!_listener.wait_readable(accept_poll) || !_listener.try_accept(connection, send_timeout)) continue;
+
+            std::lock_guard<std::mutex> lock(_lock);
+            if (!_running) return;
+            _receivers.push_back(receiver{ std::make_shared<local_socket>(std::move(connection)), false });
+            // The render thread only kept the damaged parts while there was someone to send them to. Ask for the canvas
+            // before the count lets it publish, or its first frame might be an empty one.
+            _needs_canvas = true;
+            _receiver_count = _receivers.size();
+            _wake.notify_one();
+        }
+    }
+
+    auto network_output::take_pending(damage_region &damage) -> void
+    {
+        if (_current.width() != _latest.width() || _current.height() != _latest.height()) {
+            _current.resize(_latest.width(), _latest.height());
+            _pending.add(_latest.bounds());
+        }
+        for (auto &r : _pending.rects()) {
+            copy_rect(_latest, _current, r);
+        }
+        damage = _pending;
+        _pending.clear();
+    }
+
+    auto network_output::send() -> void
+    {
+        event_trace::set_thread_name("network output");
+        std::unique_lock<std::mutex> lock(_lock);
+        for (;;) {
+            _wake.wait(lock, [this]() { return !_running || _dirty; });
+            if (!_running) return;
+
+            damage_region damage;
+            take_pending(damage);
+            auto index = _index;
+            _dirty = false;
+            auto receivers = _receivers;
+            lock.unlock();
+
+            auto start = std::chrono::steady_clock::now();
+            uint32_t tiles;
+            {
+                event_trace::scope trace("encode frame");
+                tiles = _encoder.encode(_current, damage, index, _message);
+                _key.clear();
+                if (std::any_of(receivers.begin(), receivers.end(), [](const receiver &r) { return !r.has_key; })) {
+                    _encoder.encode_key(index, _key);
+                }
+            }
+            _encode_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+            _encoded++;
+
+            // Receivers that have a frame get what changed; the ones that just connected get the whole of it instead. A send
+            // that timed out may have sent part of a message, so that receiver is dropped like one that went away.
+            std::vector<std::shared_ptr<local_socket>> failed;
+            std::vector<std::shared_ptr<local_socket>> keyed;
+            uint64_t sent = 0;
+            for (auto &r : receivers) {
+                auto &message = r.has_key ? _message : _key;
+                if (message.empty()) continue;
+                if (!r.socket->try_send(message.data(), message.size())) {
+                    failed.push_back(r.socket);
+                    continue;
+                }
+                sent += message.size();
+                if (!r.has_key) {
+                    keyed.push_back(r.socket);
+                    _key_frames++;
+                }
+            }
+            if (!_message.empty()) {
+                _frames++;
+                _tiles += tiles;
+            }
+            _bytes += sent;
+
+            lock.lock();
+            for (auto &r : _receivers) {
+                if (std::find(keyed.begin(), keyed.end(), r.socket) != keyed.end()) {
+                    r.has_key = true;
+                }
+            }
+            _receivers.erase(std::remove_if(_receivers.begin(), _receivers.end(), [&](const receiver &r) {
+                return std::find(failed.begin(), failed.end(), r.socket) != failed.end();
+            }), _receivers.end());
+            _receiver_count = _receivers.size();
+        }
+    }
+
+    auto network_output::get_statistics() const -> network_output_statistics
+    {
+        auto encoded = _encoded.load();
+        auto bytes = _bytes.load();
+        uint64_t bytes_per_second;
+        {
+            // Worked out here rather than by the sender, which doesn't run while nothing changes
+            std::lock_guard<std::mutex> lock(_rate_lock);
+            auto now = std::chrono::steady_clock::now();
+            if (_rate_start == std::chrono::steady_clock::time_point()) {
+                _rate_start = now;
+                _rate_bytes = bytes;
+            }
+            else if (now - _rate_start >= rate_window) {
+                _bytes_per_second = (bytes - _rate_bytes) * 1000000000ull / std::chrono::duration_cast<std::chrono::nanoseconds>(now - _rate_start).count();
+                _rate_start = now;
+                _rate_bytes = bytes;
+            }
+            bytes_per_second = _bytes_per_second;
+        }
+        return network_output_statistics{ _receiver_count.load(), _frames.load(), _key_frames.load(), _tiles.load(), bytes, _merged.load(),
+            encoded == 0 ? 0.0 : _encode_ns.load() / 1e6 / encoded, bytes_per_second };
+    }
+}
\ No newline at end of file
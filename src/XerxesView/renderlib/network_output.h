@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "surface.h"
+#include "damage_region.h"
+#include "local_socket.h"
+#include "tile_codec.h"
+
+namespace xerxes
+{
+    struct network_output_statistics {
+        size_t receivers;
+        // Messages sent to every receiver, and the key frames sent to receivers that connected
+        uint64_t frames;
+        uint64_t key_frames;
+        uint64_t tiles;
+        uint64_t bytes;
+        // Composed frames that were merged into a later message because the sender was still busy
+        uint64_t merged;
+        // Average time to encode a message
+        double encode_ms;
+        // Since the statistics were last taken, at least a second before; 0 while nothing is sent
+        uint64_t bytes_per_second;
+    };
+
+    // Streams the canvas to receivers on the same machine, e.g. a stream encoder or the overflow room (see tile_codec for
+    // the format). The render thread only copies the pixels it damaged, and only while someone is connected; a sender thread
+    // encodes and sends them, so a slow receiver makes the stream skip frames rather than hold up the canvas. A receiver that
+    // connects gets a key frame first, and one whose sends time out is dropped. A slide that doesn't change sends nothing at all.
+    class network_output {
+    private:
+        struct receiver {
+            std::shared_ptr<local_socket> socket;
+            bool has_key;
+        };
+
+        local_socket _listener;
+        std::thread _accept_thread;
+        std::thread _send_thread;
+
+        // Guards the receivers and the canvas between the render thread, the accept thread and the sender
+        std::mutex _lock;
+        std::condition_variable _wake;
+        std::vector<receiver> _receivers;
+        // The canvas as published; only the damaged parts are kept up to date
+        surface _latest;
+        damage_region _pending;
+        uint64_t _index = 0;
+        bool _dirty = false;
+        bool _running = false;
+        // The render thread reads these without the lock, to do nothing while nobody listens
+        std::atomic<size_t> _receiver_count{ 0 };
+        std::atomic<bool> _needs_canvas{ false };
+
+        // Sender thread only
+        surface _current;
+        tile_encoder _encoder;
+        std::vector<uint8_t> _message;
+        std::vector<uint8_t> _key;
+
+        std::atomic<uint64_t> _merged{ 0 };
+        std::atomic<uint64_t> _frames{ 0 };
+        std::atomic<uint64_t> _key_frames{ 0 };
+        std::atomic<uint64_t> _tiles{ 0 };
+        std::atomic<uint64_t> _bytes{ 0 };
+        std::atomic<uint64_t> _encoded{ 0 };
+        std::atomic<int64_t> _encode_ns{ 0 };
+        // The byte count when the rate was last worked out, so the rate falls to 0 when nothing is sent
+        mutable std::mutex _rate_lock;
+        mutable std::chrono::steady_clock::time_point _rate_start;
+        mutable uint64_t _rate_bytes = 0;
+        mutable uint64_t _bytes_per_second = 0;
+
+        auto accept() -> void;
+        auto send() -> void;
+        // Copy what the render thread damaged since the last call into _current, with _lock held
+        auto take_pending(damage_region &damage) -> void;
+    public:
+        // Where the canvas listens unless told otherwise
+        static const uint16_t default_port = 5740;
+
+        network_output() = default;
+        network_output(const network_output &) = delete;
+        auto operator=(const network_output &)->network_output& = delete;
+        ~network_output();
+
+        // Listen on 127.0.0.1:port; port 0 picks a free one. Returns false if the port can't be listened on.
+        auto try_start(uint16_t port) -> bool;
+        // Disconnect the receivers and stop listening
+        auto stop() -> void;
+        inline auto get_port() const -> uint16_t { return _listener.get_port(); }
+
+        // Render thread, once per frame, with the damage of a composed frame or an empty one. Never waits for the network.
+        auto publish(const surface &canvas, const damage_region &damage, uint64_t index) -> void;
+
+        auto get_statistics() const -> network_output_statistics;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,36 @@
+#include "stdafx.h"
+#include "network_receiver.h"
+
+namespace xerxes
+{
+    auto network_receiver::try_connect(uint16_t port) -> bool
+    {
+        _decoder = tile_decoder();
+        _statistics = network_receiver_statistics{};
+        return local_socket::try_connect(port, _socket);
+    }
+
+    auto network_receiver::try_receive() -> bool
+    {
+        if (!_socket.try_receive(&_header, sizeof(_header))) return false;
+        // Don't allocate whatever a corrupt header asks for
+        if (!tile_decoder::is_valid(_header)) return false;
+
+        _payload.resize(_header.bytes);
+        if (_header.bytes > 0 && !_socket.try_receive(_payload.data(), _payload.size())) return false;
+        if (!_decoder.try_apply(_header, _payload.data())) return false;
+
+        _statistics.frames++;
+        if ((_header.flags & tile_codec::key_frame) != 0) {
+            _statistics.key_frames++;
+        }
+        _statistics.tiles += _header.tiles;
+        _statistics.bytes += sizeof(_header) + _header.bytes;
+        return true;
+    }
+
+    auto network_receiver::close() -> void
+    {
+        _socket.close();
+    }
+}
\ No newline at end of file
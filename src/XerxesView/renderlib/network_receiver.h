@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "local_socket.h"
+#include "tile_codec.h"
+
+namespace xerxes
+{
+    struct network_receiver_statistics {
+        uint64_t frames;
+        uint64_t key_frames;
+        uint64_t tiles;
+        // Including the headers
+        uint64_t bytes;
+    };
+
+    // The other end of a network_output: connects to it and rebuilds the canvas from its stream
+    class network_receiver {
+    private:
+        local_socket _socket;
+        tile_decoder _decoder;
+        frame_header _header{};
+        std::vector<uint8_t> _payload;
+        network_receiver_statistics _statistics{};
+    public:
+        auto try_connect(uint16_t port) -> bool;
+        // Wait up to timeout for the next message; false if none arrived
+        inline auto wait(std::chrono::milliseconds timeout) -> bool { return _socket.wait_readable(timeout); }
+        // Block for the next message and apply it. Returns false once the output goes away, or if the stream is malformed.
+        auto try_receive() -> bool;
+        auto close() -> void;
+
+        // The canvas as of the last message
+        inline auto get_frame() const noexcept -> const surface& { return _decoder.get_frame(); }
+        inline auto has_frame() const noexcept -> bool { return _decoder.has_frame(); }
+        inline auto get_last_header() const noexcept -> const frame_header& { return _header; }
+        inline auto get_statistics() const noexcept -> const network_receiver_statistics& { return _statistics; }
+    };
+}
\ No newline at end of file
@@ -0,0 +1,232 @@
+#include "stdafx.h"
+#include "offline_exporter.h"
+#include "canvas_pipeline.h"
+#include "frame_pool.h"
+#include "frame_queue.h"
+#include "golden_image.h"
+#include "event_trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+namespace xerxes
+{
+    namespace
+    {
+        // The frames of the image sequence, in the order they were rendered
+        auto sequence_path(const std::string &path, uint64_t index) -> std::string
+        {
+            char number[32];
+            std::snprintf(number, sizeof(number), "_%06llu.ppm", static_cast<unsigned long long>(index));
+            return path + number;
+        }
+    }
+
+    auto export_result::format() const -> std::string
+    {
+        char text[512];
+        if (!succeeded) {
+            std::snprintf(text, sizeof(text), "Export failed after %llu frames: %s\n", static_cast<unsigned long long>(frames), error.c_str());
+            return text;
+        }
+        std::snprintf(text, sizeof(text), "%llu frames (%.1f s of media) in %.2f s: %.1f frames/s, %.2fx real time\n"
+            "%.1f MB written, compositor busy %.2f s, waiting for the writers %.2f s\n",
+            static_cast<unsigned long long>(frames), media_seconds, seconds, frames_per_second, realtime_factor,
+            bytes / (1024.0 * 1024.0), compose_seconds, stall_seconds);
+        return text;
+    }
+
+    auto offline_exporter::make_service_script(const std::vector<std::wstring> &slides, const std::vector<std::wstring> &cues, const cue_list::media_opener &opener,
+        int width, int height, double frame_rate, std::chrono::nanoseconds hold) -> scene_script
+    {
+        scene_script script;
+        script.width = width;
+        script.height = height;
+        script.refresh_rate = frame_rate;
+        script.slides = slides;
+        script.cues = cues;
+
+        auto count = std::max(slides.size(), cues.size());
+        for (size_t i = 0; i < count; i++) {
+            auto duration = hold;
+            if (i < cues.size()) {
+                auto source = opener(cues[i]);
+                if (source != nullptr && source->get_info().duration.count() > 0) {
+                    duration = source->get_info().duration;
+                }
+            }
+
+            scene_action action{};
+            action.frame = script.frames;
+            action.type = scene_action_type::command;
+            action.command = canvas_command::go_to_slide(static_cast<int64_t>(i));
+            script.actions.push_back(action);
+            script.frames += std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(duration.count() * frame_rate / 1e9)));
+        }
+        return script;
+    }
+
+    auto offline_exporter::run(const scene_script &script, const export_options &options, cue_list::media_opener opener,
+        std::shared_ptr<glyph_rasterizer> rasterizer) -> export_result
+    {
+        event_trace::scope trace("export");
+        export_result result{};
+        auto writer_count = options.format == export_format::raw ? 1 : std::max<size_t>(1, options.writers == 0 ? 2 : options.writers);
+        auto buffer_count = std::max<size_t>(1, options.buffers);
+
+        std::ofstream raw;
+        if (options.format == export_format::raw) {
+            raw.open(options.path, std::ios::out | std::ios::binary | std::ios::trunc);
+            if (!raw) {
+                result.error = "could not create " + options.path;
+                return result;
+            }
+        }
+
+        // Every buffer is either being composed into, queued, or being written, so the compositor always finds one free once
+        // the queue has taken the last
+        auto pool = frame_pool::create(buffer_count + writer_count + 1, script.width, script.height);
+        frame_queue queue(buffer_count);
+        std::atomic<uint64_t> bytes(0);
+        std::atomic<bool> failed(false);
+        std::mutex error_lock;
+        auto fail = [&](const std::string &error) {
+            std::lock_guard<std::mutex> lock(error_lock);
+            if (!failed.exchange(true)) {
+                result.error = error;
+            }
+        };
+
+        // Setting up the pipeline below may throw, and a joinable thread must not be destroyed
+        std::vector<std::thread> writers;
+        struct join_writers {
+            frame_queue &queue;
+            std::vector<std::thread> &writers;
+            ~join_writers() {
+                queue.close();
+                for (auto &w : writers) {
+                    if (w.joinable()) w.join();
+                }
+            }
+        } writers_on_exit{ queue, writers };
+        for (size_t w = 0; w < writer_count; w++) {
+            writers.emplace_back([&]() {
+                event_trace::set_thread_name("export writer");
+                std::vector<char> row;
+                for (auto frame = queue.pop_wait(); frame != nullptr; frame = queue.pop_wait()) {
+                    if (failed) continue;
+                    event_trace::scope trace("write frame");
+                    auto &pixels = frame->pixels;
+                    if (options.format == export_format::raw) {
+                        // Tightly packed, whatever the stride of the buffer
+                        auto row_bytes = static_cast<size_t>(pixels.width()) * 4;
+                        for (int y = 0; y < pixels.height(); y++) {
+                            raw.write(reinterpret_cast<const char*>(pixels.row(y)), row_bytes);
+                        }
+                        if (!raw) {
+                            fail("could not write " + options.path);
+                            continue;
+                        }
+                        bytes += row_bytes * pixels.height();
+                    }
+                    else {
+                        // The frame's timestamp is its position in the export
+                        auto index = static_cast<uint64_t>(std::llround(frame->timestamp.count() * script.refresh_rate / 1e9));
+                        auto path = sequence_path(options.path, index);
+                        if (!golden_image::try_write(path, pixels)) {
+                            fail("could not write " + path);
+                            continue;
+                        }
+                        bytes += static_cast<uint64_t>(pixels.width()) * pixels.height() * 3;
+                    }
+                }
+            });
+        }
+
+        {
+            simulated_frame_clock clock;
+            thread_pool tiles(options.threads);
+            canvas_pipeline pipeline(clock, rasterizer, std::move(opener), &tiles);
+            // Nothing may be dropped or late in an export
+            pipeline.set_deterministic(true);
+            pipeline.resize(script.width, script.height);
+            pipeline.set_slide_texts(script.slides);
+            pipeline.set_cues(script.cues);
+
+            size_t next_action = 0;
+            damage_region damage;
+            std::chrono::steady_clock::duration compose(0), stall(0);
+            presentation_scheduler scheduler(clock, script.refresh_rate, [&](const frame_info &frame) {
+                while (next_action < script.actions.size() && script.actions[next_action].frame <= frame.index) {
+                    auto &action = script.actions[next_action++];
+                    if (action.type == scene_action_type::command) {
+                        pipeline.post(action.command);
+                    }
+                }
+
+                auto start = std::chrono::steady_clock::now();
+                pipeline.render_frame(frame, damage);
+                auto rendered = std::chrono::steady_clock::now();
+                auto buffer = pool->acquire_wait();
+                auto acquired = std::chrono::steady_clock::now();
+                pipeline.read_target([&buffer](const surface &target) {
+                    auto row_bytes = static_cast<size_t>(target.width()) * 4;
+                    for (int y = 0; y < target.height(); y++) {
+                        std::memcpy(buffer->pixels.row(y), target.row(y), row_bytes);
+                    }
+                });
+                buffer->timestamp = std::chrono::nanoseconds(static_cast<long long>(frame.index * 1e9 / script.refresh_rate));
+                buffer->duration = frame.interval;
+                auto composed = std::chrono::steady_clock::now();
+                queue.push(std::move(buffer));
+                stall += std::chrono::steady_clock::now() - composed + (acquired - rendered);
+                compose += composed - start - (acquired - rendered) - pipeline.get_last_wait();
+            });
+
+            auto start = std::chrono::steady_clock::now();
+            // A failed frame ends the export like a failed write
+            try {
+                for (uint64_t i = 0; i < script.frames && !failed; i++) {
+                    if (options.cancel != nullptr && *options.cancel) {
+                        fail("cancelled");
+                        break;
+                    }
+                    scheduler.run_frames(1);
+                    result.frames++;
+                }
+            }
+            catch (std::exception &ex) {
+                fail(ex.what());
+            }
+            queue.close();
+            for (auto &w : writers) {
+                w.join();
+            }
+            result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            result.compose_seconds = std::chrono::duration<double>(compose).count();
+            result.stall_seconds = std::chrono::duration<double>(stall).count();
+            pipeline.release_media();
+        }
+
+        if (raw.is_open()) {
+            raw.close();
+            if (!raw && !failed) {
+                fail("could not write " + options.path);
+            }
+        }
+        result.succeeded = !failed;
+        result.bytes = bytes;
+        result.media_seconds = result.frames / script.refresh_rate;
+        if (result.seconds > 0.0) {
+            result.frames_per_second = result.frames / result.seconds;
+            result.realtime_factor = result.media_seconds / result.seconds;
+        }
+        return result;
+    }
+}
\ No newline at end of file
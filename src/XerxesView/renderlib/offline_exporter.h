@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "cue_list.h"
+#include "text_engine.h"
+#include "headless_renderer.h"
+
+namespace xerxes
+{
+    enum class export_format {
+        // One file of tightly packed 8-bit BGRA frames, e.g. for ffmpeg -f rawvideo -pix_fmt bgra -s WxH -r FPS
+        raw,
+        // One binary PPM per frame: <path>_000000.ppm, <path>_000001.ppm, ...
+        image_sequence
+    };
+
+    struct export_options {
+        // The raw file, or the path the image sequence numbers are appended to
+        std::string path;
+        export_format format = export_format::raw;
+        // Composed frames that may wait for the writers before the compositor blocks
+        size_t buffers = 4;
+        // Threads writing frames. A raw file is written in order by one; image sequences default to two.
+        size_t writers = 0;
+        // Tile rendering threads; 0 for one per core
+        size_t threads = 0;
+        // Checked before every frame; once set, the export stops and fails as cancelled. Must outlive the export.
+        const std::atomic<bool> *cancel = nullptr;
+    };
+
+    struct export_result {
+        bool succeeded;
+        // Why the export failed
+        std::string error;
+        uint64_t frames;
+        uint64_t bytes;
+        // Wall time of the whole export
+        double seconds;
+        // How long the exported frames play for
+        double media_seconds;
+        double frames_per_second;
+        // media_seconds / seconds; above 1 the export is faster than real time
+        double realtime_factor;
+        // Time the compositor spent composing and copying out, and waiting for a free buffer because the writers fell behind
+        double compose_seconds;
+        double stall_seconds;
+
+        auto format() const -> std::string;
+    };
+
+    // Renders a scene to a file as fast as the machine allows rather than at the refresh rate. The canvas pipeline runs
+    // deterministically on a simulated clock, so no frame is dropped or shown late. Each composed frame is copied into a pooled
+    // buffer and queued for the writer threads, which convert and write it while the next frame composes.
+    class offline_exporter {
+    public:
+        offline_exporter() = delete;
+
+        // Each slide for as long as its cue's media plays, or for hold if it has none or the media is a still
+        static auto make_service_script(const std::vector<std::wstring> &slides, const std::vector<std::wstring> &cues, const cue_list::media_opener &opener,
+            int width, int height, double frame_rate, std::chrono::nanoseconds hold) -> scene_script;
+
+        // The scene's capture actions are ignored
+        static auto run(const scene_script &script, const export_options &options, cue_list::media_opener opener,
+            std::shared_ptr<glyph_rasterizer> rasterizer) -> export_result;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+
+namespace xerxes
+{
+    const size_t cache_line_size = 64;
+
+    // A value on a cache line of its own, so threads writing it don't false-share with whatever is next to it. Padded on
+    // both sides rather than aligned: the rings and buffers that use this are members of heap allocated objects, and VS2015's
+    // operator new doesn't honour extended alignment.
+    template<typename T> struct padded {
+        char _before[cache_line_size];
+        T value;
+        char _after[cache_line_size];
+
+        template<typename... _Args> explicit padded(_Args&&... args) : value(std::forward<_Args>(args)...) {}
+    };
+}
\ No newline at end of file
@@ -0,0 +1,107 @@
+#include "stdafx.h"
+#include "presentation_scheduler.h"
+
+#include <algorithm>
+
+namespace xerxes
+{
+    const size_t presentation_scheduler::history;
+
+    presentation_scheduler::presentation_scheduler(frame_clock &clock, double refresh_rate, render_callback render)
+        : _clock(clock), _interval(std::chrono::nanoseconds(static_cast<long long>(1e9 / (refresh_rate > 1.0 ? refresh_rate : 60.0)))),
+          _render(std::move(render)), _running(false), _next_deadline(0), _frame_times(history, 0.0f)
+    {
+    }
+
+    presentation_scheduler::~presentation_scheduler()
+    {
+        stop();
+    }
+
+    auto presentation_scheduler::start() -> void
+    {
+        if (_running.exchange(true)) return;
+
+        _next_deadline = _clock.now() + _interval;
+        _thread = std::thread([this]() {
+            while (_running.load()) {
+                run_frame();
+            }
+        });
+    }
+
+    auto presentation_scheduler::stop() -> void
+    {
+        _running = false;
+        if (_thread.joinable()) {
+            _thread.join();
+        }
+    }
+
+    auto presentation_scheduler::run_frames(uint64_t count) -> void
+    {
+        if (_next_deadline.count() == 0) {
+            _next_deadline = _clock.now() + _interval;
+        }
+        for (uint64_t i = 0; i < count; i++) {
+            run_frame();
+        }
+    }
+
+    auto presentation_scheduler::run_frame() -> void
+    {
+        // Start composing one interval ahead of the deadline
+        _clock.wait_until(_next_deadline - _interval);
+
+        auto start = _clock.now();
+        _render(frame_info{ _next_index, _next_deadline, _interval, _skipped });
+        auto end = _clock.now();
+
+        // Every interval boundary we ran past is a frame that never made it to the screen
+        uint64_t missed = 0;
+        if (end > _next_deadline) {
+            missed = static_cast<uint64_t>((end - _next_deadline) / _interval) + 1;
+        }
+        _next_deadline += _interval * static_cast<long long>(missed + 1);
+        _next_index += missed + 1;
+        _skipped = missed;
+
+        record(end - start, missed);
+    }
+
+    auto presentation_scheduler::record(std::chrono::nanoseconds frame_time, uint64_t missed) -> void
+    {
+        std::lock_guard<std::mutex> lock(_statistics_lock);
+        _last_ms = std::chrono::duration<float, std::milli>(frame_time).count();
+        _frame_times[_frame_time_next] = _last_ms;
+        _frame_time_next = (_frame_time_next + 1) % history;
+        _frames++;
+        _missed += missed;
+    }
+
+    auto presentation_scheduler::get_statistics() const -> frame_statistics
+    {
+        std::vector<float> times;
+        frame_statistics stats{};
+        {
+            std::lock_guard<std::mutex> lock(_statistics_lock);
+            stats.frames = _frames;
+            stats.missed_deadlines = _missed;
+            stats.last_ms = _last_ms;
+            times.assign(_frame_times.begin(), _frame_times.begin() + static_cast<ptrdiff_t>(std::min<uint64_t>(_frames, history)));
+        }
+        stats.refresh_rate = 1e9 / _interval.count();
+
+        if (!times.empty()) {
+            double total = 0.0;
+            for (auto t : times) {
+                total += t;
+            }
+            stats.average_ms = total / times.size();
+            std::sort(times.begin(), times.end());
+            stats.worst_ms = times.back();
+            stats.p99_ms = times[std::min(times.size() - 1, times.size() * 99 / 100)];
+        }
+        return stats;
+    }
+}
\ No newline at end of file
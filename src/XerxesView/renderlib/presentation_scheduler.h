@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "frame_clock.h"
+
+namespace xerxes
+{
+    struct frame_info {
+        uint64_t index;
+        // When the frame should be on screen
+        std::chrono::nanoseconds deadline;
+        std::chrono::nanoseconds interval;
+        // Intervals skipped since the previous frame because it ran past its deadline
+        uint64_t skipped;
+    };
+
+    struct frame_statistics {
+        uint64_t frames;
+        uint64_t missed_deadlines;
+        double refresh_rate;
+        // Over the most recent frames
+        double average_ms;
+        double p99_ms;
+        double worst_ms;
+        double last_ms;
+    };
+
+    // Owns the frame clock of one output. A dedicated thread wakes up once per refresh interval and calls the render callback.
+    // Frames that take longer than an interval miss their deadline; the scheduler then skips to the next interval that is still
+    // ahead rather than queueing up late frames.
+    class presentation_scheduler {
+    public:
+        using render_callback = std::function<void(const frame_info&)>;
+    private:
+        frame_clock &_clock;
+        std::chrono::nanoseconds _interval;
+        render_callback _render;
+        std::thread _thread;
+        std::atomic<bool> _running;
+
+        std::chrono::nanoseconds _next_deadline;
+        uint64_t _next_index = 0;
+        uint64_t _skipped = 0;
+
+        mutable std::mutex _statistics_lock;
+        std::vector<float> _frame_times;
+        size_t _frame_time_next = 0;
+        uint64_t _frames = 0;
+        uint64_t _missed = 0;
+        float _last_ms = 0.0f;
+
+        auto run_frame() -> void;
+        auto record(std::chrono::nanoseconds frame_time, uint64_t missed) -> void;
+    public:
+        static const size_t history = 240;
+
+        presentation_scheduler(frame_clock &clock, double refresh_rate, render_callback render);
+        presentation_scheduler(const presentation_scheduler &) = delete;
+        auto operator=(const presentation_scheduler &)->presentation_scheduler& = delete;
+        ~presentation_scheduler();
+
+        auto start() -> void;
+        auto stop() -> void;
+
+        // Run count frames on the calling thread instead of the scheduler thread. With a simulated clock this is fully deterministic.
+        auto run_frames(uint64_t count) -> void;
+
+        inline auto get_interval() const noexcept -> std::chrono::nanoseconds { return _interval; }
+        auto get_statistics() const -> frame_statistics;
+    };
+}
\ No newline at end of file
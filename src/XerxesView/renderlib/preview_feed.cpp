@@ -0,0 +1,71 @@
+#include "stdafx.h"
+#include "preview_feed.h"
+#include "image_scaler.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace xerxes
+{
+    preview_feed::preview_feed(int max_width)
+        : _max_width(std::max(1, max_width))
+    {
+    }
+
+    auto preview_feed::publish(const surface &canvas, uint64_t index) -> void
+    {
+        auto start = std::chrono::steady_clock::now();
+        auto &frame = _frames.back();
+
+        auto halvings = 0;
+        while (halvings < 16 && (canvas.width() >> halvings) > _max_width && (canvas.height() >> halvings) > 1) {
+            halvings++;
+        }
+        if (halvings == 0) {
+            frame.pixels.resize(canvas.width(), canvas.height());
+            auto row_bytes = static_cast<size_t>(canvas.width()) * 4;
+            for (int y = 0; y < canvas.height(); y++) {
+                std::memcpy(frame.pixels.row(y), canvas.row(y), row_bytes);
+            }
+        }
+        else {
+            const surface *src = &canvas;
+            for (int i = 1; i < halvings; i++) {
+                auto &dst = _scratch[i & 1];
+                image_scaler::halve(*src, dst);
+                src = &dst;
+            }
+            image_scaler::halve(*src, frame.pixels);
+        }
+
+        frame.index = index;
+        frame.published = std::chrono::steady_clock::now();
+        _frames.publish();
+        _published.fetch_add(1, std::memory_order_relaxed);
+        _downscale_ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(frame.published - start).count(), std::memory_order_relaxed);
+    }
+
+    auto preview_feed::acquire() -> const preview_frame*
+    {
+        if (_frames.try_update()) {
+            _has_frame = true;
+            _shown.fetch_add(1, std::memory_order_relaxed);
+            _latency_ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _frames.front().published).count(), std::memory_order_relaxed);
+        }
+        return _has_frame ? &_frames.front() : nullptr;
+    }
+
+    auto preview_feed::get_statistics() const -> preview_statistics
+    {
+        preview_statistics statistics{};
+        statistics.published = _published.load(std::memory_order_relaxed);
+        statistics.shown = _shown.load(std::memory_order_relaxed);
+        if (statistics.published > 0) {
+            statistics.downscale_ms = _downscale_ns.load(std::memory_order_relaxed) / 1e6 / statistics.published;
+        }
+        if (statistics.shown > 0) {
+            statistics.latency_ms = _latency_ns.load(std::memory_order_relaxed) / 1e6 / statistics.shown;
+        }
+        return statistics;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include "surface.h"
+#include "triple_buffer.h"
+
+namespace xerxes
+{
+    struct preview_frame {
+        surface pixels;
+        // The canvas frame it shows
+        uint64_t index;
+        std::chrono::steady_clock::time_point published;
+    };
+
+    struct preview_statistics {
+        uint64_t published;
+        // Published frames the consumer took; the rest were replaced by newer ones first
+        uint64_t shown;
+        // Averages since the feed was created
+        double downscale_ms;
+        // From publishing a frame to the consumer taking it
+        double latency_ms;
+    };
+
+    // A downscaled copy of the canvas for the control window. The render thread halves each composed frame until it fits
+    // max_width and publishes it through a triple buffer, so it never waits for the consumer, and the consumer always gets
+    // the newest frame at whatever rate it paints.
+    class preview_feed {
+    private:
+        int _max_width;
+        triple_buffer<preview_frame> _frames;
+        // Halving steps before the last, which goes straight into the back buffer
+        surface _scratch[2];
+        bool _has_frame = false;
+
+        std::atomic<uint64_t> _published{ 0 };
+        std::atomic<uint64_t> _shown{ 0 };
+        std::atomic<int64_t> _downscale_ns{ 0 };
+        std::atomic<int64_t> _latency_ns{ 0 };
+    public:
+        explicit preview_feed(int max_width);
+        preview_feed(const preview_feed &) = delete;
+        auto operator=(const preview_feed &)->preview_feed& = delete;
+
+        // Render thread only
+        auto publish(const surface &canvas, uint64_t index) -> void;
+
+        // Consumer only: the newest frame, or nullptr if none was published yet. Stays valid until the next call.
+        auto acquire() -> const preview_frame*;
+
+        auto get_statistics() const -> preview_statistics;
+        inline auto is_empty() const noexcept -> bool { return _published.load(std::memory_order_relaxed) == 0; }
+    };
+}
\ No newline at end of file
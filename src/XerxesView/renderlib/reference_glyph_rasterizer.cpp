@@ -0,0 +1,58 @@
+#include "stdafx.h"
+#include "reference_glyph_rasterizer.h"
+
+#include <algorithm>
+
+namespace xerxes
+{
+    namespace
+    {
+        // The pattern is a grid of cells inside the frame
+        const int pattern_columns = 3;
+        const int pattern_rows = 5;
+    }
+
+    auto reference_glyph_rasterizer::get_font_metrics(const font_key &font) -> font_metrics
+    {
+        auto size = std::max(font.size, 1);
+        return font_metrics{ size * 4 / 5, size / 5, size * 6 / 5 };
+    }
+
+    auto reference_glyph_rasterizer::rasterize(const font_key &font, uint32_t codepoint, glyph_bitmap &glyph) -> bool
+    {
+        auto size = std::max(font.size, 4);
+        glyph.advance = font.bold ? size * 3 / 5 : size / 2;
+        if (codepoint == L' ' || codepoint == L'\t') {
+            glyph.width = 0;
+            glyph.height = 0;
+            glyph.left = 0;
+            glyph.top = 0;
+            glyph.coverage.clear();
+            return true;
+        }
+        if (codepoint < 0x20) return false;
+
+        glyph.width = std::max(2, glyph.advance - std::max(1, size / 10));
+        glyph.height = std::max(2, size * 7 / 10);
+        glyph.left = (glyph.advance - glyph.width) / 2;
+        glyph.top = glyph.height;
+        glyph.coverage.assign(static_cast<size_t>(glyph.width) * glyph.height, 0);
+
+        // A multiplicative hash spreads neighbouring codepoints over different patterns
+        auto bits = codepoint * 2654435761u;
+        for (int y = 0; y < glyph.height; y++) {
+            auto row = glyph.coverage.data() + static_cast<size_t>(y) * glyph.width;
+            for (int x = 0; x < glyph.width; x++) {
+                auto frame = x == 0 || y == 0 || x == glyph.width - 1 || y == glyph.height - 1;
+                auto cell = (y * pattern_rows / glyph.height) * pattern_columns + x * pattern_columns / glyph.width;
+                if (frame) {
+                    row[x] = 255;
+                }
+                else if ((bits >> (cell + 8)) & 1) {
+                    row[x] = font.italic ? 128 : 192;
+                }
+            }
+        }
+        return true;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "text_engine.h"
+
+namespace xerxes
+{
+    // A font that looks the same on every platform: each character is a framed box with a pattern taken from its codepoint.
+    // It isn't meant to be read, only to make rendering that involves text reproducible without the platform's font engine,
+    // e.g. for golden frames compared on another machine.
+    class reference_glyph_rasterizer : public glyph_rasterizer {
+    public:
+        virtual auto get_font_metrics(const font_key &font) -> font_metrics override;
+        virtual auto rasterize(const font_key &font, uint32_t codepoint, glyph_bitmap &glyph) -> bool override;
+    };
+}
\ No newline at end of file
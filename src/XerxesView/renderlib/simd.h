@@ -0,0 +1,22 @@
+#pragma once
+
+// SSE2 is part of the x64 baseline and every CPU we support on x86, so it is used without a runtime check.
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+    #define XERXES_SSE2 1
+    #include <emmintrin.h>
+#else
+    #define XERXES_SSE2 0
+#endif
+
+// AVX2 kernels are compiled on x86 but only called after a runtime check. With MSVC their translation units are built with
+// /arch:AVX2; GCC and clang mark the functions instead.
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+    #define XERXES_AVX2 1
+    #if defined(__GNUC__)
+        #define XERXES_TARGET_AVX2 __attribute__((target("avx2")))
+    #else
+        #define XERXES_TARGET_AVX2
+    #endif
+#else
+    #define XERXES_AVX2 0
+#endif
\ No newline at end of file
@@ -0,0 +1,161 @@
+#include "stdafx.h"
+#include "slide_cache.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace xerxes
+{
+    slide_cache::slide_cache(slide_renderer renderer, size_t budget_bytes, size_t ahead, size_t behind)
+        : _renderer(std::move(renderer)), _budget(budget_bytes), _ahead(ahead), _behind(behind)
+    {
+        _thread = std::thread([this]() { run(); });
+    }
+
+    slide_cache::~slide_cache()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            _running = false;
+        }
+        _wake.notify_all();
+        _thread.join();
+    }
+
+    auto slide_cache::find(const key &k) -> std::shared_ptr<const surface>
+    {
+        auto i = _entries.find(k);
+        if (i == _entries.end()) return nullptr;
+        _lru.splice(_lru.begin(), _lru, i->second.position);
+        return i->second.pixels;
+    }
+
+    auto slide_cache::insert(const key &k, std::shared_ptr<const surface> pixels) -> void
+    {
+        if (_entries.find(k) != _entries.end()) return;
+
+        _bytes += pixels->size_in_bytes();
+        _lru.push_front(k);
+        _entries.emplace(k, entry{ std::move(pixels), _lru.begin() });
+        // The newest entry stays even if it alone is over the budget
+        while (_bytes > _budget && _entries.size() > 1) {
+            auto oldest = _entries.find(_lru.back());
+            _bytes -= oldest->second.pixels->size_in_bytes();
+            _entries.erase(oldest);
+            _lru.pop_back();
+        }
+    }
+
+    auto slide_cache::render(size_t slide, int width, int height) -> std::shared_ptr<const surface>
+    {
+        auto pixels = std::make_shared<surface>(width, height);
+        pixels->clear(0);
+        std::lock_guard<std::mutex> lock(_render_lock);
+        _renderer(slide, *pixels);
+        return pixels;
+    }
+
+    auto slide_cache::get(size_t slide, int width, int height) -> std::shared_ptr<const surface>
+    {
+        key k{ slide, width, height };
+        uint64_t generation;
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            auto pixels = find(k);
+            if (pixels != nullptr) {
+                _hits++;
+                return pixels;
+            }
+            _misses++;
+            generation = _generation;
+        }
+
+        auto pixels = render(slide, width, height);
+        std::lock_guard<std::mutex> lock(_lock);
+        if (generation == _generation) {
+            insert(k, pixels);
+        }
+        return pixels;
+    }
+
+    auto slide_cache::set_current(size_t slide, int width, int height) -> void
+    {
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            _current = slide;
+            _width = width;
+            _height = height;
+            _warm_requested = true;
+        }
+        _wake.notify_all();
+    }
+
+    auto slide_cache::set_slide_count(size_t count) -> void
+    {
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            _slide_count = count;
+            _warm_requested = true;
+        }
+        _wake.notify_all();
+    }
+
+    auto slide_cache::invalidate() -> void
+    {
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            _entries.clear();
+            _lru.clear();
+            _bytes = 0;
+            _generation++;
+            _warm_requested = true;
+        }
+        _wake.notify_all();
+    }
+
+    auto slide_cache::run() -> void
+    {
+        std::unique_lock<std::mutex> lock(_lock);
+        while (_running) {
+            _wake.wait(lock, [this]() { return !_running || _warm_requested; });
+            if (!_running) return;
+            _warm_requested = false;
+
+            // Nearest first: the next slide is the likeliest jump, then the previous one
+            std::vector<size_t> wanted;
+            for (size_t d = 1; d <= std::max(_ahead, _behind); d++) {
+                if (d <= _ahead && _current + d < _slide_count) wanted.push_back(_current + d);
+                if (d <= _behind && _current >= d && _current - d < _slide_count) wanted.push_back(_current - d);
+            }
+
+            for (auto slide : wanted) {
+                // A newer request replaces this one
+                if (!_running || _warm_requested) break;
+                key k{ slide, _width, _height };
+                if (_width <= 0 || _height <= 0 || _entries.find(k) != _entries.end()) continue;
+
+                auto generation = _generation;
+                lock.unlock();
+                auto pixels = render(slide, std::get<1>(k), std::get<2>(k));
+                lock.lock();
+                if (generation == _generation) {
+                    insert(k, std::move(pixels));
+                    _warmed++;
+                }
+            }
+        }
+    }
+
+    auto slide_cache::get_statistics() -> slide_cache_statistics
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        slide_cache_statistics stats{};
+        stats.hits = _hits;
+        stats.misses = _misses;
+        stats.warmed = _warmed;
+        stats.entries = _entries.size();
+        stats.bytes = _bytes;
+        stats.budget = _budget;
+        return stats;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include "surface.h"
+
+namespace xerxes
+{
+    struct slide_cache_statistics {
+        uint64_t hits;
+        uint64_t misses;
+        // Slides rendered ahead of time by the warm-up worker
+        uint64_t warmed;
+        size_t entries;
+        size_t bytes;
+        size_t budget;
+
+        inline auto hit_rate() const noexcept -> double { return hits + misses == 0 ? 0.0 : static_cast<double>(hits) / (hits + misses); }
+    };
+
+    // Fully rendered slides per output resolution, least recently used first out once the memory budget is exceeded. A worker
+    // renders the slides around the current one in the background, so jumping to a neighbour is a lookup.
+    class slide_cache {
+    public:
+        // Render slide into target, which is sized for the output and cleared to transparent. Calls are never concurrent.
+        using slide_renderer = std::function<void(size_t slide, surface &target)>;
+    private:
+        using key = std::tuple<size_t, int, int>;
+        using lru_list = std::list<key>;
+        struct entry {
+            std::shared_ptr<const surface> pixels;
+            lru_list::iterator position;
+        };
+
+        slide_renderer _renderer;
+        size_t _budget;
+        size_t _ahead;
+        size_t _behind;
+
+        std::mutex _lock;
+        std::condition_variable _wake;
+        std::map<key, entry> _entries;
+        lru_list _lru;
+        size_t _bytes = 0;
+        // Changes whenever the content of the slides does, so renders of the old content are thrown away
+        uint64_t _generation = 0;
+        size_t _slide_count = 0;
+        size_t _current = 0;
+        int _width = 0;
+        int _height = 0;
+        bool _warm_requested = false;
+        bool _running = true;
+        uint64_t _hits = 0;
+        uint64_t _misses = 0;
+        uint64_t _warmed = 0;
+
+        // Serializes the renderer between the worker and a caller rendering a miss
+        std::mutex _render_lock;
+        std::thread _thread;
+
+        auto run() -> void;
+        auto find(const key &k) -> std::shared_ptr<const surface>;
+        auto insert(const key &k, std::shared_ptr<const surface> pixels) -> void;
+        auto render(size_t slide, int width, int height) -> std::shared_ptr<const surface>;
+    public:
+        // Keep ahead slides after the current one and behind before it warm
+        slide_cache(slide_renderer renderer, size_t budget_bytes, size_t ahead = 2, size_t behind = 1);
+        slide_cache(const slide_cache &) = delete;
+        auto operator=(const slide_cache &)->slide_cache& = delete;
+        ~slide_cache();
+
+        // The slide rendered at width x height; rendered now, on the calling thread, if it isn't cached
+        auto get(size_t slide, int width, int height) -> std::shared_ptr<const surface>;
+
+        // Start warming the slides around slide at this resolution
+        auto set_current(size_t slide, int width, int height) -> void;
+        auto set_slide_count(size_t count) -> void;
+        // The slides changed; drop everything
+        auto invalidate() -> void;
+
+        auto get_statistics() -> slide_cache_statistics;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,23 @@
+#include "stdafx.h"
+#include "slide_layer.h"
+#include "coverage_blend.h"
+
+namespace xerxes
+{
+    auto slide_layer::set_slide(std::shared_ptr<const surface> slide) -> void
+    {
+        if (slide == _slide) return;
+        _slide = std::move(slide);
+        invalidate_all();
+    }
+
+    auto slide_layer::render(surface &target, const pixel_rect &clip) -> void
+    {
+        if (_slide == nullptr || is_stale()) return;
+
+        auto area = clip.intersect(_slide->bounds());
+        for (int y = area.top; y < area.bottom; y++) {
+            blend_over(target.row(y) + area.left, _slide->row(y) + area.left, area.width());
+        }
+    }
+}
\ No newline at end of file
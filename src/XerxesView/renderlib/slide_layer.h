@@ -0,0 +1,20 @@
+#pragma once
+
+#include <memory>
+#include "layer.h"
+
+namespace xerxes
+{
+    // Shows a pre-rendered slide (see slide_cache) over the layers below it. A slide of another size than the canvas isn't shown.
+    class slide_layer : public layer {
+    private:
+        std::shared_ptr<const surface> _slide;
+    public:
+        auto set_slide(std::shared_ptr<const surface> slide) -> void;
+        inline auto get_slide() const noexcept -> const std::shared_ptr<const surface>& { return _slide; }
+        // Whether the slide has to be rendered again for the current canvas size
+        inline auto is_stale() const noexcept -> bool { return _slide != nullptr && (_slide->width() != _width || _slide->height() != _height); }
+
+        virtual auto render(surface &target, const pixel_rect &clip) -> void override;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include "padded.h"
+
+namespace xerxes
+{
+    // Bounded single-producer/single-consumer queue. Neither side ever blocks or allocates: push fails when the ring is full and pop
+    // fails when it is empty. Capacity must be a power of two.
+    template<typename T, size_t Capacity> class spsc_ring {
+        static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+    private:
+        T _slots[Capacity];
+        // Producer and consumer indices live on their own cache lines so the two threads don't false-share
+        padded<std::atomic<size_t>> _head;
+        padded<std::atomic<size_t>> _tail;
+    public:
+        spsc_ring() noexcept : _head(0), _tail(0) {}
+        spsc_ring(const spsc_ring &) = delete;
+        auto operator=(const spsc_ring &)->spsc_ring& = delete;
+
+        // Producer only
+        template<typename U> inline auto try_push(U &&value) -> bool {
+            auto tail = _tail.value.load(std::memory_order_relaxed);
+            if (tail - _head.value.load(std::memory_order_acquire) == Capacity) return false;
+            _slots[tail & (Capacity - 1)] = std::forward<U>(value);
+            _tail.value.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer only
+        inline auto try_pop(T &value) -> bool {
+            auto head = _head.value.load(std::memory_order_relaxed);
+            if (head == _tail.value.load(std::memory_order_acquire)) return false;
+            value = std::move(_slots[head & (Capacity - 1)]);
+            _head.value.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Only exact when called from one of the two sides while the other is idle
+        inline auto size() const noexcept -> size_t {
+            return _tail.value.load(std::memory_order_acquire) - _head.value.load(std::memory_order_acquire);
+        }
+        inline auto capacity() const noexcept -> size_t { return Capacity; }
+    };
+}
\ No newline at end of file
@@ -0,0 +1,94 @@
+#include "stdafx.h"
+#include "startup_trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+
+namespace xerxes
+{
+    std::mutex startup_trace::_lock;
+    std::vector<startup_trace::phase> startup_trace::_phases;
+    startup_trace::clock::time_point startup_trace::_origin = startup_trace::clock::now();
+    bool startup_trace::_finished = false;
+    startup_trace::finished_callback startup_trace::_on_finished;
+
+    namespace
+    {
+        std::atomic<uint32_t> next_thread{ 0 };
+        thread_local uint32_t thread_number = static_cast<uint32_t>(-1);
+
+        inline auto to_ms(std::chrono::steady_clock::duration d) -> double { return std::chrono::duration<double, std::milli>(d).count(); }
+    }
+
+    auto startup_trace::current_thread() -> uint32_t
+    {
+        if (thread_number == static_cast<uint32_t>(-1)) {
+            thread_number = next_thread++;
+        }
+        return thread_number;
+    }
+
+    auto startup_trace::set_origin(clock::time_point origin) -> void
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        _origin = origin;
+    }
+
+    auto startup_trace::get_origin() -> clock::time_point
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        return _origin;
+    }
+
+    auto startup_trace::record(const char *name, clock::time_point start, clock::time_point end) -> void
+    {
+        auto thread = current_thread();
+        std::lock_guard<std::mutex> lock(_lock);
+        if (_finished) return;
+        _phases.push_back(phase{ name, thread, start, end });
+    }
+
+    auto startup_trace::set_on_finished(finished_callback callback) -> void
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        _on_finished = std::move(callback);
+    }
+
+    auto startup_trace::try_finish(const char *name) -> bool
+    {
+        auto now = clock::now();
+        record(name, now, now);
+        finished_callback callback;
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            if (_finished) return false;
+            _finished = true;
+            callback = std::move(_on_finished);
+        }
+        if (callback) {
+            callback(format());
+        }
+        return true;
+    }
+
+    auto startup_trace::format() -> std::string
+    {
+        std::vector<phase> phases;
+        clock::time_point origin;
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            phases = _phases;
+            origin = _origin;
+        }
+        std::stable_sort(phases.begin(), phases.end(), [](const phase &a, const phase &b) { return a.start < b.start; });
+
+        std::string report("phase                                  thread    start ms     took ms\n");
+        char line[160];
+        for (auto &p : phases) {
+            snprintf(line, sizeof(line), "%-38.38s %6u %11.2f %11.2f\n", p.name.c_str(), p.thread, to_ms(p.start - origin), to_ms(p.end - p.start));
+            report += line;
+        }
+        return report;
+    }
+}
\ No newline at end of file
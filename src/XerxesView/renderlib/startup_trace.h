@@ -0,0 +1,63 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace xerxes
+{
+    // Where the time goes between the process starting and the first frame on the canvas. Phases can be recorded from any
+    // thread until startup finishes; after that recording is a no-op, so the hooks can stay in code that also runs later.
+    class startup_trace {
+    public:
+        using clock = std::chrono::steady_clock;
+        using finished_callback = std::function<void(const std::string &report)>;
+
+        // Records the time from its construction to its destruction as a phase
+        class scope {
+        private:
+            const char *_name;
+            clock::time_point _start;
+        public:
+            explicit scope(const char *name) : _name(name), _start(clock::now()) {}
+            scope(const scope &) = delete;
+            auto operator=(const scope &)->scope& = delete;
+            ~scope() { record(_name, _start, clock::now()); }
+        };
+    private:
+        struct phase {
+            std::string name;
+            uint32_t thread;
+            clock::time_point start;
+            clock::time_point end;
+        };
+
+        static std::mutex _lock;
+        static std::vector<phase> _phases;
+        static clock::time_point _origin;
+        static bool _finished;
+        static finished_callback _on_finished;
+
+        static auto current_thread() -> uint32_t;
+    public:
+        startup_trace() = delete;
+
+        // Times are reported relative to origin; the first call to anything here sets it otherwise
+        static auto set_origin(clock::time_point origin) -> void;
+        static auto get_origin() -> clock::time_point;
+
+        static auto record(const char *name, clock::time_point start, clock::time_point end) -> void;
+
+        // Called, on the thread that finishes startup, with the report
+        static auto set_on_finished(finished_callback callback) -> void;
+        // Record the end of startup as a mark and report. Returns false if startup had finished already.
+        static auto try_finish(const char *name) -> bool;
+        inline static auto get_finished() -> bool { std::lock_guard<std::mutex> lock(_lock); return _finished; }
+
+        // One line per phase in the order they started, with the thread that ran it (0 is the first thread that recorded)
+        static auto format() -> std::string;
+    };
+}
\ No newline at end of file
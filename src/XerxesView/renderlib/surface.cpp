@@ -0,0 +1,91 @@
+#include "stdafx.h"
+#include "surface.h"
+
+#include <new>
+#include <cstdlib>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace xerxes
+{
+    auto aligned_allocate(size_t size, size_t alignment) noexcept -> void*
+    {
+#ifdef _WIN32
+        return _aligned_malloc(size, alignment);
+#else
+        void *p = nullptr;
+        if (posix_memalign(&p, alignment, size) != 0) return nullptr;
+        return p;
+#endif
+    }
+
+    auto aligned_free(void *p) noexcept -> void
+    {
+#ifdef _WIN32
+        _aligned_free(p);
+#else
+        free(p);
+#endif
+    }
+
+    surface::surface(int width, int height)
+    {
+        resize(width, height);
+    }
+
+    surface::surface(surface &&other) noexcept
+    {
+        swap(other);
+    }
+
+    surface::~surface() noexcept
+    {
+        aligned_free(_pixels);
+    }
+
+    auto surface::operator=(surface &&other) noexcept -> surface&
+    {
+        if (this != &other) {
+            surface t(static_cast<surface&&>(other));
+            swap(t);
+        }
+        return *this;
+    }
+
+    auto surface::resize(int width, int height) -> void
+    {
+        if (width == _width && height == _height) return;
+
+        aligned_free(_pixels);
+        _pixels = nullptr;
+        _width = _height = 0;
+        _stride = 0;
+
+        if (width <= 0 || height <= 0) return;
+
+        auto stride = (static_cast<size_t>(width) * 4 + alignment - 1) & ~(alignment - 1);
+        _pixels = static_cast<uint8_t*>(aligned_allocate(stride * height, alignment));
+        if (_pixels == nullptr) throw std::bad_alloc();
+
+        _width = width;
+        _height = height;
+        _stride = static_cast<ptrdiff_t>(stride);
+    }
+
+    auto surface::clear(uint32_t bgra) -> void
+    {
+        fill(bounds(), bgra);
+    }
+
+    auto surface::fill(const pixel_rect &r, uint32_t bgra) -> void
+    {
+        auto clipped = r.intersect(bounds());
+        for (int y = clipped.top; y < clipped.bottom; y++) {
+            auto p = row(y);
+            for (int x = clipped.left; x < clipped.right; x++) {
+                p[x] = bgra;
+            }
+        }
+    }
+}
\ No newline at end of file
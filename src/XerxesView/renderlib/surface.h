@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "damage_region.h"
+
+namespace xerxes
+{
+    // Allocate memory aligned to the given power of two. Returns nullptr on failure.
+    auto aligned_allocate(size_t size, size_t alignment) noexcept -> void*;
+    auto aligned_free(void *p) noexcept -> void;
+
+    // A 32-bit BGRA (premultiplied) pixel buffer. The pixels and every row are 32 byte aligned so that the SIMD kernels can use aligned loads.
+    class surface {
+    private:
+        uint8_t *_pixels = nullptr;
+        int _width = 0;
+        int _height = 0;
+        ptrdiff_t _stride = 0;
+    public:
+        static constexpr size_t alignment = 32;
+
+        surface() noexcept = default;
+        surface(int width, int height);
+        surface(const surface &) = delete;
+        surface(surface &&other) noexcept;
+        ~surface() noexcept;
+
+        auto operator=(const surface &)->surface& = delete;
+        auto operator=(surface &&other) noexcept -> surface&;
+
+        // Reallocates the surface if the size changed. The content is undefined afterwards.
+        auto resize(int width, int height) -> void;
+        auto clear(uint32_t bgra) -> void;
+        auto fill(const pixel_rect &r, uint32_t bgra) -> void;
+
+        inline auto width() const noexcept -> int { return _width; }
+        inline auto height() const noexcept -> int { return _height; }
+        inline auto stride() const noexcept -> ptrdiff_t { return _stride; }
+        inline auto size_in_bytes() const noexcept -> size_t { return static_cast<size_t>(_stride) * _height; }
+        inline auto empty() const noexcept -> bool { return _pixels == nullptr; }
+        inline auto bounds() const noexcept -> pixel_rect { return pixel_rect::from_size(_width, _height); }
+
+        inline auto data() noexcept -> uint8_t* { return _pixels; }
+        inline auto data() const noexcept -> const uint8_t* { return _pixels; }
+        inline auto row(int y) noexcept -> uint32_t* { return reinterpret_cast<uint32_t*>(_pixels + y * _stride); }
+        inline auto row(int y) const noexcept -> const uint32_t* { return reinterpret_cast<const uint32_t*>(_pixels + y * _stride); }
+
+        inline auto swap(surface &other) noexcept -> void {
+            auto p = _pixels; _pixels = other._pixels; other._pixels = p;
+            auto w = _width; _width = other._width; other._width = w;
+            auto h = _height; _height = other._height; other._height = h;
+            auto s = _stride; _stride = other._stride; other._stride = s;
+        }
+    };
+
+    inline auto swap(surface &left, surface &right) noexcept -> void {
+        left.swap(right);
+    }
+}
\ No newline at end of file
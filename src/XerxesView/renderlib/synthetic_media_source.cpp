@@ -0,0 +1,47 @@
+#include "stdafx.h"
+#include "synthetic_media_source.h"
+
+namespace xerxes
+{
+    namespace
+    {
+        const uint32_t bars[] = { 0xffc0c0c0, 0xffc0c000, 0xff00c0c0, 0xff00c000, 0xffc000c0, 0xffc00000, 0xff0000c0, 0xff000000 };
+    }
+
+    synthetic_media_source::synthetic_media_source(int width, int height, double frame_rate, uint64_t frame_count)
+        : _frame_count(frame_count)
+    {
+        _info.width = width;
+        _info.height = height;
+        _info.frame_rate = frame_rate > 0.0 ? frame_rate : 30.0;
+        _info.duration = std::chrono::nanoseconds(static_cast<long long>(frame_count * 1e9 / _info.frame_rate));
+    }
+
+    auto synthetic_media_source::read_frame(video_frame &frame) -> bool
+    {
+        if (_frame_count != 0 && _next >= _frame_count) return false;
+
+        frame.pixels.resize(_info.width, _info.height);
+        frame.timestamp = std::chrono::nanoseconds(static_cast<long long>(_next * 1e9 / _info.frame_rate));
+        frame.duration = std::chrono::nanoseconds(static_cast<long long>(1e9 / _info.frame_rate));
+
+        // Bars scroll one pixel per frame so every frame differs and stale frames are easy to spot
+        auto bar_width = _info.width / 8 > 0 ? _info.width / 8 : 1;
+        auto shift = static_cast<int>(_next % _info.width);
+        for (int y = 0; y < _info.height; y++) {
+            auto p = frame.pixels.row(y);
+            for (int x = 0; x < _info.width; x++) {
+                p[x] = bars[((x + shift) / bar_width) & 7];
+            }
+        }
+
+        _next++;
+        return true;
+    }
+
+    auto synthetic_media_source::seek(std::chrono::nanoseconds position) -> bool
+    {
+        _next = static_cast<uint64_t>(position.count() * _info.frame_rate / 1e9);
+        return true;
+    }
+}
\ No newline at end of file
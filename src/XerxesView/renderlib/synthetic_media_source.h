@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+#include "media_source.h"
+
+namespace xerxes
+{
+    // Generates moving colour bars without touching the disk or a codec, so the decode pipeline can be exercised and measured anywhere
+    class synthetic_media_source : public media_source {
+    private:
+        media_info _info;
+        uint64_t _frame_count;
+        uint64_t _next = 0;
+    public:
+        // frame_count == 0 produces frames forever
+        synthetic_media_source(int width, int height, double frame_rate, uint64_t frame_count = 0);
+
+        virtual auto get_info() const -> media_info override { return _info; }
+        virtual auto read_frame(video_frame &frame) -> bool override;
+        virtual auto seek(std::chrono::nanoseconds position) -> bool override;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,99 @@
+#include "stdafx.h"
+#include "task_graph.h"
+#include "startup_trace.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace xerxes
+{
+    auto task_graph::add(const char *name, std::function<void()> run, std::initializer_list<task_id> dependencies, bool on_caller) -> task_id
+    {
+        auto id = _tasks.size();
+        for (auto d : dependencies) {
+            assert(d < id);
+            _tasks[d].dependents.push_back(id);
+        }
+        _tasks.push_back(task{ name, std::move(run), on_caller, dependencies.size(), {} });
+        return id;
+    }
+
+    auto task_graph::start(task_id id) -> void
+    {
+        // Once something failed the rest only has to be accounted for
+        if (_failure) {
+            complete(id);
+        }
+        else if (_tasks[id].on_caller) {
+            _caller_ready.push_back(id);
+            _changed.notify_all();
+        }
+        else {
+            _threads.emplace_back([this, id]() { execute(id); });
+        }
+    }
+
+    auto task_graph::complete(task_id id) -> void
+    {
+        _done++;
+        for (auto d : _tasks[id].dependents) {
+            if (--_tasks[d].waiting == 0) {
+                start(d);
+            }
+        }
+        if (_done == _tasks.size()) {
+            _changed.notify_all();
+        }
+    }
+
+    auto task_graph::execute(task_id id) -> void
+    {
+        auto &t = _tasks[id];
+        try {
+            startup_trace::scope trace(t.name.c_str());
+            t.run();
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(_lock);
+            if (!_failure) {
+                _failure = std::current_exception();
+            }
+        }
+        std::lock_guard<std::mutex> lock(_lock);
+        complete(id);
+    }
+
+    auto task_graph::run() -> void
+    {
+        {
+            std::unique_lock<std::mutex> lock(_lock);
+            for (task_id id = 0; id < _tasks.size(); id++) {
+                if (_tasks[id].waiting == 0) {
+                    start(id);
+                }
+            }
+            while (_done < _tasks.size()) {
+                if (_caller_ready.empty()) {
+                    _changed.wait(lock);
+                    continue;
+                }
+                // In the order they were added, so the caller can put the steps that unblock others first
+                auto first = std::min_element(_caller_ready.begin(), _caller_ready.end());
+                auto id = *first;
+                _caller_ready.erase(first);
+                lock.unlock();
+                execute(id);
+                lock.lock();
+            }
+        }
+
+        // Every step is done, so no more threads are added
+        for (auto &t : _threads) {
+            t.join();
+        }
+        _threads.clear();
+        if (_failure) {
+            std::rethrow_exception(_failure);
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace xerxes
+{
+    // Steps that depend on each other, each started as soon as the steps it needs are done. Steps that have to run on the
+    // calling thread (window creation, anything tied to its COM apartment) say so; the others get a thread each, since a
+    // graph is a handful of mostly blocking steps. Every step is recorded in the startup trace.
+    class task_graph {
+    public:
+        using task_id = size_t;
+    private:
+        struct task {
+            std::string name;
+            std::function<void()> run;
+            bool on_caller;
+            size_t waiting;
+            std::vector<task_id> dependents;
+        };
+
+        std::vector<task> _tasks;
+        std::mutex _lock;
+        std::condition_variable _changed;
+        std::vector<task_id> _caller_ready;
+        std::vector<std::thread> _threads;
+        size_t _done = 0;
+        std::exception_ptr _failure;
+
+        // Both called with _lock held
+        auto start(task_id id) -> void;
+        auto complete(task_id id) -> void;
+        auto execute(task_id id) -> void;
+    public:
+        task_graph() = default;
+        task_graph(const task_graph &) = delete;
+        auto operator=(const task_graph &)->task_graph& = delete;
+
+        // Dependencies have to be added first, so a graph can't have cycles
+        auto add(const char *name, std::function<void()> run, std::initializer_list<task_id> dependencies = {}, bool on_caller = false) -> task_id;
+
+        // Run every step and return once they're all done. Once a step throws no more steps are started, and the first
+        // exception is rethrown when the ones already running have finished. Caller steps run in the order they were added.
+        auto run() -> void;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,240 @@
+#include "stdafx.h"
+#include "text_engine.h"
+
+#include <algorithm>
+#include <tuple>
+
+namespace xerxes
+{
+    auto font_key::operator<(const font_key &other) const -> bool
+    {
+        return std::tie(face, size, bold, italic) < std::tie(other.face, other.size, other.bold, other.italic);
+    }
+
+    auto text_engine::layout_key::operator<(const layout_key &other) const -> bool
+    {
+        return std::tie(text, font, align, box_width, box_height) < std::tie(other.text, other.font, other.align, other.box_width, other.box_height);
+    }
+
+    namespace
+    {
+        inline auto glyph_id(uint32_t font_id, uint32_t codepoint) noexcept -> uint64_t
+        {
+            return (static_cast<uint64_t>(font_id) << 32) | codepoint;
+        }
+
+        // Padding between glyphs, so filtering never bleeds a neighbour in
+        const int atlas_padding = 1;
+    }
+
+    glyph_atlas::glyph_atlas(int size)
+        : _coverage(static_cast<size_t>(size) * size, 0), _size(size)
+    {
+    }
+
+    auto glyph_atlas::find(uint32_t font_id, uint32_t codepoint) const -> const atlas_glyph*
+    {
+        auto i = _glyphs.find(glyph_id(font_id, codepoint));
+        return i == _glyphs.end() ? nullptr : &i->second;
+    }
+
+    auto glyph_atlas::insert(uint32_t font_id, uint32_t codepoint, const glyph_bitmap &glyph) -> const atlas_glyph*
+    {
+        auto width = glyph.width + atlas_padding;
+        auto height = glyph.height + atlas_padding;
+        if (width > _size || height > _size) return nullptr;
+
+        if (_shelf_x + width > _size) {
+            _shelf_y += _shelf_height;
+            _shelf_x = 0;
+            _shelf_height = 0;
+        }
+        if (_shelf_y + height > _size) {
+            clear();
+            return nullptr;
+        }
+
+        atlas_glyph entry{ _shelf_x, _shelf_y, glyph.width, glyph.height, glyph.left, glyph.top, glyph.advance };
+        for (int y = 0; y < glyph.height; y++) {
+            std::copy(glyph.coverage.begin() + static_cast<ptrdiff_t>(y) * glyph.width, glyph.coverage.begin() + static_cast<ptrdiff_t>(y + 1) * glyph.width,
+                _coverage.begin() + static_cast<ptrdiff_t>(_shelf_y + y) * _size + _shelf_x);
+        }
+        _shelf_x += width;
+        _shelf_height = std::max(_shelf_height, height);
+
+        return &(_glyphs[glyph_id(font_id, codepoint)] = entry);
+    }
+
+    auto glyph_atlas::clear() -> void
+    {
+        std::fill(_coverage.begin(), _coverage.end(), static_cast<uint8_t>(0));
+        _glyphs.clear();
+        _shelf_x = _shelf_y = _shelf_height = 0;
+        _generation++;
+    }
+
+    text_engine::text_engine(std::shared_ptr<glyph_rasterizer> rasterizer, size_t max_layouts, int atlas_size)
+        : _rasterizer(std::move(rasterizer)), _atlas(atlas_size), _max_layouts(max_layouts > 0 ? max_layouts : 1)
+    {
+    }
+
+    auto text_engine::get_font_id(const font_key &font) -> uint32_t
+    {
+        auto i = _font_ids.find(font);
+        if (i != _font_ids.end()) return i->second;
+        auto id = static_cast<uint32_t>(_font_ids.size());
+        _font_ids.emplace(font, id);
+        return id;
+    }
+
+    auto text_engine::get_metrics(const font_key &font) -> const font_metrics&
+    {
+        auto i = _font_metrics.find(font);
+        if (i == _font_metrics.end()) {
+            i = _font_metrics.emplace(font, _rasterizer->get_font_metrics(font)).first;
+        }
+        return i->second;
+    }
+
+    auto text_engine::get_glyph(uint32_t font_id, const font_key &font, uint32_t codepoint) -> const atlas_glyph*
+    {
+        auto glyph = _atlas.find(font_id, codepoint);
+        if (glyph != nullptr) return glyph;
+
+        glyph_bitmap bitmap{};
+        if (!_rasterizer->rasterize(font, codepoint, bitmap)) return nullptr;
+        _glyphs_rasterized++;
+        return _atlas.insert(font_id, codepoint, bitmap);
+    }
+
+    auto text_engine::build(const layout_key &key, bool retried) -> std::shared_ptr<const text_layout>
+    {
+        auto font_id = get_font_id(key.font);
+        auto &metrics = get_metrics(key.font);
+        auto generation = _atlas.get_generation();
+
+        // Shape: one glyph per codepoint, surrogate pairs combined
+        struct shaped {
+            uint32_t codepoint;
+            const atlas_glyph *glyph;
+        };
+        std::vector<shaped> run;
+        run.reserve(key.text.size());
+        for (size_t i = 0; i < key.text.size(); i++) {
+            uint32_t c = key.text[i];
+            if (c >= 0xd800 && c < 0xdc00 && i + 1 < key.text.size() && key.text[i + 1] >= 0xdc00 && key.text[i + 1] < 0xe000) {
+                c = 0x10000 + ((c - 0xd800) << 10) + (key.text[i + 1] - 0xdc00);
+                i++;
+            }
+            if (c == L'\r') continue;
+            run.push_back(shaped{ c, c == L'\n' ? nullptr : get_glyph(font_id, key.font, c) });
+            // The atlas started over; everything looked up so far is gone, so try again in the fresh atlas. If the text doesn't fit
+            // in an empty atlas either, the glyphs that didn't fit are left out.
+            if (_atlas.get_generation() != generation) {
+                if (!retried) return build(key, true);
+                for (auto &s : run) {
+                    s.glyph = nullptr;
+                }
+                generation = _atlas.get_generation();
+            }
+        }
+
+        // Break lines greedily at spaces; a word wider than the box gets a line of its own
+        struct line {
+            size_t first;
+            size_t last;
+            int width;
+        };
+        std::vector<line> lines;
+        auto advance = [&](size_t i) { return run[i].glyph != nullptr ? run[i].glyph->advance : 0; };
+        size_t start = 0;
+        while (start <= run.size()) {
+            int width = 0;
+            size_t end = start;
+            size_t break_at = start;
+            int break_width = 0;
+            bool hard_break = false;
+            for (; end < run.size(); end++) {
+                if (run[end].codepoint == L'\n') {
+                    hard_break = true;
+                    break;
+                }
+                if (run[end].codepoint == L' ') {
+                    break_at = end;
+                    break_width = width;
+                }
+                if (width + advance(end) > key.box_width && end > start) {
+                    if (break_at > start) {
+                        end = break_at;
+                        width = break_width;
+                    }
+                    break;
+                }
+                width += advance(end);
+            }
+            lines.push_back(line{ start, end, width });
+            if (end >= run.size()) break;
+            // Skip the space or line feed the line was broken at
+            start = (hard_break || run[end].codepoint == L' ') ? end + 1 : end;
+        }
+
+        auto layout = std::make_shared<text_layout>();
+        layout->generation = _atlas.get_generation();
+        layout->width = 0;
+        layout->height = static_cast<int>(lines.size()) * metrics.line_height;
+        layout->glyphs.reserve(run.size());
+        auto y = (key.box_height - layout->height) / 2 + metrics.ascent;
+        for (auto &l : lines) {
+            int x = 0;
+            if (key.align == text_align::center) x = (key.box_width - l.width) / 2;
+            else if (key.align == text_align::right) x = key.box_width - l.width;
+            for (auto i = l.first; i < l.last; i++) {
+                auto glyph = run[i].glyph;
+                if (glyph == nullptr) continue;
+                if (glyph->width > 0 && glyph->height > 0) {
+                    layout->glyphs.push_back(positioned_glyph{ x + glyph->left, y - glyph->top, *glyph });
+                }
+                x += glyph->advance;
+            }
+            layout->width = std::max(layout->width, l.width);
+            y += metrics.line_height;
+        }
+        _layouts_built++;
+        return layout;
+    }
+
+    auto text_engine::layout(const std::wstring &text, const text_style &style, int box_width, int box_height) -> std::shared_ptr<const text_layout>
+    {
+        layout_key key{ text, style.font, style.align, box_width, box_height };
+        auto i = _layouts.find(key);
+        if (i != _layouts.end()) {
+            if (i->second.layout->generation == _atlas.get_generation()) {
+                _layout_hits++;
+                _lru.splice(_lru.begin(), _lru, i->second.position);
+                return i->second.layout;
+            }
+            _lru.erase(i->second.position);
+            _layouts.erase(i);
+        }
+
+        auto layout = build(key);
+        _lru.push_front(key);
+        _layouts.emplace(std::move(key), cached_layout{ layout, _lru.begin() });
+        while (_layouts.size() > _max_layouts) {
+            _layouts.erase(_lru.back());
+            _lru.pop_back();
+        }
+        return layout;
+    }
+
+    auto text_engine::get_statistics() const -> text_engine_statistics
+    {
+        text_engine_statistics stats{};
+        stats.glyphs_rasterized = _glyphs_rasterized;
+        stats.layouts_built = _layouts_built;
+        stats.layout_hits = _layout_hits;
+        stats.atlas_glyphs = _atlas.get_glyph_count();
+        stats.atlas_usage = _atlas.get_usage();
+        return stats;
+    }
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace xerxes
+{
+    struct font_key {
+        std::wstring face;
+        // Pixels per em
+        int size;
+        bool bold;
+        bool italic;
+
+        auto operator<(const font_key &other) const -> bool;
+    };
+
+    struct font_metrics {
+        int ascent;
+        int descent;
+        int line_height;
+    };
+
+    // One rasterized glyph. left and top place the coverage box relative to the pen position on the baseline (top is up).
+    struct glyph_bitmap {
+        int width;
+        int height;
+        int left;
+        int top;
+        int advance;
+        std::vector<uint8_t> coverage;
+    };
+
+    // Turns characters into coverage masks; the platform font engine implements this
+    class glyph_rasterizer {
+    public:
+        virtual ~glyph_rasterizer() = default;
+
+        virtual auto get_font_metrics(const font_key &font) -> font_metrics = 0;
+        // Returns false if the font has no glyph for the codepoint
+        virtual auto rasterize(const font_key &font, uint32_t codepoint, glyph_bitmap &glyph) -> bool = 0;
+    };
+
+    // Where a glyph lives in the atlas
+    struct atlas_glyph {
+        int x;
+        int y;
+        int width;
+        int height;
+        int left;
+        int top;
+        int advance;
+    };
+
+    // 8-bit coverage masks of all the glyphs rasterized so far, packed on shelves. When the atlas is full it starts over and its
+    // generation changes, so layouts that point into it know they have to be built again.
+    class glyph_atlas {
+    private:
+        std::vector<uint8_t> _coverage;
+        int _size;
+        int _shelf_x = 0;
+        int _shelf_y = 0;
+        int _shelf_height = 0;
+        uint32_t _generation = 0;
+        std::unordered_map<uint64_t, atlas_glyph> _glyphs;
+    public:
+        explicit glyph_atlas(int size = 2048);
+
+        // nullptr if the glyph isn't in the atlas. The pointer stays valid until the generation changes.
+        auto find(uint32_t font_id, uint32_t codepoint) const -> const atlas_glyph*;
+        // Copy a rasterized glyph in. Returns nullptr, after starting over, if the atlas was full.
+        auto insert(uint32_t font_id, uint32_t codepoint, const glyph_bitmap &glyph) -> const atlas_glyph*;
+        auto clear() -> void;
+
+        inline auto row(int y) const noexcept -> const uint8_t* { return _coverage.data() + static_cast<size_t>(y) * _size; }
+        inline auto get_generation() const noexcept -> uint32_t { return _generation; }
+        inline auto get_glyph_count() const noexcept -> size_t { return _glyphs.size(); }
+        // Fraction of the atlas height in use
+        inline auto get_usage() const noexcept -> double { return static_cast<double>(_shelf_y + _shelf_height) / _size; }
+    };
+
+    enum class text_align {
+        left,
+        center,
+        right
+    };
+
+    struct text_style {
+        font_key font;
+        text_align align;
+        // Premultiplied BGRA
+        uint32_t color;
+    };
+
+    struct positioned_glyph {
+        int x;
+        int y;
+        atlas_glyph glyph;
+    };
+
+    // Text shaped and broken into lines for one box, with the glyphs positioned relative to the top left of the box. The glyphs
+    // point into the atlas of the given generation; once the atlas starts over the layout can't be drawn any more.
+    struct text_layout {
+        std::vector<positioned_glyph> glyphs;
+        int width;
+        int height;
+        uint32_t generation;
+    };
+
+    struct text_engine_statistics {
+        uint64_t glyphs_rasterized;
+        uint64_t layouts_built;
+        uint64_t layout_hits;
+        size_t atlas_glyphs;
+        double atlas_usage;
+    };
+
+    // Lays out text with a glyph atlas and a cache of finished layouts keyed by text, font, alignment and box. Showing text
+    // that was laid out before only looks it up; nothing is shaped or rasterized again.
+    // Not thread safe: use it from the compositing thread (layer prepare). Layouts and the atlas may be read concurrently
+    // while rendering tiles.
+    class text_engine {
+    private:
+        struct layout_key {
+            std::wstring text;
+            font_key font;
+            text_align align;
+            int box_width;
+            int box_height;
+
+            auto operator<(const layout_key &other) const -> bool;
+        };
+
+        using lru_list = std::list<layout_key>;
+        struct cached_layout {
+            std::shared_ptr<const text_layout> layout;
+            lru_list::iterator position;
+        };
+
+        std::shared_ptr<glyph_rasterizer> _rasterizer;
+        glyph_atlas _atlas;
+        std::map<font_key, uint32_t> _font_ids;
+        std::map<font_key, font_metrics> _font_metrics;
+        std::map<layout_key, cached_layout> _layouts;
+        lru_list _lru;
+        size_t _max_layouts;
+        uint64_t _glyphs_rasterized = 0;
+        uint64_t _layouts_built = 0;
+        uint64_t _layout_hits = 0;
+
+        auto get_font_id(const font_key &font) -> uint32_t;
+        auto get_metrics(const font_key &font) -> const font_metrics&;
+        auto get_glyph(uint32_t font_id, const font_key &font, uint32_t codepoint) -> const atlas_glyph*;
+        auto build(const layout_key &key, bool retried = false) -> std::shared_ptr<const text_layout>;
+    public:
+        explicit text_engine(std::shared_ptr<glyph_rasterizer> rasterizer, size_t max_layouts = 256, int atlas_size = 2048);
+
+        // The cached layout of text in a box_width x box_height box, laid out now if it isn't cached. Lines are broken at spaces
+        // and at line feeds; the block of lines is centred vertically.
+        auto layout(const std::wstring &text, const text_style &style, int box_width, int box_height) -> std::shared_ptr<const text_layout>;
+
+        inline auto get_atlas() const noexcept -> const glyph_atlas& { return _atlas; }
+        auto get_statistics() const -> text_engine_statistics;
+    };
+}
@@ -0,0 +1,106 @@
+#include "stdafx.h"
+#include "text_layer.h"
+#include "coverage_blend.h"
+
+#include <algorithm>
+
+namespace xerxes
+{
+    namespace
+    {
+        // Lines per canvas height when the font scales with the canvas
+        const int auto_size_lines = 14;
+        const int min_auto_size = 12;
+    }
+
+    text_layer::text_layer(std::shared_ptr<text_engine> engine, const text_style &style)
+        : _engine(std::move(engine)), _style(style), _auto_size(style.font.size == 0)
+    {
+    }
+
+    auto text_layer::changed() -> void
+    {
+        _layout_valid = false;
+        // The new text can be anywhere in the box, and so could the old
+        invalidate(_box);
+    }
+
+    auto text_layer::set_text(const std::wstring &text) -> void
+    {
+        if (text == _text) return;
+        _text = text;
+        changed();
+    }
+
+    auto text_layer::set_style(const text_style &style) -> void
+    {
+        _style = style;
+        _auto_size = style.font.size == 0;
+        update_box();
+        changed();
+    }
+
+    auto text_layer::set_box(const pixel_rect &box) -> void
+    {
+        invalidate(_box);
+        _box = box;
+        _auto_box = false;
+        changed();
+    }
+
+    auto text_layer::update_box() -> void
+    {
+        if (_auto_box) {
+            auto margin_x = _width / 20;
+            auto margin_y = _height / 20;
+            _box = pixel_rect{ margin_x, margin_y, _width - margin_x, _height - margin_y };
+        }
+        if (_auto_size) {
+            _style.font.size = std::max(min_auto_size, _height / auto_size_lines);
+        }
+    }
+
+    auto text_layer::resize(int width, int height) -> void
+    {
+        layer::resize(width, height);
+        update_box();
+        _layout_valid = false;
+    }
+
+    auto text_layer::advance(std::chrono::nanoseconds now) -> void
+    {
+        // Another layer filled the atlas and it started over; our glyphs are gone
+        if (_layout != nullptr && _layout->generation != _engine->get_atlas().get_generation()) {
+            changed();
+        }
+    }
+
+    auto text_layer::prepare(thread_pool *pool) -> void
+    {
+        if (_layout_valid) return;
+
+        _layout = _text.empty() || _box.empty() ? nullptr : _engine->layout(_text, _style, _box.width(), _box.height());
+        _layout_valid = true;
+    }
+
+    auto text_layer::render(surface &target, const pixel_rect &clip) -> void
+    {
+        if (_layout == nullptr) return;
+        auto &atlas = _engine->get_atlas();
+        if (_layout->generation != atlas.get_generation()) return;
+
+        auto area = clip.intersect(_box);
+        if (area.empty()) return;
+
+        for (auto &g : _layout->glyphs) {
+            pixel_rect r{ _box.left + g.x, _box.top + g.y, _box.left + g.x + g.glyph.width, _box.top + g.y + g.glyph.height };
+            auto visible = r.intersect(area);
+            if (visible.empty()) continue;
+
+            for (int y = visible.top; y < visible.bottom; y++) {
+                auto coverage = atlas.row(g.glyph.y + y - r.top) + g.glyph.x + (visible.left - r.left);
+                blend_coverage(target.row(y) + visible.left, coverage, visible.width(), _style.color);
+            }
+        }
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include "layer.h"
+#include "text_engine.h"
+
+namespace xerxes
+{
+    // A block of text (lyrics, scripture) laid out in a box on the canvas. Layout goes through the shared text engine in prepare,
+    // so showing text that was shown before costs a cache lookup; render only blends glyph coverage from the atlas.
+    class text_layer : public layer {
+    private:
+        std::shared_ptr<text_engine> _engine;
+        std::wstring _text;
+        text_style _style;
+        bool _auto_size;
+        // Relative to the canvas; by default the canvas less a margin
+        pixel_rect _box{ 0, 0, 0, 0 };
+        bool _auto_box = true;
+        std::shared_ptr<const text_layout> _layout;
+        bool _layout_valid = false;
+
+        auto update_box() -> void;
+        auto changed() -> void;
+    public:
+        // A font size of zero scales the font with the canvas height
+        text_layer(std::shared_ptr<text_engine> engine, const text_style &style);
+
+        auto set_text(const std::wstring &text) -> void;
+        inline auto get_text() const noexcept -> const std::wstring& { return _text; }
+        auto set_style(const text_style &style) -> void;
+        inline auto get_style() const noexcept -> const text_style& { return _style; }
+        auto set_box(const pixel_rect &box) -> void;
+
+        virtual auto resize(int width, int height) -> void override;
+        virtual auto advance(std::chrono::nanoseconds now) -> void override;
+        virtual auto prepare(thread_pool *pool) -> void override;
+        virtual auto render(surface &target, const pixel_rect &clip) -> void override;
+    };
+}
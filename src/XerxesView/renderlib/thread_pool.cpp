@@ -0,0 +1,201 @@
+#include "stdafx.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace xerxes
+{
+    namespace
+    {
+        thread_local size_t current_worker = 0;
+        thread_local task_priority current_task_priority = task_priority::high;
+    }
+
+    const size_t thread_pool::worker_queue::capacity;
+    const size_t thread_pool::priorities;
+
+    thread_pool::priority_scope::priority_scope(task_priority priority) noexcept
+        : _previous(current_task_priority)
+    {
+        current_task_priority = priority;
+    }
+
+    thread_pool::priority_scope::~priority_scope() noexcept
+    {
+        current_task_priority = _previous;
+    }
+
+    thread_pool::thread_pool(size_t threads)
+    {
+        if (threads == 0) {
+            auto cores = std::thread::hardware_concurrency();
+            threads = cores > 1 ? cores - 1 : 0;
+        }
+        // Queue 0 is shared by the threads outside the pool
+        for (size_t p = 0; p < priorities; p++) {
+            _queued[p] = 0;
+            for (size_t i = 0; i <= threads; i++) {
+                _queues[p].emplace_back(new worker_queue());
+            }
+        }
+        for (size_t i = 1; i <= threads; i++) {
+            _threads.emplace_back([this, i]() { worker(i); });
+        }
+    }
+
+    thread_pool::~thread_pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_sleep_lock);
+            _stopping = true;
+        }
+        _wake.notify_all();
+        for (auto &t : _threads) {
+            t.join();
+        }
+    }
+
+    auto thread_pool::current_thread() noexcept -> size_t
+    {
+        return current_worker;
+    }
+
+    auto thread_pool::current_priority() noexcept -> task_priority
+    {
+        return current_task_priority;
+    }
+
+    auto thread_pool::get_queued() const noexcept -> size_t
+    {
+        size_t queued = 0;
+        for (size_t p = 0; p < priorities; p++) {
+            queued += _queued[p].load(std::memory_order_acquire);
+        }
+        return queued;
+    }
+
+    auto thread_pool::try_push(size_t queue, const task &t) -> bool
+    {
+        auto &q = *_queues[static_cast<size_t>(t.priority)][queue];
+        std::lock_guard<std::mutex> lock(q.lock);
+        if (q.count == worker_queue::capacity) return false;
+        q.tasks[(q.first + q.count) % worker_queue::capacity] = t;
+        q.count++;
+        return true;
+    }
+
+    auto thread_pool::try_take(size_t queue, task_priority lowest, task &t) -> bool
+    {
+        for (size_t p = 0; p <= static_cast<size_t>(lowest); p++) {
+            if (try_take_at(p, queue, t)) return true;
+        }
+        return false;
+    }
+
+    auto thread_pool::try_take_at(size_t priority, size_t queue, task &t) -> bool
+    {
+        auto &queued = _queued[priority];
+        if (queued.load(std::memory_order_acquire) == 0) return false;
+
+        auto &queues = _queues[priority];
+        {
+            auto &own = *queues[queue];
+            std::lock_guard<std::mutex> lock(own.lock);
+            if (own.count > 0) {
+                own.count--;
+                t = own.tasks[(own.first + own.count) % worker_queue::capacity];
+                queued--;
+                return true;
+            }
+        }
+        for (size_t i = 1; i < queues.size(); i++) {
+            auto &victim = *queues[(queue + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.lock);
+            if (victim.count > 0) {
+                t = victim.tasks[victim.first];
+                victim.first = (victim.first + 1) % worker_queue::capacity;
+                victim.count--;
+                queued--;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    auto thread_pool::execute(const task &t) -> void
+    {
+        {
+            priority_scope priority(t.priority);
+            t.run(t.context, t.index);
+        }
+        t.group->remaining.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+    auto thread_pool::worker(size_t index) -> void
+    {
+        current_worker = index;
+        task t;
+        for (;;) {
+            if (try_take(index, task_priority::low, t)) {
+                execute(t);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(_sleep_lock);
+            _wake.wait(lock, [this]() { return _stopping || get_queued() > 0; });
+            if (_stopping) return;
+        }
+    }
+
+    auto thread_pool::run(size_t count, void(*fn)(void *, size_t), void *context) -> void
+    {
+        if (count == 0) return;
+        if (_threads.empty() || count == 1) {
+            for (size_t i = 0; i < count; i++) {
+                fn(context, i);
+            }
+            return;
+        }
+
+        task_group group;
+        group.remaining = count;
+
+        // Deal the tasks out over the queues; whatever doesn't fit runs on this thread
+        auto home = current_worker;
+        auto priority = current_task_priority;
+        size_t queued = 0;
+        for (size_t i = 0; i < count; i++) {
+            task t{ fn, context, i, &group, priority };
+            auto queue = (home + i) % _queues[0].size();
+            if (try_push(queue, t)) {
+                _queued[static_cast<size_t>(priority)]++;
+                queued++;
+            }
+            else {
+                execute(t);
+            }
+        }
+        if (queued > 0) {
+            // Taking the lock orders the notification after a worker that is about to sleep has checked _queued
+            { std::lock_guard<std::mutex> lock(_sleep_lock); }
+            _wake.notify_all();
+        }
+
+        // Help out until our tasks are done; tasks of other groups are fair game too, unless they are less urgent. A thread
+        // that isn't urgent itself leaves its tasks to the workers, so it never competes with urgent work for a core.
+        task t;
+        while (group.remaining.load(std::memory_order_acquire) > 0) {
+            if (try_take(home, task_priority::high, t)) {
+                execute(t);
+            }
+            else if (priority == task_priority::high) {
+                std::this_thread::yield();
+            }
+            else {
+                // Spinning would take a core from the workers
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+        }
+    }
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace xerxes
+{
+    enum class task_priority {
+        // The program output
+        high,
+        // Work that can wait for it, like the preview bus
+        low
+    };
+
+    // A fixed set of worker threads, each with its own task queue. A worker takes its newest task first and, when it runs dry,
+    // steals the oldest task of another worker. Tasks are plain function pointers in fixed size rings, so running work never allocates.
+    // Every queue is kept per priority, and no thread takes a low priority task while a high priority one is queued anywhere.
+    class thread_pool {
+    public:
+        // parallel_for queues its tasks at the priority of the calling thread, which is high unless a scope says otherwise.
+        // Tasks run at the priority they were queued with, so the work they spread inherits it.
+        class priority_scope {
+        private:
+            task_priority _previous;
+        public:
+            explicit priority_scope(task_priority priority) noexcept;
+            priority_scope(const priority_scope &) = delete;
+            auto operator=(const priority_scope &)->priority_scope& = delete;
+            ~priority_scope() noexcept;
+        };
+    private:
+        static const size_t priorities = 2;
+
+        struct task_group {
+            std::atomic<size_t> remaining;
+        };
+
+        struct task {
+            void(*run)(void *context, size_t index);
+            void *context;
+            size_t index;
+            task_group *group;
+            task_priority priority;
+        };
+
+        struct worker_queue {
+            static const size_t capacity = 1024;
+
+            std::mutex lock;
+            task tasks[capacity];
+            size_t first = 0;
+            size_t count = 0;
+        };
+
+        // Indexed by priority, then by thread
+        std::vector<std::unique_ptr<worker_queue>> _queues[priorities];
+        std::vector<std::thread> _threads;
+        std::mutex _sleep_lock;
+        std::condition_variable _wake;
+        std::atomic<size_t> _queued[priorities];
+        bool _stopping = false;
+
+        auto worker(size_t index) -> void;
+        auto try_push(size_t queue, const task &t) -> bool;
+        // The most urgent task no less urgent than lowest: at each priority the newest task of queue, then the oldest of the
+        // others. Returns false if there's nothing to do anywhere.
+        auto try_take(size_t queue, task_priority lowest, task &t) -> bool;
+        auto try_take_at(size_t priority, size_t queue, task &t) -> bool;
+        auto get_queued() const noexcept -> size_t;
+        auto execute(const task &t) -> void;
+        auto run(size_t count, void(*fn)(void *, size_t), void *context) -> void;
+
+        template <class F> static auto invoke(void *context, size_t index) -> void { (*static_cast<F*>(context))(index); }
+    public:
+        // threads is the number of workers besides the calling thread; by default one per core less the caller
+        explicit thread_pool(size_t threads = 0);
+        thread_pool(const thread_pool &) = delete;
+        auto operator=(const thread_pool &)->thread_pool& = delete;
+        ~thread_pool();
+
+        // Threads that take part in parallel_for, including the caller
+        inline auto get_concurrency() const noexcept -> size_t { return _threads.size() + 1; }
+
+        // 0 on threads outside the pool, else 1 + the worker index
+        static auto current_thread() noexcept -> size_t;
+        static auto current_priority() noexcept -> task_priority;
+
+        // Call fn(i) for every i in [0, count) and return when all calls are done. The calling thread works along, but only on
+        // high priority tasks: a high priority caller never waits behind low priority work, and a low priority one leaves its
+        // own tasks to the workers rather than take a core from the program.
+        template <class F> auto parallel_for(size_t count, F &&fn) -> void {
+            run(count, &invoke<typename std::remove_reference<F>::type>, &fn);
+        }
+    };
+}
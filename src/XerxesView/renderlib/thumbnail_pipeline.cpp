@@ -0,0 +1,161 @@
+#include "stdafx.h"
+#include "thumbnail_pipeline.h"
+#include "image_scaler.h"
+
+#include <algorithm>
+
+namespace xerxes
+{
+    thumbnail_pipeline::thumbnail_pipeline(image_decoder decoder, thumbnail_loader loader, thumbnail_saver saver, ready_callback ready, int width, int height, size_t threads, size_t max_entries)
+        : _decoder(std::move(decoder)), _loader(std::move(loader)), _saver(std::move(saver)), _ready(std::move(ready)),
+        _width(width), _height(height), _max_entries(max_entries > 0 ? max_entries : 1), _pool(threads)
+    {
+        _thread = std::thread([this]() { run(); });
+    }
+
+    thumbnail_pipeline::~thumbnail_pipeline()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            _running = false;
+        }
+        _wake.notify_all();
+        _thread.join();
+    }
+
+    auto thumbnail_pipeline::request(const std::vector<std::wstring> &paths) -> void
+    {
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            _wanted = paths;
+        }
+        _wake.notify_all();
+    }
+
+    auto thumbnail_pipeline::try_get(const std::wstring &path) -> std::shared_ptr<const surface>
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        auto i = _entries.find(path);
+        if (i == _entries.end()) return nullptr;
+        _lru.splice(_lru.begin(), _lru, i->second.position);
+        return i->second.pixels;
+    }
+
+    auto thumbnail_pipeline::take_batch(std::vector<std::wstring> &batch) -> void
+    {
+        // Enough to keep every thread busy, few enough that a scroll is picked up quickly
+        auto size = _pool.get_concurrency() * 2;
+        batch.clear();
+        size_t taken = 0;
+        for (; taken < _wanted.size() && batch.size() < size; taken++) {
+            if (_entries.find(_wanted[taken]) == _entries.end()) {
+                batch.push_back(_wanted[taken]);
+            }
+        }
+        _wanted.erase(_wanted.begin(), _wanted.begin() + taken);
+    }
+
+    auto thumbnail_pipeline::publish(const std::wstring &path, std::shared_ptr<const surface> pixels) -> void
+    {
+        auto i = _entries.find(path);
+        if (i != _entries.end()) {
+            _lru.erase(i->second.position);
+            _entries.erase(i);
+        }
+        _lru.push_front(path);
+        _entries.emplace(path, entry{ std::move(pixels), _lru.begin() });
+        while (_entries.size() > _max_entries) {
+            _entries.erase(_lru.back());
+            _lru.pop_back();
+        }
+    }
+
+    auto thumbnail_pipeline::decode(const std::wstring &path) -> std::shared_ptr<const surface>
+    {
+        surface image;
+        if (!_decoder(path, _width, _height, image) || image.empty()) return nullptr;
+
+        // Fit the box, keeping the aspect ratio; never enlarge
+        auto scale = std::min(1.0, std::min(static_cast<double>(_width) / image.width(), static_cast<double>(_height) / image.height()));
+        auto width = std::max(1, static_cast<int>(image.width() * scale + 0.5));
+        auto height = std::max(1, static_cast<int>(image.height() * scale + 0.5));
+        auto thumbnail = std::make_shared<surface>(width, height);
+        image_scaler::scale(image, *thumbnail, scale_filter::bicubic);
+        return thumbnail;
+    }
+
+    auto thumbnail_pipeline::run() -> void
+    {
+        std::vector<std::wstring> batch;
+        std::vector<std::wstring> misses;
+        std::vector<std::shared_ptr<const surface>> results;
+        decoded_thumbnails decoded;
+
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(_lock);
+                _wake.wait(lock, [this]() { return !_running || !_wanted.empty(); });
+                if (!_running) return;
+                take_batch(batch);
+                _requested += batch.size();
+            }
+            if (batch.empty()) continue;
+
+            // The store first: on a second launch that's everything, and it is shown before anything is decoded
+            misses.clear();
+            size_t loaded = 0;
+            for (auto &path : batch) {
+                auto thumbnail = std::make_shared<surface>();
+                if (_loader && _loader(path, *thumbnail)) {
+                    std::lock_guard<std::mutex> lock(_lock);
+                    publish(path, std::move(thumbnail));
+                    loaded++;
+                }
+                else {
+                    misses.push_back(path);
+                }
+            }
+            if (loaded > 0) {
+                {
+                    std::lock_guard<std::mutex> lock(_lock);
+                    _loaded += loaded;
+                }
+                if (_ready) _ready();
+            }
+            if (misses.empty()) continue;
+
+            results.assign(misses.size(), nullptr);
+            _pool.parallel_for(misses.size(), [this, &misses, &results](size_t i) { results[i] = decode(misses[i]); });
+
+            decoded.clear();
+            {
+                std::lock_guard<std::mutex> lock(_lock);
+                for (size_t i = 0; i < misses.size(); i++) {
+                    if (results[i] != nullptr) {
+                        decoded.emplace_back(misses[i], results[i]);
+                        _decoded++;
+                    }
+                    else {
+                        _failed++;
+                    }
+                    // Failures are remembered too, so they aren't decoded again on every repaint
+                    publish(misses[i], results[i]);
+                }
+            }
+            if (_saver && !decoded.empty()) _saver(decoded);
+            if (_ready) _ready();
+        }
+    }
+
+    auto thumbnail_pipeline::get_statistics() -> thumbnail_statistics
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        thumbnail_statistics stats{};
+        stats.requested = _requested;
+        stats.loaded = _loaded;
+        stats.decoded = _decoded;
+        stats.failed = _failed;
+        stats.entries = _entries.size();
+        return stats;
+    }
+}
\ No newline at end of file
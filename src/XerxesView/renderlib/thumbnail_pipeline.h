@@ -0,0 +1,96 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "surface.h"
+#include "thread_pool.h"
+
+namespace xerxes
+{
+    struct thumbnail_statistics {
+        uint64_t requested;
+        // Found in the store
+        uint64_t loaded;
+        uint64_t decoded;
+        uint64_t failed;
+        size_t entries;
+    };
+
+    // Produces thumbnails for a browser that shows a window onto thousands of files. Only what was asked for last is loaded:
+    // stored thumbnails are looked up first, and the rest is decoded and downscaled in parallel on a thread pool and handed back
+    // to be stored in one batch. The thumbnails are kept in memory, least recently used first out.
+    class thumbnail_pipeline {
+    public:
+        // Decode path into image, called concurrently on the pool's threads. The image may be smaller than the file (e.g. a
+        // reduced JPEG decode) as long as it still covers width x height.
+        using image_decoder = std::function<bool(const std::wstring &path, int width, int height, surface &image)>;
+        // Find a stored thumbnail of path. Called on the pipeline's thread only.
+        using thumbnail_loader = std::function<bool(const std::wstring &path, surface &thumbnail)>;
+        using decoded_thumbnails = std::vector<std::pair<std::wstring, std::shared_ptr<const surface>>>;
+        // Store newly decoded thumbnails. Called on the pipeline's thread only.
+        using thumbnail_saver = std::function<void(const decoded_thumbnails &thumbnails)>;
+        // More thumbnails are available. Called on the pipeline's thread.
+        using ready_callback = std::function<void()>;
+    private:
+        using lru_list = std::list<std::wstring>;
+        struct entry {
+            // nullptr if the file couldn't be decoded
+            std::shared_ptr<const surface> pixels;
+            lru_list::iterator position;
+        };
+
+        image_decoder _decoder;
+        thumbnail_loader _loader;
+        thumbnail_saver _saver;
+        ready_callback _ready;
+        int _width;
+        int _height;
+        size_t _max_entries;
+        thread_pool _pool;
+
+        std::mutex _lock;
+        std::condition_variable _wake;
+        std::map<std::wstring, entry> _entries;
+        lru_list _lru;
+        // Most wanted first
+        std::vector<std::wstring> _wanted;
+        bool _running = true;
+        uint64_t _requested = 0;
+        uint64_t _loaded = 0;
+        uint64_t _decoded = 0;
+        uint64_t _failed = 0;
+        std::thread _thread;
+
+        auto run() -> void;
+        // The next paths that are wanted and not known yet
+        auto take_batch(std::vector<std::wstring> &batch) -> void;
+        auto publish(const std::wstring &path, std::shared_ptr<const surface> pixels) -> void;
+        auto decode(const std::wstring &path) -> std::shared_ptr<const surface>;
+    public:
+        // Thumbnails fit in width x height, keeping the aspect ratio. threads, the decode threads besides the pipeline's own, is
+        // passed on to the thread pool.
+        thumbnail_pipeline(image_decoder decoder, thumbnail_loader loader, thumbnail_saver saver, ready_callback ready, int width, int height, size_t threads = 0, size_t max_entries = 2048);
+        thumbnail_pipeline(const thumbnail_pipeline &) = delete;
+        auto operator=(const thumbnail_pipeline &)->thumbnail_pipeline& = delete;
+        ~thumbnail_pipeline();
+
+        // Replace what is wanted with paths, most important first. Paths that were asked for before but weren't started are dropped.
+        auto request(const std::vector<std::wstring> &paths) -> void;
+        // nullptr if the thumbnail isn't ready, or the file couldn't be decoded
+        auto try_get(const std::wstring &path) -> std::shared_ptr<const surface>;
+
+        inline auto get_width() const noexcept -> int { return _width; }
+        inline auto get_height() const noexcept -> int { return _height; }
+        auto get_statistics() -> thumbnail_statistics;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,129 @@
+#include "stdafx.h"
+#include "tile_benchmark.h"
+#include "compositor.h"
+#include "basic_layers.h"
+#include "video_layer.h"
+#include "synthetic_media_source.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <thread>
+
+namespace xerxes
+{
+    namespace
+    {
+        // Compose options.frames frames into last, the canvas of the last frame
+        auto run_once(const tile_benchmark_options &options, thread_pool *pool, surface &last) -> tile_benchmark_run
+        {
+            tile_benchmark_run run{ pool == nullptr ? 0 : pool->get_concurrency() - 1, 0.0, 0.0, 0, 0, true };
+            auto source = std::unique_ptr<media_source>(new synthetic_media_source(options.video_width, options.video_height, 60.0));
+            auto decoder = std::make_shared<media_decoder>(std::move(source));
+            auto video = std::make_shared<video_layer>(scale_filter::bicubic);
+            compositor canvas;
+            canvas.set_thread_pool(pool);
+            canvas.add_layer(video);
+            canvas.add_layer(std::make_shared<line_overlay_layer>());
+            canvas.resize(options.width, options.height);
+            video->set_decoder(decoder, std::chrono::nanoseconds(0));
+            decoder->start();
+
+            std::vector<double> frame_ms;
+            damage_region damage;
+            for (uint64_t i = 0; i < options.frames; i++) {
+                // The video has a frame for every canvas frame; waiting for it isn't part of the time
+                auto now = std::chrono::nanoseconds(static_cast<long long>(i * 1e9 / 60.0));
+                video->wait_for_frames(now);
+                auto start = std::chrono::steady_clock::now();
+                canvas.advance(now);
+                canvas.invalidate_all();
+                canvas.compose(damage);
+                frame_ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+            }
+            decoder->stop();
+
+            // The first frames warm the caches and the tile height
+            auto warm = std::min<size_t>(frame_ms.size() / 4, 5);
+            std::vector<double> sorted(frame_ms.begin() + warm, frame_ms.end());
+            std::sort(sorted.begin(), sorted.end());
+            if (!sorted.empty()) {
+                double total = 0.0;
+                for (auto ms : sorted) {
+                    total += ms;
+                }
+                run.average_ms = total / sorted.size();
+                run.p99_ms = sorted[std::min(sorted.size() - 1, sorted.size() * 99 / 100)];
+            }
+            run.tile_height = canvas.get_tile_height();
+            run.tiles = canvas.get_tile_timings().size();
+
+            auto &target = canvas.target();
+            last.resize(target.width(), target.height());
+            for (int y = 0; y < target.height(); y++) {
+                std::memcpy(last.row(y), target.row(y), static_cast<size_t>(target.width()) * sizeof(uint32_t));
+            }
+            return run;
+        }
+
+        auto same(const surface &a, const surface &b) -> bool
+        {
+            if (a.width() != b.width() || a.height() != b.height()) return false;
+            for (int y = 0; y < a.height(); y++) {
+                if (std::memcmp(a.row(y), b.row(y), static_cast<size_t>(a.width()) * sizeof(uint32_t)) != 0) return false;
+            }
+            return true;
+        }
+    }
+
+    auto tile_benchmark_result::passed() const -> bool
+    {
+        for (auto &r : runs) {
+            if (!r.identical) return false;
+        }
+        return true;
+    }
+
+    auto tile_benchmark_result::format() const -> std::string
+    {
+        std::ostringstream out;
+        char line[256];
+        auto serial = runs.empty() ? 0.0 : runs.front().average_ms;
+        for (auto &r : runs) {
+            if (r.workers == 0) {
+                std::snprintf(line, sizeof(line), "serial          %8.2f ms, p99 %8.2f ms\n", r.average_ms, r.p99_ms);
+            }
+            else {
+                std::snprintf(line, sizeof(line), "%3llu workers + 1 %8.2f ms, p99 %8.2f ms, %.2fx, %llu tiles of %d rows%s\n",
+                    static_cast<unsigned long long>(r.workers), r.average_ms, r.p99_ms, r.average_ms > 0.0 ? serial / r.average_ms : 0.0,
+                    static_cast<unsigned long long>(r.tiles), r.tile_height, r.identical ? "" : ", DIFFERENT FROM SERIAL");
+            }
+            out << line;
+        }
+        return out.str();
+    }
+
+    auto tile_benchmark::run(const tile_benchmark_options &options) -> tile_benchmark_result
+    {
+        auto workers = options.workers;
+        if (workers.empty()) {
+            auto cores = std::max<size_t>(2, std::thread::hardware_concurrency());
+            for (size_t n = 1; n < cores; n = n * 2 + 1) {
+                workers.push_back(n);
+            }
+        }
+
+        tile_benchmark_result result;
+        surface serial, pooled;
+        result.runs.push_back(run_once(options, nullptr, serial));
+        for (auto n : workers) {
+            thread_pool pool(n);
+            auto run = run_once(options, &pool, pooled);
+            run.identical = same(serial, pooled);
+            result.runs.push_back(run);
+        }
+        return result;
+    }
+}
\ No newline at end of file
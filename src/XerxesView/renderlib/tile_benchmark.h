@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace xerxes
+{
+    struct tile_benchmark_options {
+        int width = 3840;
+        int height = 2160;
+        // The video scaled up to the canvas, a new frame every canvas frame
+        int video_width = 1920;
+        int video_height = 1080;
+        uint64_t frames = 60;
+        // The pool sizes to compare with composing serially; empty for 1, 3, 7... up to one worker per core
+        std::vector<size_t> workers;
+    };
+
+    struct tile_benchmark_run {
+        // 0 for the serial run, which has no pool
+        size_t workers;
+        double average_ms;
+        double p99_ms;
+        // Of the last frame
+        int tile_height;
+        size_t tiles;
+        // Composed the same pixels as the serial run
+        bool identical;
+    };
+
+    struct tile_benchmark_result {
+        std::vector<tile_benchmark_run> runs;
+
+        auto passed() const -> bool;
+        // One line per run, with its speedup over the serial run
+        auto format() const -> std::string;
+    };
+
+    // How composing the canvas scales over the tiles of the thread pool. A video with the overlay on top is composed into the
+    // whole canvas every frame, serially and on each pool; the frames are timed and the last one compared with the serial run's.
+    class tile_benchmark {
+    public:
+        tile_benchmark() = delete;
+
+        static auto run(const tile_benchmark_options &options) -> tile_benchmark_result;
+    };
+}
\ No newline at end of file
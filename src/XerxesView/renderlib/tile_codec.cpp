@@ -0,0 +1,287 @@
+#include "stdafx.h"
+#include "tile_codec.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace xerxes
+{
+    namespace
+    {
+        const uint32_t max_run = 0xffff;
+
+        inline auto put32(uint8_t *p, uint32_t v) noexcept -> void
+        {
+            p[0] = static_cast<uint8_t>(v);
+            p[1] = static_cast<uint8_t>(v >> 8);
+            p[2] = static_cast<uint8_t>(v >> 16);
+            p[3] = static_cast<uint8_t>(v >> 24);
+        }
+
+        inline auto get32(const uint8_t *p) noexcept -> uint32_t
+        {
+            return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 | static_cast<uint32_t>(p[2]) << 16 | static_cast<uint32_t>(p[3]) << 24;
+        }
+
+        inline auto get16(const uint8_t *p) noexcept -> uint32_t
+        {
+            return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8;
+        }
+
+        // Runs into a buffer sized for the worst case. A run is a word repeated, then the words that don't repeat.
+        class run_writer {
+        private:
+            uint8_t *_start;
+            uint8_t *_out;
+            uint8_t *_run;
+            uint32_t _word = 0;
+            uint32_t _repeats = 0;
+            uint32_t _literals = 0;
+
+            inline auto close() noexcept -> void {
+                _run[0] = static_cast<uint8_t>(_repeats);
+                _run[1] = static_cast<uint8_t>(_repeats >> 8);
+                _run[2] = static_cast<uint8_t>(_literals);
+                _run[3] = static_cast<uint8_t>(_literals >> 8);
+                put32(_run + 4, _word);
+                _run = _out;
+                _out += 8;
+                _repeats = 0;
+                _literals = 0;
+            }
+
+            inline auto repeat(uint32_t word, uint32_t count) noexcept -> void {
+                _word = word;
+                _repeats = count;
+            }
+        public:
+            explicit run_writer(uint8_t *out) noexcept : _start(out), _out(out + 8), _run(out) {}
+
+            inline auto put(uint32_t word) noexcept -> void {
+                if (_repeats == 0) {
+                    repeat(word, 1);
+                }
+                else if (_literals == 0 && word == _word) {
+                    if (_repeats == max_run) {
+                        close();
+                        repeat(word, 1);
+                    }
+                    else {
+                        _repeats++;
+                    }
+                }
+                else if (_literals >= 2 && word == get32(_out - 4) && word == get32(_out - 8)) {
+                    // Three of a kind are cheaper as a run of their own than as literals
+                    _out -= 8;
+                    _literals -= 2;
+                    close();
+                    repeat(word, 3);
+                }
+                else if (_literals == max_run) {
+                    close();
+                    repeat(word, 1);
+                }
+                else {
+                    put32(_out, word);
+                    _out += 4;
+                    _literals++;
+                }
+            }
+
+            // The bytes written
+            inline auto finish() noexcept -> size_t {
+                if (_repeats > 0) {
+                    close();
+                }
+                return static_cast<size_t>(_run - _start);
+            }
+        };
+    }
+
+    const uint32_t tile_codec::magic;
+    const uint32_t tile_codec::key_frame;
+    const int tile_codec::tile_size;
+    const uint32_t tile_codec::max_dimension;
+
+    auto tile_codec::get_tile(int width, int height, uint32_t tile) noexcept -> pixel_rect
+    {
+        auto columns = static_cast<uint32_t>(get_columns(width));
+        auto x = static_cast<int>(tile % columns) * tile_size;
+        auto y = static_cast<int>(tile / columns) * tile_size;
+        return pixel_rect{ x, y, std::min(x + tile_size, width), std::min(y + tile_size, height) };
+    }
+
+    auto tile_encoder::encode(const surface &canvas, const damage_region &damage, uint64_t index, std::vector<uint8_t> &message) -> uint32_t
+    {
+        message.clear();
+        auto key = _previous.width() != canvas.width() || _previous.height() != canvas.height();
+        if (key) {
+            _previous.resize(canvas.width(), canvas.height());
+            _previous.clear(0);
+        }
+        if (canvas.empty()) return 0;
+
+        message.resize(sizeof(frame_header));
+        auto columns = tile_codec::get_columns(canvas.width());
+        auto rows = tile_codec::get_rows(canvas.height());
+        // The damage is a handful of rectangles, so marking the tiles they touch is cheaper than testing every tile against them
+        std::vector<bool> touched(static_cast<size_t>(columns) * rows, key);
+        for (auto &r : damage.rects()) {
+            auto area = r.intersect(canvas.bounds());
+            if (area.empty()) continue;
+            for (int ty = area.top / tile_codec::tile_size; ty <= (area.bottom - 1) / tile_codec::tile_size; ty++) {
+                for (int tx = area.left / tile_codec::tile_size; tx <= (area.right - 1) / tile_codec::tile_size; tx++) {
+                    touched[static_cast<size_t>(ty) * columns + tx] = true;
+                }
+            }
+        }
+
+        uint32_t tiles = 0;
+        for (size_t t = 0; t < touched.size(); t++) {
+            if (!touched[t]) continue;
+
+            // Damaged isn't the same as changed: a layer redrawn with the same pixels, or a video of a static scene
+            auto rect = tile_codec::get_tile(canvas.width(), canvas.height(), static_cast<uint32_t>(t));
+            auto bytes = static_cast<size_t>(rect.width()) * sizeof(uint32_t);
+            auto same = !key;
+            for (int y = rect.top; same && y < rect.bottom; y++) {
+                same = std::memcmp(canvas.row(y) + rect.left, _previous.row(y) + rect.left, bytes) == 0;
+            }
+            if (same) continue;
+
+            append_tile(canvas, static_cast<uint32_t>(t), false, message);
+            tiles++;
+        }
+
+        if (tiles == 0) {
+            message.clear();
+            return 0;
+        }
+        finish(index, key ? tile_codec::key_frame : 0, tiles, message);
+        return tiles;
+    }
+
+    auto tile_encoder::encode_key(uint64_t index, std::vector<uint8_t> &message) -> void
+    {
+        message.clear();
+        if (_previous.empty()) return;
+
+        message.resize(sizeof(frame_header));
+        auto count = static_cast<uint32_t>(tile_codec::get_columns(_previous.width()) * tile_codec::get_rows(_previous.height()));
+        for (uint32_t t = 0; t < count; t++) {
+            append_tile(_previous, t, true, message);
+        }
+        finish(index, tile_codec::key_frame, count, message);
+    }
+
+    auto tile_encoder::append_tile(const surface &canvas, uint32_t tile, bool key, std::vector<uint8_t> &message) -> void
+    {
+        auto rect = tile_codec::get_tile(canvas.width(), canvas.height(), tile);
+        auto words = static_cast<size_t>(rect.area());
+        // A run header for every word is the worst case
+        auto at = message.size();
+        message.resize(at + 8 + words * 8 + 8);
+
+        run_writer runs(message.data() + at + 8);
+        for (int y = rect.top; y < rect.bottom; y++) {
+            auto src = canvas.row(y) + rect.left;
+            auto previous = _previous.row(y) + rect.left;
+            for (int x = 0; x < rect.width(); x++) {
+                runs.put(key ? src[x] : src[x] ^ previous[x]);
+            }
+            if (!key) {
+                std::memcpy(previous, src, static_cast<size_t>(rect.width()) * sizeof(uint32_t));
+            }
+        }
+        auto size = runs.finish();
+        put32(message.data() + at, tile);
+        put32(message.data() + at + 4, static_cast<uint32_t>(size));
+        message.resize(at + 8 + size);
+    }
+
+    auto tile_encoder::finish(uint64_t index, uint32_t flags, uint32_t tiles, std::vector<uint8_t> &message) -> void
+    {
+        frame_header header{ tile_codec::magic, flags, static_cast<uint32_t>(_previous.width()), static_cast<uint32_t>(_previous.height()), index, tiles,
+            static_cast<uint32_t>(message.size() - sizeof(frame_header)) };
+        std::memcpy(message.data(), &header, sizeof(header));
+    }
+
+    auto tile_decoder::is_valid(const frame_header &header) noexcept -> bool
+    {
+        if (header.magic != tile_codec::magic || header.width == 0 || header.height == 0) return false;
+        if (header.width > tile_codec::max_dimension || header.height > tile_codec::max_dimension) return false;
+
+        // No more than every tile, each no bigger than the worst case of the encoder
+        auto count = static_cast<uint64_t>(tile_codec::get_columns(static_cast<int>(header.width))) * tile_codec::get_rows(static_cast<int>(header.height));
+        return header.tiles <= count && header.bytes <= static_cast<uint64_t>(header.width) * header.height * 8 + count * 16;
+    }
+
+    auto tile_decoder::try_apply(const frame_header &header, const uint8_t *payload) -> bool
+    {
+        if (!is_valid(header)) return false;
+
+        auto width = static_cast<int>(header.width);
+        auto height = static_cast<int>(header.height);
+        if ((header.flags & tile_codec::key_frame) != 0) {
+            _frame.resize(width, height);
+            _frame.clear(0);
+            _has_key = true;
+        }
+        else if (!_has_key || width != _frame.width() || height != _frame.height()) {
+            return false;
+        }
+
+        auto count = static_cast<uint32_t>(tile_codec::get_columns(width) * tile_codec::get_rows(height));
+        auto p = payload;
+        auto end = payload + header.bytes;
+        for (uint32_t i = 0; i < header.tiles; i++) {
+            if (end - p < 8) return false;
+            auto tile = get32(p);
+            auto size = get32(p + 4);
+            p += 8;
+            if (tile >= count || static_cast<uint32_t>(end - p) < size) return false;
+
+            auto rect = tile_codec::get_tile(width, height, tile);
+            auto tile_end = p + size;
+            int x = 0;
+            int y = rect.top;
+            auto remaining = static_cast<uint64_t>(rect.area());
+            while (p < tile_end) {
+                if (tile_end - p < 8) return false;
+                auto repeats = get16(p);
+                auto literals = get16(p + 2);
+                auto word = get32(p + 4);
+                p += 8;
+                if (repeats + literals > remaining || static_cast<uint64_t>(tile_end - p) < literals * 4ull) return false;
+                remaining -= repeats + literals;
+
+                // Zeroes leave the pixels as they were
+                if (word == 0) {
+                    x += static_cast<int>(repeats);
+                    y += x / rect.width();
+                    x %= rect.width();
+                }
+                else {
+                    for (uint32_t r = 0; r < repeats; r++) {
+                        _frame.row(y)[rect.left + x] ^= word;
+                        if (++x == rect.width()) {
+                            x = 0;
+                            y++;
+                        }
+                    }
+                }
+                for (uint32_t l = 0; l < literals; l++) {
+                    _frame.row(y)[rect.left + x] ^= get32(p);
+                    p += 4;
+                    if (++x == rect.width()) {
+                        x = 0;
+                        y++;
+                    }
+                }
+            }
+        }
+        if (p != end) return false;
+        _index = header.index;
+        return true;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "surface.h"
+#include "damage_region.h"
+
+namespace xerxes
+{
+    // A message of the frame stream is a frame_header followed by header.bytes of tile records. The canvas is cut into
+    // tile_size squares, numbered row by row, the last row and column cut short. A record is the tile number and the byte
+    // count of its data, both uint32, then the tile's pixels XORed with the previous frame's, row by row, as runs: a uint16
+    // count of repeats, a uint16 count of literals, the uint32 word repeated and the literal words. Unchanged pixels are
+    // repeated zeroes, a flat background a repeated color. Tiles that didn't change aren't sent. A key frame is XORed with
+    // zeroes, so it stands on its own. Everything is little endian.
+    struct frame_header {
+        uint32_t magic;
+        uint32_t flags;
+        uint32_t width;
+        uint32_t height;
+        uint64_t index;
+        uint32_t tiles;
+        uint32_t bytes;
+    };
+    static_assert(sizeof(frame_header) == 32, "frame_header is sent as it is laid out");
+
+    class tile_codec {
+    public:
+        tile_codec() = delete;
+
+        static const uint32_t magic = 0x31465658;
+        static const uint32_t key_frame = 1;
+        static const int tile_size = 64;
+        // Nobody sends a canvas larger than 8K
+        static const uint32_t max_dimension = 8192;
+
+        static inline auto get_columns(int width) noexcept -> int { return (width + tile_size - 1) / tile_size; }
+        static inline auto get_rows(int height) noexcept -> int { return (height + tile_size - 1) / tile_size; }
+        static auto get_tile(int width, int height, uint32_t tile) noexcept -> pixel_rect;
+    };
+
+    // Encodes a canvas against the frame the receivers already have
+    class tile_encoder {
+    private:
+        // What the receivers have after the last message
+        surface _previous;
+
+        auto append_tile(const surface &canvas, uint32_t tile, bool key, std::vector<uint8_t> &message) -> void;
+        auto finish(uint64_t index, uint32_t flags, uint32_t tiles, std::vector<uint8_t> &message) -> void;
+    public:
+        // Encode the tiles damage touches that differ from the previous frame into message. Returns how many there were;
+        // with none, message is left empty and nothing needs sending. A canvas of a new size is sent as a key frame.
+        auto encode(const surface &canvas, const damage_region &damage, uint64_t index, std::vector<uint8_t> &message) -> uint32_t;
+        // The frame the receivers have now as a key frame, for a receiver that just connected. Empty if nothing was encoded yet.
+        auto encode_key(uint64_t index, std::vector<uint8_t> &message) -> void;
+    };
+
+    // Rebuilds the canvas from the messages of a stream
+    class tile_decoder {
+    private:
+        surface _frame;
+        bool _has_key = false;
+        uint64_t _index = 0;
+    public:
+        // Whether a header can start a message of this stream, before its payload is read
+        static auto is_valid(const frame_header &header) noexcept -> bool;
+
+        // Apply a message. Returns false if it is malformed, or if a delta arrives before the first key frame.
+        auto try_apply(const frame_header &header, const uint8_t *payload) -> bool;
+
+        inline auto has_frame() const noexcept -> bool { return _has_key; }
+        inline auto get_frame() const noexcept -> const surface& { return _frame; }
+        inline auto get_index() const noexcept -> uint64_t { return _index; }
+    };
+}
\ No newline at end of file
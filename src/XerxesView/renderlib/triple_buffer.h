@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include "padded.h"
+
+namespace xerxes
+{
+    // Hands the latest value from one producer to one consumer without either side ever waiting on the other. The producer
+    // fills the back slot and publishes it by swapping it with the middle one; the consumer swaps the middle slot with its front
+    // one whenever a newer value was published. Values the consumer didn't get to in time are overwritten, never queued.
+    template<typename T> class triple_buffer {
+    private:
+        // The slot index in the low bits, with fresh_bit set when the producer published since the consumer last took it
+        static const uint32_t fresh_bit = 4;
+
+        T _slots[3];
+        // Each index on its own cache line
+        padded<std::atomic<uint32_t>> _middle;
+        // Each only touched by its own side
+        padded<uint32_t> _back;
+        padded<uint32_t> _front;
+    public:
+        triple_buffer() noexcept : _middle(1), _back(0), _front(2) {}
+        triple_buffer(const triple_buffer &) = delete;
+        auto operator=(const triple_buffer &)->triple_buffer& = delete;
+
+        // Producer only: the slot to write the next value into
+        inline auto back() noexcept -> T& { return _slots[_back.value]; }
+        // Producer only. Returns true if the previous value was never taken.
+        inline auto publish() noexcept -> bool {
+            auto previous = _middle.value.exchange(_back.value | fresh_bit, std::memory_order_acq_rel);
+            _back.value = previous & ~fresh_bit;
+            return (previous & fresh_bit) != 0;
+        }
+
+        // Consumer only: take the latest published value, if it is newer than front(). Returns false if nothing was published since.
+        inline auto try_update() noexcept -> bool {
+            if ((_middle.value.load(std::memory_order_relaxed) & fresh_bit) == 0) return false;
+            auto previous = _middle.value.exchange(_front.value, std::memory_order_acq_rel);
+            _front.value = previous & ~fresh_bit;
+            return true;
+        }
+        // Consumer only: the value taken last. Stays valid and unchanged until the next try_update.
+        inline auto front() noexcept -> T& { return _slots[_front.value]; }
+    };
+
+    template<typename T> const uint32_t triple_buffer<T>::fresh_bit;
+}
\ No newline at end of file
@@ -0,0 +1,165 @@
+#include "stdafx.h"
+#include "video_layer.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace xerxes
+{
+    auto video_layer::set_decoder(std::shared_ptr<media_decoder> decoder, std::chrono::nanoseconds cued_at) -> void
+    {
+        _current.reset();
+        _decoder = std::move(decoder);
+        _started = false;
+        _position = std::chrono::nanoseconds(0);
+        _cue_pending = _decoder != nullptr;
+        _cued_at = cued_at;
+        _scaled_valid = false;
+        update_placement();
+        invalidate_all();
+    }
+
+    auto video_layer::set_still(frame_ref frame) -> void
+    {
+        auto same = _current == nullptr ? frame == nullptr : frame != nullptr && &*frame == &*_current;
+        if (_decoder == nullptr && same) return;
+
+        _decoder.reset();
+        _current = std::move(frame);
+        _cue_pending = false;
+        _scaled_valid = false;
+        update_placement();
+        invalidate_all();
+    }
+
+    auto video_layer::set_playing(bool playing) -> void
+    {
+        _playing = playing;
+        // Don't count the paused time as playback when resuming
+        _started = false;
+    }
+
+    auto video_layer::resize(int width, int height) -> void
+    {
+        layer::resize(width, height);
+        _scaled_valid = false;
+        update_placement();
+    }
+
+    auto video_layer::update_placement() -> void
+    {
+        if ((_decoder == nullptr && _current == nullptr) || _width <= 0 || _height <= 0) {
+            _placement = pixel_rect{ 0, 0, 0, 0 };
+            return;
+        }
+
+        // A still has no decoder, so its own size is the media's
+        auto width = _decoder != nullptr ? _decoder->get_info().width : _current->pixels.width();
+        auto height = _decoder != nullptr ? _decoder->get_info().height : _current->pixels.height();
+        if (width <= 0 || height <= 0) {
+            _placement = pixel_rect::from_size(_width, _height);
+            return;
+        }
+
+        // Letterbox or pillarbox
+        auto w = _width;
+        auto h = static_cast<int>(static_cast<long long>(w) * height / width);
+        if (h > _height) {
+            h = _height;
+            w = static_cast<int>(static_cast<long long>(h) * width / height);
+        }
+        auto x = (_width - w) / 2;
+        auto y = (_height - h) / 2;
+        _placement = pixel_rect{ x, y, x + w, y + h };
+    }
+
+    auto video_layer::advance(std::chrono::nanoseconds now) -> void
+    {
+        if (_decoder == nullptr) return;
+
+        if (_playing) {
+            if (_started) {
+                _position += now - _last_tick;
+            }
+            _started = true;
+            _last_tick = now;
+        }
+
+        // Take the newest frame that is due; frames we were too late for are skipped
+        auto &queue = _decoder->get_queue();
+        std::chrono::nanoseconds timestamp;
+        bool changed = false;
+        while (queue.peek_timestamp(timestamp) && (timestamp <= _position || _current == nullptr)) {
+            if (_current == nullptr) {
+                // The timeline starts wherever the decoder was positioned
+                _position = std::max(_position, timestamp);
+                if (_cue_pending) {
+                    _cue_latency = now - _cued_at;
+                    _cue_pending = false;
+                }
+            }
+            _current = queue.pop();
+            changed = true;
+        }
+
+        if (changed) {
+            _scaled_valid = false;
+            invalidate(_placement);
+        }
+    }
+
+    auto video_layer::wait_for_frames(std::chrono::nanoseconds now) -> void
+    {
+        if (_decoder == nullptr) return;
+
+        // Where advance will move the position to
+        auto position = _position;
+        if (_playing && _started) {
+            position += now - _last_tick;
+        }
+
+        // Once a frame past the position is queued, every frame due before it is too. A full queue can't grow, so what is
+        // queued then is all advance gets either way.
+        auto &queue = _decoder->get_queue();
+        while (!_decoder->get_end_of_stream() && queue.size() < queue.capacity()) {
+            std::chrono::nanoseconds oldest, newest;
+            if (queue.peek_timestamp(oldest) && queue.peek_newest_timestamp(newest)) {
+                auto due = _current == nullptr ? std::max(position, oldest) : position;
+                if (newest > due) break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    auto video_layer::prepare(thread_pool *pool) -> void
+    {
+        if (_current == nullptr || _placement.empty() || _scaled_valid) return;
+
+        auto &pixels = _current->pixels;
+        if (pixels.width() != _placement.width() || pixels.height() != _placement.height()) {
+            _scaled.resize(_placement.width(), _placement.height());
+            image_scaler::scale(pixels, _scaled, _filter, pool);
+        }
+        _scaled_valid = true;
+    }
+
+    auto video_layer::render(surface &target, const pixel_rect &clip) -> void
+    {
+        if (_current == nullptr || _placement.empty()) return;
+
+        auto area = clip.intersect(_placement);
+        if (area.empty()) return;
+
+        // A frame that already fits is composed straight from the decoder's buffer
+        auto &pixels = _current->pixels;
+        const surface *source = &pixels;
+        if (pixels.width() != _placement.width() || pixels.height() != _placement.height()) {
+            source = &_scaled;
+        }
+
+        for (int y = area.top; y < area.bottom; y++) {
+            auto src = source->row(y - _placement.top) + (area.left - _placement.left);
+            std::copy(src, src + area.width(), target.row(y) + area.left);
+        }
+    }
+}
\ No newline at end of file
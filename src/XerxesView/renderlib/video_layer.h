@@ -0,0 +1,55 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include "layer.h"
+#include "media_decoder.h"
+#include "image_scaler.h"
+
+namespace xerxes
+{
+    // Shows the frames of a media decoder, fitted to the canvas with the aspect ratio preserved
+    class video_layer : public layer {
+    private:
+        std::shared_ptr<media_decoder> _decoder;
+        frame_ref _current;
+        surface _scaled;
+        pixel_rect _placement{ 0, 0, 0, 0 };
+        bool _scaled_valid = false;
+        bool _playing = true;
+        bool _started = false;
+        std::chrono::nanoseconds _position{ 0 };
+        std::chrono::nanoseconds _last_tick{ 0 };
+        bool _cue_pending = false;
+        std::chrono::nanoseconds _cued_at{ 0 };
+        std::chrono::nanoseconds _cue_latency{ 0 };
+        scale_filter _filter;
+
+        auto update_placement() -> void;
+    public:
+        explicit video_layer(scale_filter filter = scale_filter::bicubic) : _filter(filter) {}
+
+        // Show another decoder from its current position. Passing nullptr clears the layer. cued_at is when the switch was asked
+        // for, on the same clock advance gets; the time until its first frame is presented is reported by get_cue_latency.
+        auto set_decoder(std::shared_ptr<media_decoder> decoder, std::chrono::nanoseconds cued_at = std::chrono::nanoseconds(0)) -> void;
+        inline auto get_decoder() const noexcept -> const std::shared_ptr<media_decoder>& { return _decoder; }
+        // Show one frame, e.g. a cue's first frame before it plays, without a decoder. Passing an empty reference clears the layer.
+        auto set_still(frame_ref frame) -> void;
+
+        auto set_playing(bool playing) -> void;
+        inline auto get_playing() const noexcept -> bool { return _playing; }
+        inline auto get_position() const noexcept -> std::chrono::nanoseconds { return _position; }
+        inline auto get_cue_latency() const noexcept -> std::chrono::nanoseconds { return _cue_latency; }
+        // The frame on screen. Other outputs can keep a reference to show the same pixels without copying them.
+        inline auto get_frame() const noexcept -> const frame_ref& { return _current; }
+
+        // Block until the decoder has every frame advance(now) would show, or has run out. Real outputs show whatever is ready;
+        // this is for runs that have to show the same frames every time.
+        auto wait_for_frames(std::chrono::nanoseconds now) -> void;
+
+        virtual auto resize(int width, int height) -> void override;
+        virtual auto advance(std::chrono::nanoseconds now) -> void override;
+        virtual auto prepare(thread_pool *pool) -> void override;
+        virtual auto render(surface &target, const pixel_rect &clip) -> void override;
+    };
+}
\ No newline at end of file